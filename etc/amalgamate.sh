@@ -0,0 +1,63 @@
+#!/bin/sh
+#
+# Generates the single header build of rldisplay from the sources in src/ and
+# writes it to stdout.
+#
+# Usage: etc/amalgamate.sh > rl_display.h
+#
+# The generated header declares the API like src/rl_display.h does. Defining
+# RL_DISPLAY_IMPLEMENTATION in exactly one translation unit before including
+# it also compiles the shared sources and the backend selected with
+# RL_DISPLAY_<BACKEND>, e.g. RL_DISPLAY_SFML for src/rl_display_sfml.c, which
+# is also the default. Since everything then lives in that translation unit,
+# the compiler is free to inline the hot paths into the calling code.
+
+cd "$(dirname "$0")/.." || exit 1
+
+shared="src/rl_display_hue.c"
+backends=$(ls src/rl_display_*.c | grep -v -e '_hue\.c$')
+
+# Prints a source file without its include of rl_display.h, keeping its line
+# numbers intact for the #line directive in front of it
+emit()
+{
+    printf '\n#line 1 "%s"\n' "$1"
+    sed -e 's/^#include "rl_display\.h"$//' "$1"
+}
+
+# Maps src/rl_display_sfml.c to RL_DISPLAY_SFML
+backend()
+{
+    basename "$1" .c | tr '[:lower:]' '[:upper:]'
+}
+
+printf '/* rl_display.h - single header build of rldisplay, generated by\n'
+printf '   etc/amalgamate.sh. Do not edit, edit the sources in src/ instead. */\n\n'
+
+cat src/rl_display.h
+
+printf '\n#ifdef RL_DISPLAY_IMPLEMENTATION\n'
+printf '#ifndef RL_DISPLAY_IMPLEMENTED\n'
+printf '#define RL_DISPLAY_IMPLEMENTED\n\n'
+
+# Default to the CSFML backend when none is selected
+printf '#if'
+sep=' '
+for b in $backends; do
+    printf '%s!defined(%s)' "$sep" "$(backend "$b")"
+    sep=' && '
+done
+printf '\n#define %s\n#endif\n' "$(backend "$(echo "$backends" | grep sfml)")"
+
+for f in $shared; do
+    emit "$f"
+done
+
+for b in $backends; do
+    printf '\n#if defined(%s)\n' "$(backend "$b")"
+    emit "$b"
+    printf '\n#endif /* %s */\n' "$(backend "$b")"
+done
+
+printf '\n#endif /* RL_DISPLAY_IMPLEMENTED */\n'
+printf '#endif /* RL_DISPLAY_IMPLEMENTATION */\n'
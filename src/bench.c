@@ -0,0 +1,632 @@
+/*
+ * Benchmarks for the hot paths of the library.
+ *
+ * Every case is run for a few warmup repetitions and then timed over a fixed
+ * number of repetitions, reporting the minimum and median time per unit of
+ * work in nanoseconds. The cases cover tile, hue and string writes, full map
+ * rewrites, tile prototype ID writes (see rltmap_proto) and the cost of
+ * drawing and presenting a frame over a range of map sizes, once with full
+ * vertex storage and once with compact storage (see rltmap_cmpct), plus the
+ * scene of main.c as a fixed seed workload and the insertion of GLYPHS glyphs
+ * that miss the glyph cache, into an empty atlas and through a full one that
+ * has to evict (see rltmap_atlas). A window is required, so on a headless
+ * machine run it under Xvfb (e.g. xvfb-run) with a software GL driver such as
+ * llvmpipe.
+ *
+ * The output is JSON, so runs can be stored and diffed against a baseline.
+ *
+ * When compiled with BENCH_SINGLE defined, the library is compiled into this
+ * file from the single header build (see etc/amalgamate.sh) instead of being
+ * linked, which lets the compiler inline the library calls. Comparing both
+ * builds shows the gain from inlining. BENCH_BACKEND names the backend linked
+ * in for the output, so runs of the same cases on different backends can be
+ * told apart.
+ *
+ * Usage: bench [reps] [seed]
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+#include <stdio.h>
+#include <wchar.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef BENCH_SINGLE
+#define RL_DISPLAY_IMPLEMENTATION
+#include <rl_display.h>
+#define BENCH_BUILD "single"
+#else
+#include "rl_display.h"
+#define BENCH_BUILD "split"
+#endif
+
+#ifndef BENCH_BACKEND
+#define BENCH_BACKEND "sfml"
+#endif
+
+#define WARMUP 3
+
+#define FONT "res/fonts/unifont.ttf"
+
+/* Glyphs inserted by the glyph cases, taken from the CJK ideographs so every
+   one of them is a distinct cache miss */
+#define GLYPHS 10000
+#define GLYPH_FIRST 0x4E00
+
+/* Map the eviction case streams its glyphs through, whose tiles are fewer
+   than the glyphs its atlas holds */
+#define EVICT_WIDTH 40
+#define EVICT_HEIGHT 5
+
+/* Tile prototypes registered for the ID write cases */
+#define PROTOS 256
+
+enum {
+    C_PTILE, C_PHUEF, C_PHUEB, C_HUESET, C_WSTRR, C_REWRITE, C_PID, C_PGRID,
+    C_FRAME, C_COUNT
+};
+
+static const char *cnames[C_COUNT] = {
+    "ptile", "phuef", "phueb", "hueset", "wstrr", "rewrite", "pid", "pgrid",
+    "frame"
+};
+
+static const char *cunits[C_COUNT] = {
+    "ns/tile", "ns/tile", "ns/tile", "ns/hue", "ns/char", "ns/map", "ns/tile",
+    "ns/map", "ns/frame"
+};
+
+static const int sizes[][2] = {
+    {80, 25}, {128, 64}, {256, 128}, {512, 512}
+};
+
+struct bench
+{
+    rldisp *disp;
+    rltmap *tmap;
+    rltile *tile;
+    rlcell *cells;
+    rlhue *hues;
+    wchar_t *wstr;
+    uint16_t *ids;
+    int width;
+    int height;
+};
+
+static bool first = true;
+
+static double
+now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec * 1000000000.0 + (double)t.tv_nsec;
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+static void
+fill(struct bench *b)
+{
+    int count = b->width * b->height;
+
+    for (int i = 0; i < count; ++i)
+    {
+        b->hues[i] = (rlhue){(uint8_t)rand(), (uint8_t)rand(),
+            (uint8_t)rand(), 255};
+        b->cells[i] = (rlcell){(wchar_t)(L'!' + rand() % 94), b->hues[i],
+            (rlhue){(uint8_t)rand(), (uint8_t)rand(), (uint8_t)rand(), 255},
+            0.0f, 0.0f, RL_TILE_CENTER};
+        b->wstr[i] = b->cells[i].glyph;
+    }
+
+    b->wstr[count] = L'\0';
+
+    /* After the cells, so they are the same as without the ID cases */
+    for (int i = 0; i < count; ++i)
+        b->ids[i] = (uint16_t)(rand() % PROTOS);
+}
+
+static void
+run(struct bench *b, int c, int rep)
+{
+    int i = 0;
+
+    switch (c)
+    {
+    case C_PTILE:
+        for (int y = 0; y < b->height; ++y)
+        for (int x = 0; x < b->width; ++x)
+        {
+            rltile_glyph(b->tile, b->cells[(i++ + rep) % (b->width
+                * b->height)].glyph);
+            rltmap_ptile(b->tmap, b->tile, x, y);
+        }
+        break;
+    case C_PHUEF:
+        for (int y = 0; y < b->height; ++y)
+        for (int x = 0; x < b->width; ++x)
+            rltmap_phuef(b->tmap, b->hues[i++], x, y);
+        break;
+    case C_PHUEB:
+        for (int y = 0; y < b->height; ++y)
+        for (int x = 0; x < b->width; ++x)
+            rltmap_phueb(b->tmap, b->hues[i++], x, y);
+        break;
+    case C_HUESET:
+        for (i = 0; i < b->width * b->height; ++i)
+            rlhue_set(&b->hues[i], (uint8_t)i, (uint8_t)rep, (uint8_t)(i + rep),
+                255);
+        break;
+    case C_WSTRR:
+        rltmap_wstrr(b->tmap, b->wstr, b->hues[rep % 7], b->hues[rep % 5],
+            RL_TILE_TEXT, 0, 0);
+        break;
+    case C_REWRITE:
+        rltmap_pcells(b->tmap, b->cells, 0, 0, b->width, b->height);
+        break;
+    case C_PID:
+        for (int y = 0; y < b->height; ++y)
+        for (int x = 0; x < b->width; ++x)
+            rltmap_pid(b->tmap, b->ids[(i++ + rep) % (b->width * b->height)],
+                x, y);
+        break;
+    case C_PGRID:
+        rltmap_pgrid(b->tmap, b->ids, 0, 0, b->width, b->height);
+        break;
+    case C_FRAME:
+        rldisp_evtflsh(b->disp);
+        rldisp_clear(b->disp);
+        rldisp_dtmap(b->disp, b->tmap);
+        rldisp_prsnt(b->disp);
+        break;
+    }
+}
+
+static void
+report(const char *name, int width, int height, bool compact,
+    const char *unit, double *times, int reps, double per)
+{
+    qsort(times, (size_t)reps, sizeof(double), cmp);
+
+    printf("%s    {\"case\": \"%s\", \"width\": %d, \"height\": %d, "
+        "\"storage\": \"%s\", \"unit\": \"%s\", \"min\": %.2f, "
+        "\"median\": %.2f}", first ? "" : ",\n", name, width, height,
+        compact ? "compact" : "full", unit, times[0] / per,
+        times[reps / 2] / per);
+    first = false;
+}
+
+static bool
+bench_size(rldisp *disp, int width, int height, bool compact, int reps,
+    unsigned seed, double *times)
+{
+    double t0, per;
+    int count = width * height;
+    struct bench b = {disp, NULL, NULL, NULL, NULL, NULL, NULL, width,
+        height};
+
+    if (!(b.tmap = rltmap_init(FONT, 16, 65536, width, height, 8, 16)))
+        return false;
+
+    /* Backends with a single storage mode skip the cases of the other */
+    if (rltmap_cmpct(b.tmap, compact) != compact)
+    {
+        rltmap_free(b.tmap);
+        return true;
+    }
+
+    if (!(b.tile = rltile_init(L'@', (rlhue){255, 255, 255, 255},
+            (rlhue){0, 0, 0, 255}, RL_TILE_CENTER, 0.0f, 0.0f))
+        || !(b.cells = malloc((size_t)count * sizeof(rlcell)))
+        || !(b.hues = malloc((size_t)count * sizeof(rlhue)))
+        || !(b.wstr = malloc((size_t)(count + 1) * sizeof(wchar_t)))
+        || !(b.ids = malloc((size_t)count * sizeof(uint16_t))))
+        goto error;
+
+    srand(seed);
+    fill(&b);
+
+    /* Rasterize every glyph used once so glyph misses don't skew the cases */
+    rltmap_pcells(b.tmap, b.cells, 0, 0, width, height);
+
+    for (int i = 0; i < PROTOS; ++i)
+        if (rltmap_proto(b.tmap, b.cells[i]) < 0)
+            goto error;
+
+    for (int c = 0; c < C_COUNT; ++c)
+    {
+        per = (c == C_REWRITE || c == C_PGRID || c == C_FRAME) ? 1.0
+            : (double)count;
+
+        for (int r = 0; r < WARMUP + reps; ++r)
+        {
+            t0 = now();
+            run(&b, c, r);
+            t0 = now() - t0;
+
+            if (r >= WARMUP)
+                times[r - WARMUP] = t0;
+        }
+
+        report(cnames[c], width, height, compact, cunits[c], times, reps,
+            per);
+    }
+
+    rltmap_free(b.tmap);
+    rltile_free(b.tile);
+    free(b.cells);
+    free(b.hues);
+    free(b.wstr);
+    free(b.ids);
+
+    return true;
+
+error:
+
+    rltmap_free(b.tmap);
+    rltile_free(b.tile);
+    free(b.cells);
+    free(b.hues);
+    free(b.wstr);
+    free(b.ids);
+
+    return false;
+}
+
+/* The scene of main.c: a 60x60 map of grass with a house, a menu box and a
+   cursor, with the light map following a wandering mouse position and the
+   view being regenerated every 30 frames. */
+static void
+scene_view(rltmap *view)
+{
+    int housex, housey;
+    rlcell cell = {L'?', {0, 0, 0, 255}, {0, 0, 0, 255}, 0.0f, 0.0f,
+        RL_TILE_CENTER};
+
+    for (int i = 0; i < 60; ++i)
+    for (int j = 0; j < 60; ++j)
+    {
+        if (rand()%15 == 0)
+        {
+            cell.glyph = L'♠';
+            rlhue_set(&cell.fghue, 0, (uint8_t)(rand()%50 + 140), 0, 255);
+        }
+        else
+        {
+            cell.glyph = (rand()%3 == 0) ? L',' : L'.';
+            rlhue_set(&cell.fghue, 0, (uint8_t)(rand()%20 + 70), 0, 255);
+        }
+
+        rlhue_set(&cell.bghue, 0, (uint8_t)(rand()%20 + 20), 0, 255);
+        rltmap_pcell(view, cell, i, j);
+    }
+
+    cell.glyph = L'☰';
+    rlhue_set(&cell.fghue, 100, 20, 20, 255);
+    rlhue_set(&cell.bghue, 50, 10, 10, 255);
+
+    housex = rand()%30 + 4;
+    housey = rand()%30 + 4;
+
+    for (int i = housex; i < housex + 14; ++i)
+    {
+        rltmap_pcell(view, cell, i, housey);
+        rltmap_pcell(view, cell, i, housey + 13);
+    }
+    for (int i = housey; i < housey + 14; ++i)
+    {
+        rltmap_pcell(view, cell, housex, i);
+        rltmap_pcell(view, cell, housex + 13, i);
+    }
+
+    cell.glyph = L' ';
+
+    for (int i = housex + 1; i < housex + 13; ++i)
+    for (int j = housey + 1; j < housey + 13; ++j)
+        rltmap_pcell(view, cell, i, j);
+}
+
+static void
+scene_light(rltmap *view, int tx, int ty)
+{
+    int d;
+    static rlhue hues[60 * 60];
+
+    for (int j = 0; j < 60; ++j)
+    for (int i = 0; i < 60; ++i)
+    {
+        d = abs(i - tx) + abs(j - ty);
+        d = (d > 10) ? 80 : 255 - d * 17;
+        rlhue_set(&hues[j * 60 + i], (uint8_t)d, (uint8_t)d, (uint8_t)d, 255);
+    }
+
+    rltmap_vlight(view, hues, 0, 0, 60, 60);
+}
+
+static bool
+bench_scene(rldisp *disp, bool defer, int reps, unsigned seed,
+    double *times)
+{
+    double t0;
+    bool status = false, compact;
+    int tx = 30, ty = 30;
+    rlcell edge = {L'#', {255, 255, 255, 255}, {0, 0, 0, 255}, 0.0f, 0.0f,
+        RL_TILE_CENTER};
+    rlcell fill = {L' ', {255, 255, 255, 255}, {0, 0, 0, 255}, 0.0f, 0.0f,
+        RL_TILE_CENTER};
+    rlcell curs = {L'⬉', {255, 255, 255, 255}, {0, 0, 0, 0}, 0.0f, 0.0f,
+        RL_TILE_CENTER};
+    rltmap *view = NULL, *menu = NULL, *cursor = NULL;
+
+    if (!(view = rltmap_init(FONT, 16, 65536, 60, 60, 16, 16))
+        || !(menu = rltmap_init(FONT, 16, 65536, 20, 30, 8, 16))
+        || !(cursor = rltmap_init(FONT, 32, 65536, 1, 1, 32, 32)))
+        goto cleanup;
+
+    /* Full storage where the backend has it, reported as what it got */
+    compact = rltmap_cmpct(view, false);
+
+    srand(seed);
+    rltmap_light(view, true);
+    rltmap_dpos(view, -320, -320);
+    scene_view(view);
+
+    for (int j = 0; j < 30; ++j)
+    for (int i = 0; i < 20; ++i)
+        rltmap_pcell(menu, (i == 0 || i == 19 || j == 0 || j == 29) ? edge
+            : fill, i, j);
+
+    rltmap_pcell(cursor, curs, 0, 0);
+    rldisp_defer(disp, defer);
+
+    for (int r = 0; r < WARMUP + reps; ++r)
+    {
+        t0 = now();
+
+        tx = abs(tx + rand()%3 - 1) % 60;
+        ty = abs(ty + rand()%3 - 1) % 60;
+
+        if (r % 30 == 0)
+            scene_view(view);
+
+        scene_light(view, tx, ty);
+        rltmap_dpos(cursor, tx * 16 - 320, ty * 16 - 320);
+
+        rldisp_evtflsh(disp);
+        rldisp_clear(disp);
+        rldisp_dtmap(disp, view);
+        rldisp_dtmap(disp, menu);
+        rldisp_dtmap(disp, cursor);
+        rldisp_prsnt(disp);
+
+        t0 = now() - t0;
+
+        if (r >= WARMUP)
+            times[r - WARMUP] = t0;
+    }
+
+    report(defer ? "scene_defer" : "scene", 60, 60, compact, "ns/frame",
+        times, reps, 1.0);
+    status = true;
+
+cleanup:
+
+    rldisp_defer(disp, false);
+
+    rltmap_free(view);
+    rltmap_free(menu);
+    rltmap_free(cursor);
+
+    return status;
+}
+
+/* Inserts GLYPHS new glyphs into an empty rltmap one tile at a time and
+   draws it once. The time per insert, the slowest single insert (the worst
+   hitch a frame sees from a glyph miss) and the frame uploading the glyphs
+   are reported. */
+static bool
+bench_glyph(rldisp *disp, int reps, double *times)
+{
+    double t0, t1, worst;
+    bool status = false, compact = false;
+    rltmap *tmap = NULL;
+    double *hitch = NULL, *upload = NULL;
+    rlcell cell = {L'?', {255, 255, 255, 255}, {0, 0, 0, 255}, 0.0f, 0.0f,
+        RL_TILE_CENTER};
+
+    if (!(hitch = malloc((size_t)reps * sizeof(double)))
+        || !(upload = malloc((size_t)reps * sizeof(double))))
+        goto cleanup;
+
+    for (int r = 0; r < WARMUP + reps; ++r)
+    {
+        if (!(tmap = rltmap_init(FONT, 16, 65536, 100, GLYPHS / 100, 8, 16)))
+            goto cleanup;
+
+        compact = rltmap_cmpct(tmap, false);
+
+        t0 = now();
+        worst = 0.0;
+
+        for (int i = 0; i < GLYPHS; ++i)
+        {
+            t1 = now();
+            cell.glyph = (wchar_t)(GLYPH_FIRST + i);
+            rltmap_pcell(tmap, cell, i % 100, i / 100);
+
+            if ((t1 = now() - t1) > worst)
+                worst = t1;
+        }
+
+        t0 = now() - t0;
+        t1 = now();
+
+        rldisp_evtflsh(disp);
+        rldisp_clear(disp);
+        rldisp_dtmap(disp, tmap);
+        rldisp_prsnt(disp);
+
+        t1 = now() - t1;
+
+        if (r >= WARMUP)
+        {
+            times[r - WARMUP] = t0;
+            hitch[r - WARMUP] = worst;
+            upload[r - WARMUP] = t1;
+        }
+
+        rltmap_free(tmap);
+        tmap = NULL;
+    }
+
+    report("glyph insert", 100, GLYPHS / 100, compact, "ns/glyph", times,
+        reps, GLYPHS);
+    report("glyph hitch", 100, GLYPHS / 100, compact, "ns/glyph", hitch,
+        reps, 1.0);
+    report("glyph upload", 100, GLYPHS / 100, compact, "ns/frame", upload,
+        reps, 1.0);
+    status = true;
+
+cleanup:
+
+    rltmap_free(tmap);
+    free(hitch);
+    free(upload);
+
+    return status;
+}
+
+/* Streams GLYPHS glyphs through a map whose atlas holds only a few hundred,
+   so the atlas is full and evicts pages all along. Skipped on backends that
+   don't let the atlas be bounded. */
+static bool
+bench_evict(rldisp *disp, int reps, double *times)
+{
+    double t0;
+    bool compact = false;
+    rltmap *tmap = NULL;
+    rlcell cell = {L'?', {255, 255, 255, 255}, {0, 0, 0, 255}, 0.0f, 0.0f,
+        RL_TILE_CENTER};
+
+    for (int r = 0; r < WARMUP + reps; ++r)
+    {
+        if (!(tmap = rltmap_init(FONT, 16, 65536, EVICT_WIDTH, EVICT_HEIGHT,
+            8, 16)))
+            return false;
+
+        if (!rltmap_atlas(tmap, 256, 4, 1))
+        {
+            rltmap_free(tmap);
+            return true;
+        }
+
+        compact = rltmap_cmpct(tmap, false);
+
+        t0 = now();
+
+        for (int i = 0; i < GLYPHS; ++i)
+        {
+            cell.glyph = (wchar_t)(GLYPH_FIRST + i);
+            rltmap_pcell(tmap, cell, i % EVICT_WIDTH, i / EVICT_WIDTH
+                % EVICT_HEIGHT);
+
+            if ((i + 1) % (EVICT_WIDTH * EVICT_HEIGHT) == 0)
+            {
+                rldisp_evtflsh(disp);
+                rldisp_clear(disp);
+                rldisp_dtmap(disp, tmap);
+                rldisp_prsnt(disp);
+            }
+        }
+
+        if (r >= WARMUP)
+            times[r - WARMUP] = now() - t0;
+
+        rltmap_free(tmap);
+    }
+
+    report("glyph evict", EVICT_WIDTH, EVICT_HEIGHT, compact, "ns/glyph",
+        times, reps, GLYPHS);
+
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    int reps = 20;
+    unsigned seed = 1;
+    double *times = NULL;
+    rldisp *disp = NULL;
+    int status = EXIT_SUCCESS;
+
+    if (argc > 1)
+        reps = atoi(argv[1]);
+    if (argc > 2)
+        seed = (unsigned)strtoul(argv[2], NULL, 10);
+
+    if (reps < 1)
+        reps = 1;
+
+    if (!(times = malloc((size_t)reps * sizeof(double))))
+        return EXIT_FAILURE;
+
+    if (!(disp = rldisp_init(640, 480, 640, 480, "rldisplay bench", false)))
+    {
+        fprintf(stderr, "bench: could not open a window\n");
+        free(times);
+        return EXIT_FAILURE;
+    }
+
+    /* Frames are only bounded by the work being measured */
+    rldisp_vsync(disp, false);
+    rldisp_fpslim(disp, 0);
+
+    printf("{\n  \"bench\": \"rldisplay\",\n  \"backend\": \"%s\",\n"
+        "  \"build\": \"%s\",\n  \"seed\": %u,\n  \"reps\": %d,\n"
+        "  \"results\": [\n", BENCH_BACKEND, BENCH_BUILD, seed, reps);
+
+    for (int compact = 0; compact < 2; ++compact)
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i)
+    {
+        if (!bench_size(disp, sizes[i][0], sizes[i][1], compact, reps, seed,
+            times))
+        {
+            fprintf(stderr, "bench: could not set up a %dx%d map\n",
+                sizes[i][0], sizes[i][1]);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if (!bench_scene(disp, false, reps, seed, times)
+        || !bench_scene(disp, true, reps, seed, times))
+    {
+        fprintf(stderr, "bench: could not set up the scene\n");
+        status = EXIT_FAILURE;
+    }
+
+    if (!bench_glyph(disp, reps, times) || !bench_evict(disp, reps, times))
+    {
+        fprintf(stderr, "bench: could not set up the glyph cases\n");
+        status = EXIT_FAILURE;
+    }
+
+    printf("\n  ]\n}\n");
+
+    rldisp_free(disp);
+    free(times);
+
+    return status;
+}
@@ -0,0 +1,176 @@
+/*
+ * Microbenchmarks for the batch rlhue kernels.
+ *
+ * Every kernel is timed for each implementation available on this CPU and
+ * checked against the scalar implementation. Throughput is reported in bytes
+ * of rlhue data processed per cycle. On x86 cycles are read from the time
+ * stamp counter, elsewhere nanoseconds are reported instead.
+ *
+ * Usage: bench_hue [count] [reps]
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "rl_display.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycle"
+#else
+#define BENCH_UNIT "ns"
+#endif
+
+#define WARMUP 3
+
+enum { K_ADD, K_SUB, K_MUL, K_LERP, K_OVER, K_GRAY, K_COUNT };
+
+static const char *knames[K_COUNT] = {
+    "add", "sub", "mul", "lerp", "over", "gray"
+};
+
+static const char *impls[] = { "scalar", "sse2", "avx2", "neon" };
+
+static uint64_t
+ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint64_t)__rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+#endif
+}
+
+static void
+run(int k, rlhue *a, const rlhue *b, size_t count)
+{
+    rlhue hue = {40, 80, 120, 160};
+
+    switch (k)
+    {
+    case K_ADD:
+        rlhue_vadd(a, count, hue);
+        break;
+    case K_SUB:
+        rlhue_vsub(a, count, hue);
+        break;
+    case K_MUL:
+        rlhue_vmul(a, count, hue);
+        break;
+    case K_LERP:
+        rlhue_vlerp(a, b, count, 97);
+        break;
+    case K_OVER:
+        rlhue_vover(a, b, count);
+        break;
+    case K_GRAY:
+        rlhue_vgray(a, count, 200);
+        break;
+    }
+}
+
+static void
+fill(rlhue *hues, size_t count, unsigned seed)
+{
+    srand(seed);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        hues[i].r = (uint8_t)rand();
+        hues[i].g = (uint8_t)rand();
+        hues[i].b = (uint8_t)rand();
+        hues[i].a = (uint8_t)rand();
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    bool first = true;
+    uint64_t t0, best;
+    size_t count = 4096, check = 1027;
+    int reps = 200, status = EXIT_SUCCESS;
+    rlhue *a = NULL, *b = NULL, *ref = NULL, *out = NULL;
+
+    if (argc > 1)
+        count = (size_t)strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        reps = atoi(argv[2]);
+
+    if (!(a = malloc(count * sizeof(rlhue)))
+        || !(b = malloc((count > check ? count : check) * sizeof(rlhue)))
+        || !(ref = malloc(check * sizeof(rlhue)))
+        || !(out = malloc(check * sizeof(rlhue))))
+    {
+        status = EXIT_FAILURE;
+        goto cleanup;
+    }
+
+    printf("{\n  \"bench\": \"rlhue\",\n  \"default\": \"%s\",\n"
+        "  \"count\": %zu,\n  \"unit\": \"bytes/%s\",\n  \"results\": [\n",
+        rlhue_vname(), count, BENCH_UNIT);
+
+    for (size_t i = 0; i < sizeof(impls) / sizeof(*impls); ++i)
+    {
+        if (!rlhue_vimpl(impls[i]))
+            continue;
+
+        for (int k = 0; k < K_COUNT; ++k)
+        {
+            /* Verify against scalar on an odd length to exercise tails */
+            fill(b, check, 2);
+            fill(ref, check, 1);
+            fill(out, check, 1);
+            rlhue_vimpl("scalar");
+            run(k, ref, b, check);
+            rlhue_vimpl(impls[i]);
+            run(k, out, b, check);
+
+            if (memcmp(ref, out, check * sizeof(rlhue)))
+            {
+                fprintf(stderr, "%s %s differs from scalar\n", impls[i],
+                    knames[k]);
+                status = EXIT_FAILURE;
+            }
+
+            fill(a, count, 1);
+            fill(b, count, 2);
+            best = UINT64_MAX;
+
+            for (int r = 0; r < WARMUP + reps; ++r)
+            {
+                t0 = ticks();
+                run(k, a, b, count);
+                t0 = ticks() - t0;
+
+                if (r >= WARMUP && t0 < best)
+                    best = t0;
+            }
+
+            printf("%s    {\"impl\": \"%s\", \"kernel\": \"%s\", "
+                "\"throughput\": %.3f}", first ? "" : ",\n", impls[i],
+                knames[k], (double)(count * sizeof(rlhue))
+                / (double)(best ? best : 1));
+            first = false;
+        }
+    }
+
+    printf("\n  ]\n}\n");
+    rlhue_vimpl(NULL);
+
+cleanup:
+
+    free(a);
+    free(b);
+    free(ref);
+    free(out);
+
+    return status;
+}
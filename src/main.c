@@ -18,12 +18,13 @@
 #define UNUSED(x) (void)x
 
 void
-view_set(rltmap *view, rltile *tile)
+view_set(rltmap *view)
 {
-    rlhue hue;
     int housex, housey;
+    rlcell cell = {L'?', {0, 0, 0, 255}, {0, 0, 0, 255}, 0.0f, 0.0f,
+        RL_TILE_CENTER};
 
-    if (!view || !tile)
+    if (!view)
         return;
     
     for (int i = 0; i < 60; ++i)
@@ -31,51 +32,46 @@ view_set(rltmap *view, rltile *tile)
     {
         if (rand()%15 == 0)
         {
-            rltile_glyph(tile, L'♠');
-            rlhue_set(&hue, 0, (uint8_t)(rand()%50 + 140), 0, 255);
-            rltile_fghue(tile, hue);
+            cell.glyph = L'♠';
+            rlhue_set(&cell.fghue, 0, (uint8_t)(rand()%50 + 140), 0, 255);
         }
         else
         {
             if (rand()%3 == 0)
-                rltile_glyph(tile, L',');
+                cell.glyph = L',';
             else
-                rltile_glyph(tile, L'.');
+                cell.glyph = L'.';
 
-            rlhue_set(&hue, 0, (uint8_t)(rand()%20 + 70), 0, 255);
-            rltile_fghue(tile, hue);
+            rlhue_set(&cell.fghue, 0, (uint8_t)(rand()%20 + 70), 0, 255);
         }
            
-        rlhue_set(&hue, 0, (uint8_t)(rand()%20 + 20), 0, 255);
-        rltile_bghue(tile, hue);
-        rltmap_ptile(view, tile, i, j);
+        rlhue_set(&cell.bghue, 0, (uint8_t)(rand()%20 + 20), 0, 255);
+        rltmap_pcell(view, cell, i, j);
     }
 
-    rltile_glyph(tile, L'☰');
-    rlhue_set(&hue, 100, 20, 20, 255);
-    rltile_fghue(tile, hue);
-    rlhue_set(&hue, 50, 10, 10, 255);
-    rltile_bghue(tile, hue);
+    cell.glyph = L'☰';
+    rlhue_set(&cell.fghue, 100, 20, 20, 255);
+    rlhue_set(&cell.bghue, 50, 10, 10, 255);
 
     housex = rand()%30 + 4;
     housey = rand()%30 + 4;
 
     for (int i = housex; i < housex + 14; ++i)
     {
-        rltmap_ptile(view, tile, i, housey);
-        rltmap_ptile(view, tile, i, housey + 13);
+        rltmap_pcell(view, cell, i, housey);
+        rltmap_pcell(view, cell, i, housey + 13);
     }
     for (int i = housey; i < housey + 14; ++i)
     {
-        rltmap_ptile(view, tile, housex, i);
-        rltmap_ptile(view, tile, housex + 13, i);
+        rltmap_pcell(view, cell, housex, i);
+        rltmap_pcell(view, cell, housex + 13, i);
     }
 
-    rltile_glyph(tile, L' ');
+    cell.glyph = L' ';
 
     for (int i = housex + 1; i < housex + 13; ++i)
     for (int j = housey + 1; j < housey + 13; ++j)
-        rltmap_ptile(view, tile, i, j);
+        rltmap_pcell(view, cell, i, j);
 }
 
 void
@@ -111,31 +107,51 @@ menu_set(rltmap *menu, rltile *tile)
 }
 
 void
-curs_set(rltmap *curs, rltile *tile)
+curs_set(rldisp *disp, rltmap *view)
+{
+    rlcell cell = {L'⬉', {255, 255, 255, 255}, {0, 0, 0, 0}, 0.0f, 0.0f,
+        RL_TILE_TEXT};
+
+    if (!disp || !view)
+        return;
+
+    /* Drawn by the system at twice the size of the view's glyphs, with the
+       hot spot at the tip of the arrow */
+    rldisp_cursor(disp, view, cell, 2, 0, 0);
+}
+
+void
+light_set(rltmap *view, int tx, int ty)
 {
-    rlhue hue;
+    int d;
+    static rlhue hues[60 * 60];
 
-    if (!curs || !tile)
+    if (!view)
         return;
 
-    rltile_glyph(tile, L'⬉');
-    rlhue_set(&hue, 255, 255, 255, 255);
-    rltile_fghue(tile, hue);
-    rlhue_set(&hue, 0, 0, 0, 0);
-    rltile_bghue(tile, hue);
-    rltmap_ptile(curs, tile, 0, 0);
+    for (int j = 0; j < 60; ++j)
+    for (int i = 0; i < 60; ++i)
+    {
+        d = abs(i - tx) + abs(j - ty);
+        d = (d > 10) ? 80 : 255 - d * 17;
+        rlhue_set(&hues[j * 60 + i], (uint8_t)d, (uint8_t)d, (uint8_t)d, 255);
+    }
+
+    rltmap_vlight(view, hues, 0, 0, 60, 60);
 }
 
 int
 main(void)
 {
-    bool run = true;
+    bool run = true, trace = false;
     double delta = 0.0;
     rldisp *disp = NULL;
     rltile *tile = NULL;
     int mousex = 0, mousey = 0;
+    int tilex = 0, tiley = 0;
     const char *font = "res/fonts/unifont.ttf";
-    rltmap *view = NULL, *menu = NULL, *curs = NULL;
+    rltpool *pool = NULL;
+    rltmap *view = NULL, *menu = NULL;
 
     if (!(disp = rldisp_init(0, 0, 640, 480, "rldisplay", true)))
         goto cleanup;
@@ -146,21 +162,28 @@ main(void)
     if (!(menu = rltmap_init(font, 16, 65536, 20, 30, 8, 16)))
         goto cleanup;
 
-    if (!(curs = rltmap_init(font, 32, 65536, 1, 1, 32, 32)))
-        goto cleanup;
-
-    if (!(tile = rltile_null()))
+    if (!(pool = rltpool_init(16)) || !(tile = rltpool_take(pool)))
         goto cleanup;
 
     rltmap_dpos(view, -320, -320);
 
     rldisp_fpslim(disp, 60);
     rldisp_vsync(disp, true);
-    rldisp_shwcur(disp, false);
+    rldisp_hudset(disp, font, RL_KEY_TILDE);
 
-    view_set(view, tile);
+    /* The tiles of the view under the menu are skipped, and the backgrounds
+       of both are drawn together */
+    rldisp_occl(disp, true);
+    rldisp_defer(disp, true);
+
+    rltmap_light(view, true);
+
+    /* Only records anything when built with RL_TRACE defined */
+    trace = rldisp_trace(disp, true);
+
+    view_set(view);
     menu_set(menu, tile);
-    curs_set(curs, tile);
+    curs_set(disp, view);
 
     while (rldisp_status(disp) && run)
     {
@@ -173,12 +196,10 @@ main(void)
             run = false;
 
         if (rldisp_key(disp, RL_KEY_SPACE))
-            view_set(view, tile);
+            view_set(view);
 
-        rltmap_dpos(curs, mousex, mousey);
-
-        if (rldisp_key(disp, RL_KEY_MOUSELEFT))
-            rltmap_move(curs, -3, -3);
+        rltmap_mouse(view, disp, &tilex, &tiley);
+        light_set(view, tilex, tiley);
 
         if (mousex < 5)
             rltmap_move(view, 5, 0);
@@ -193,15 +214,17 @@ main(void)
         rldisp_clear(disp);
         rldisp_dtmap(disp, view);
         rldisp_dtmap(disp, menu);
-        rldisp_dtmap(disp, curs);
         rldisp_prsnt(disp);
     }
 
+    if (trace)
+        rldisp_trdump(disp, "bin/trace.json");
+
 cleanup:
 
     rldisp_free(disp);
-    rltile_free(tile);
+    rltpool_give(pool, tile);
+    rltpool_free(pool);
     rltmap_free(view);
     rltmap_free(menu);
-    rltmap_free(curs);
 }
@@ -28,6 +28,7 @@ extern "C" {
 #endif
 
 #include <wchar.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -38,6 +39,7 @@ Structs
 typedef struct rltile rltile;
 typedef struct rltmap rltmap;
 typedef struct rldisp rldisp;
+typedef struct rltpool rltpool;
 typedef struct { uint8_t r; uint8_t g; uint8_t b; uint8_t a; } rlhue;
 
 /******************************************************************************
@@ -114,6 +116,118 @@ typedef enum {
     RL_KEY_MAXIMUM
 } rlkey;
 
+/******************************************************************************
+Value types
+******************************************************************************/
+
+/* @brief   Plain tile value that can be passed by value or stored in arrays
+ *
+ * An rlcell carries the same data as an rltile, but it is a public POD type
+ * instead of a heap allocated handle, so it requires no init/free calls.
+ * Unlike an rltile, the hues of an rlcell are uniform across the four corners
+ * of the tile. The right and bottom shift values only matter for tiles of type
+ * RL_TILE_EXACT.
+ */
+typedef struct {
+    wchar_t glyph;
+    rlhue fghue;
+    rlhue bghue;
+    float right;
+    float bottom;
+    rlttype type;
+} rlcell;
+
+/* Number of rldisp_dtmap(2) calls timed individually per frame in rlstats */
+#define RL_STATS_MAPS 16
+
+/* Number of frames the rolling frame times of rlstats are computed over */
+#define RL_STATS_FRAMES 120
+
+/* @brief   Performance statistics of one frame of an rldisp
+ *
+ * Filled by rldisp_stats(2) with the values of the last frame completed by
+ * rldisp_prsnt(1). All times are wall clock seconds spent inside the named
+ * calls. Counters that belong to rltmaps (tiles, gmiss, agrow, gevict,
+ * graster, gfail and the texture part of bytes) are kept by each rltmap until
+ * an rldisp draws it, and count towards the frame of that rldisp. allocs
+ * counts the allocations made by the library since the previous frame of the
+ * rldisp ended, as they are not tied to one. abytes is the current total
+ * rather than a count for the frame. tfirst is set once, and tmode keeps its
+ * value until the next switch. bquads is below bcells where backgrounds of
+ * one hue are merged into larger quads: by the SFML backend, and along rows
+ * by the GLFW backend in deferred drawing (see rldisp_defer(2)). The GLFW
+ * backend otherwise draws a quad per tile, and bquads equals bcells.
+ */
+typedef struct {
+    int draws;      /* draw calls submitted */
+    int verts;      /* vertices submitted */
+    int bcells;     /* tile backgrounds drawn */
+    int bquads;     /* quads the tile backgrounds were drawn as */
+    int culled;     /* tiles not drawn as hidden (see rldisp_occl(2)) */
+    int tiles;      /* tiles written to rltmaps */
+    int gmiss;      /* glyph cache misses */
+    int agrow;      /* glyph atlas growth events */
+    int gevict;     /* glyphs evicted from a full glyph atlas */
+    int graster;    /* glyphs rasterized again after an eviction */
+    int gfail;      /* glyphs that did not fit even after an eviction */
+    int allocs;     /* heap allocations, including atlas growth */
+    int nmaps;      /* number of rldisp_dtmap(2) calls */
+    size_t bytes;   /* bytes of vertex and texture data uploaded */
+    size_t abytes;  /* client memory held by all glyph atlases */
+    double tevt;    /* time in rldisp_evtflsh(1), without tidle */
+    double tidle;   /* time blocked waiting for input (see rldisp_idle(3)) */
+    double tmap;    /* total time in rldisp_dtmap(2) */
+    double tprim;   /* time in rldisp_dline(7) and rldisp_dbox*(6-7) */
+    double tprsnt;  /* time in rldisp_prsnt(1), including the swap */
+    double tswap;   /* time in the buffer swap alone */
+    double tframe;  /* time between the last two rldisp_prsnt(1) calls */
+    double thud;    /* time drawing the HUD, excluded from everything else */
+    double tfirst;  /* time from rldisp_init(6) to the first rldisp_prsnt(1) */
+    double tmode;   /* time from the last rldisp_fscrn(2) or rldisp_rsize(3)
+                       to the end of the rldisp_prsnt(1) after it */
+    double tmaps[RL_STATS_MAPS]; /* time of each of the first nmaps draws */
+    int frames;     /* frames in the rolling window below */
+    double fmin;    /* minimum frame time over the rolling window */
+    double favg;    /* average frame time over the rolling window */
+    double fp99;    /* 99th percentile frame time over the rolling window */
+} rlstats;
+
+/* @brief   Memory allocation functions used by the library
+ *
+ * Set with rlalloc_set(1). The functions have the semantics of malloc,
+ * realloc and free, with user passed as the first argument of each.
+ */
+typedef struct {
+    void *(*alloc)(void *user, size_t size);
+    void *(*realloc)(void *user, void *ptr, size_t size);
+    void (*free)(void *user, void *ptr);
+    void *user;
+} rlalloc;
+
+/* Number of 1 ms buckets in the histograms of rllatency */
+#define RL_LATENCY_BUCKETS 64
+
+/* @brief   Input latency of an rldisp
+ *
+ * Filled by rldisp_latency(3). Every key press, mouse button press and
+ * scroll handled by rldisp_evtflsh(1) is timestamped on arrival and measured
+ * against the next rldisp_prsnt(1): once when the frame is submitted (first
+ * present) and once when the buffer swap returns (swap complete). Times are
+ * in seconds; bucket i of a histogram counts events with a latency between i
+ * and i + 1 milliseconds, and the last bucket also counts everything above.
+ */
+typedef struct {
+    int events;     /* input events measured */
+    double pmin;    /* minimum event to first present latency */
+    double pavg;    /* average event to first present latency */
+    double pmax;    /* maximum event to first present latency */
+    double smin;    /* minimum event to swap complete latency */
+    double savg;    /* average event to swap complete latency */
+    double smax;    /* maximum event to swap complete latency */
+    int phist[RL_LATENCY_BUCKETS]; /* event to first present histogram */
+    int shist[RL_LATENCY_BUCKETS]; /* event to swap complete histogram */
+} rllatency;
+
 /******************************************************************************
 rldisp function declarations
 ******************************************************************************/
@@ -125,11 +239,10 @@ rldisp function declarations
  * are what should be taken into account when using mouse coords and drawing
  * to the window, as the frame is what is actually drawn to. Every time the
  * window is refreshed with rldisp_prsnt(1), the frame is stretched to the
- * current size of the window. If the window is fullscreen, but the passed
- * window dimensions are not a valid fullscreen mode, the largest valid mode
- * will be selected. If you just want to create a fullscreen window at the
- * largest possible mode for the monitor, you can pass 0 as the first two
- * arguments and true as the last.
+ * current size of the window. A fullscreen window covers the monitor in its
+ * current video mode, which is never changed, and the window dimensions are
+ * the size it takes once windowed. Passing 0 as the first two arguments uses
+ * the size of the monitor.
  *
  * @param   wwidth  width of the window
  * @param   wheight height of the window
@@ -146,19 +259,26 @@ rldisp_init(int wwidth, int wheight, int fwidth, int fheight, const char *name,
 
 /* @brief   Sets an rldisp to be either fullscreen or windowed.
  *
- * Calling this function will cause the window to be recreated.
+ * The monitor keeps its video mode, and the frame, the rltmaps and their
+ * textures are kept, as are the vsync, frame rate limit and cursor settings.
+ * The GLFW backend keeps the window and its context. SFML can't change the
+ * style of a window, so the SFML backend creates it again, keeping the old
+ * window if that fails. The time until the next frame is shown is reported
+ * as tmode by rldisp_stats(2).
  *
  * @param   this    pointer to an rldisp
  * @param   fscrn   whether the window should be set to fullscreen or windowed
+ * @return  true on success, false if the rldisp was left as it was
  */
-extern void
+extern bool
 rldisp_fscrn(rldisp *this, bool fscrn);
 
 /* @brief   Sets an rldisp window size
  *
- * Calling this function will cause the window to be recreated. If the window
- * is fullscreen and the dimensions passed are not a valid fullscreen mode,
- * the largest valid mode will be selected.
+ * The window is resized in place, keeping everything rldisp_fscrn(2) keeps.
+ * A fullscreen window keeps covering the monitor and takes the new size once
+ * it is windowed again. The time until the next frame is shown is reported as
+ * tmode by rldisp_stats(2).
  *
  * @param   this    pointer to an rldisp
  * @param   width   new width of the window
@@ -191,6 +311,30 @@ rldisp_vsync(rldisp *this, bool enabled);
 extern void
 rldisp_shwcur(rldisp *this, bool visible);
 
+/* @brief   Sets the mouse cursor of an rldisp window to a glyph of an rltmap
+ *
+ * The cursor is drawn by the operating system, so it follows the mouse
+ * without waiting for a frame and without a rldisp_dtmap(2) of its own. The
+ * image is the box of the glyph's pixels, rasterized at scale times the size
+ * of the rltmap, tinted with the cell's fghue and drawn over its bghue. Only
+ * the glyph and hues of the cell are used. Cursors are kept once made, so
+ * going back to one made before is free.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   tmap    pointer to the rltmap of the glyph, NULL for the system
+ *                  cursor
+ * @param   cell    glyph and hues of the cursor
+ * @param   scale   size of a pixel of the rltmap in pixels of the cursor
+ * @param   hotx    x position of the cursor hot spot in pixels of the rltmap
+ *                  from the left of the glyph
+ * @param   hoty    y position of the cursor hot spot in pixels of the rltmap
+ *                  from the top of the glyph
+ * @return  true on success, false if the cursor couldn't be made
+ */
+extern bool
+rldisp_cursor(rldisp *this, rltmap *tmap, rlcell cell, int scale, int hotx,
+    int hoty);
+
 /* @brief   Sets the filtering method for the frame buffer of an rldisp
  *
  * Determines if the frame buffer appears sharp/pixelated or blurry/smooth
@@ -213,6 +357,37 @@ rldisp_filter(rldisp *this, bool filter);
 extern void
 rldisp_fpslim(rldisp *this, int limit);
 
+/* @brief   Sets whether an rldisp waits for input instead of polling for it
+ *
+ * In idle mode rldisp_evtflsh(1) blocks until input arrives, timeout seconds
+ * pass or the deadline set with rldisp_wake(2) is reached, and rldisp_prsnt(1)
+ * does nothing unless the frame was drawn to since the last present, or the
+ * window was resized or exposed. Clearing a frame nothing was drawn to since
+ * it was last cleared doesn't count. A loop that only draws when something
+ * changed then sleeps while nothing happens, even if it clears every frame.
+ * rldisp_evtflsh doesn't wait while a present is due. Input is timestamped on
+ * arrival either way, and the time spent blocked is reported as tidle by
+ * rldisp_stats(2) instead of being counted in tevt. The default is disabled.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   enabled whether the rldisp waits for input
+ * @param   timeout longest wait in seconds, or 0 to wait without limit
+ */
+extern void
+rldisp_idle(rldisp *this, bool enabled, double timeout);
+
+/* @brief   Sets a deadline by which an idle rldisp stops waiting for input
+ *
+ * The next wait of rldisp_evtflsh(1) in idle mode ends no later than delay
+ * seconds from now, e.g. for the next frame of an animation. Of several
+ * deadlines the soonest is kept, and it is cleared once reached.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   delay   seconds from now
+ */
+extern void
+rldisp_wake(rldisp *this, double delay);
+
 /* @brief   Frees the memory allocated for an rldisp
  *
  * @param   this    pointer to an rldisp
@@ -266,6 +441,47 @@ rldisp_clrhue(rldisp *this, rlhue hue);
 extern void
 rldisp_dtmap(rldisp *this, rltmap *tmap);
 
+/* @brief   Sets whether an rldisp skips the tiles hidden by later rltmaps
+ *
+ * With occlusion culling on, rldisp_dtmap(2) holds rltmaps back until
+ * something else is drawn, the frame is cleared or presented, or culling is
+ * turned off. They are then drawn in order, skipping every tile whose
+ * background and glyph lie entirely under opaque tile backgrounds of a
+ * single rltmap drawn after it, e.g. the world under a menu panel. Position,
+ * scale and rotation are taken into account, and are those at the time of
+ * the rldisp_dtmap call. Writing to an rltmap held back draws the rltmaps
+ * held back first, so each draw shows the tiles as they were at its
+ * rldisp_dtmap call. Tiles are opaque when their background is, after the
+ * palette and the light. The number of tiles skipped is reported as culled by
+ * rldisp_stats(2). The default is disabled.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   enabled whether hidden tiles are skipped
+ */
+extern void
+rldisp_occl(rldisp *this, bool enabled);
+
+/* @brief   Sets whether an rldisp defers drawing to submit fewer draw calls
+ *
+ * With deferred drawing on, rldisp_dtmap(2) and the line and box primitives
+ * are recorded rather than drawn, until the frame is cleared or presented or
+ * deferred drawing is turned off. The tile backgrounds of every rltmap and
+ * the primitives are then merged into shared buffers, transformed as they
+ * are written, and drawn with as few draw calls as the order of the draws
+ * allows; the glyphs of each rltmap still take one draw call, since each is
+ * drawn from the tiles of that rltmap. Draws are only reordered where they
+ * don't overlap, so the frame looks the same as when drawn in order, to the
+ * rounding of the edges of rotated or scaled rltmaps. As with
+ * rldisp_occl(2), which it combines with, writing to an rltmap submits the
+ * draws recorded first, so every draw shows the rltmap as it was at its
+ * rldisp_dtmap call. The default is disabled.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   enabled whether draws are deferred
+ */
+extern void
+rldisp_defer(rldisp *this, bool enabled);
+
 /* @brief   Draws a line directly to an rldisp's frame buffer
  *
  * The coordinates should be based on the rldisp's frame buffer, not its window
@@ -418,6 +634,104 @@ rldisp_mouse(rldisp *this, int *mousex, int *mousey);
 extern int
 rldisp_mscrl(rldisp *this);
 
+/* @brief   Retrieves the performance statistics of the last frame of an rldisp
+ *
+ * The statistics are gathered between two calls to rldisp_prsnt(1) and reset
+ * every time it is called, so this returns the values of the frame that was
+ * most recently presented.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   stats   pointer to an rlstats to fill
+ */
+extern void
+rldisp_stats(rldisp *this, rlstats *stats);
+
+/* @brief   Asserts that every frame of an rldisp is free of allocations
+ *
+ * When enabled, rldisp_prsnt(1) asserts that the frame it completes made no
+ * heap allocations through the library (see the allocs field of rlstats),
+ * counting glyph atlas growth as one. Glyph caches fill on first use, so
+ * enable this once the application has reached a steady state. It has no
+ * effect when compiled with NDEBUG.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   enabled whether to assert on allocations
+ */
+extern void
+rldisp_noalloc(rldisp *this, bool enabled);
+
+/* @brief   Retrieves the input latency measured by an rldisp
+ *
+ * Latencies are accumulated from the creation of the rldisp or the last
+ * reset, so to compare settings such as rldisp_vsync(2) or rldisp_fpslim(2),
+ * reset after changing them and read after a number of frames. Events are
+ * timestamped when rldisp_evtflsh(1) receives them from the window system,
+ * so time spent in the OS queue before that is not included.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   latency pointer to an rllatency to fill, or NULL
+ * @param   reset   whether to clear the measurements afterwards
+ */
+extern void
+rldisp_latency(rldisp *this, rllatency *latency, bool reset);
+
+/* @brief   Sets up the performance HUD of an rldisp
+ *
+ * The HUD is an overlay drawn by rldisp_prsnt(1) in the top left corner of
+ * the frame. It shows the frame rate, frame time, draw calls and tiles
+ * updated of the last frame, a graph of recent frame times and outlines
+ * around the regions of each rltmap that were redrawn with modified tiles.
+ * The cost of drawing the HUD is left out of rldisp_stats(2) and reported on
+ * its own as thud. The HUD starts hidden; it is shown with rldisp_shwhud(2)
+ * or toggled every time key is pressed during rldisp_evtflsh(1).
+ *
+ * @param   this    pointer to an rldisp
+ * @param   font    path to the font for the HUD text, or NULL to remove it
+ * @param   key     key that toggles the HUD, or RL_KEY_MAXIMUM for none
+ * @return  false if the HUD could not be created
+ */
+extern bool
+rldisp_hudset(rldisp *this, const char *font, rlkey key);
+
+/* @brief   Shows or hides the performance HUD of an rldisp
+ *
+ * @param   this    pointer to an rldisp
+ * @param   visible whether the HUD is shown
+ * @return  whether the HUD is now shown, always false before rldisp_hudset(3)
+ */
+extern bool
+rldisp_shwhud(rldisp *this, bool visible);
+
+/* @brief   Enables or disables recording of trace events
+ *
+ * Trace events are timed scopes around the hot paths of the library
+ * (rldisp_evtflsh(1), rldisp_clear(1), each rldisp_dtmap(2), batched rltmap
+ * writes, rldisp_prsnt(1) and its buffer swap) plus glyph atlas growth
+ * markers. They are kept in a fixed size ring buffer shared by the library,
+ * so only the most recent events survive. Tracing is only available when the
+ * library is compiled with RL_TRACE defined; when it is not, this always
+ * returns false.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   enabled whether to record trace events
+ * @return  whether trace events are now being recorded
+ */
+extern bool
+rldisp_trace(rldisp *this, bool enabled);
+
+/* @brief   Writes the recorded trace events to a file
+ *
+ * The file is written in the Chrome trace event JSON format, which can be
+ * opened with chrome://tracing or ui.perfetto.dev. The ring buffer is left
+ * untouched, so it can be dumped again later.
+ *
+ * @param   this    pointer to an rldisp
+ * @param   path    path of the file to write
+ * @return  true on success, false on failure or if tracing is compiled out
+ */
+extern bool
+rldisp_trdump(rldisp *this, const char *path);
+
 /* @brief   Returns the delta time between calls in seconds
  *
  * @param   this    pointer to an rldisp
@@ -521,6 +835,55 @@ rltile_shift(rltile *this, float right, float bottom);
 extern void
 rltile_free(rltile *this);
 
+/******************************************************************************
+rltpool function declarations
+******************************************************************************/
+
+/* @brief   Returns a pointer to a new rltpool
+ *
+ * An rltpool hands out rltiles from slabs of preallocated storage. Tiles that
+ * are given back to the pool are reused by later calls to rltpool_take(1), so
+ * once the pool has grown to the number of live tiles no further allocations
+ * are made. When the pool runs out of tiles another slab of count tiles is
+ * allocated.
+ *
+ * @param   count   number of tiles allocated per slab
+ *
+ * @return  a pointer to the new rltpool
+ */
+extern rltpool *
+rltpool_init(int count);
+
+/* @brief   Returns a pointer to an rltile taken from an rltpool
+ *
+ * The tile is reset to the same defaults as rltile_null(0). Tiles taken from
+ * an rltpool must be returned with rltpool_give(2) and never passed to
+ * rltile_free(1).
+ *
+ * @param   this    pointer to an rltpool
+ *
+ * @return  a pointer to the rltile, or NULL if the pool could not grow
+ */
+extern rltile *
+rltpool_take(rltpool *this);
+
+/* @brief   Returns an rltile to the rltpool it was taken from
+ *
+ * @param   this    pointer to an rltpool
+ * @param   tile    pointer to an rltile taken from the same rltpool
+ */
+extern void
+rltpool_give(rltpool *this, rltile *tile);
+
+/* @brief   Frees the memory allocated for an rltpool and all of its rltiles
+ *
+ * Any rltiles taken from the pool are invalid after this call.
+ *
+ * @param   this    pointer to an rltpool
+ */
+extern void
+rltpool_free(rltpool *this);
+
 /******************************************************************************
 rltmap function declarations
 ******************************************************************************/
@@ -543,6 +906,82 @@ extern rltmap *
 rltmap_init(const char *font, int csize, int cnum, int width, int height,
     int offx, int offy);
 
+/* @brief   Returns a pointer to a new rltmap whose font loads in the background
+ *
+ * Like rltmap_init, but the font is parsed on a thread of its own, along
+ * with the glyphs of the printable ASCII characters, and the rltmap is
+ * returned right away. Creating rltmaps this way before rldisp_init(6) lets
+ * the fonts load while the window comes up. Until the font is loaded the
+ * rltmap is pending: rldisp_dtmap(2) draws nothing, and the calls that need
+ * glyphs (writing tiles, rltmap_atlas(4), rltmap_sdf(2)) wait for it first.
+ * A font that fails to load leaves the rltmap drawing no glyphs.
+ *
+ * The OpenGL backend calls the allocator set with rlalloc_set(1) from the
+ * loading thread as well, so it must be thread safe. The loading thread
+ * keeps the allocator it started with, which can't change before the
+ * rltmap is freed anyway. The SFML backend only defers opening the font to
+ * the thread, allocating nothing there, and rasterizes glyphs on first use
+ * as rltmap_init does.
+ *
+ * @param   font    relative path to the font file in the local filesystem
+ * @param   csize   pt size for the characters in the map
+ * @param   cnum    highest unicode value to support
+ * @param   width   width of the map (in # of characters)
+ * @param   height  height of the map (in # of characters)
+ * @param   offx    horizontal offset of each character in the map
+ * @param   offy    vertical offset of each character in the map
+ *
+ * @return  pointer to the new pending rltmap
+ */
+extern rltmap *
+rltmap_async(const char *font, int csize, int cnum, int width, int height,
+    int offx, int offy);
+
+/* @brief   Returns whether the font of an rltmap is loaded
+ *
+ * Always true for rltmaps from rltmap_init and rltmap_sheet once created.
+ * For one from rltmap_async, false while the font is still loading, unless
+ * wait is set, in which case the call blocks until loading is finished.
+ * False after loading if the font failed to load.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   wait    whether to wait for the font to finish loading
+ *
+ * @return  whether the font is loaded
+ */
+extern bool
+rltmap_ready(rltmap *this, bool wait);
+
+/* @brief   Returns a pointer to a new rltmap drawing glyphs from a tilesheet
+ *
+ * The tilesheet is an image of cwidth x cheight cells read row by row from
+ * the top left. It is used as the glyph atlas as is, so nothing is rasterized
+ * and startup does not depend on the number of glyphs. Cell i draws codepoint
+ * map[i]; without a map the sheet is read as the 256 characters of code page
+ * 437 and each cell draws the unicode equivalent of its character. Glyphs no
+ * cell draws are empty.
+ *
+ * Cells behave like font glyphs the size of a cell resting on the baseline,
+ * so tile types work as they do for rltmap_init. Sheets with transparency are
+ * drawn with their colors multiplied by the foreground hue, opaque sheets are
+ * read as white glyphs on black with brightness as coverage.
+ *
+ * @param   sheet   relative path to the image in the local filesystem (PNG)
+ * @param   cwidth  width of a cell of the sheet in pixels
+ * @param   cheight height of a cell of the sheet in pixels
+ * @param   map     codepoint drawn by each cell, or NULL for CP437
+ * @param   count   number of codepoints in map (ignored without a map)
+ * @param   width   width of the map (in # of characters)
+ * @param   height  height of the map (in # of characters)
+ * @param   offx    horizontal offset of each character in the map
+ * @param   offy    vertical offset of each character in the map
+ *
+ * @return  pointer to the new rltmap, or NULL if the sheet can't be loaded
+ */
+extern rltmap *
+rltmap_sheet(const char *sheet, int cwidth, int cheight, const wchar_t *map,
+    int count, int width, int height, int offx, int offy);
+
 /* @brief   Sets the position of an rltmap relative to the rldisp's frame
  *
  * The default position for new rltmaps is 0x0
@@ -607,6 +1046,79 @@ rltmap_angle(rltmap *this, float rot);
 extern void
 rltmap_ptile(rltmap *this, rltile *tile, int x, int y);
 
+/* @brief   Updates an rltmap at coords with rlcell data
+ *
+ * @param   this    pointer to an rltmap
+ * @param   cell    rlcell to update the rltmap with
+ * @param   x       x coordinate of the tile to update (within the rltmap)
+ * @param   y       y coordinate of the tile to update (within the rltmap)
+ */
+extern void
+rltmap_pcell(rltmap *this, rlcell cell, int x, int y);
+
+/* @brief   Updates a rectangular region of an rltmap from an array of rlcells
+ *
+ * The cells array is read row by row and must hold width * height rlcells.
+ * Cells that fall outside of the rltmap are skipped.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   cells   pointer to an array of width * height rlcells
+ * @param   x       x coordinate of the top left of the region
+ * @param   y       y coordinate of the top left of the region
+ * @param   width   width of the region (in # of tiles)
+ * @param   height  height of the region (in # of tiles)
+ */
+extern void
+rltmap_pcells(rltmap *this, const rlcell *cells, int x, int y, int width,
+    int height);
+
+/* @brief   Registers a tile prototype with an rltmap and returns its ID
+ *
+ * Maps are usually built from a small set of tile kinds (floor, wall, tree,
+ * ...). Registering each kind once lets the glyph lookup and vertex layout be
+ * computed up front, after which tiles can be written by ID with
+ * rltmap_pid(4) or rltmap_pgrid(6). Writing a prototype produces exactly the
+ * same tile as writing the rlcell it was registered from with rltmap_pcell(4).
+ * IDs are assigned in order starting from 0 and are only valid for the rltmap
+ * that returned them. At most 65536 prototypes can be registered.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   cell    rlcell describing the prototype
+ *
+ * @return  the ID of the new prototype, or -1 on failure
+ */
+extern int
+rltmap_proto(rltmap *this, rlcell cell);
+
+/* @brief   Updates an rltmap at coords with a registered tile prototype
+ *
+ * Unregistered IDs are skipped.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   id      ID returned by rltmap_proto(2)
+ * @param   x       x coordinate of the tile to update
+ * @param   y       y coordinate of the tile to update
+ */
+extern void
+rltmap_pid(rltmap *this, uint16_t id, int x, int y);
+
+/* @brief   Updates a rectangular region of an rltmap from a grid of tile IDs
+ *
+ * The ids array is read row by row and must hold width * height IDs returned
+ * by rltmap_proto(2). Unregistered IDs and tiles outside of the rltmap are
+ * skipped.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   ids     pointer to an array of width * height prototype IDs
+ * @param   x       x coordinate of the top left of the region
+ * @param   y       y coordinate of the top left of the region
+ * @param   width   width of the region (in # of tiles)
+ * @param   height  height of the region (in # of tiles)
+ */
+extern void
+rltmap_pgrid(rltmap *this, const uint16_t *ids, int x, int y, int width,
+    int height);
+
 /* @brief   Updates the foreground (glyph) hue at the coords on an rltmap
  *
  * @param   this    pointer to an rltmap
@@ -627,6 +1139,39 @@ rltmap_phuef(rltmap *this, rlhue hue, int x, int y);
 extern void
 rltmap_phueb(rltmap *this, rlhue hue, int x, int y);
 
+/* @brief   Updates the foreground hues of a rectangular region of an rltmap
+ *
+ * The hues array is read row by row and must hold width * height rlhues. This
+ * is intended to be paired with the rlhue batch functions, e.g. to fade or
+ * tint a whole rltmap at once. Tiles outside of the rltmap are skipped.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   hues    pointer to an array of width * height rlhues
+ * @param   x       x coordinate of the top left of the region
+ * @param   y       y coordinate of the top left of the region
+ * @param   width   width of the region (in # of tiles)
+ * @param   height  height of the region (in # of tiles)
+ */
+extern void
+rltmap_vhuef(rltmap *this, const rlhue *hues, int x, int y, int width,
+    int height);
+
+/* @brief   Updates the background hues of a rectangular region of an rltmap
+ *
+ * The hues array is read row by row and must hold width * height rlhues.
+ * Tiles outside of the rltmap are skipped.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   hues    pointer to an array of width * height rlhues
+ * @param   x       x coordinate of the top left of the region
+ * @param   y       y coordinate of the top left of the region
+ * @param   width   width of the region (in # of tiles)
+ * @param   height  height of the region (in # of tiles)
+ */
+extern void
+rltmap_vhueb(rltmap *this, const rlhue *hues, int x, int y, int width,
+    int height);
+
 /* @brief   Updates an rltmap with a *wchar_t, moving towards the right
  *
  * Places a wide string onto the rltmap, starting from the position specified
@@ -665,6 +1210,180 @@ extern void
 rltmap_wstrb(rltmap *this, wchar_t *wstr, rlhue fghue, rlhue bghue,
         rlttype type, int x, int y);
 
+/* @brief   Switches an rltmap between full and compact tile storage
+ *
+ * By default every tile of an rltmap is stored as the 8 vertices it is drawn
+ * with (160 bytes). A compact rltmap stores a 16 byte record per tile instead
+ * and expands it into vertices every time it is drawn, which takes about a
+ * tenth of the memory at the cost of some CPU time per draw. The hues of a
+ * compact tile are uniform, so an rltile uses the hues of its top left
+ * corner. Switching discards the contents of the rltmap. Backends that always
+ * store tiles compactly, such as the OpenGL one, ignore enabled.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   enabled whether the rltmap should use compact storage
+ *
+ * @return  whether the rltmap now uses compact storage
+ */
+extern bool
+rltmap_cmpct(rltmap *this, bool enabled);
+
+/* @brief   Sets the layout of the glyph atlas of an rltmap
+ *
+ * Glyphs are rasterized on first use and packed into square atlas pages of
+ * size pixels, with pad pixels of empty space around each one so filtering
+ * doesn't bleed between neighbors. A new page is started when a glyph fits
+ * in none of the existing ones, up to pages pages, so the atlas never takes
+ * more than pages * size * size bytes. Once it is full a page is evicted:
+ * the one drawn from by the fewest tiles, least recently used first. Its
+ * glyphs no tile draws are dropped and the others are rasterized again
+ * elsewhere, with the tiles drawing them moved along. Glyphs that still
+ * don't fit are drawn empty, counted in gfail of rlstats, and tried again the
+ * next time a tile is written with them. Only the part of a page written
+ * since the last draw is uploaded. Setting the layout discards the glyph
+ * cache, the tiles and the prototypes of the rltmap, unless it is an SDF
+ * rltmap that already shares an atlas of that layout. The default is 8
+ * pages of 1024 pixels with a padding of 1.
+ *
+ * Backends that pack glyphs through their windowing library (SFML) can't
+ * change the layout and return false, as do rltmaps drawing from a tilesheet.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   size    side of an atlas page in pixels (64 to 8192)
+ * @param   pages   maximum number of atlas pages (1 to 256)
+ * @param   pad     padding around each glyph in pixels (0 to 16)
+ *
+ * @return  whether the layout was applied
+ */
+extern bool
+rltmap_atlas(rltmap *this, int size, int pages, int pad);
+
+/* @brief   Sets whether an rltmap rasterizes glyphs as signed distance fields
+ *
+ * Glyphs of an SDF rltmap are stored as the distance to their outline,
+ * rasterized once at no less than 48 pixels, and resolved to an edge when
+ * drawn. They stay sharp when the rltmap is scaled or rotated, where the
+ * coverage glyphs of the default mode blur. As they don't depend on the
+ * size drawn at, SDF rltmaps of the same font path and atlas layout share
+ * one glyph cache and atlas, whatever their cell size up to 48 pixels
+ * (larger ones share with those of the same size). Changing the mode
+ * discards the glyph cache, the tiles and the prototypes of the rltmap.
+ *
+ * Backends without a distance field renderer (SFML, or FreeType before
+ * 2.11) return false when enabling it, as do rltmaps drawing from a
+ * tilesheet.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   enabled whether glyphs are rasterized as distance fields
+ *
+ * @return  whether the mode was applied
+ */
+extern bool
+rltmap_sdf(rltmap *this, bool enabled);
+
+/* @brief   Attaches or detaches a per-tile light map to an rltmap
+ *
+ * The light map holds one rlhue per tile. When the rltmap is drawn, the
+ * foreground and background hues of every tile are multiplied by its light
+ * hue on the GPU, so changing the lighting of an rltmap only uploads a
+ * width x height texture instead of rewriting every tile. A new light map is
+ * filled with white, which leaves the rltmap unchanged. Detaching the light
+ * map discards its contents.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   enabled whether the rltmap should have a light map
+ *
+ * @return  true on success, false if shaders are unavailable or the light map
+ *          could not be created
+ */
+extern bool
+rltmap_light(rltmap *this, bool enabled);
+
+/* @brief   Updates the light hue of a tile of an rltmap
+ *
+ * Does nothing if the rltmap has no light map attached.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   hue     new light hue of the tile
+ * @param   x       x coordinate of the tile to update
+ * @param   y       y coordinate of the tile to update
+ */
+extern void
+rltmap_plight(rltmap *this, rlhue hue, int x, int y);
+
+/* @brief   Updates the light hues of a rectangular region of an rltmap
+ *
+ * The hues array is read row by row and must hold width * height rlhues.
+ * Tiles outside of the rltmap are skipped. Does nothing if the rltmap has no
+ * light map attached.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   hues    pointer to an array of width * height rlhues
+ * @param   x       x coordinate of the top left of the region
+ * @param   y       y coordinate of the top left of the region
+ * @param   width   width of the region (in # of tiles)
+ * @param   height  height of the region (in # of tiles)
+ */
+extern void
+rltmap_vlight(rltmap *this, const rlhue *hues, int x, int y, int width,
+    int height);
+
+/* @brief   Enables or disables palette mode for an rltmap
+ *
+ * In palette mode the red channel of every foreground and background hue
+ * written to the rltmap (by rltmap_ptile(4), rltmap_pcell(4), rltmap_phuef(4)
+ * and so on) is an index into a 256 entry palette, and the other channels are
+ * ignored. The palette is looked up on the GPU when the rltmap is drawn, so
+ * changing an entry with rltmap_ppal(3) recolors every tile that uses it
+ * without any per-tile work. The indices are kept in the full hues of the
+ * tiles, so palette mode does not make the tile storage of an rltmap any
+ * smaller. A new palette is a grayscale ramp where entry i is {i, i, i, 255}.
+ * Disabling palette mode discards the palette and the hues already written
+ * are drawn as regular hues again.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   enabled whether the rltmap should be in palette mode
+ *
+ * @return  true on success, false if shaders are unavailable or the palette
+ *          could not be created
+ */
+extern bool
+rltmap_palet(rltmap *this, bool enabled);
+
+/* @brief   Sets a palette entry of an rltmap in palette mode
+ *
+ * @param   this    pointer to an rltmap
+ * @param   index   index of the palette entry
+ * @param   hue     new hue of the palette entry
+ */
+extern void
+rltmap_ppal(rltmap *this, uint8_t index, rlhue hue);
+
+/* @brief   Sets a range of palette entries of an rltmap in palette mode
+ *
+ * Entries past the end of the palette are ignored.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   hues    pointer to an array of count rlhues
+ * @param   first   index of the first palette entry to set
+ * @param   count   number of palette entries to set
+ */
+extern void
+rltmap_vpal(rltmap *this, const rlhue *hues, int first, int count);
+
+/* @brief   Sets the palette indices of a tile of an rltmap in palette mode
+ *
+ * The glyph of the tile is left untouched.
+ *
+ * @param   this    pointer to an rltmap
+ * @param   fg      palette index of the foreground (glyph) hue
+ * @param   bg      palette index of the background hue
+ * @param   x       x coordinate of the tile to update
+ * @param   y       y coordinate of the tile to update
+ */
+extern void
+rltmap_pindx(rltmap *this, uint8_t fg, uint8_t bg, int x, int y);
+
 /* @brief   Frees the memory allocated for an rltmap
  *
  * @param   this    pointer to an rltmap
@@ -754,6 +1473,115 @@ rlhue_add(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 extern void
 rlhue_sub(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
+/******************************************************************************
+rlhue batch function declarations
+******************************************************************************/
+
+/* The batch functions operate on contiguous arrays of rlhues and saturate
+ * instead of wrapping. They are vectorized where the CPU allows it, and the
+ * fastest implementation available is selected the first time one is called.
+ * Every implementation produces identical results.
+ */
+
+/* @brief   Adds an rlhue to every rlhue of an array, saturating at 255
+ *
+ * @param   hues    pointer to an array of rlhues
+ * @param   count   number of rlhues in the array
+ * @param   hue     rlhue to add to each element
+ */
+extern void
+rlhue_vadd(rlhue *hues, size_t count, rlhue hue);
+
+/* @brief   Subtracts an rlhue from every rlhue of an array, saturating at 0
+ *
+ * @param   hues    pointer to an array of rlhues
+ * @param   count   number of rlhues in the array
+ * @param   hue     rlhue to subtract from each element
+ */
+extern void
+rlhue_vsub(rlhue *hues, size_t count, rlhue hue);
+
+/* @brief   Modulates every rlhue of an array by an rlhue
+ *
+ * Each channel is multiplied by the matching channel of hue / 255, so white
+ * leaves the array unchanged and black clears it.
+ *
+ * @param   hues    pointer to an array of rlhues
+ * @param   count   number of rlhues in the array
+ * @param   hue     rlhue to modulate each element by
+ */
+extern void
+rlhue_vmul(rlhue *hues, size_t count, rlhue hue);
+
+/* @brief   Linearly interpolates every rlhue of an array towards another array
+ *
+ * @param   hues    pointer to an array of rlhues, which receives the result
+ * @param   to      pointer to an array of count target rlhues
+ * @param   count   number of rlhues in each array
+ * @param   t       interpolation amount, 0 keeps hues and 255 yields to
+ */
+extern void
+rlhue_vlerp(rlhue *hues, const rlhue *to, size_t count, uint8_t t);
+
+/* @brief   Blends an array of rlhues over another using the source alpha
+ *
+ * @param   hues    pointer to an array of destination rlhues
+ * @param   src     pointer to an array of count rlhues drawn over hues
+ * @param   count   number of rlhues in each array
+ */
+extern void
+rlhue_vover(rlhue *hues, const rlhue *src, size_t count);
+
+/* @brief   Desaturates every rlhue of an array towards its luma
+ *
+ * Alpha values are left untouched.
+ *
+ * @param   hues    pointer to an array of rlhues
+ * @param   count   number of rlhues in the array
+ * @param   amount  0 leaves the array unchanged, 255 makes it fully gray
+ */
+extern void
+rlhue_vgray(rlhue *hues, size_t count, uint8_t amount);
+
+/* @brief   Returns the name of the implementation used by the batch functions
+ *
+ * @return  one of "scalar", "sse2", "avx2" or "neon"
+ */
+extern const char *
+rlhue_vname(void);
+
+/* @brief   Selects the implementation used by the batch functions by name
+ *
+ * This is intended for testing and benchmarking. Passing NULL restores the
+ * automatically selected implementation.
+ *
+ * @param   name    name as returned by rlhue_vname(0), or NULL
+ *
+ * @return  true if the implementation is available, false otherwise
+ */
+extern bool
+rlhue_vimpl(const char *name);
+
+/******************************************************************************
+rlalloc function declarations
+******************************************************************************/
+
+/* @brief   Sets the functions the library allocates memory with
+ *
+ * Every allocation the library makes itself goes through these functions.
+ * Memory allocated internally by the backend (e.g. CSFML objects) does not.
+ * The allocator can only be changed while no memory allocated by the library
+ * is alive, i.e. before the first or after the last rldisp, rltmap, rltile
+ * and rltpool is freed, so never while an rltmap from rltmap_async(7) is
+ * loading.
+ *
+ * @param   alloc   pointer to the allocator functions, or NULL for the
+ *                  standard library ones
+ * @return  false if memory is still alive or a function is missing
+ */
+extern bool
+rlalloc_set(const rlalloc *alloc);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,6214 @@
+/*
+Copyright (c) 2017 Jacob P Adkins
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * OpenGL 3.3 core backend, using GLFW for windows and input and FreeType for
+ * glyphs.
+ *
+ * Every tile of an rltmap is a 20 byte instance record (struct rltinst) kept
+ * in client memory and mirrored in a GL buffer. Only the rows written since
+ * the last draw are uploaded, and the vertex shader expands each record into
+ * its background and glyph quads, so a map is drawn with two instanced draw
+ * calls no matter its size. Glyphs are rasterized by FreeType and packed into
+ * the pages of a per-map atlas in client memory, of which only the parts
+ * written since the last draw are uploaded (see rltmap_atlas(4)). Tilesheets
+ * are loaded with libpng and take the place of the atlas as a single page.
+ * rltmap_async(7) parses the font and rasterizes the printable ASCII glyphs
+ * on a thread of its own, with a FreeType library of its own, and the main
+ * thread packs them into the atlas once the rltmap is first used.
+ *
+ * GL objects are created lazily by the rldisp calls that need them, so
+ * rltmaps can be created and written before any rldisp exists. The contexts
+ * of all rldisps share their objects, and the objects of an rltmap are
+ * recreated if every rldisp was closed in between.
+ */
+
+#include "rl_display.h"
+
+#include <math.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <png.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_MODULE_H
+#include FT_BITMAP_H
+#define GLFW_INCLUDE_GLCOREARB
+#include <GLFW/glfw3.h>
+
+#define UNUSED(x) (void)x
+
+/* Argument validation of the hot paths. Defining RL_DISPLAY_NO_CHECKS
+   compiles it out, making invalid arguments undefined behavior. */
+#ifdef RL_DISPLAY_NO_CHECKS
+#define RL_INVALID(cond) 0
+#else
+#define RL_INVALID(cond) (cond)
+#endif
+
+/* Feature flags of the shader variants. The rltmap shader draws the
+   backgrounds of the tiles, or their glyphs with RL_SHADER_GLYPH (as signed
+   distance fields with RL_SHADER_SDF), skipping the tiles hidden by later
+   rltmaps with RL_SHADER_CULL, and RL_SHADER_SOLID selects the shader of the
+   primitives instead. */
+#define RL_SHADER_LIGHT     0x1
+#define RL_SHADER_PALET     0x2
+#define RL_SHADER_GLYPH     0x4
+#define RL_SHADER_SOLID     0x8
+#define RL_SHADER_SDF       0x10
+#define RL_SHADER_CULL      0x20
+#define RL_SHADER_MAXIMUM   0x40
+
+/* Number of entries in an rltmap palette */
+#define RL_PALET_SIZE       256
+
+/* Maximum number of tile prototypes per rltmap */
+#define RL_PROTO_MAXIMUM    65536
+
+/* Number of glyphs per page of an rltmap glyph cache */
+#define RL_GLYPH_PAGE       256
+
+/* Default side of a glyph atlas page in pixels, number of pages and padding
+   around each glyph, and the limits rltmap_atlas(4) accepts */
+#define RL_ATLAS_SIZE       1024
+#define RL_ATLAS_PAGES      8
+#define RL_ATLAS_PAD        1
+#define RL_ATLAS_MINSIZE    64
+#define RL_ATLAS_MAXSIZE    8192
+#define RL_ATLAS_MAXPAGES   256
+#define RL_ATLAS_MAXPAD     16
+
+/* Largest glyph bitmap that fits in an instance record along either axis */
+#define RL_GLYPH_MAXIMUM    255
+
+/* Smallest size in pixels the glyphs of an SDF rltmap are rasterized at, and
+   the distance from the outline in pixels of that size at which the distance
+   field saturates. FreeType renders distance fields since 2.11. */
+#define RL_SDF_SIZE         48
+#define RL_SDF_SPREAD       6
+
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+#define RL_SDF_SUPPORTED
+#endif
+
+/* Range of glyphs rasterized ahead by the loading thread of rltmap_async(7),
+   the printable ASCII characters */
+#define RL_ASYNC_FIRST      0x20
+#define RL_ASYNC_LAST       0x7E
+
+/* Size of the HUD rltmap in tiles and of its tiles in pixels. The frame time
+   graph fills the bottom RL_HUD_GRAPH rows, scaled so that a full column is
+   RL_HUD_SCALE seconds. */
+#define RL_HUD_WIDTH        40
+#define RL_HUD_HEIGHT       6
+#define RL_HUD_GRAPH        2
+#define RL_HUD_TILEX        8
+#define RL_HUD_TILEY        16
+#define RL_HUD_SCALE        (1.0 / 30.0)
+
+/* Input events waiting for a present to measure their latency against */
+#define RL_LATENCY_PENDING  64
+
+/* Hardware cursors kept by an rldisp for rldisp_cursor(6), and the largest
+   side of a cursor image in pixels */
+#define RL_CURSOR_CACHE     16
+#define RL_CURSOR_MAXIMUM   256
+
+/* Number of draws an rldisp holds back for occlusion culling or deferred
+   drawing before it submits them (see rldisp_occl(2), rldisp_defer(2)) */
+#define RL_QUEUE_DRAWS      64
+
+/* Sub pixel precision of the glyph shifts stored in tile instances */
+#define RL_SHIFT_SUB        16.0f
+
+/* Capacity of the trace event ring buffer */
+#ifndef RL_TRACE_EVENTS
+#define RL_TRACE_EVENTS     16384
+#endif
+
+/* Trace points. Each one expands to a single test of rltrace.on when RL_TRACE
+   is defined and to nothing otherwise. RL_TRACE_END(3) takes the start time
+   of the scope in seconds and RL_TRACE_MARK(2) records an instant event. */
+#ifdef RL_TRACE
+#define RL_TRACE_BEGIN(t0) \
+    double t0 = rltrace.on ? rlstats_now() : 0.0
+#define RL_TRACE_END(name, t0, count) \
+    do { if (rltrace.on) rltrace_push(name, t0, count); } while (0)
+#define RL_TRACE_MARK(name, count) \
+    do { if (rltrace.on) rltrace_push(name, -1.0, count); } while (0)
+#else
+#define RL_TRACE_BEGIN(t0)
+#define RL_TRACE_END(name, t0, count)
+#define RL_TRACE_MARK(name, count)
+#endif
+
+/* GL entry points used by the backend, loaded through GLFW when the first
+   context is created */
+#define RL_GL_FUNCS \
+    RL_GL(PFNGLACTIVETEXTUREPROC, ActiveTexture) \
+    RL_GL(PFNGLATTACHSHADERPROC, AttachShader) \
+    RL_GL(PFNGLBINDBUFFERPROC, BindBuffer) \
+    RL_GL(PFNGLBINDFRAMEBUFFERPROC, BindFramebuffer) \
+    RL_GL(PFNGLBINDTEXTUREPROC, BindTexture) \
+    RL_GL(PFNGLBINDVERTEXARRAYPROC, BindVertexArray) \
+    RL_GL(PFNGLBLENDFUNCSEPARATEPROC, BlendFuncSeparate) \
+    RL_GL(PFNGLBLITFRAMEBUFFERPROC, BlitFramebuffer) \
+    RL_GL(PFNGLBUFFERDATAPROC, BufferData) \
+    RL_GL(PFNGLBUFFERSUBDATAPROC, BufferSubData) \
+    RL_GL(PFNGLCHECKFRAMEBUFFERSTATUSPROC, CheckFramebufferStatus) \
+    RL_GL(PFNGLCLEARPROC, Clear) \
+    RL_GL(PFNGLCLEARCOLORPROC, ClearColor) \
+    RL_GL(PFNGLCOMPILESHADERPROC, CompileShader) \
+    RL_GL(PFNGLCOPYTEXSUBIMAGE3DPROC, CopyTexSubImage3D) \
+    RL_GL(PFNGLCREATEPROGRAMPROC, CreateProgram) \
+    RL_GL(PFNGLCREATESHADERPROC, CreateShader) \
+    RL_GL(PFNGLDELETEBUFFERSPROC, DeleteBuffers) \
+    RL_GL(PFNGLDELETEFRAMEBUFFERSPROC, DeleteFramebuffers) \
+    RL_GL(PFNGLDELETEPROGRAMPROC, DeleteProgram) \
+    RL_GL(PFNGLDELETESHADERPROC, DeleteShader) \
+    RL_GL(PFNGLDELETETEXTURESPROC, DeleteTextures) \
+    RL_GL(PFNGLDELETEVERTEXARRAYSPROC, DeleteVertexArrays) \
+    RL_GL(PFNGLDRAWARRAYSPROC, DrawArrays) \
+    RL_GL(PFNGLDRAWARRAYSINSTANCEDPROC, DrawArraysInstanced) \
+    RL_GL(PFNGLENABLEPROC, Enable) \
+    RL_GL(PFNGLENABLEVERTEXATTRIBARRAYPROC, EnableVertexAttribArray) \
+    RL_GL(PFNGLFRAMEBUFFERTEXTURE2DPROC, FramebufferTexture2D) \
+    RL_GL(PFNGLFRAMEBUFFERTEXTURELAYERPROC, FramebufferTextureLayer) \
+    RL_GL(PFNGLGENBUFFERSPROC, GenBuffers) \
+    RL_GL(PFNGLGENFRAMEBUFFERSPROC, GenFramebuffers) \
+    RL_GL(PFNGLGENTEXTURESPROC, GenTextures) \
+    RL_GL(PFNGLGENVERTEXARRAYSPROC, GenVertexArrays) \
+    RL_GL(PFNGLGETPROGRAMIVPROC, GetProgramiv) \
+    RL_GL(PFNGLGETSHADERIVPROC, GetShaderiv) \
+    RL_GL(PFNGLGETUNIFORMLOCATIONPROC, GetUniformLocation) \
+    RL_GL(PFNGLLINKPROGRAMPROC, LinkProgram) \
+    RL_GL(PFNGLPIXELSTOREIPROC, PixelStorei) \
+    RL_GL(PFNGLSHADERSOURCEPROC, ShaderSource) \
+    RL_GL(PFNGLTEXIMAGE2DPROC, TexImage2D) \
+    RL_GL(PFNGLTEXIMAGE3DPROC, TexImage3D) \
+    RL_GL(PFNGLTEXPARAMETERIPROC, TexParameteri) \
+    RL_GL(PFNGLTEXSUBIMAGE2DPROC, TexSubImage2D) \
+    RL_GL(PFNGLTEXSUBIMAGE3DPROC, TexSubImage3D) \
+    RL_GL(PFNGLUNIFORM1FPROC, Uniform1f) \
+    RL_GL(PFNGLUNIFORM1IPROC, Uniform1i) \
+    RL_GL(PFNGLUNIFORM2FPROC, Uniform2f) \
+    RL_GL(PFNGLUNIFORMMATRIX3FVPROC, UniformMatrix3fv) \
+    RL_GL(PFNGLUSEPROGRAMPROC, UseProgram) \
+    RL_GL(PFNGLVERTEXATTRIBDIVISORPROC, VertexAttribDivisor) \
+    RL_GL(PFNGLVERTEXATTRIBIPOINTERPROC, VertexAttribIPointer) \
+    RL_GL(PFNGLVERTEXATTRIBPOINTERPROC, VertexAttribPointer) \
+    RL_GL(PFNGLVIEWPORTPROC, Viewport)
+
+/******************************************************************************
+Struct definitions
+******************************************************************************/
+
+/* The hues of an rltile are uniform, as every tile is drawn with one hue per
+   layer */
+struct rltile {
+    float right;
+    float bottom;
+    rlttype type;
+    wchar_t glyph;
+    rlhue fghue;
+    rlhue bghue;
+};
+
+struct rlrect
+{
+    int left;
+    int top;
+    int width;
+    int height;
+};
+
+/* Cached glyph metrics needed to place a tile, in atlas pixels, and the
+   atlas page its bitmap is in */
+struct rltglyph
+{
+    bool ok;
+    int page;
+    float left;
+    float top;
+    struct rlrect rect;
+};
+
+/* A tile as read by the tile shader: the position of its glyph in the atlas,
+   the size of the glyph packed as width | height << 8, the atlas page, the
+   shift of the glyph from the top left of the tile in 1/RL_SHIFT_SUB pixels
+   and its hues. The position of the tile follows from its instance index. */
+struct rltinst
+{
+    uint16_t rect[4];
+    int16_t shift[2];
+    rlhue fg;
+    rlhue bg;
+};
+
+/* A segment of the skyline of an atlas page: the span from x to x + width is
+   filled from the top down to y */
+struct rlsky
+{
+    int x;
+    int y;
+    int width;
+};
+
+/* A page of the glyph atlas with its skyline, and the bounds of the pixels
+   written since the last upload, empty when x1 < x0 */
+struct rlpage
+{
+    uint8_t *pixels;
+    int nsky;
+    struct rlsky *sky;
+
+    /* Value of the atlas tick when a glyph on the page was last looked up */
+    unsigned tick;
+
+    struct {
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+    } dirty;
+};
+
+/* A glyph rasterized by the loading thread of rltmap_async(7), waiting to
+   be packed into the atlas */
+struct rlpre
+{
+    int left;
+    int top;
+    FT_Bitmap bitmap;
+};
+
+/* A glyph on an atlas page being evicted, keyed by its place on the page,
+   and whether a tile or prototype still draws it */
+struct rlmove
+{
+    uint32_t key;
+    wchar_t glyph;
+    bool live;
+};
+
+/* Rasterized glyphs and the atlas they are packed into. An rltmap has one
+   of its own, but distance fields don't depend on the size drawn at, so
+   SDF rltmaps of the same font file rasterizing at the same size share one,
+   found by path in rlcaches. maps links the rltmaps drawing from it. */
+struct rlcache
+{
+    struct rlcache *next;
+    char *path;
+    int rsize;
+    rltmap *maps;
+
+    struct {
+        int pages;
+        struct rltglyph **list;
+    } glyph;
+
+    /* Coverage of the rasterized glyphs, one byte per pixel, in up to
+       limit square pages of size pixels, of which count are in use. The
+       atlas of a tilesheet is the sheet, four bytes per pixel, as its only
+       page. tick counts the draws from the atlas, to tell which page was
+       used least recently. */
+    struct {
+        int size;
+        int bpp;
+        int pad;
+        int limit;
+        int count;
+        unsigned tick;
+        struct rlpage *pages;
+    } atlas;
+
+    /* GL objects, valid while gen matches rlgen. The atlas is an array
+       texture with a layer per page, of which layers are allocated. */
+    struct {
+        unsigned gen;
+        GLuint atlas;
+        int layers;
+    } gl;
+};
+
+struct rltmap
+{
+    int x;
+    int y;
+    int offx;
+    int offy;
+    int cnum;
+    int origx;
+    int origy;
+    float rot;
+    int csize;
+    int width;
+    int height;
+    float scale;
+
+    /* Tells the rltmap apart from those made before, whose address it can
+       take once they are freed */
+    unsigned id;
+    FT_Face font;
+    struct rltinst *tiles;
+
+    /* The rldisp holding the rltmap back for occlusion culling, if any */
+    rldisp *queued;
+
+    /* Bounds of the tiles written since the last draw, empty when x1 < x0 */
+    struct {
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+    } dirty;
+
+    /* Font file of the rltmap, to find the glyph cache it shares. cache is
+       the glyph cache it draws from, and cnext the next rltmap that does. */
+    char *path;
+    struct rlcache *cache;
+    rltmap *cnext;
+
+    /* Whether glyphs are signed distance fields, the size of an atlas pixel
+       in pixels of the rltmap, and the width of the distance border of the
+       glyphs in pixels of the rltmap */
+    struct {
+        bool on;
+        float texel;
+        float border;
+    } sdf;
+
+    struct {
+        int dirty0;
+        int dirty1;
+        rlhue *hues;
+    } light;
+
+    struct {
+        bool dirty;
+        rlhue *hues;
+    } palet;
+
+    struct {
+        int count;
+        int capacity;
+        struct rltinst *list;
+    } proto;
+
+    /* Font loaded by rltmap_async(7). While pending, the loading thread owns
+       everything here but pending and lock, and sets done under lock when
+       it is finished. lib holds the font from then on. mem allocates with
+       hooks, the allocator hooks when the load started, and counts its
+       blocks in alive until rltmap_adopt hands them over. */
+    struct {
+        bool pending;
+        bool done;
+        bool failed;
+        char *path;
+        pthread_t thread;
+        pthread_mutex_t lock;
+        rlalloc hooks;
+        int alive;
+        struct FT_MemoryRec_ mem;
+        FT_Library lib;
+        FT_Face face;
+        int count;
+        struct rlpre *pre;
+    } load;
+
+    /* GL objects, valid while gen matches rlgen. cull marks the tiles
+       hidden by later rltmaps, made on the first draw that hides any, and
+       holds the mask of the draw held back in mdraw. */
+    struct {
+        unsigned gen;
+        GLuint tiles;
+        GLuint light;
+        GLuint palet;
+        GLuint cull;
+        const struct rlqdraw *mdraw;
+    } gl;
+
+    /* Counters of the rlstats of the frame that draws the rltmap next */
+    struct {
+        int tiles;
+        int gmiss;
+        int agrow;
+        int gevict;
+        int graster;
+        int gfail;
+    } stats;
+};
+
+union rltnode
+{
+    struct rltile tile;
+    union rltnode *next;
+};
+
+struct rltslab
+{
+    struct rltslab *next;
+    union rltnode nodes[];
+};
+
+struct rltpool
+{
+    int count;
+    union rltnode *head;
+    struct rltslab *slabs;
+};
+
+/* A vertex of a primitive, in frame coordinates */
+struct rlpvert
+{
+    float x;
+    float y;
+    rlhue hue;
+};
+
+/* A linked shader variant and the locations of its uniforms */
+struct rlshader
+{
+    GLuint prog;
+    GLint xform;
+    GLint frame;
+    GLint cell;
+    GLint width;
+    GLint texel;
+};
+
+/* A draw held back by an rldisp. An rltmap with its transform when it was
+   drawn, the offset of its cells in the cull mask of the rldisp and how
+   many of them are hidden, or when tmap is NULL, count vertices of
+   primitives from first in the queue. box bounds all it draws and bbox
+   its backgrounds in frame coordinates, and batch is the batch its
+   backgrounds or primitives are submitted in. */
+struct rlqdraw
+{
+    rltmap *tmap;
+    float m[9];
+    size_t mask;
+    int culled;
+    int first;
+    int count;
+    float box[4];
+    float bbox[4];
+    int batch;
+};
+
+/* Draws submitted together. Either the glyphs of the rltmap held back at
+   draw, or when draw is -1, the backgrounds and primitives merged into one
+   buffer. box bounds what it draws in frame coordinates. */
+struct rlbatch
+{
+    int draw;
+    float box[4];
+};
+
+/* A hardware cursor made by rldisp_cursor(6) and what it was made from,
+   the rltmap by its id */
+struct rlcursor
+{
+    unsigned tmap;
+    wchar_t glyph;
+    rlhue fghue;
+    rlhue bghue;
+    int scale;
+    int hotx;
+    int hoty;
+    GLFWcursor *handle;
+};
+
+struct rldisp
+{
+    rldisp *next;
+
+    /* wwidth and wheight are the size of the window when windowed, kept
+       while it is fullscreen */
+    struct {
+        int width;
+        int height;
+        int wwidth;
+        int wheight;
+        int scroll;
+        char *name;
+        bool fscrn;
+        int limit;
+        double due;
+        GLFWwindow *handle;
+    } window;
+
+    /* dirty is set when the frame is drawn to, or has to be shown again,
+       and cleared by rldisp_prsnt(1). clear is set while nothing was drawn
+       to the frame since rldisp_clear(1) cleared it. */
+    struct {
+        int width;
+        int height;
+        bool filter;
+        bool dirty;
+        bool clear;
+        rlhue clrhue;
+        struct {
+            float x;
+            float y;
+        } scale;
+        GLuint fbo;
+        GLuint texture;
+    } frame;
+
+    /* Idle mode, in which rldisp_evtflsh(1) waits up to timeout seconds for
+       input (without limit if 0), or until wake if that is sooner and not
+       0 */
+    struct {
+        bool on;
+        double timeout;
+        double wake;
+    } idle;
+
+    /* Vertex array objects are not shared between contexts, so every rldisp
+       has its own for the tiles and the primitives, along with the buffer
+       the primitives are streamed through */
+    struct {
+        GLuint tvao;
+        GLuint pvao;
+        GLuint pvbo;
+    } gl;
+
+    struct {
+        int head;
+        int count;
+        bool noalloc;
+        double prev;
+        double born;
+        double tfirst;
+        double switched;
+        double tmode;
+        int allocs;
+        rlstats acc;
+        rlstats last;
+        double frames[RL_STATS_FRAMES];
+    } stats;
+
+    struct {
+        int count;
+        double psum;
+        double ssum;
+        rllatency last;
+        double arrival[RL_LATENCY_PENDING];
+    } latency;
+
+    struct {
+        bool shown;
+        bool down;
+        rlkey key;
+        rltmap *tmap;
+        int count;
+        struct rlrect dirty[RL_STATS_MAPS];
+    } hud;
+
+    /* Cached hardware cursors, of which count are made. Once all are, next
+       is the one replaced. shown is the one installed, NULL for the system
+       cursor. */
+    struct {
+        int count;
+        int next;
+        struct rlcursor *shown;
+        struct rlcursor list[RL_CURSOR_CACHE];
+    } cursor;
+
+    /* Occlusion culling. The rltmaps held back are drawn without the cells
+       that later ones hide. mask has a byte per cell of each, 255 when
+       hidden, and sat is the summed area table of the opaque cells of the
+       rltmap hiding them. */
+    struct {
+        bool on;
+        uint8_t *mask;
+        size_t msize;
+        int *sat;
+        size_t ssize;
+    } occl;
+
+    /* Draws held back for occlusion culling, or for deferred drawing where
+       primitives are held back too, their vertices in prims. batch is
+       where backgrounds and primitives are merged on submission. */
+    struct {
+        bool defer;
+        int count;
+        struct rlqdraw list[RL_QUEUE_DRAWS];
+        struct rlpvert *prims;
+        int pcount;
+        int psize;
+        struct rlpvert *batch;
+        int bsize;
+    } queue;
+};
+
+#ifdef RL_TRACE
+struct rltevt
+{
+    const char *name;
+    double ts;
+    double dur;
+    int count;
+};
+#endif
+
+/* Default allocator hooks, declared here since rlahooks refers to them */
+static void *
+rlalloc_dmalloc(void *user, size_t size);
+
+static void *
+rlalloc_drealloc(void *user, void *ptr, size_t size);
+
+static void
+rlalloc_dfree(void *user, void *ptr);
+
+/* FreeType allocates through the library's allocator as well */
+static void *
+rlft_alloc(FT_Memory memory, long size);
+
+static void *
+rlft_realloc(FT_Memory memory, long cur, long size, void *block);
+
+static void
+rlft_free(FT_Memory memory, void *block);
+
+static void *
+rlft_lalloc(FT_Memory memory, long size);
+
+static void *
+rlft_lrealloc(FT_Memory memory, long cur, long size, void *block);
+
+static void
+rlft_lfree(FT_Memory memory, void *block);
+
+/******************************************************************************
+Static global variables
+******************************************************************************/
+
+static int rldcount = 0;
+static int rltcount = 0;
+static unsigned rltnext = 0;
+static double rldlast = 0.0;
+static int rlacount = 0;
+static size_t rlabytes = 0;
+static int rlalive = 0;
+static rlalloc rlahooks = {rlalloc_dmalloc, rlalloc_drealloc, rlalloc_dfree,
+    NULL};
+
+/* Open rldisps, whose contexts form a single share group. rlgen counts the
+   share groups created so far, so GL objects of an earlier one are known to
+   be gone. rlbound is the rldisp whose frame is bound for drawing. */
+static rldisp *rldlist = NULL;
+static unsigned rlgen = 0;
+static rldisp *rlbound = NULL;
+static struct rlshader rlshaders[RL_SHADER_MAXIMUM];
+
+static FT_Library rlftlib = NULL;
+static struct rlcache *rlcaches = NULL;
+static const struct rltglyph rltgnone = {true, 0, 0.0f, 0.0f, {0, 0, 0, 0}};
+static struct FT_MemoryRec_ rlftmem = {NULL, rlft_alloc, rlft_free,
+    rlft_realloc};
+
+/* Unicode equivalents of the characters of code page 437, the layout of
+   tilesheets without a codepoint map */
+static const wchar_t rlcp437[256] = {
+    0x0000, 0x263A, 0x263B, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022,
+    0x25D8, 0x25CB, 0x25D9, 0x2642, 0x2640, 0x266A, 0x266B, 0x263C,
+    0x25BA, 0x25C4, 0x2195, 0x203C, 0x00B6, 0x00A7, 0x25AC, 0x21A8,
+    0x2191, 0x2193, 0x2192, 0x2190, 0x221F, 0x2194, 0x25B2, 0x25BC,
+    0x0020, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027,
+    0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+    0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+    0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+    0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+    0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+    0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+    0x0058, 0x0059, 0x005A, 0x005B, 0x005C, 0x005D, 0x005E, 0x005F,
+    0x0060, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+    0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+    0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+    0x0078, 0x0079, 0x007A, 0x007B, 0x007C, 0x007D, 0x007E, 0x2302,
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+    0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0,
+};
+
+static struct
+{
+#define RL_GL(type, name) type name;
+    RL_GL_FUNCS
+#undef RL_GL
+} rlgl;
+
+#ifdef RL_TRACE
+static struct
+{
+    bool on;
+    bool wrap;
+    int head;
+    struct rltevt evts[RL_TRACE_EVENTS];
+} rltrace;
+#endif
+
+/******************************************************************************
+Shader sources
+******************************************************************************/
+
+/* The shaders are assembled from these sources, prefixed with the GLSL
+   version and a #define for each RL_SHADER_* flag that the variant enables.
+   The tile vertex shader draws a tile per instance as a 4 vertex strip,
+   either its background or its glyph. A culled tile collapses to a point
+   outside of the frame, which is clipped before rasterization. */
+
+static const char *rlshader_vert =
+    "layout(location = 0) in uvec4 rl_rect;\n"
+    "layout(location = 1) in ivec2 rl_shift;\n"
+    "layout(location = 2) in vec4 rl_fg;\n"
+    "layout(location = 3) in vec4 rl_bg;\n"
+    "uniform mat3 rl_xform;\n"
+    "uniform vec2 rl_frame;\n"
+    "uniform vec2 rl_cell;\n"
+    "uniform int rl_width;\n"
+    "uniform float rl_texel;\n"
+    "#ifdef RL_SHADER_CULL\n"
+    "uniform sampler2D rl_cull;\n"
+    "#endif\n"
+    "out vec2 rl_uv;\n"
+    "out vec2 rl_pos;\n"
+    "flat out vec4 rl_hue;\n"
+    "flat out float rl_page;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+    "    vec2 pos = vec2(gl_InstanceID % rl_width, gl_InstanceID / rl_width)\n"
+    "        * rl_cell;\n"
+    "#ifdef RL_SHADER_GLYPH\n"
+    "    vec2 size = vec2(rl_rect.z & 255u, rl_rect.z >> 8u);\n"
+    "    pos += vec2(rl_shift) / RL_SHIFT_SUB + corner * size * rl_texel;\n"
+    "    rl_uv = vec2(rl_rect.xy) + corner * size;\n"
+    "    rl_hue = rl_fg;\n"
+    "    rl_page = float(rl_rect.w);\n"
+    "#else\n"
+    "    pos += corner * rl_cell;\n"
+    "    rl_uv = vec2(0.0);\n"
+    "    rl_hue = rl_bg;\n"
+    "    rl_page = 0.0;\n"
+    "#endif\n"
+    "    rl_pos = pos / rl_cell;\n"
+    "    pos = (rl_xform * vec3(pos, 1.0)).xy;\n"
+    "    gl_Position = vec4(pos.x / rl_frame.x * 2.0 - 1.0,\n"
+    "        1.0 - pos.y / rl_frame.y * 2.0, 0.0, 1.0);\n"
+    "#ifdef RL_SHADER_CULL\n"
+    "    if (texelFetch(rl_cull, ivec2(gl_InstanceID % rl_width,\n"
+    "        gl_InstanceID / rl_width), 0).r > 0.5)\n"
+    "        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+    "#endif\n"
+    "}\n";
+
+static const char *rlshader_frag =
+    "uniform sampler2DArray rl_atlas;\n"
+    "uniform sampler2D rl_light;\n"
+    "uniform sampler2D rl_palet;\n"
+    "in vec2 rl_uv;\n"
+    "in vec2 rl_pos;\n"
+    "flat in vec4 rl_hue;\n"
+    "flat in float rl_page;\n"
+    "out vec4 rl_out;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 hue = rl_hue;\n"
+    "#ifdef RL_SHADER_PALET\n"
+    "    hue = texelFetch(rl_palet, ivec2(int(hue.r * 255.0 + 0.5), 0), 0);\n"
+    "#endif\n"
+    "#ifdef RL_SHADER_LIGHT\n"
+    "    hue *= texelFetch(rl_light, clamp(ivec2(floor(rl_pos)), ivec2(0),\n"
+    "        textureSize(rl_light, 0) - 1), 0);\n"
+    "#endif\n"
+    "#ifdef RL_SHADER_GLYPH\n"
+    "    vec4 texel = texture(rl_atlas, vec3(rl_uv\n"
+    "        / vec2(textureSize(rl_atlas, 0).xy), rl_page));\n"
+    "#ifdef RL_SHADER_SDF\n"
+    "    float d = texel.a - 128.0 / 255.0;\n"
+    "    float w = length(vec2(dFdx(d), dFdy(d)));\n"
+    "    hue.a *= clamp(d / max(w, 1e-5) + 0.5, 0.0, 1.0);\n"
+    "#else\n"
+    "    hue *= texel;\n"
+    "#endif\n"
+    "#endif\n"
+    "    rl_out = hue;\n"
+    "}\n";
+
+static const char *rlshader_svert =
+    "layout(location = 0) in vec2 rl_vpos;\n"
+    "layout(location = 1) in vec4 rl_vhue;\n"
+    "uniform vec2 rl_frame;\n"
+    "out vec4 rl_hue;\n"
+    "void main()\n"
+    "{\n"
+    "    rl_hue = rl_vhue;\n"
+    "    gl_Position = vec4(rl_vpos.x / rl_frame.x * 2.0 - 1.0,\n"
+    "        1.0 - rl_vpos.y / rl_frame.y * 2.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *rlshader_sfrag =
+    "in vec4 rl_hue;\n"
+    "out vec4 rl_out;\n"
+    "void main()\n"
+    "{\n"
+    "    rl_out = rl_hue;\n"
+    "}\n";
+
+/******************************************************************************
+Static function declarations
+******************************************************************************/
+
+/* misc */
+static char *
+rlstrdup(const char *s);
+
+static bool
+rlgl_load(void);
+
+static bool
+rlgl_ctx(void);
+
+/* memory */
+static void *
+rlmalloc(size_t size);
+
+static void *
+rlcalloc(size_t count, size_t size);
+
+static void *
+rlrealloc(void *ptr, size_t size);
+
+static void
+rlfree(void *ptr);
+
+/* stats */
+static double
+rlstats_now(void);
+
+static int
+rlstats_cmp(const void *a, const void *b);
+
+#ifdef RL_TRACE
+/* trace */
+static void
+rltrace_push(const char *name, double t0, int count);
+#endif
+
+/* rldisp */
+static void
+rldisp_updscl(rldisp *this);
+
+static void
+rldisp_updstats(rldisp *this, double now);
+
+static void
+rldisp_evtarr(rldisp *this);
+
+static double
+rldisp_until(rldisp *this, double now);
+
+static double
+rldisp_wait(rldisp *this);
+
+static rlhue
+rldisp_curpix(const uint8_t *src, int bpp, rlhue fghue, rlhue bghue);
+
+static GLFWcursor *
+rldisp_mkcur(rltmap *tmap, rlcell cell, int scale, int hotx, int hoty);
+
+static void
+rldisp_updlat(rldisp *this, double present, double swap);
+
+static void
+rldisp_drwhud(rldisp *this);
+
+static void
+rldisp_drwmap(rldisp *this, rltmap *tmap, const float *m,
+    const struct rlqdraw *q);
+
+static void
+rldisp_flush(rldisp *this);
+
+static int
+rldisp_sat(rldisp *this, rltmap *tmap);
+
+static int
+rldisp_hide(rldisp *this, const struct rlqdraw *back,
+    const struct rlqdraw *front);
+
+static void
+rldisp_prpmap(rldisp *this, rltmap *tmap);
+
+static void
+rldisp_upcull(rldisp *this, const struct rlqdraw *q);
+
+static void
+rldisp_drwpass(rldisp *this, rltmap *tmap, const float *m, bool cull,
+    bool glyph);
+
+static void
+rldisp_endmap(rldisp *this, rltmap *tmap);
+
+static void
+rldisp_tstats(rldisp *this, rltmap *tmap);
+
+static void
+rldisp_submit(rldisp *this, int count);
+
+static int
+rldisp_expbg(rldisp *this, struct rlqdraw *q, const uint8_t *mask,
+    struct rlpvert *verts);
+
+static int
+rldisp_xquad(struct rlpvert *verts, const float *m, float l, float t,
+    float r, float b, rlhue hue);
+
+static void
+rldisp_xbox(const float *m, const float *box, float *out);
+
+static bool
+rldisp_hit(const float *a, const float *b);
+
+static void
+rldisp_hudln(rldisp *this, wchar_t *line, int y, rlhue fg, rlhue bg);
+
+static void
+rldisp_rsizd(rldisp *this, int w, int h);
+
+static void
+rldisp_bind(rldisp *this);
+
+static void
+rldisp_dprim(rldisp *this, const struct rlpvert *verts, int count);
+
+static void
+rldisp_dsolid(rldisp *this, const struct rlpvert *verts, int count);
+
+static int
+rldisp_quad(struct rlpvert *verts, float l, float t, float r, float b,
+    rlhue hue);
+
+static void
+rldisp_cbkey(GLFWwindow *window, int key, int scancode, int action,
+    int mods);
+
+static void
+rldisp_cbbtn(GLFWwindow *window, int button, int action, int mods);
+
+static void
+rldisp_cbscrl(GLFWwindow *window, double dx, double dy);
+
+static void
+rldisp_cbsize(GLFWwindow *window, int width, int height);
+
+static void
+rldisp_cbrfsh(GLFWwindow *window);
+
+/* rltile */
+static void
+rltile_set(rltile *this, wchar_t glyph, rlhue fghue, rlhue bghue,
+    rlttype type, float right, float bottom);
+
+/* rltpool */
+static bool
+rltpool_grow(rltpool *this);
+
+/* rltmap */
+static rltmap *
+rltmap_new(int csize, int cnum, int width, int height, int offx, int offy);
+
+static int
+rltmap_index(rltmap *this, int x, int y);
+
+static void
+rltmap_dirty(rltmap *this, int x, int y);
+
+static void
+rltmap_clean(rltmap *this);
+
+static void
+rltmap_flush(rltmap *this);
+
+static void *
+rltmap_work(void *arg);
+
+static void
+rltmap_adopt(rltmap *this);
+
+static struct rltglyph *
+rltmap_entry(rltmap *this, wchar_t glyph);
+
+static const struct rltglyph *
+rltmap_glyph(rltmap *this, wchar_t glyph);
+
+static bool
+rltmap_load(rltmap *this, wchar_t glyph);
+
+static void
+rltmap_raster(rltmap *this, wchar_t glyph, struct rltglyph *entry,
+    bool evict);
+
+static bool
+rltmap_place(rltmap *this, struct rltglyph *entry, const FT_Bitmap *bitmap);
+
+static void
+rltmap_use(rltmap *this, struct rlcache *cache);
+
+static bool
+rltmap_evict(rltmap *this);
+
+static bool
+rltmap_pack(rltmap *this, int width, int height, int *page, int *x, int *y);
+
+static bool
+rltmap_addpg(rltmap *this);
+
+static void
+rltmap_updtile(rltmap *this, rltile *t, int x, int y);
+
+static void
+rltmap_updcell(rltmap *this, const rlcell *c, int x, int y);
+
+static void
+rltmap_shift(rltmap *this, wchar_t glyph, rlttype type, float right,
+    float bottom, float *r, float *b, const struct rltglyph **g);
+
+static void
+rltmap_updhue(rltmap *this, bool fg, const rlhue *hues, int x, int y,
+    int width, int height);
+
+static size_t
+rltmap_sync(rltmap *this);
+
+static GLuint
+rltmap_mktex(GLenum format, int width, int height, GLint filter);
+
+static void
+rltmap_deltex(rltmap *this, GLuint *tex);
+
+static const struct rlshader *
+rltmap_shader(rltmap *this, bool glyph, bool cull);
+
+static void
+rltmap_xform(rltmap *this, float *m);
+
+static rlhue
+rltmap_bghue(rltmap *this, int i);
+
+static bool
+rltmap_opaque(rltmap *this, int i);
+
+static void
+rltmap_bounds(rltmap *this, int i, float *box);
+
+static void
+rltmap_extent(rltmap *this, float *box);
+
+/* rltinst */
+static void
+rltinst_set(struct rltinst *this, const struct rltglyph *g, float r,
+    float b, rlhue fg, rlhue bg);
+
+/* rlcache */
+static struct rlcache *
+rlcache_get(const char *path, int rsize, int cnum, int size, int limit,
+    int pad);
+
+static void
+rlcache_free(struct rlcache *this);
+
+static void
+rlcache_gfree(struct rlcache *this);
+
+static void
+rlcache_layers(struct rlcache *this);
+
+static size_t
+rlcache_sync(struct rlcache *this);
+
+/* rlpage */
+static int
+rlpage_fit(const struct rlpage *this, int size, int i, int width,
+    int height);
+
+static bool
+rlpage_pack(struct rlpage *this, int size, int width, int height, int *x,
+    int *y);
+
+/* shaders */
+static const struct rlshader *
+rlshader_get(int flags);
+
+static GLuint
+rlshader_cmpl(GLenum type, const char *defs, const char *src);
+
+static void
+rlshader_free(void);
+
+/******************************************************************************
+Misc static function implementations
+******************************************************************************/
+
+static char *
+rlstrdup(const char *s)
+{
+    char *d = NULL;
+    size_t len;
+
+    if (!s)
+        return NULL;
+
+    len = strlen(s);
+
+    if (!(d = rlmalloc(len + 1)))
+        return NULL;
+
+    d[len] = '\0';
+    strcpy(d, s);
+    return d;
+}
+
+static bool
+rlgl_load(void)
+{
+#define RL_GL(type, name) \
+    if (!(rlgl.name = (type)glfwGetProcAddress("gl" #name))) \
+        return false;
+    RL_GL_FUNCS
+#undef RL_GL
+
+    return true;
+}
+
+/* Makes sure a context of the share group is current, so GL objects can be
+   created or deleted outside of the rldisp calls. Returns false if there is
+   no share group left. */
+static bool
+rlgl_ctx(void)
+{
+    if (!rldlist)
+        return false;
+
+    if (!glfwGetCurrentContext())
+        glfwMakeContextCurrent(rldlist->window.handle);
+
+    return true;
+}
+
+/******************************************************************************
+Memory static function implementations
+******************************************************************************/
+
+static void *
+rlalloc_dmalloc(void *user, size_t size)
+{
+    UNUSED(user);
+    return malloc(size);
+}
+
+static void *
+rlalloc_drealloc(void *user, void *ptr, size_t size)
+{
+    UNUSED(user);
+    return realloc(ptr, size);
+}
+
+static void
+rlalloc_dfree(void *user, void *ptr)
+{
+    UNUSED(user);
+    free(ptr);
+}
+
+static void *
+rlft_alloc(FT_Memory memory, long size)
+{
+    UNUSED(memory);
+    return rlmalloc((size_t)size);
+}
+
+static void *
+rlft_realloc(FT_Memory memory, long cur, long size, void *block)
+{
+    UNUSED(memory);
+    UNUSED(cur);
+    return rlrealloc(block, (size_t)size);
+}
+
+static void
+rlft_free(FT_Memory memory, void *block)
+{
+    UNUSED(memory);
+    rlfree(block);
+}
+
+/* FreeType memory of a font being loaded by rltmap_async(7), whose rltmap
+   user points to. The loading thread leaves the counters of the main
+   thread alone, counting its live blocks in load.alive instead, and calls
+   the allocator hooks copied when the load started rather than rlahooks. */
+static void *
+rlft_lalloc(FT_Memory memory, long size)
+{
+    void *ptr = NULL;
+    rltmap *tmap = memory->user;
+
+    if ((ptr = tmap->load.hooks.alloc(tmap->load.hooks.user, (size_t)size)))
+        tmap->load.alive += 1;
+
+    return ptr;
+}
+
+static void *
+rlft_lrealloc(FT_Memory memory, long cur, long size, void *block)
+{
+    void *next = NULL;
+    rltmap *tmap = memory->user;
+
+    UNUSED(cur);
+
+    if ((next = tmap->load.hooks.realloc(tmap->load.hooks.user, block,
+        (size_t)size)) && !block)
+        tmap->load.alive += 1;
+
+    return next;
+}
+
+static void
+rlft_lfree(FT_Memory memory, void *block)
+{
+    rltmap *tmap = memory->user;
+
+    if (!block)
+        return;
+
+    tmap->load.alive -= 1;
+    tmap->load.hooks.free(tmap->load.hooks.user, block);
+}
+
+static void *
+rlmalloc(size_t size)
+{
+    void *ptr = NULL;
+
+    if (!(ptr = rlahooks.alloc(rlahooks.user, size)))
+        return NULL;
+
+    rlalive += 1;
+    rlacount += 1;
+    return ptr;
+}
+
+static void *
+rlcalloc(size_t count, size_t size)
+{
+    void *ptr = NULL;
+
+    if (size && count > (size_t)-1 / size)
+        return NULL;
+
+    if (!(ptr = rlmalloc(count * size)))
+        return NULL;
+
+    memset(ptr, 0, count * size);
+    return ptr;
+}
+
+static void *
+rlrealloc(void *ptr, size_t size)
+{
+    void *next = NULL;
+
+    if (!(next = rlahooks.realloc(rlahooks.user, ptr, size)))
+        return NULL;
+
+    if (!ptr)
+        rlalive += 1;
+
+    rlacount += 1;
+    return next;
+}
+
+static void
+rlfree(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    rlalive -= 1;
+    rlahooks.free(rlahooks.user, ptr);
+}
+
+/******************************************************************************
+Stats static function implementations
+******************************************************************************/
+
+static double
+rlstats_now(void)
+{
+    if (!rldcount)
+        return 0.0;
+
+    return glfwGetTime();
+}
+
+static int
+rlstats_cmp(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+/******************************************************************************
+Trace static function implementations
+******************************************************************************/
+
+#ifdef RL_TRACE
+static void
+rltrace_push(const char *name, double t0, int count)
+{
+    double now = rlstats_now();
+    struct rltevt *evt = &rltrace.evts[rltrace.head];
+
+    evt->name = name;
+    evt->ts = (t0 < 0.0) ? now : t0;
+    evt->dur = (t0 < 0.0) ? -1.0 : now - t0;
+    evt->count = count;
+
+    if (++rltrace.head == RL_TRACE_EVENTS)
+    {
+        rltrace.head = 0;
+        rltrace.wrap = true;
+    }
+}
+#endif
+
+/******************************************************************************
+Shader static function implementations
+******************************************************************************/
+
+static GLuint
+rlshader_cmpl(GLenum type, const char *defs, const char *src)
+{
+    GLint ok = GL_FALSE;
+    GLuint shader = 0;
+    const char *srcs[3] = {"#version 330 core\n", defs, src};
+
+    if (!(shader = rlgl.CreateShader(type)))
+        return 0;
+
+    rlgl.ShaderSource(shader, 3, srcs, NULL);
+    rlgl.CompileShader(shader);
+    rlgl.GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+
+    if (!ok)
+    {
+        rlgl.DeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+static const struct rlshader *
+rlshader_get(int flags)
+{
+    GLint ok = GL_FALSE;
+    GLuint vert = 0, frag = 0;
+    struct rlshader *s = NULL;
+    char defs[256] = "#define RL_SHIFT_SUB 16.0\n";
+
+    if (flags < 0 || flags >= RL_SHADER_MAXIMUM)
+        return NULL;
+
+    s = &rlshaders[flags];
+
+    if (s->prog)
+        return s;
+
+    if (flags & RL_SHADER_LIGHT)
+        strcat(defs, "#define RL_SHADER_LIGHT\n");
+
+    if (flags & RL_SHADER_PALET)
+        strcat(defs, "#define RL_SHADER_PALET\n");
+
+    if (flags & RL_SHADER_GLYPH)
+        strcat(defs, "#define RL_SHADER_GLYPH\n");
+
+    if (flags & RL_SHADER_SDF)
+        strcat(defs, "#define RL_SHADER_SDF\n");
+
+    if (flags & RL_SHADER_CULL)
+        strcat(defs, "#define RL_SHADER_CULL\n");
+
+    if (!(vert = rlshader_cmpl(GL_VERTEX_SHADER, defs,
+        (flags & RL_SHADER_SOLID) ? rlshader_svert : rlshader_vert)))
+        goto error;
+
+    if (!(frag = rlshader_cmpl(GL_FRAGMENT_SHADER, defs,
+        (flags & RL_SHADER_SOLID) ? rlshader_sfrag : rlshader_frag)))
+        goto error;
+
+    if (!(s->prog = rlgl.CreateProgram()))
+        goto error;
+
+    rlgl.AttachShader(s->prog, vert);
+    rlgl.AttachShader(s->prog, frag);
+    rlgl.LinkProgram(s->prog);
+    rlgl.GetProgramiv(s->prog, GL_LINK_STATUS, &ok);
+
+    /* The shaders are flagged for deletion along with the program */
+    rlgl.DeleteShader(vert);
+    rlgl.DeleteShader(frag);
+
+    if (!ok)
+    {
+        rlgl.DeleteProgram(s->prog);
+        s->prog = 0;
+        return NULL;
+    }
+
+    s->xform = rlgl.GetUniformLocation(s->prog, "rl_xform");
+    s->frame = rlgl.GetUniformLocation(s->prog, "rl_frame");
+    s->cell = rlgl.GetUniformLocation(s->prog, "rl_cell");
+    s->width = rlgl.GetUniformLocation(s->prog, "rl_width");
+    s->texel = rlgl.GetUniformLocation(s->prog, "rl_texel");
+
+    /* Samplers read the texture units rltmap_shader(3) binds to */
+    rlgl.UseProgram(s->prog);
+    rlgl.Uniform1i(rlgl.GetUniformLocation(s->prog, "rl_atlas"), 0);
+    rlgl.Uniform1i(rlgl.GetUniformLocation(s->prog, "rl_light"), 1);
+    rlgl.Uniform1i(rlgl.GetUniformLocation(s->prog, "rl_palet"), 2);
+    rlgl.Uniform1i(rlgl.GetUniformLocation(s->prog, "rl_cull"), 3);
+
+    return s;
+
+error:
+
+    if (vert)
+        rlgl.DeleteShader(vert);
+    if (frag)
+        rlgl.DeleteShader(frag);
+
+    return NULL;
+}
+
+static void
+rlshader_free(void)
+{
+    for (int i = 0; i < RL_SHADER_MAXIMUM; ++i)
+    {
+        if (rlshaders[i].prog)
+            rlgl.DeleteProgram(rlshaders[i].prog);
+
+        rlshaders[i].prog = 0;
+    }
+}
+
+/******************************************************************************
+rldisp function implementations
+******************************************************************************/
+
+static void
+rldisp_rsizd(rldisp *this, int width, int height)
+{
+    if (!this)
+        return;
+
+    this->window.width = width;
+    this->window.height = height;
+    this->frame.dirty = true;
+
+    rldisp_updscl(this);
+}
+
+static void
+rldisp_updscl(rldisp *this)
+{
+    if (!this)
+        return;
+
+    this->frame.scale.x = (float)this->window.width
+        / (float)this->frame.width;
+    this->frame.scale.y = (float)this->window.height
+        / (float)this->frame.height;
+}
+
+static void
+rldisp_cbkey(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    UNUSED(key);
+    UNUSED(scancode);
+    UNUSED(mods);
+
+    if (action == GLFW_PRESS)
+        rldisp_evtarr(glfwGetWindowUserPointer(window));
+}
+
+static void
+rldisp_cbbtn(GLFWwindow *window, int button, int action, int mods)
+{
+    UNUSED(button);
+    UNUSED(mods);
+
+    if (action == GLFW_PRESS)
+        rldisp_evtarr(glfwGetWindowUserPointer(window));
+}
+
+static void
+rldisp_cbscrl(GLFWwindow *window, double dx, double dy)
+{
+    rldisp *this = glfwGetWindowUserPointer(window);
+
+    UNUSED(dx);
+
+    this->window.scroll += (int)dy;
+    rldisp_evtarr(this);
+}
+
+static void
+rldisp_cbsize(GLFWwindow *window, int width, int height)
+{
+    rldisp_rsizd(glfwGetWindowUserPointer(window), width, height);
+}
+
+/* The window was exposed and has to be presented again */
+static void
+rldisp_cbrfsh(GLFWwindow *window)
+{
+    rldisp *this = glfwGetWindowUserPointer(window);
+
+    if (this)
+        this->frame.dirty = true;
+}
+
+/* Makes the context of an rldisp current and binds its frame for drawing */
+static void
+rldisp_bind(rldisp *this)
+{
+    if (rlbound == this && glfwGetCurrentContext() == this->window.handle)
+        return;
+
+    glfwMakeContextCurrent(this->window.handle);
+    rlgl.BindFramebuffer(GL_FRAMEBUFFER, this->frame.fbo);
+    rlgl.Viewport(0, 0, this->frame.width, this->frame.height);
+    rlbound = this;
+}
+
+rldisp *
+rldisp_init(int wwidth, int wheight, int fwidth, int fheight, const char *name,
+    bool fscrn)
+{
+    rldisp *this = NULL;
+    GLFWwindow *share = NULL;
+    GLFWmonitor *monitor = NULL;
+    const GLFWvidmode *mode = NULL;
+
+    if (!(this = rlcalloc(1, sizeof(rldisp))))
+        return NULL;
+
+    /* Initialize GLFW if this is the only display */
+    rldcount += 1;
+
+    if (rldcount == 1 && !glfwInit())
+        goto error;
+
+    this->stats.born = glfwGetTime();
+    this->stats.allocs = rlacount;
+
+    if (!(this->window.name = rlstrdup(name)))
+        goto error;
+
+    if (!(monitor = glfwGetPrimaryMonitor()) || !(mode
+        = glfwGetVideoMode(monitor)))
+        goto error;
+
+    /* If both wwidth and wheight are 0, then use the current video mode of
+       the primary monitor */
+    if (!wwidth && !wheight)
+    {
+        wwidth = mode->width;
+        wheight = mode->height;
+    }
+
+    if (rldlist)
+        share = rldlist->window.handle;
+
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
+
+    this->window.wwidth = wwidth;
+    this->window.wheight = wheight;
+
+    /* Fullscreen windows take the current video mode of the monitor, so
+       the monitor never changes modes */
+    if (!(this->window.handle = glfwCreateWindow(fscrn ? mode->width
+        : wwidth, fscrn ? mode->height : wheight, name, fscrn ? monitor
+        : NULL, share)))
+        goto error;
+
+    glfwSetWindowUserPointer(this->window.handle, this);
+    glfwSetKeyCallback(this->window.handle, rldisp_cbkey);
+    glfwSetMouseButtonCallback(this->window.handle, rldisp_cbbtn);
+    glfwSetScrollCallback(this->window.handle, rldisp_cbscrl);
+    glfwSetWindowSizeCallback(this->window.handle, rldisp_cbsize);
+    glfwSetWindowRefreshCallback(this->window.handle, rldisp_cbrfsh);
+    glfwMakeContextCurrent(this->window.handle);
+
+    /* A new share group starts without any of the GL objects of the last */
+    if (!share)
+    {
+        rlgen += 1;
+
+        if (!rlgl_load())
+            goto error;
+    }
+
+    this->next = rldlist;
+    rldlist = this;
+
+    glfwGetWindowSize(this->window.handle, &this->window.width,
+        &this->window.height);
+    this->window.scroll = 0;
+    this->window.fscrn = fscrn;
+
+    this->frame.width = fwidth;
+    this->frame.height = fheight;
+
+    rlgl.GenTextures(1, &this->frame.texture);
+    rlgl.BindTexture(GL_TEXTURE_2D, this->frame.texture);
+    rlgl.TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, fwidth, fheight, 0, GL_RGBA,
+        GL_UNSIGNED_BYTE, NULL);
+
+    rlgl.GenFramebuffers(1, &this->frame.fbo);
+    rlgl.BindFramebuffer(GL_FRAMEBUFFER, this->frame.fbo);
+    rlgl.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D, this->frame.texture, 0);
+
+    if (rlgl.CheckFramebufferStatus(GL_FRAMEBUFFER)
+        != GL_FRAMEBUFFER_COMPLETE)
+        goto error;
+
+    /* Tile attributes advance per instance and are pointed at the buffer of
+       the rltmap being drawn by rldisp_dtmap(2) */
+    rlgl.GenVertexArrays(1, &this->gl.tvao);
+    rlgl.BindVertexArray(this->gl.tvao);
+
+    for (GLuint i = 0; i < 4; ++i)
+    {
+        rlgl.EnableVertexAttribArray(i);
+        rlgl.VertexAttribDivisor(i, 1);
+    }
+
+    rlgl.GenVertexArrays(1, &this->gl.pvao);
+    rlgl.GenBuffers(1, &this->gl.pvbo);
+    rlgl.BindVertexArray(this->gl.pvao);
+    rlgl.BindBuffer(GL_ARRAY_BUFFER, this->gl.pvbo);
+    rlgl.EnableVertexAttribArray(0);
+    rlgl.EnableVertexAttribArray(1);
+    rlgl.VertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(struct rlpvert),
+        (const void *)offsetof(struct rlpvert, x));
+    rlgl.VertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+        sizeof(struct rlpvert), (const void *)offsetof(struct rlpvert, hue));
+
+    /* Blending matches SFML's alpha blend mode */
+    rlgl.Enable(GL_BLEND);
+    rlgl.BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+        GL_ONE_MINUS_SRC_ALPHA);
+    rlgl.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    rlbound = NULL;
+
+    this->frame.filter = false;
+    this->frame.clrhue = (rlhue){0, 0, 0, 255};
+    this->stats.prev = rlstats_now();
+    this->hud.key = RL_KEY_MAXIMUM;
+
+    rldisp_updscl(this);
+
+    return this;
+
+error:
+
+    rldisp_free(this);
+    return NULL;
+}
+
+bool
+rldisp_fscrn(rldisp *this, bool fscrn)
+{
+    GLFWmonitor *monitor = NULL;
+    const GLFWvidmode *mode = NULL;
+
+    if (!this || !this->window.handle)
+        return false;
+
+    if (fscrn == this->window.fscrn)
+        return true;
+
+    if (!(monitor = glfwGetPrimaryMonitor())
+        || !(mode = glfwGetVideoMode(monitor)))
+        return false;
+
+    this->window.fscrn = fscrn;
+    this->stats.switched = rlstats_now();
+
+    /* The window and its context are kept, only the monitor changes.
+       Fullscreen takes the current video mode of the monitor, so it never
+       changes modes, and a window leaving fullscreen is centered on it. */
+    if (fscrn)
+        glfwSetWindowMonitor(this->window.handle, monitor, 0, 0, mode->width,
+            mode->height, mode->refreshRate);
+    else
+        glfwSetWindowMonitor(this->window.handle, NULL, (mode->width
+            - this->window.wwidth) / 2, (mode->height
+            - this->window.wheight) / 2, this->window.wwidth,
+            this->window.wheight, GLFW_DONT_CARE);
+
+    glfwGetWindowSize(this->window.handle, &this->window.width,
+        &this->window.height);
+    rldisp_updscl(this);
+
+    return true;
+}
+
+void
+rldisp_rsize(rldisp *this, int width, int height)
+{
+    if (!this || !this->window.handle)
+        return;
+
+    this->window.wwidth = width;
+    this->window.wheight = height;
+    this->stats.switched = rlstats_now();
+
+    /* A fullscreen window keeps covering the monitor, taking the new size
+       once it leaves fullscreen */
+    if (this->window.fscrn)
+        return;
+
+    this->window.width = width;
+    this->window.height = height;
+    rldisp_updscl(this);
+
+    glfwSetWindowSize(this->window.handle, width, height);
+}
+
+void
+rldisp_rname(rldisp *this, const char *name)
+{
+    if (!this || !this->window.name)
+        return;
+
+    rlfree(this->window.name);
+
+    this->window.name = rlstrdup(name);
+
+    glfwSetWindowTitle(this->window.handle, name);
+}
+
+void
+rldisp_vsync(rldisp *this, bool enabled)
+{
+    if (!this || !this->window.handle)
+        return;
+
+    /* The swap interval belongs to the current context */
+    glfwMakeContextCurrent(this->window.handle);
+    glfwSwapInterval(enabled ? 1 : 0);
+}
+
+void
+rldisp_shwcur(rldisp *this, bool visible)
+{
+    if (!this || !this->window.handle)
+        return;
+
+    glfwSetInputMode(this->window.handle, GLFW_CURSOR,
+        visible ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_HIDDEN);
+}
+
+extern bool
+rldisp_cursor(rldisp *this, rltmap *tmap, rlcell cell, int scale, int hotx,
+    int hoty)
+{
+    struct rlcursor *cur = NULL;
+    GLFWcursor *handle = NULL;
+
+    if (!this || !this->window.handle || (tmap && scale < 1))
+        return false;
+
+    if (!tmap)
+    {
+        glfwSetCursor(this->window.handle, NULL);
+        this->cursor.shown = NULL;
+        return true;
+    }
+
+    for (int i = 0; i < this->cursor.count && !cur; ++i)
+    {
+        cur = &this->cursor.list[i];
+
+        if (cur->tmap != tmap->id || cur->glyph != cell.glyph
+            || memcmp(&cur->fghue, &cell.fghue, sizeof(rlhue))
+            || memcmp(&cur->bghue, &cell.bghue, sizeof(rlhue))
+            || cur->scale != scale || cur->hotx != hotx || cur->hoty != hoty)
+            cur = NULL;
+    }
+
+    if (!cur)
+    {
+        if (!(handle = rldisp_mkcur(tmap, cell, scale, hotx, hoty)))
+            return false;
+
+        /* The cursor installed is never the one replaced */
+        if (this->cursor.count < RL_CURSOR_CACHE)
+            cur = &this->cursor.list[this->cursor.count++];
+        else
+        {
+            cur = &this->cursor.list[this->cursor.next];
+
+            if (cur == this->cursor.shown)
+            {
+                this->cursor.next = (this->cursor.next + 1) % RL_CURSOR_CACHE;
+                cur = &this->cursor.list[this->cursor.next];
+            }
+
+            this->cursor.next = (this->cursor.next + 1) % RL_CURSOR_CACHE;
+            glfwDestroyCursor(cur->handle);
+        }
+
+        *cur = (struct rlcursor){tmap->id, cell.glyph, cell.fghue, cell.bghue,
+            scale, hotx, hoty, handle};
+    }
+
+    if (cur != this->cursor.shown)
+        glfwSetCursor(this->window.handle, cur->handle);
+
+    this->cursor.shown = cur;
+    return true;
+}
+
+/* Returns a pixel of a glyph, coverage if bpp is 1 and a tilesheet pixel
+   otherwise, tinted with fghue and drawn over bghue */
+static rlhue
+rldisp_curpix(const uint8_t *src, int bpp, rlhue fghue, rlhue bghue)
+{
+    int fa, ba, a;
+    rlhue hue;
+
+    if (bpp == 1)
+        fa = src[0] * fghue.a / 255;
+    else
+    {
+        fa = src[3] * fghue.a / 255;
+        fghue.r = (uint8_t)(src[0] * fghue.r / 255);
+        fghue.g = (uint8_t)(src[1] * fghue.g / 255);
+        fghue.b = (uint8_t)(src[2] * fghue.b / 255);
+    }
+
+    ba = bghue.a * (255 - fa) / 255;
+
+    if (!(a = fa + ba))
+        return (rlhue){0, 0, 0, 0};
+
+    hue.r = (uint8_t)((fghue.r * fa + bghue.r * ba) / a);
+    hue.g = (uint8_t)((fghue.g * fa + bghue.g * ba) / a);
+    hue.b = (uint8_t)((fghue.b * fa + bghue.b * ba) / a);
+    hue.a = (uint8_t)a;
+
+    return hue;
+}
+
+/* Makes a hardware cursor of the pixels of a glyph of an rltmap, scale times
+   their size. A font is rasterized again at that size, a tilesheet cell is
+   scaled up. */
+static GLFWcursor *
+rldisp_mkcur(rltmap *tmap, rlcell cell, int scale, int hotx, int hoty)
+{
+    int w, h, bpp, pitch, step;
+    bool mono = false;
+    uint8_t bit;
+    const uint8_t *src = NULL;
+    rlhue *pixels = NULL;
+    GLFWimage image;
+    GLFWcursor *handle = NULL;
+    const FT_Bitmap *bitmap = NULL;
+    const struct rltglyph *entry = NULL;
+
+    if (tmap->load.pending)
+        rltmap_adopt(tmap);
+
+    if (cell.glyph < 0)
+        return NULL;
+
+    if (tmap->font)
+    {
+        if (FT_Set_Pixel_Sizes(tmap->font, 0, (FT_UInt)(tmap->csize * scale))
+            || FT_Load_Char(tmap->font, (FT_ULong)cell.glyph, FT_LOAD_RENDER))
+            goto error;
+
+        bitmap = &tmap->font->glyph->bitmap;
+        mono = bitmap->pixel_mode == FT_PIXEL_MODE_MONO;
+        w = (int)bitmap->width;
+        h = (int)bitmap->rows;
+        src = bitmap->buffer;
+        pitch = bitmap->pitch;
+        bpp = 1;
+        step = 1;
+    }
+    else
+    {
+        if (!(entry = rltmap_glyph(tmap, cell.glyph)))
+            return NULL;
+
+        w = entry->rect.width * scale;
+        h = entry->rect.height * scale;
+        src = &tmap->cache->atlas.pages[0].pixels[(entry->rect.top
+            * tmap->cache->atlas.size + entry->rect.left) * 4];
+        pitch = tmap->cache->atlas.size * 4;
+        bpp = 4;
+        step = scale;
+    }
+
+    if (!w || !h || w > RL_CURSOR_MAXIMUM || h > RL_CURSOR_MAXIMUM)
+        goto error;
+
+    if (!(pixels = rlmalloc((size_t)(w * h) * sizeof(rlhue))))
+        goto error;
+
+    for (int j = 0; j < h; ++j)
+    for (int i = 0; i < w; ++i)
+    {
+        if (mono)
+        {
+            bit = ((src[j * pitch + (i >> 3)] >> (7 - (i & 7))) & 1) ? 255 : 0;
+            pixels[j * w + i] = rldisp_curpix(&bit, 1, cell.fghue,
+                cell.bghue);
+        }
+        else
+            pixels[j * w + i] = rldisp_curpix(&src[j / step * pitch
+                + i / step * bpp], bpp, cell.fghue, cell.bghue);
+    }
+
+    /* The hot spot is kept inside the image */
+    hotx = (hotx < 0) ? 0 : (hotx * scale < w) ? hotx * scale : w - 1;
+    hoty = (hoty < 0) ? 0 : (hoty * scale < h) ? hoty * scale : h - 1;
+
+    image = (GLFWimage){w, h, (unsigned char *)pixels};
+    handle = glfwCreateCursor(&image, hotx, hoty);
+
+error:
+
+    /* The glyphs of the rltmap are rasterized at its own size again */
+    if (tmap->font)
+        FT_Set_Pixel_Sizes(tmap->font, 0, (FT_UInt)tmap->cache->rsize);
+
+    rlfree(pixels);
+    return handle;
+}
+
+extern void
+rldisp_filter(rldisp *this, bool filter)
+{
+    if (!this)
+        return;
+
+    this->frame.filter = filter;
+    this->frame.dirty = true;
+}
+
+void
+rldisp_fpslim(rldisp *this, int limit)
+{
+    if (!this || !this->window.handle)
+        return;
+
+    this->window.limit = (limit > 0) ? limit : 0;
+    this->window.due = rlstats_now();
+}
+
+void
+rldisp_free(rldisp *this)
+{
+    rldisp **link = &rldlist;
+
+    if (!this)
+        return;
+
+    rldcount -= 1;
+
+    while (*link && *link != this)
+        link = &(*link)->next;
+
+    if (*link)
+        *link = this->next;
+
+    if (rlbound == this)
+        rlbound = NULL;
+
+    /* The draws held back are dropped along with the frame */
+    for (int i = 0; i < this->queue.count; ++i)
+        if (this->queue.list[i].tmap
+            && this->queue.list[i].tmap->queued == this)
+            this->queue.list[i].tmap->queued = NULL;
+
+    this->queue.count = 0;
+
+    if (this->hud.tmap)
+        rltmap_free(this->hud.tmap);
+
+    if (this->window.handle)
+    {
+        glfwMakeContextCurrent(this->window.handle);
+
+        if (this->gl.tvao)
+            rlgl.DeleteVertexArrays(1, &this->gl.tvao);
+        if (this->gl.pvao)
+            rlgl.DeleteVertexArrays(1, &this->gl.pvao);
+        if (this->gl.pvbo)
+            rlgl.DeleteBuffers(1, &this->gl.pvbo);
+        if (this->frame.fbo)
+            rlgl.DeleteFramebuffers(1, &this->frame.fbo);
+        if (this->frame.texture)
+            rlgl.DeleteTextures(1, &this->frame.texture);
+
+        /* The shaders go along with the last context of the share group */
+        if (!rldlist)
+            rlshader_free();
+
+        glfwDestroyWindow(this->window.handle);
+
+        for (int i = 0; i < this->cursor.count; ++i)
+            glfwDestroyCursor(this->cursor.list[i].handle);
+
+        if (rldlist)
+            glfwMakeContextCurrent(rldlist->window.handle);
+    }
+
+    /* If this is the last rldisp, terminate GLFW */
+    if (rldcount == 0)
+        glfwTerminate();
+
+    if (this->window.name)
+        rlfree(this->window.name);
+
+    rlfree(this->occl.mask);
+    rlfree(this->occl.sat);
+    rlfree(this->queue.prims);
+    rlfree(this->queue.batch);
+
+    if (this)
+        rlfree(this);
+}
+
+bool
+rldisp_status(rldisp *this)
+{
+    if (!this || !this->window.handle)
+        return false;
+
+    return !glfwWindowShouldClose(this->window.handle);
+}
+
+void
+rldisp_evtflsh(rldisp *this)
+{
+    double t0 = rlstats_now(), idle = 0.0;
+
+    if (!this || !this->window.handle)
+        return;
+
+    if (this->idle.on)
+        idle = rldisp_wait(this);
+
+    /* Events are delivered to the callbacks of every window */
+    glfwPollEvents();
+
+    /* Toggle the HUD on the press of its key, not while it is held */
+    if (this->hud.tmap && this->hud.key != RL_KEY_MAXIMUM)
+    {
+        if (rldisp_key(this, this->hud.key) && !this->hud.down)
+        {
+            this->hud.shown = !this->hud.shown;
+            this->frame.dirty = true;
+        }
+
+        this->hud.down = rldisp_key(this, this->hud.key);
+    }
+
+    this->stats.acc.tidle += idle;
+    this->stats.acc.tevt += rlstats_now() - t0 - idle;
+    RL_TRACE_END("rldisp_evtflsh", t0, 0);
+}
+
+void
+rldisp_idle(rldisp *this, bool enabled, double timeout)
+{
+    if (!this)
+        return;
+
+    this->idle.on = enabled;
+    this->idle.timeout = (timeout > 0.0) ? timeout : 0.0;
+    this->frame.dirty = true;
+}
+
+void
+rldisp_wake(rldisp *this, double delay)
+{
+    double wake;
+
+    if (!this)
+        return;
+
+    wake = rlstats_now() + (delay > 0.0 ? delay : 0.0);
+
+    /* The soonest deadline wins */
+    if (this->idle.wake == 0.0 || wake < this->idle.wake)
+        this->idle.wake = wake;
+}
+
+void
+rldisp_clear(rldisp *this)
+{
+    RL_TRACE_BEGIN(t0);
+
+    if (!this || !this->window.handle)
+        return;
+
+    rldisp_flush(this);
+
+    /* Clearing a frame that nothing was drawn to changes nothing, which
+       keeps a loop clearing every frame idle */
+    if (this->frame.clear)
+        return;
+
+    rldisp_bind(this);
+    rlgl.ClearColor((float)this->frame.clrhue.r / 255.0f,
+        (float)this->frame.clrhue.g / 255.0f,
+        (float)this->frame.clrhue.b / 255.0f,
+        (float)this->frame.clrhue.a / 255.0f);
+    rlgl.Clear(GL_COLOR_BUFFER_BIT);
+    this->frame.dirty = true;
+    this->frame.clear = true;
+    RL_TRACE_END("rldisp_clear", t0, 0);
+}
+
+void
+rldisp_clrhue(rldisp *this, rlhue hue)
+{
+    if (!this)
+        return;
+
+    this->frame.clrhue = hue;
+    this->frame.clear = false;
+}
+
+void
+rldisp_dtmap(rldisp *this, rltmap *tmap)
+{
+    float m[9];
+    struct rlqdraw *q = NULL;
+
+    if (!this || !this->window.handle || !tmap)
+        return;
+
+    /* An rltmap still loading its font is drawn once it is done */
+    if (tmap->load.pending && !rltmap_ready(tmap, false))
+        return;
+
+    this->frame.dirty = true;
+    this->frame.clear = false;
+
+    if (!this->occl.on && !this->queue.defer)
+    {
+        rltmap_xform(tmap, m);
+        rldisp_drwmap(this, tmap, m, NULL);
+        return;
+    }
+
+    /* An rltmap is held back by one rldisp at a time */
+    if (tmap->queued && tmap->queued != this)
+        rldisp_flush(tmap->queued);
+
+    if (this->queue.count == RL_QUEUE_DRAWS)
+        rldisp_flush(this);
+
+    q = &this->queue.list[this->queue.count++];
+    q->tmap = tmap;
+    rltmap_xform(tmap, q->m);
+    tmap->queued = this;
+}
+
+void
+rldisp_occl(rldisp *this, bool enabled)
+{
+    if (!this)
+        return;
+
+    if (!enabled)
+        rldisp_flush(this);
+
+    this->occl.on = enabled;
+}
+
+void
+rldisp_defer(rldisp *this, bool enabled)
+{
+    if (!this)
+        return;
+
+    if (!enabled)
+        rldisp_flush(this);
+
+    this->queue.defer = enabled;
+}
+
+/* Draws an rltmap with the transform m, skipping the tiles hidden from the
+   draw held back in q if it is not NULL */
+static void
+rldisp_drwmap(rldisp *this, rltmap *tmap, const float *m,
+    const struct rlqdraw *q)
+{
+    double t0 = rlstats_now();
+    int count = tmap->width * tmap->height, culled = q ? q->culled : 0;
+
+    rldisp_prpmap(this, tmap);
+
+    if (culled)
+        rldisp_upcull(this, q);
+
+    /* All the backgrounds are drawn before any glyph, so glyphs overhanging
+       their tile are not covered by the background of a later tile */
+    for (int pass = 0; pass < 2; ++pass)
+        rldisp_drwpass(this, tmap, m, culled > 0, pass > 0);
+
+    this->stats.acc.bcells += count - culled;
+    this->stats.acc.bquads += count - culled;
+    rldisp_endmap(this, tmap);
+
+    if (this->stats.acc.nmaps < RL_STATS_MAPS)
+        this->stats.acc.tmaps[this->stats.acc.nmaps] = rlstats_now()
+            - t0;
+
+    this->stats.acc.nmaps += 1;
+    this->stats.acc.tmap += rlstats_now() - t0;
+    RL_TRACE_END("rldisp_dtmap", t0, count * 8);
+}
+
+/* Uploads what changed in an rltmap since it was last drawn */
+static void
+rldisp_prpmap(rldisp *this, rltmap *tmap)
+{
+    rldisp_bind(this);
+
+    /* Only the rows written since the last draw are uploaded */
+    this->stats.acc.bytes += rltmap_sync(tmap);
+    rldisp_bind(this);
+}
+
+/* Uploads the tiles hidden from the draw held back in q to the cull texture
+   of its rltmap, unless it holds them already. An rltmap drawn more than
+   once before a flush has a mask per draw, so the texture is keyed by the
+   draw rather than the rltmap. */
+static void
+rldisp_upcull(rldisp *this, const struct rlqdraw *q)
+{
+    rltmap *tmap = q->tmap;
+
+    if (tmap->gl.mdraw == q)
+        return;
+
+    rldisp_bind(this);
+
+    if (!tmap->gl.cull)
+        tmap->gl.cull = rltmap_mktex(GL_R8, tmap->width, tmap->height,
+            GL_NEAREST);
+
+    rlgl.BindTexture(GL_TEXTURE_2D, tmap->gl.cull);
+    rlgl.TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tmap->width, tmap->height,
+        GL_RED, GL_UNSIGNED_BYTE, &this->occl.mask[q->mask]);
+    this->stats.acc.bytes += (size_t)(tmap->width * tmap->height);
+    tmap->gl.mdraw = q;
+}
+
+/* Draws the backgrounds, or the glyphs, of every tile of an rltmap with one
+   instanced draw call, skipping the ones marked in its cull texture if
+   cull is set. The passes use separate shaders so backgrounds don't sample
+   the atlas. */
+static void
+rldisp_drwpass(rldisp *this, rltmap *tmap, const float *m, bool cull,
+    bool glyph)
+{
+    const struct rlshader *shader = NULL;
+    size_t stride = sizeof(struct rltinst);
+    int count = tmap->width * tmap->height;
+
+    rlgl.BindVertexArray(this->gl.tvao);
+    rlgl.BindBuffer(GL_ARRAY_BUFFER, tmap->gl.tiles);
+    rlgl.VertexAttribIPointer(0, 4, GL_UNSIGNED_SHORT, (GLsizei)stride,
+        (const void *)offsetof(struct rltinst, rect));
+    rlgl.VertexAttribIPointer(1, 2, GL_SHORT, (GLsizei)stride,
+        (const void *)offsetof(struct rltinst, shift));
+    rlgl.VertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, (GLsizei)stride,
+        (const void *)offsetof(struct rltinst, fg));
+    rlgl.VertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, (GLsizei)stride,
+        (const void *)offsetof(struct rltinst, bg));
+
+    if (!(shader = rltmap_shader(tmap, glyph, cull)))
+        return;
+
+    rlgl.UniformMatrix3fv(shader->xform, 1, GL_FALSE, m);
+    rlgl.Uniform2f(shader->frame, (float)this->frame.width,
+        (float)this->frame.height);
+    rlgl.Uniform2f(shader->cell, (float)tmap->offx, (float)tmap->offy);
+    rlgl.Uniform1i(shader->width, tmap->width);
+    rlgl.Uniform1f(shader->texel, tmap->sdf.texel);
+    rlgl.DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+
+    /* Vertices are generated by the vertex shader, none are uploaded */
+    this->stats.acc.draws += 1;
+    this->stats.acc.verts += count * 4;
+}
+
+/* Finishes the draw of an rltmap once all of it is drawn */
+static void
+rldisp_endmap(rldisp *this, rltmap *tmap)
+{
+    /* Remember the region of the rltmap redrawn this frame for the HUD. The
+       rotation of the rltmap is not taken into account. */
+    if (this->hud.shown && tmap != this->hud.tmap && tmap->dirty.x1 >= 0
+        && this->hud.count < RL_STATS_MAPS)
+    {
+        this->hud.dirty[this->hud.count++] = (struct rlrect){
+            tmap->x + (int)((float)(tmap->dirty.x0 * tmap->offx)
+                * tmap->scale),
+            tmap->y + (int)((float)(tmap->dirty.y0 * tmap->offy)
+                * tmap->scale),
+            (int)((float)((tmap->dirty.x1 - tmap->dirty.x0 + 1)
+                * tmap->offx) * tmap->scale),
+            (int)((float)((tmap->dirty.y1 - tmap->dirty.y0 + 1)
+                * tmap->offy) * tmap->scale)
+        };
+    }
+
+    rldisp_tstats(this, tmap);
+    rltmap_clean(tmap);
+}
+
+/* Moves the counters of an rltmap over to the frame drawing it */
+static void
+rldisp_tstats(rldisp *this, rltmap *tmap)
+{
+    this->stats.acc.tiles += tmap->stats.tiles;
+    this->stats.acc.gmiss += tmap->stats.gmiss;
+    this->stats.acc.agrow += tmap->stats.agrow;
+    this->stats.acc.gevict += tmap->stats.gevict;
+    this->stats.acc.graster += tmap->stats.graster;
+    this->stats.acc.gfail += tmap->stats.gfail;
+    memset(&tmap->stats, 0, sizeof(tmap->stats));
+}
+
+/* Submits the draws held back, in the order they were made in. Hidden
+   tiles are culled first if occlusion culling is on. An rltmap hidden
+   entirely is not drawn at all. */
+static void
+rldisp_flush(rldisp *this)
+{
+    void *p = NULL;
+    struct rlqdraw *q = NULL;
+    size_t cells = 0;
+    int count = this->queue.count, maps = 0;
+    double t0 = rlstats_now();
+
+    if (!count)
+        return;
+
+    this->queue.count = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        q = &this->queue.list[i];
+        q->mask = cells;
+        q->culled = 0;
+
+        if (!q->tmap)
+            continue;
+
+        cells += (size_t)(q->tmap->width * q->tmap->height);
+        maps += 1;
+
+        /* The draws are made again, and so are their masks */
+        q->tmap->gl.mdraw = NULL;
+
+        if (q->tmap->queued == this)
+            q->tmap->queued = NULL;
+    }
+
+    /* The mask is kept between frames. Without room for it nothing is
+       culled. */
+    if (this->occl.on && maps > 1 && cells > this->occl.msize
+        && (p = rlrealloc(this->occl.mask, cells)))
+    {
+        this->occl.mask = p;
+        this->occl.msize = cells;
+    }
+
+    if (this->occl.on && maps > 1 && cells <= this->occl.msize)
+    {
+        memset(this->occl.mask, 0, cells);
+
+        /* Every rltmap is tested against each one drawn after it. The cells
+           an rltmap hides are the ones its own cells hide. */
+        for (int j = count - 1; j > 0; --j)
+        {
+            if (!this->queue.list[j].tmap
+                || !rldisp_sat(this, this->queue.list[j].tmap))
+                continue;
+
+            for (int i = 0; i < j; ++i)
+                if (this->queue.list[i].tmap)
+                    this->queue.list[i].culled += rldisp_hide(this,
+                        &this->queue.list[i], &this->queue.list[j]);
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+        this->stats.acc.culled += this->queue.list[i].culled;
+
+    this->stats.acc.tmap += rlstats_now() - t0;
+    RL_TRACE_END("rldisp_occl", t0, count);
+
+    if (this->queue.defer)
+    {
+        rldisp_submit(this, count);
+        this->queue.pcount = 0;
+        return;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        q = &this->queue.list[i];
+
+        if (q->culled < q->tmap->width * q->tmap->height)
+            rldisp_drwmap(this, q->tmap, q->m, q);
+    }
+}
+
+/* Submits the draws held back in deferred drawing with as few draw calls as
+   painter's order allows. The backgrounds of the rltmaps and the
+   primitives are merged into batches drawn with one call each, and the
+   glyphs of each rltmap are drawn with a call of their own, as each is an
+   instanced draw of the tiles buffer of its rltmap. A draw joins the last
+   batch before it as long as nothing drawn in between overlaps it, so only
+   draws that don't overlap are reordered. */
+static void
+rldisp_submit(rldisp *this, int count)
+{
+    void *p = NULL;
+    struct rlqdraw *q = NULL, *only = NULL;
+    struct rlbatch batch[RL_QUEUE_DRAWS * 2];
+    const uint8_t *mask = NULL;
+    int n = 0, b, verts, size, members;
+    float box[4];
+    double t0 = rlstats_now();
+
+    /* Plan the batches */
+    for (int i = 0; i < count; ++i)
+    {
+        q = &this->queue.list[i];
+        q->batch = -1;
+
+        if (q->tmap && q->culled == q->tmap->width * q->tmap->height)
+            continue;
+
+        if (q->tmap)
+        {
+            box[0] = 0.0f;
+            box[1] = 0.0f;
+            box[2] = (float)(q->tmap->width * q->tmap->offx);
+            box[3] = (float)(q->tmap->height * q->tmap->offy);
+            rldisp_xbox(q->m, box, q->bbox);
+            rltmap_extent(q->tmap, box);
+            rldisp_xbox(q->m, box, q->box);
+        }
+
+        for (b = n - 1; b >= 0; --b)
+            if (batch[b].draw < 0 || rldisp_hit(batch[b].box, q->bbox))
+                break;
+
+        if (b < 0 || batch[b].draw >= 0)
+        {
+            b = n++;
+            batch[b].draw = -1;
+            memcpy(batch[b].box, q->bbox, sizeof(box));
+        }
+
+        batch[b].box[0] = fminf(batch[b].box[0], q->bbox[0]);
+        batch[b].box[1] = fminf(batch[b].box[1], q->bbox[1]);
+        batch[b].box[2] = fmaxf(batch[b].box[2], q->bbox[2]);
+        batch[b].box[3] = fmaxf(batch[b].box[3], q->bbox[3]);
+        q->batch = b;
+
+        if (!q->tmap)
+            continue;
+
+        batch[n].draw = i;
+        memcpy(batch[n++].box, q->box, sizeof(box));
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        q = &this->queue.list[i];
+
+        if (q->tmap && q->batch >= 0)
+            rldisp_prpmap(this, q->tmap);
+    }
+
+    for (b = 0; b < n; ++b)
+    {
+        /* The mask of a draw is uploaded right before its passes, as an
+           rltmap drawn more than once has one texture for them */
+        if (batch[b].draw >= 0)
+        {
+            q = &this->queue.list[batch[b].draw];
+
+            if (q->culled)
+                rldisp_upcull(this, q);
+
+            rldisp_drwpass(this, q->tmap, q->m, q->culled > 0, true);
+            continue;
+        }
+
+        size = 0;
+        members = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            q = &this->queue.list[i];
+
+            if (q->batch != b)
+                continue;
+
+            size += q->tmap ? q->tmap->width * q->tmap->height * 6 : q->count;
+            only = q;
+            members += 1;
+        }
+
+        if (size > this->queue.bsize && (p = rlrealloc(this->queue.batch,
+            (size_t)size * sizeof(struct rlpvert))))
+        {
+            this->queue.batch = p;
+            this->queue.bsize = size;
+        }
+
+        /* An rltmap alone in its batch is cheaper drawn from its instances,
+           as is every rltmap if there is no room to merge them */
+        if ((members == 1 && only->tmap) || size > this->queue.bsize)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                q = &this->queue.list[i];
+
+                if (q->batch == b && q->tmap)
+                {
+                    if (q->culled)
+                        rldisp_upcull(this, q);
+
+                    rldisp_drwpass(this, q->tmap, q->m, q->culled > 0,
+                        false);
+                    this->stats.acc.bquads += q->tmap->width * q->tmap->height
+                        - q->culled;
+                }
+                else if (q->batch == b)
+                    rldisp_dsolid(this, &this->queue.prims[q->first],
+                        q->count);
+            }
+
+            continue;
+        }
+
+        verts = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            q = &this->queue.list[i];
+            mask = q->culled ? &this->occl.mask[q->mask] : NULL;
+
+            if (q->batch == b && q->tmap)
+                verts += rldisp_expbg(this, q, mask,
+                    &this->queue.batch[verts]);
+            else if (q->batch == b)
+            {
+                memcpy(&this->queue.batch[verts],
+                    &this->queue.prims[q->first],
+                    (size_t)q->count * sizeof(struct rlpvert));
+                verts += q->count;
+            }
+        }
+
+        if (verts)
+            rldisp_dsolid(this, this->queue.batch, verts);
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        q = &this->queue.list[i];
+
+        if (!q->tmap || q->batch < 0)
+            continue;
+
+        this->stats.acc.bcells += q->tmap->width * q->tmap->height - q->culled;
+        this->stats.acc.nmaps += 1;
+        rldisp_endmap(this, q->tmap);
+    }
+
+    this->stats.acc.tmap += rlstats_now() - t0;
+    RL_TRACE_END("rldisp_submit", t0, n);
+}
+
+/* Writes the backgrounds of an rltmap held back to verts in frame
+   coordinates, after the palette and the light, as a quad per run of tiles
+   of one hue in a row. Hidden tiles, marked in mask if it is not NULL, and
+   transparent ones are left out. Returns the number of vertices written. */
+static int
+rldisp_expbg(rldisp *this, struct rlqdraw *q, const uint8_t *mask,
+    struct rlpvert *verts)
+{
+    rltmap *t = q->tmap;
+    rlhue hue = {0, 0, 0, 0}, run = {0, 0, 0, 0};
+    int n = 0, x0, i;
+    float ox = (float)t->offx, oy = (float)t->offy;
+    bool shown;
+
+    for (int y = 0; y < t->height; ++y)
+    {
+        x0 = -1;
+
+        for (int x = 0; x <= t->width; ++x)
+        {
+            i = y * t->width + x;
+            shown = x < t->width && (!mask || !mask[i]);
+
+            if (shown)
+            {
+                hue = rltmap_bghue(t, i);
+                shown = hue.a > 0;
+            }
+
+            if (x0 >= 0 && (!shown || memcmp(&hue, &run, sizeof(rlhue))))
+            {
+                n += rldisp_xquad(&verts[n], q->m, (float)x0 * ox,
+                    (float)y * oy, (float)x * ox, (float)(y + 1) * oy, run);
+                x0 = -1;
+            }
+
+            if (shown && x0 < 0)
+            {
+                x0 = x;
+                run = hue;
+            }
+        }
+    }
+
+    this->stats.acc.bquads += n / 6;
+    return n;
+}
+
+/* Writes a quad transformed by m as two triangles and returns the number of
+   vertices */
+static int
+rldisp_xquad(struct rlpvert *verts, const float *m, float l, float t,
+    float r, float b, rlhue hue)
+{
+    struct rlpvert c[4];
+
+    c[0] = (struct rlpvert){m[0] * l + m[3] * t + m[6],
+        m[1] * l + m[4] * t + m[7], hue};
+    c[1] = (struct rlpvert){m[0] * r + m[3] * t + m[6],
+        m[1] * r + m[4] * t + m[7], hue};
+    c[2] = (struct rlpvert){m[0] * r + m[3] * b + m[6],
+        m[1] * r + m[4] * b + m[7], hue};
+    c[3] = (struct rlpvert){m[0] * l + m[3] * b + m[6],
+        m[1] * l + m[4] * b + m[7], hue};
+
+    verts[0] = c[0];
+    verts[1] = c[1];
+    verts[2] = c[2];
+    verts[3] = c[0];
+    verts[4] = c[2];
+    verts[5] = c[3];
+
+    return 6;
+}
+
+/* Writes the bounds in frame coordinates of box transformed by m to out,
+   both as left, top, right and bottom */
+static void
+rldisp_xbox(const float *m, const float *box, float *out)
+{
+    float x, y;
+
+    out[0] = out[1] = HUGE_VALF;
+    out[2] = out[3] = -HUGE_VALF;
+
+    for (int k = 0; k < 4; ++k)
+    {
+        x = box[(k & 1) ? 2 : 0];
+        y = box[(k & 2) ? 3 : 1];
+        out[0] = fminf(out[0], m[0] * x + m[3] * y + m[6]);
+        out[1] = fminf(out[1], m[1] * x + m[4] * y + m[7]);
+        out[2] = fmaxf(out[2], m[0] * x + m[3] * y + m[6]);
+        out[3] = fmaxf(out[3], m[1] * x + m[4] * y + m[7]);
+    }
+}
+
+/* Whether two bounds as left, top, right and bottom overlap */
+static bool
+rldisp_hit(const float *a, const float *b)
+{
+    return a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3];
+}
+
+/* Fills the summed area table of the opaque cells of an rltmap and returns
+   their number, 0 if there are none or no room for the table. Entry
+   (x, y) of the table counts the opaque cells above and left of cell
+   (x, y), with an extra row and column of zeros. */
+static int
+rldisp_sat(rldisp *this, rltmap *tmap)
+{
+    void *p = NULL;
+    int *sat = NULL, w = tmap->width, row;
+    size_t size = (size_t)((tmap->width + 1) * (tmap->height + 1));
+
+    if (size > this->occl.ssize)
+    {
+        if (!(p = rlrealloc(this->occl.sat, size * sizeof(int))))
+            return 0;
+
+        this->occl.sat = p;
+        this->occl.ssize = size;
+    }
+
+    sat = this->occl.sat;
+    memset(sat, 0, (size_t)(w + 1) * sizeof(int));
+
+    for (int y = 0; y < tmap->height; ++y)
+    {
+        row = 0;
+        sat[(y + 1) * (w + 1)] = 0;
+
+        for (int x = 0; x < w; ++x)
+        {
+            row += rltmap_opaque(tmap, y * w + x);
+            sat[(y + 1) * (w + 1) + x + 1] = sat[y * (w + 1) + x + 1] + row;
+        }
+    }
+
+    return sat[size - 1];
+}
+
+/* Marks the cells of back that front hides in the cull mask and returns how
+   many were marked. A cell is hidden when the bounds of all it draws, mapped
+   into front, fall within opaque cells of front. Bounds within 1/256 of a
+   pixel of a cell edge, the precision vertices are snapped to when they are
+   rasterized, count as on it, so rltmaps on the same grid hide each other
+   despite rounding. */
+static int
+rldisp_hide(rldisp *this, const struct rlqdraw *back,
+    const struct rlqdraw *front)
+{
+    const float *b = back->m, *f = front->m;
+    double det, i00, i01, i10, i11, a[6], x, y, qx, qy, eps, lo[2], hi[2];
+    double x0, y0, x1, y1;
+    float box[4];
+    int w = front->tmap->width, h = front->tmap->height, hidden = 0, n;
+    int count = back->tmap->width * back->tmap->height;
+    const int *sat = this->occl.sat;
+    uint8_t *mask = &this->occl.mask[back->mask];
+
+    /* A front squashed to nothing hides nothing */
+    det = (double)f[0] * f[4] - (double)f[3] * f[1];
+
+    if (fabs(det) < 1e-12)
+        return 0;
+
+    /* The transform from back into front, the inverse of the transform of
+       front after that of back */
+    i00 = f[4] / det;
+    i01 = -f[3] / det;
+    i10 = -f[1] / det;
+    i11 = f[0] / det;
+
+    a[0] = i00 * b[0] + i01 * b[1];
+    a[1] = i00 * b[3] + i01 * b[4];
+    a[2] = i00 * (b[6] - f[6]) + i01 * (b[7] - f[7]);
+    a[3] = i10 * b[0] + i11 * b[1];
+    a[4] = i10 * b[3] + i11 * b[4];
+    a[5] = i10 * (b[6] - f[6]) + i11 * (b[7] - f[7]);
+
+    eps = 1.0 / (256.0 * sqrt(fabs(det)));
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (mask[i])
+            continue;
+
+        rltmap_bounds(back->tmap, i, box);
+        lo[0] = lo[1] = HUGE_VAL;
+        hi[0] = hi[1] = -HUGE_VAL;
+
+        for (int k = 0; k < 4; ++k)
+        {
+            x = box[(k & 1) ? 2 : 0];
+            y = box[(k & 2) ? 3 : 1];
+            qx = a[0] * x + a[1] * y + a[2];
+            qy = a[3] * x + a[4] * y + a[5];
+            lo[0] = (qx < lo[0]) ? qx : lo[0];
+            lo[1] = (qy < lo[1]) ? qy : lo[1];
+            hi[0] = (qx > hi[0]) ? qx : hi[0];
+            hi[1] = (qy > hi[1]) ? qy : hi[1];
+        }
+
+        /* The cells of front the bounds overlap */
+        x0 = floor((lo[0] + eps) / (double)front->tmap->offx);
+        y0 = floor((lo[1] + eps) / (double)front->tmap->offy);
+        x1 = ceil((hi[0] - eps) / (double)front->tmap->offx) - 1.0;
+        y1 = ceil((hi[1] - eps) / (double)front->tmap->offy) - 1.0;
+
+        if (!(x0 >= 0.0 && y0 >= 0.0 && x1 < (double)w && y1 < (double)h
+            && x1 >= x0 && y1 >= y0))
+            continue;
+
+        n = sat[((int)y1 + 1) * (w + 1) + (int)x1 + 1]
+            - sat[(int)y0 * (w + 1) + (int)x1 + 1]
+            - sat[((int)y1 + 1) * (w + 1) + (int)x0]
+            + sat[(int)y0 * (w + 1) + (int)x0];
+
+        if (n == (int)((x1 - x0 + 1.0) * (y1 - y0 + 1.0)))
+        {
+            mask[i] = 255;
+            hidden += 1;
+        }
+    }
+
+    return hidden;
+}
+
+/* Writes a quad as two triangles and returns the number of vertices */
+static int
+rldisp_quad(struct rlpvert *verts, float l, float t, float r, float b,
+    rlhue hue)
+{
+    verts[0] = (struct rlpvert){l, t, hue};
+    verts[1] = (struct rlpvert){r, t, hue};
+    verts[2] = (struct rlpvert){r, b, hue};
+    verts[3] = (struct rlpvert){l, t, hue};
+    verts[4] = (struct rlpvert){r, b, hue};
+    verts[5] = (struct rlpvert){l, b, hue};
+
+    return 6;
+}
+
+/* Draws triangles in frame coordinates, or holds them back in deferred
+   drawing to be merged with other primitives and backgrounds */
+static void
+rldisp_dprim(rldisp *this, const struct rlpvert *verts, int count)
+{
+    void *p = NULL;
+    struct rlqdraw *q = NULL;
+    int size;
+
+    this->frame.dirty = true;
+    this->frame.clear = false;
+
+    if (!this->queue.defer)
+    {
+        /* The rltmaps held back are drawn first, under the primitive */
+        rldisp_flush(this);
+        rldisp_dsolid(this, verts, count);
+        return;
+    }
+
+    if (this->queue.count == RL_QUEUE_DRAWS)
+        rldisp_flush(this);
+
+    if (this->queue.pcount + count > this->queue.psize)
+    {
+        size = (this->queue.pcount + count) * 2;
+
+        /* Without room to hold it back the primitive is drawn now */
+        if (!(p = rlrealloc(this->queue.prims,
+            (size_t)size * sizeof(struct rlpvert))))
+        {
+            rldisp_flush(this);
+            rldisp_dsolid(this, verts, count);
+            return;
+        }
+
+        this->queue.prims = p;
+        this->queue.psize = size;
+    }
+
+    q = &this->queue.list[this->queue.count++];
+    q->tmap = NULL;
+    q->first = this->queue.pcount;
+    q->count = count;
+    q->bbox[0] = q->bbox[1] = HUGE_VALF;
+    q->bbox[2] = q->bbox[3] = -HUGE_VALF;
+
+    for (int i = 0; i < count; ++i)
+    {
+        q->bbox[0] = fminf(q->bbox[0], verts[i].x);
+        q->bbox[1] = fminf(q->bbox[1], verts[i].y);
+        q->bbox[2] = fmaxf(q->bbox[2], verts[i].x);
+        q->bbox[3] = fmaxf(q->bbox[3], verts[i].y);
+    }
+
+    memcpy(q->box, q->bbox, sizeof(q->box));
+    memcpy(&this->queue.prims[q->first], verts,
+        (size_t)count * sizeof(struct rlpvert));
+    this->queue.pcount += count;
+}
+
+/* Draws triangles in frame coordinates. The buffer is orphaned and refilled
+   on every call. */
+static void
+rldisp_dsolid(rldisp *this, const struct rlpvert *verts, int count)
+{
+    const struct rlshader *shader = NULL;
+    size_t size = (size_t)count * sizeof(struct rlpvert);
+
+    rldisp_bind(this);
+
+    if (!(shader = rlshader_get(RL_SHADER_SOLID)))
+        return;
+
+    rlgl.UseProgram(shader->prog);
+    rlgl.Uniform2f(shader->frame, (float)this->frame.width,
+        (float)this->frame.height);
+
+    rlgl.BindVertexArray(this->gl.pvao);
+    rlgl.BindBuffer(GL_ARRAY_BUFFER, this->gl.pvbo);
+    rlgl.BufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, NULL, GL_STREAM_DRAW);
+    rlgl.BufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)size, verts);
+    rlgl.DrawArrays(GL_TRIANGLES, 0, count);
+
+    this->stats.acc.draws += 1;
+    this->stats.acc.verts += count;
+    this->stats.acc.bytes += size;
+}
+
+extern void
+rldisp_dline(rldisp *this, int x0, int y0, int x1, int y1, int thick,
+    rlhue hue)
+{
+    float unit, ox, oy;
+    struct rlpvert vert[6];
+    double t0 = rlstats_now();
+
+    if (!this || !this->window.handle)
+        return;
+
+    unit = sqrtf((float)((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0)));
+
+    if (unit <= 0.0f)
+        return;
+
+    /* Offset of the edges from the center line, perpendicular to it */
+    ox = -(float)(y1 - y0) / unit * (float)thick / 2.0f;
+    oy = (float)(x1 - x0) / unit * (float)thick / 2.0f;
+
+    vert[0] = (struct rlpvert){(float)x0 + ox, (float)y0 + oy, hue};
+    vert[1] = (struct rlpvert){(float)x1 + ox, (float)y1 + oy, hue};
+    vert[2] = (struct rlpvert){(float)x1 - ox, (float)y1 - oy, hue};
+    vert[3] = vert[0];
+    vert[4] = vert[2];
+    vert[5] = (struct rlpvert){(float)x0 - ox, (float)y0 - oy, hue};
+
+    rldisp_dprim(this, vert, 6);
+    this->stats.acc.tprim += rlstats_now() - t0;
+}
+
+extern void
+rldisp_dboxo(rldisp *this, int x, int y, int width, int height, int thick,
+    rlhue hue)
+{
+    int n = 0;
+    struct rlpvert vert[24];
+    double t0 = rlstats_now();
+    float l = (float)x, t = (float)y, r = (float)(x + width);
+    float b = (float)(y + height), d = (float)thick;
+
+    if (!this || !this->window.handle)
+        return;
+
+    /* The outline is drawn outside of the box, as SFML does */
+    n += rldisp_quad(&vert[n], l - d, t - d, r + d, t, hue);
+    n += rldisp_quad(&vert[n], l - d, b, r + d, b + d, hue);
+    n += rldisp_quad(&vert[n], l - d, t, l, b, hue);
+    n += rldisp_quad(&vert[n], r, t, r + d, b, hue);
+
+    rldisp_dprim(this, vert, n);
+    this->stats.acc.tprim += rlstats_now() - t0;
+}
+
+extern void
+rldisp_dboxi(rldisp *this, int x, int y, int width, int height, int thick,
+    rlhue hue)
+{
+    if (!this || !this->window.handle)
+        return;
+
+    rldisp_dboxo(this, x + thick, y + thick, width - 2 * thick,
+        height - 2 * thick, thick, hue);
+}
+
+extern void
+rldisp_dboxf(rldisp *this, int x, int y, int width, int height, rlhue hue)
+{
+    struct rlpvert vert[6];
+    double t0 = rlstats_now();
+
+    if (!this || !this->window.handle)
+        return;
+
+    rldisp_quad(vert, (float)x, (float)y, (float)(x + width),
+        (float)(y + height), hue);
+
+    rldisp_dprim(this, vert, 6);
+    this->stats.acc.tprim += rlstats_now() - t0;
+}
+
+static void
+rldisp_evtarr(rldisp *this)
+{
+    /* Events beyond the pending limit in a single frame are not measured */
+    if (this->latency.count < RL_LATENCY_PENDING)
+        this->latency.arrival[this->latency.count++] = rlstats_now();
+}
+
+/* Returns the time an idle rldisp waits for input until, or a negative
+   value to wait without limit */
+static double
+rldisp_until(rldisp *this, double now)
+{
+    double until = (this->idle.timeout > 0.0) ? now + this->idle.timeout
+        : -1.0;
+
+    if (this->idle.wake != 0.0 && (until < 0.0 || this->idle.wake < until))
+        until = this->idle.wake;
+
+    return until;
+}
+
+/* Blocks an idle rldisp until input arrives or its wait is over, and
+   returns the time it was blocked. A present still due doesn't wait. */
+static double
+rldisp_wait(rldisp *this)
+{
+    double t0 = rlstats_now(), until = rldisp_until(this, t0);
+
+    if (this->frame.dirty)
+        return 0.0;
+
+    if (until < 0.0)
+        glfwWaitEvents();
+    else if (until > t0)
+        glfwWaitEventsTimeout(until - t0);
+
+    if (this->idle.wake != 0.0 && rlstats_now() >= this->idle.wake)
+        this->idle.wake = 0.0;
+
+    return rlstats_now() - t0;
+}
+
+static void
+rldisp_updlat(rldisp *this, double present, double swap)
+{
+    int b;
+    double p, s;
+    rllatency *l = &this->latency.last;
+
+    for (int i = 0; i < this->latency.count; ++i)
+    {
+        p = present - this->latency.arrival[i];
+        s = swap - this->latency.arrival[i];
+
+        if (!l->events || p < l->pmin)
+            l->pmin = p;
+        if (!l->events || s < l->smin)
+            l->smin = s;
+        if (p > l->pmax)
+            l->pmax = p;
+        if (s > l->smax)
+            l->smax = s;
+
+        b = (int)(p * 1000.0);
+        l->phist[(b < RL_LATENCY_BUCKETS) ? b : RL_LATENCY_BUCKETS - 1] += 1;
+        b = (int)(s * 1000.0);
+        l->shist[(b < RL_LATENCY_BUCKETS) ? b : RL_LATENCY_BUCKETS - 1] += 1;
+
+        this->latency.psum += p;
+        this->latency.ssum += s;
+        l->events += 1;
+    }
+
+    this->latency.count = 0;
+}
+
+static void
+rldisp_drwhud(rldisp *this)
+{
+    int n, level;
+    double t0, frame;
+    rlstats keep, last;
+    wchar_t line[RL_HUD_WIDTH + 1];
+    rlhue fg = {255, 255, 255, 255}, bg = {0, 0, 0, 192};
+    rlhue hot = {255, 220, 0, 255}, bar;
+
+    if (!this->hud.shown || !this->hud.tmap)
+    {
+        this->hud.count = 0;
+        return;
+    }
+
+    /* Everything the HUD draws is kept out of the frame's statistics and
+       reported as thud instead. Its allocations are counted all the same,
+       as they are taken from rlacount when the frame ends. */
+    t0 = rlstats_now();
+    keep = this->stats.acc;
+    rldisp_stats(this, &last);
+
+    for (int i = 0; i < this->hud.count; ++i)
+        rldisp_dboxo(this, this->hud.dirty[i].left, this->hud.dirty[i].top,
+            this->hud.dirty[i].width, this->hud.dirty[i].height, 1, hot);
+
+    this->hud.count = 0;
+
+    swprintf(line, RL_HUD_WIDTH + 1, L" %5.1f fps %6.2f ms p99 %6.2f ms",
+        last.tframe > 0.0 ? 1.0 / last.tframe : 0.0, last.tframe * 1000.0,
+        last.fp99 * 1000.0);
+    rldisp_hudln(this, line, 0, fg, bg);
+
+    swprintf(line, RL_HUD_WIDTH + 1, L" draws %d verts %d tiles %d",
+        last.draws, last.verts, last.tiles);
+    rldisp_hudln(this, line, 1, fg, bg);
+
+    swprintf(line, RL_HUD_WIDTH + 1, L" maps %d %.2f ms prsnt %.2f ms",
+        last.nmaps, last.tmap * 1000.0, last.tprsnt * 1000.0);
+    rldisp_hudln(this, line, 2, fg, bg);
+
+    swprintf(line, RL_HUD_WIDTH + 1, L" hud %.2f ms gmiss %d kb %zu",
+        last.thud * 1000.0, last.gmiss, last.bytes / 1024);
+    rldisp_hudln(this, line, 3, fg, bg);
+
+    /* Frame time graph, one column per frame with the latest on the right */
+    n = (this->stats.count < RL_HUD_WIDTH) ? this->stats.count : RL_HUD_WIDTH;
+
+    for (int x = 0; x < RL_HUD_WIDTH; ++x)
+    {
+        frame = 0.0;
+
+        if (x >= RL_HUD_WIDTH - n)
+            frame = this->stats.frames[(this->stats.head - RL_HUD_WIDTH + x
+                + RL_STATS_FRAMES) % RL_STATS_FRAMES];
+
+        level = (int)(frame / RL_HUD_SCALE * (double)(RL_HUD_GRAPH * 8));
+        bar = (frame < RL_HUD_SCALE / 2.0) ? (rlhue){0, 220, 0, 255}
+            : (frame < RL_HUD_SCALE) ? hot : (rlhue){255, 40, 40, 255};
+
+        for (int y = 0; y < RL_HUD_GRAPH; ++y)
+        {
+            n = level - (RL_HUD_GRAPH - 1 - y) * 8;
+            n = (n < 0) ? 0 : (n > 8) ? 8 : n;
+            rltmap_pcell(this->hud.tmap, (rlcell){n ? (wchar_t)(0x2580 + n)
+                : L' ', bar, bg, 0.0f, 0.0f, RL_TILE_TEXT}, x,
+                RL_HUD_HEIGHT - RL_HUD_GRAPH + y);
+        }
+    }
+
+    rldisp_dtmap(this, this->hud.tmap);
+
+    /* Mark the frame time of 60 fps on the graph */
+    rldisp_dline(this, 0, RL_HUD_HEIGHT * RL_HUD_TILEY - RL_HUD_GRAPH
+        * RL_HUD_TILEY / 2, RL_HUD_WIDTH * RL_HUD_TILEX, RL_HUD_HEIGHT
+        * RL_HUD_TILEY - RL_HUD_GRAPH * RL_HUD_TILEY / 2, 1, hot);
+
+    /* Held back draws of the HUD are submitted before the statistics are
+       restored */
+    rldisp_flush(this);
+
+    this->stats.acc = keep;
+    this->stats.acc.thud = rlstats_now() - t0;
+    RL_TRACE_END("hud", t0, 0);
+}
+
+static void
+rldisp_hudln(rldisp *this, wchar_t *line, int y, rlhue fg, rlhue bg)
+{
+    size_t len = wcslen(line);
+
+    /* Pad with spaces so the text of the previous frame is overwritten */
+    for (size_t i = len; i < RL_HUD_WIDTH; ++i)
+        line[i] = L' ';
+
+    line[RL_HUD_WIDTH] = L'\0';
+    rltmap_wstrr(this->hud.tmap, line, fg, bg, RL_TILE_CENTER, 0, y);
+}
+
+static void
+rldisp_updstats(rldisp *this, double now)
+{
+    if (!this)
+        return;
+
+    this->stats.acc.tframe = now - this->stats.prev;
+    this->stats.prev = now;
+
+    this->stats.frames[this->stats.head] = this->stats.acc.tframe;
+    this->stats.head = (this->stats.head + 1) % RL_STATS_FRAMES;
+
+    if (this->stats.count < RL_STATS_FRAMES)
+        this->stats.count += 1;
+
+    /* Allocations are not tied to an rldisp, so a frame counts all those
+       made by the library since the last frame of this rldisp ended */
+    this->stats.acc.allocs = rlacount - this->stats.allocs;
+    this->stats.allocs = rlacount;
+
+    /* Steady state frames are not expected to allocate at all */
+    assert(!this->stats.noalloc || !this->stats.acc.allocs);
+
+    this->stats.last = this->stats.acc;
+    memset(&this->stats.acc, 0, sizeof(this->stats.acc));
+}
+
+void
+rldisp_prsnt(rldisp *this)
+{
+    double t0, t1, left;
+    int width, height;
+
+    if (!this || !this->window.handle)
+        return;
+
+    /* An idle rldisp shows nothing new unless the frame changed */
+    if (this->idle.on && !this->frame.dirty)
+        return;
+
+    rldisp_flush(this);
+    rldisp_drwhud(this);
+    t0 = rlstats_now();
+
+    this->window.scroll = 0;
+
+    /* The frame is stretched over the whole window */
+    rldisp_bind(this);
+    glfwGetFramebufferSize(this->window.handle, &width, &height);
+    rlgl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    rlgl.BlitFramebuffer(0, 0, this->frame.width, this->frame.height, 0, 0,
+        width, height, GL_COLOR_BUFFER_BIT,
+        this->frame.filter ? GL_LINEAR : GL_NEAREST);
+    rlbound = NULL;
+
+    t1 = rlstats_now();
+    glfwSwapBuffers(this->window.handle);
+
+    /* Wait out the rest of the frame when the frame rate is limited, waking
+       up for events in the meantime so they are timestamped on arrival */
+    if (this->window.limit)
+    {
+        this->window.due += 1.0 / (double)this->window.limit;
+
+        while ((left = this->window.due - rlstats_now()) > 0.0)
+            glfwWaitEventsTimeout(left);
+
+        if (this->window.due < t1)
+            this->window.due = t1;
+    }
+
+    this->stats.acc.tswap = rlstats_now() - t1;
+    rldisp_updlat(this, t1, t1 + this->stats.acc.tswap);
+    RL_TRACE_END("swap", t1, 0);
+
+    this->stats.acc.draws += 1;
+    this->stats.acc.tprsnt = rlstats_now() - t0;
+    RL_TRACE_END("rldisp_prsnt", t0, 0);
+
+    this->frame.dirty = false;
+
+    if (this->stats.tfirst == 0.0)
+        this->stats.tfirst = rlstats_now() - this->stats.born;
+
+    /* A mode switch or resize is done once a frame is shown after it */
+    if (this->stats.switched != 0.0)
+    {
+        this->stats.tmode = rlstats_now() - this->stats.switched;
+        this->stats.switched = 0.0;
+    }
+
+    rldisp_updstats(this, rlstats_now());
+}
+
+void
+rldisp_stats(rldisp *this, rlstats *stats)
+{
+    int n;
+    double sorted[RL_STATS_FRAMES], sum = 0.0;
+
+    if (!this || !stats)
+        return;
+
+    *stats = this->stats.last;
+    stats->abytes = rlabytes;
+    stats->tfirst = this->stats.tfirst;
+    stats->tmode = this->stats.tmode;
+
+    if (!(n = this->stats.count))
+        return;
+
+    memcpy(sorted, this->stats.frames, (size_t)n * sizeof(double));
+    qsort(sorted, (size_t)n, sizeof(double), rlstats_cmp);
+
+    for (int i = 0; i < n; ++i)
+        sum += sorted[i];
+
+    stats->frames = n;
+    stats->fmin = sorted[0];
+    stats->favg = sum / (double)n;
+    stats->fp99 = sorted[(int)ceil(0.99 * (double)n) - 1];
+}
+
+void
+rldisp_noalloc(rldisp *this, bool enabled)
+{
+    if (!this)
+        return;
+
+    this->stats.noalloc = enabled;
+}
+
+void
+rldisp_latency(rldisp *this, rllatency *latency, bool reset)
+{
+    if (!this)
+        return;
+
+    if (latency)
+    {
+        *latency = this->latency.last;
+
+        if (latency->events)
+        {
+            latency->pavg = this->latency.psum / (double)latency->events;
+            latency->savg = this->latency.ssum / (double)latency->events;
+        }
+    }
+
+    if (reset)
+    {
+        memset(&this->latency.last, 0, sizeof(rllatency));
+        this->latency.psum = 0.0;
+        this->latency.ssum = 0.0;
+    }
+}
+
+bool
+rldisp_hudset(rldisp *this, const char *font, rlkey key)
+{
+    if (!this)
+        return false;
+
+    if (this->hud.tmap)
+        rltmap_free(this->hud.tmap);
+
+    this->hud.tmap = NULL;
+    this->hud.key = key;
+    this->hud.down = false;
+
+    if (!font)
+    {
+        this->hud.shown = false;
+        return true;
+    }
+
+    if (!(this->hud.tmap = rltmap_init(font, RL_HUD_TILEY, 65536,
+        RL_HUD_WIDTH, RL_HUD_HEIGHT, RL_HUD_TILEX, RL_HUD_TILEY)))
+    {
+        this->hud.shown = false;
+        return false;
+    }
+
+    /* Cache every glyph the HUD can show up front, so a frame drawing a
+       glyph for the first time doesn't count against rldisp_noalloc(2) */
+    for (wchar_t g = L' '; g <= L'~'; ++g)
+        rltmap_glyph(this->hud.tmap, g);
+
+    for (wchar_t g = 0x2581; g <= 0x2588; ++g)
+        rltmap_glyph(this->hud.tmap, g);
+
+    return true;
+}
+
+bool
+rldisp_shwhud(rldisp *this, bool visible)
+{
+    if (!this)
+        return false;
+
+    this->hud.shown = visible && this->hud.tmap;
+    return this->hud.shown;
+}
+
+bool
+rldisp_trace(rldisp *this, bool enabled)
+{
+#ifdef RL_TRACE
+    if (!this)
+        return false;
+
+    rltrace.on = enabled;
+    return rltrace.on;
+#else
+    UNUSED(this);
+    UNUSED(enabled);
+    return false;
+#endif
+}
+
+bool
+rldisp_trdump(rldisp *this, const char *path)
+{
+#ifdef RL_TRACE
+    FILE *file = NULL;
+    const struct rltevt *evt = NULL;
+    int first = rltrace.wrap ? rltrace.head : 0;
+    int count = rltrace.wrap ? RL_TRACE_EVENTS : rltrace.head;
+
+    if (!this || !path || !(file = fopen(path, "w")))
+        return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (int i = 0; i < count; ++i)
+    {
+        evt = &rltrace.evts[(first + i) % RL_TRACE_EVENTS];
+
+        /* Complete events carry their duration, instant events a scope */
+        if (evt->dur < 0.0)
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"p\","
+                "\"ts\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"count\":%d}}",
+                evt->name, evt->ts * 1000000.0, evt->count);
+        else
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+                "\"dur\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"count\":%d}}",
+                evt->name, evt->ts * 1000000.0, evt->dur * 1000000.0,
+                evt->count);
+
+        fputs((i + 1 < count) ? ",\n" : "\n", file);
+    }
+
+    fprintf(file, "]}\n");
+
+    return !fclose(file);
+#else
+    UNUSED(this);
+    UNUSED(path);
+    return false;
+#endif
+}
+
+bool
+rldisp_key(rldisp *this, rlkey key)
+{
+    GLFWwindow *w = NULL;
+
+    if (!this || !(w = this->window.handle) || key < 0
+        || key >= RL_KEY_MAXIMUM)
+        return false;
+
+    /* Letters and digits are contiguous in both enumerations */
+    if (key <= RL_KEY_Z)
+        return glfwGetKey(w, GLFW_KEY_A + (int)(key - RL_KEY_A));
+
+    if (key <= RL_KEY_9)
+        return glfwGetKey(w, GLFW_KEY_0 + (int)(key - RL_KEY_0))
+            || glfwGetKey(w, GLFW_KEY_KP_0 + (int)(key - RL_KEY_0));
+
+    switch (key)
+    {
+    case RL_KEY_ESCAPE:
+        return glfwGetKey(w, GLFW_KEY_ESCAPE);
+    case RL_KEY_CONTROL:
+        return glfwGetKey(w, GLFW_KEY_LEFT_CONTROL) ||
+            glfwGetKey(w, GLFW_KEY_RIGHT_CONTROL);
+    case RL_KEY_SHIFT:
+        return glfwGetKey(w, GLFW_KEY_LEFT_SHIFT) ||
+            glfwGetKey(w, GLFW_KEY_RIGHT_SHIFT);
+    case RL_KEY_ALT:
+        return glfwGetKey(w, GLFW_KEY_LEFT_ALT) ||
+            glfwGetKey(w, GLFW_KEY_RIGHT_ALT);
+    case RL_KEY_SYSTEM:
+        return glfwGetKey(w, GLFW_KEY_LEFT_SUPER) ||
+            glfwGetKey(w, GLFW_KEY_RIGHT_SUPER);
+    case RL_KEY_SEMICOLON:
+        return glfwGetKey(w, GLFW_KEY_SEMICOLON);
+    case RL_KEY_COMMA:
+        return glfwGetKey(w, GLFW_KEY_COMMA);
+    case RL_KEY_PERIOD:
+        return glfwGetKey(w, GLFW_KEY_PERIOD);
+    case RL_KEY_QUOTE:
+        return glfwGetKey(w, GLFW_KEY_APOSTROPHE);
+    case RL_KEY_SLASH:
+        return glfwGetKey(w, GLFW_KEY_SLASH);
+    case RL_KEY_TILDE:
+        return glfwGetKey(w, GLFW_KEY_GRAVE_ACCENT);
+    case RL_KEY_SPACE:
+        return glfwGetKey(w, GLFW_KEY_SPACE);
+    case RL_KEY_ENTER:
+        return glfwGetKey(w, GLFW_KEY_ENTER);
+    case RL_KEY_BACKSPACE:
+        return glfwGetKey(w, GLFW_KEY_BACKSPACE);
+    case RL_KEY_TAB:
+        return glfwGetKey(w, GLFW_KEY_TAB);
+    case RL_KEY_UP:
+        return glfwGetKey(w, GLFW_KEY_UP);
+    case RL_KEY_DOWN:
+        return glfwGetKey(w, GLFW_KEY_DOWN);
+    case RL_KEY_LEFT:
+        return glfwGetKey(w, GLFW_KEY_LEFT);
+    case RL_KEY_RIGHT:
+        return glfwGetKey(w, GLFW_KEY_RIGHT);
+    case RL_KEY_MOUSELEFT:
+        return glfwGetMouseButton(w, GLFW_MOUSE_BUTTON_LEFT);
+    case RL_KEY_MOUSERIGHT:
+        return glfwGetMouseButton(w, GLFW_MOUSE_BUTTON_RIGHT);
+    case RL_KEY_MOUSEMIDDLE:
+        return glfwGetMouseButton(w, GLFW_MOUSE_BUTTON_MIDDLE);
+    default:
+        return false;
+    }
+}
+
+int
+rldisp_mousx(rldisp *this)
+{
+    int x;
+    double mx, my;
+
+    if (!this || !this->window.handle)
+        return 0;
+
+    glfwGetCursorPos(this->window.handle, &mx, &my);
+    x = (int)floor(mx);
+
+    if (x < 0 || x > this->window.width)
+        return x;
+
+    return (int)((float)x / this->frame.scale.x);
+}
+
+int
+rldisp_mousy(rldisp *this)
+{
+    int y;
+    double mx, my;
+
+    if (!this || !this->window.handle)
+        return 0;
+
+    glfwGetCursorPos(this->window.handle, &mx, &my);
+    y = (int)floor(my);
+
+    if (y < 0 || y > this->window.height)
+        return y;
+
+    return (int)((float)y / this->frame.scale.y);
+}
+
+void
+rldisp_mouse(rldisp *this, int *x, int *y)
+{
+    double mx, my;
+
+    if (!this || !this->window.handle || !x || !y)
+        return;
+
+    glfwGetCursorPos(this->window.handle, &mx, &my);
+
+    if (mx < 0.0 || mx > (double)this->window.width)
+        *x = -1;
+    else
+        *x = (int)((float)mx / this->frame.scale.x);
+
+    if (my < 0.0 || my > (double)this->window.height)
+        *y = -1;
+    else
+        *y = (int)((float)my / this->frame.scale.y);
+}
+
+extern int
+rldisp_mscrl(rldisp *this)
+{
+    if (!this)
+        return 0;
+
+    return this->window.scroll;
+}
+
+extern double
+rldisp_delta(void)
+{
+    double now = rlstats_now(), delta = now - rldlast;
+
+    rldlast = now;
+    return delta;
+}
+
+/******************************************************************************
+rltile function implementations
+******************************************************************************/
+
+static void
+rltile_set(rltile *this, wchar_t glyph, rlhue fghue, rlhue bghue,
+    rlttype type, float right, float bottom)
+{
+    if (!this)
+        return;
+
+    this->glyph = glyph;
+    this->fghue = fghue;
+    this->bghue = bghue;
+    this->type = type;
+    this->right = right;
+    this->bottom = bottom;
+}
+
+rltile *
+rltile_init(wchar_t glyph, rlhue fghue, rlhue bghue, rlttype type, float right,
+    float bottom)
+{
+    rltile *this = NULL;
+
+    if (!(this = rlmalloc(sizeof(rltile))))
+        return NULL;
+
+    rltile_set(this, glyph, fghue, bghue, type, right, bottom);
+
+    return this;
+}
+
+rltile *
+rltile_null(void)
+{
+    rlhue fg = {255, 0, 0, 255};
+    rlhue bg = {0, 0, 255, 255};
+
+    return rltile_init(L'?', fg, bg, RL_TILE_CENTER, 0.0f, 0.0f);
+}
+
+void
+rltile_glyph(rltile *this, wchar_t glyph)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    this->glyph = glyph;
+}
+
+void
+rltile_fghue(rltile *this, rlhue hue)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    this->fghue = hue;
+}
+
+void
+rltile_bghue(rltile *this, rlhue hue)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    this->bghue = hue;
+}
+
+void
+rltile_type(rltile *this, rlttype type)
+{
+    if (!this)
+        return;
+
+    this->type = type;
+}
+
+void
+rltile_right(rltile *this, float right)
+{
+    if (!this)
+        return;
+
+    this->right = right;
+}
+
+void
+rltile_bottm(rltile *this, float bottom)
+{
+    if (!this)
+        return;
+
+    this->bottom = bottom;
+}
+
+extern void
+rltile_shift(rltile *this, float right, float bottom)
+{
+    if (!this)
+        return;
+
+    this->right = right;
+    this->bottom = bottom;
+}
+
+void
+rltile_free(rltile *this)
+{
+    if (!this)
+        return;
+
+    rlfree(this);
+}
+
+/******************************************************************************
+rltpool function implementations
+******************************************************************************/
+
+static bool
+rltpool_grow(rltpool *this)
+{
+    struct rltslab *slab = NULL;
+
+    if (!this)
+        return false;
+
+    if (!(slab = rlmalloc(sizeof(struct rltslab)
+        + (size_t)this->count * sizeof(union rltnode))))
+        return false;
+
+    slab->next = this->slabs;
+    this->slabs = slab;
+
+    /* Thread the new nodes onto the free list */
+    for (int i = 0; i < this->count; ++i)
+    {
+        slab->nodes[i].next = this->head;
+        this->head = &slab->nodes[i];
+    }
+
+    return true;
+}
+
+rltpool *
+rltpool_init(int count)
+{
+    rltpool *this = NULL;
+
+    if (count <= 0 || !(this = rlmalloc(sizeof(rltpool))))
+        return NULL;
+
+    this->count = count;
+    this->head = NULL;
+    this->slabs = NULL;
+
+    if (!rltpool_grow(this))
+        goto error;
+
+    return this;
+
+error:
+
+    rltpool_free(this);
+    return NULL;
+}
+
+rltile *
+rltpool_take(rltpool *this)
+{
+    union rltnode *node = NULL;
+    rlhue fg = {255, 0, 0, 255};
+    rlhue bg = {0, 0, 255, 255};
+
+    if (!this || (!this->head && !rltpool_grow(this)))
+        return NULL;
+
+    node = this->head;
+    this->head = node->next;
+
+    rltile_set(&node->tile, L'?', fg, bg, RL_TILE_CENTER, 0.0f, 0.0f);
+
+    return &node->tile;
+}
+
+void
+rltpool_give(rltpool *this, rltile *tile)
+{
+    union rltnode *node = (union rltnode *)tile;
+
+    if (!this || !tile)
+        return;
+
+    node->next = this->head;
+    this->head = node;
+}
+
+void
+rltpool_free(rltpool *this)
+{
+    struct rltslab *next = NULL;
+
+    if (!this)
+        return;
+
+    while (this->slabs)
+    {
+        next = this->slabs->next;
+        rlfree(this->slabs);
+        this->slabs = next;
+    }
+
+    rlfree(this);
+}
+
+/******************************************************************************
+rltinst function implementations
+******************************************************************************/
+
+static void
+rltinst_set(struct rltinst *this, const struct rltglyph *g, float r, float b,
+    rlhue fg, rlhue bg)
+{
+    this->rect[0] = (uint16_t)g->rect.left;
+    this->rect[1] = (uint16_t)g->rect.top;
+    this->rect[2] = (uint16_t)(g->rect.width | g->rect.height << 8);
+    this->rect[3] = (uint16_t)g->page;
+    this->shift[0] = (int16_t)lroundf(r * RL_SHIFT_SUB);
+    this->shift[1] = (int16_t)lroundf(b * RL_SHIFT_SUB);
+    this->fg = fg;
+    this->bg = bg;
+}
+
+/******************************************************************************
+rlpage function implementations
+******************************************************************************/
+
+/* Returns the top of a glyph placed at the left edge of skyline segment i,
+   resting on the highest segment below it, or -1 if it doesn't fit there */
+static int
+rlpage_fit(const struct rlpage *this, int size, int i, int width, int height)
+{
+    int y = 0, left = width;
+
+    if (this->sky[i].x + width > size)
+        return -1;
+
+    for (; left > 0; ++i)
+    {
+        if (this->sky[i].y > y)
+            y = this->sky[i].y;
+
+        if (y + height > size)
+            return -1;
+
+        left -= this->sky[i].width;
+    }
+
+    return y;
+}
+
+/* Finds room for a glyph on the skyline of a page, preferring the position
+   that leaves the lowest top and then the narrowest segment, and raises the
+   skyline over it */
+static bool
+rlpage_pack(struct rlpage *this, int size, int width, int height, int *x,
+    int *y)
+{
+    int top, cut, best = -1, btop = 0;
+    struct rlsky *sky = this->sky;
+
+    for (int i = 0; i < this->nsky; ++i)
+    {
+        if ((top = rlpage_fit(this, size, i, width, height)) < 0)
+            continue;
+
+        if (best < 0 || top < btop || (top == btop
+            && sky[i].width < sky[best].width))
+        {
+            best = i;
+            btop = top;
+        }
+    }
+
+    if (best < 0)
+        return false;
+
+    *x = sky[best].x;
+    *y = btop;
+
+    /* The new segment covers the start of the ones it rests on */
+    memmove(&sky[best + 1], &sky[best], (size_t)(this->nsky - best)
+        * sizeof(struct rlsky));
+    sky[best] = (struct rlsky){*x, btop + height, width};
+    this->nsky += 1;
+
+    for (int i = best + 1; i < this->nsky;)
+    {
+        if ((cut = *x + width - sky[i].x) <= 0)
+            break;
+
+        if (cut < sky[i].width)
+        {
+            sky[i].x += cut;
+            sky[i].width -= cut;
+            break;
+        }
+
+        memmove(&sky[i], &sky[i + 1], (size_t)(this->nsky - i - 1)
+            * sizeof(struct rlsky));
+        this->nsky -= 1;
+    }
+
+    /* Neighbors of the same height are merged */
+    for (int i = 0; i + 1 < this->nsky;)
+    {
+        if (sky[i].y != sky[i + 1].y)
+        {
+            ++i;
+            continue;
+        }
+
+        sky[i].width += sky[i + 1].width;
+        memmove(&sky[i + 1], &sky[i + 2], (size_t)(this->nsky - i - 2)
+            * sizeof(struct rlsky));
+        this->nsky -= 1;
+    }
+
+    return true;
+}
+
+/******************************************************************************
+rlcache function implementations
+******************************************************************************/
+
+/* Returns the glyph cache of the SDF rltmaps of the font at path that
+   rasterize at rsize pixels into an atlas of the given layout, making it if
+   there is none yet. Without a path, a new one is made that is never
+   shared. */
+static struct rlcache *
+rlcache_get(const char *path, int rsize, int cnum, int size, int limit,
+    int pad)
+{
+    struct rlcache *this = NULL;
+
+    for (this = rlcaches; path && this; this = this->next)
+    {
+        if (!strcmp(this->path, path) && this->rsize == rsize
+            && this->atlas.size == size && this->atlas.limit == limit
+            && this->atlas.pad == pad)
+            return this;
+    }
+
+    if (!(this = rlcalloc(1, sizeof(struct rlcache))))
+        return NULL;
+
+    this->rsize = rsize;
+    this->glyph.pages = cnum / RL_GLYPH_PAGE + 1;
+    this->atlas.size = size;
+    this->atlas.bpp = 1;
+    this->atlas.pad = pad;
+    this->atlas.limit = limit;
+
+    if (path && !(this->path = rlstrdup(path)))
+        goto error;
+
+    if (!(this->glyph.list = rlcalloc((size_t)this->glyph.pages,
+        sizeof(struct rltglyph *))))
+        goto error;
+
+    if (!(this->atlas.pages = rlcalloc((size_t)limit, sizeof(struct rlpage))))
+        goto error;
+
+    if (this->path)
+    {
+        this->next = rlcaches;
+        rlcaches = this;
+    }
+
+    return this;
+
+error:
+
+    rlcache_free(this);
+    return NULL;
+}
+
+static void
+rlcache_free(struct rlcache *this)
+{
+    struct rlcache **link = &rlcaches;
+
+    while (*link && *link != this)
+        link = &(*link)->next;
+
+    if (*link)
+        *link = this->next;
+
+    if (this->gl.atlas && this->gl.gen == rlgen && rlgl_ctx())
+        rlgl.DeleteTextures(1, &this->gl.atlas);
+
+    rlcache_gfree(this);
+    rlfree(this->atlas.pages);
+    rlfree(this->glyph.list);
+    rlfree(this->path);
+    rlfree(this);
+}
+
+/* Frees the atlas pages and empties the glyph cache */
+static void
+rlcache_gfree(struct rlcache *this)
+{
+    for (int i = 0; this->atlas.pages && i < this->atlas.count; ++i)
+    {
+        rlfree(this->atlas.pages[i].pixels);
+        rlfree(this->atlas.pages[i].sky);
+        rlabytes -= (size_t)this->atlas.size * (size_t)this->atlas.size
+            * (size_t)this->atlas.bpp;
+    }
+
+    if (this->atlas.pages)
+        memset(this->atlas.pages, 0, (size_t)this->atlas.limit
+            * sizeof(struct rlpage));
+
+    this->atlas.count = 0;
+
+    for (int i = 0; this->glyph.list && i < this->glyph.pages; ++i)
+    {
+        rlfree(this->glyph.list[i]);
+        this->glyph.list[i] = NULL;
+    }
+}
+
+/* Makes room for every atlas page in the atlas texture. The layers are
+   doubled, so the pages already uploaded are copied over on the GPU rather
+   than uploaded again, and the new layers are cleared. */
+static void
+rlcache_layers(struct rlcache *this)
+{
+    GLuint tex = 0, fbo = 0;
+    int size = this->atlas.size, layers = this->gl.layers;
+    GLint filter = this->atlas.bpp == 1 ? GL_LINEAR : GL_NEAREST;
+
+    layers = layers ? layers * 2 : 1;
+
+    while (layers < this->atlas.count)
+        layers *= 2;
+
+    if (layers > this->atlas.limit)
+        layers = this->atlas.limit;
+
+    rlgl.GenTextures(1, &tex);
+    rlgl.BindTexture(GL_TEXTURE_2D_ARRAY, tex);
+    rlgl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+    rlgl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+    rlgl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,
+        GL_CLAMP_TO_EDGE);
+    rlgl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,
+        GL_CLAMP_TO_EDGE);
+
+    /* Coverage is read as white with that alpha, so glyphs and tilesheets
+       both multiply the hue by the texel */
+    if (this->atlas.bpp == 1)
+    {
+        rlgl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_R, GL_ONE);
+        rlgl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_G, GL_ONE);
+        rlgl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_B, GL_ONE);
+        rlgl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_A, GL_RED);
+    }
+
+    rlgl.TexImage3D(GL_TEXTURE_2D_ARRAY, 0, this->atlas.bpp == 1 ? GL_R8
+        : GL_RGBA8, size, size, layers, 0, this->atlas.bpp == 1 ? GL_RED
+        : GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    rlgl.GenFramebuffers(1, &fbo);
+    rlgl.BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    rlgl.ClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    for (int i = 0; i < layers; ++i)
+    {
+        if (i < this->gl.layers)
+        {
+            rlgl.FramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                this->gl.atlas, 0, i);
+            rlgl.CopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, 0, 0,
+                size, size);
+        }
+        else
+        {
+            rlgl.FramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                tex, 0, i);
+            rlgl.Clear(GL_COLOR_BUFFER_BIT);
+        }
+    }
+
+    rlgl.DeleteFramebuffers(1, &fbo);
+
+    if (this->gl.atlas)
+        rlgl.DeleteTextures(1, &this->gl.atlas);
+
+    /* The frame of the bound rldisp has to be bound again */
+    rlbound = NULL;
+
+    this->gl.atlas = tex;
+    this->gl.layers = layers;
+}
+
+/* Uploads the atlas pages written since the last draw from the glyph cache,
+   creating the atlas texture if needed, and returns the number of bytes
+   uploaded */
+static size_t
+rlcache_sync(struct rlcache *this)
+{
+    int w, h;
+    size_t bytes = 0;
+    struct rlpage *page = NULL;
+
+    this->atlas.tick += 1;
+
+    /* Objects of an earlier share group are gone, start over. Atlas pages
+       uploaded to it are uploaded again whole. */
+    if (this->gl.gen != rlgen)
+    {
+        for (int i = 0; this->gl.gen && i < this->atlas.count; ++i)
+        {
+            page = &this->atlas.pages[i];
+            page->dirty.x0 = 0;
+            page->dirty.y0 = 0;
+            page->dirty.x1 = this->atlas.size - 1;
+            page->dirty.y1 = this->atlas.size - 1;
+        }
+
+        memset(&this->gl, 0, sizeof(this->gl));
+        this->gl.gen = rlgen;
+    }
+
+    if (this->atlas.count > this->gl.layers)
+        rlcache_layers(this);
+
+    /* Only the part of each page written since the last upload is sent */
+    rlgl.BindTexture(GL_TEXTURE_2D_ARRAY, this->gl.atlas);
+    rlgl.PixelStorei(GL_UNPACK_ROW_LENGTH, this->atlas.size);
+
+    for (int i = 0; i < this->atlas.count; ++i)
+    {
+        page = &this->atlas.pages[i];
+
+        if (page->dirty.x1 < page->dirty.x0)
+            continue;
+
+        w = page->dirty.x1 - page->dirty.x0 + 1;
+        h = page->dirty.y1 - page->dirty.y0 + 1;
+
+        rlgl.TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, page->dirty.x0,
+            page->dirty.y0, i, w, h, 1, this->atlas.bpp == 1 ? GL_RED
+            : GL_RGBA, GL_UNSIGNED_BYTE, &page->pixels[(page->dirty.y0
+            * this->atlas.size + page->dirty.x0) * this->atlas.bpp]);
+        bytes += (size_t)(w * h * this->atlas.bpp);
+
+        page->dirty.x0 = this->atlas.size;
+        page->dirty.y0 = this->atlas.size;
+        page->dirty.x1 = -1;
+        page->dirty.y1 = -1;
+    }
+
+    rlgl.PixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    return bytes;
+}
+
+/******************************************************************************
+rltmap function implementations
+******************************************************************************/
+
+static void
+rltmap_shift(rltmap *this, wchar_t glyph, rlttype type, float right,
+    float bottom, float *r, float *b, const struct rltglyph **glyphp)
+{
+    float w = 0.0f, h = 0.0f, border = 0.0f;
+    const struct rltglyph *g = NULL;
+
+    if (!this || !r || !b || !glyphp)
+        return;
+
+    if (!(g = rltmap_glyph(this, glyph)))
+        g = &rltgnone;
+
+    *r = 0.0f;
+    *b = 0.0f;
+    *glyphp = g;
+
+    /* Glyphs are placed by their outline, without the distance border
+       around the glyphs of an SDF rltmap */
+    if (g->rect.width)
+    {
+        border = this->sdf.border;
+        w = (float)g->rect.width * this->sdf.texel - 2.0f * border;
+        h = (float)g->rect.height * this->sdf.texel - 2.0f * border;
+    }
+
+    switch (type)
+    {
+    case RL_TILE_TEXT:
+        *r = g->left * this->sdf.texel;
+        *b = (float)(this->offy) + g->top * this->sdf.texel;
+        return;
+    case RL_TILE_EXACT:
+        *r = (float)(int)(((float)this->offx - w) / 2.0f);
+        *b = (float)(int)(((float)this->offy - h) / 2.0f);
+        *r += right;
+        *b += bottom;
+        break;
+    case RL_TILE_FLOOR:
+        *r = (float)(int)(((float)this->offx - w) / 2.0f);
+        *b = (float)(int)((float)this->offy - h);
+        break;
+    case RL_TILE_CENTER:
+        *r = (float)(int)(((float)this->offx - w) / 2.0f);
+        *b = (float)(int)(((float)this->offy - h) / 2.0f);
+        break;
+    }
+
+    *r -= border;
+    *b -= border;
+}
+
+/* Starts a new atlas page, unless the atlas has as many as it may have */
+static bool
+rltmap_addpg(rltmap *this)
+{
+    struct rlcache *cache = this->cache;
+    int size = cache->atlas.size;
+    struct rlpage *page = &cache->atlas.pages[cache->atlas.count];
+
+    if (cache->atlas.count == cache->atlas.limit)
+        return false;
+
+    /* The skyline never has more segments than the page has columns, plus
+       the one inserted before the covered ones are trimmed */
+    if (!(page->pixels = rlcalloc((size_t)size * (size_t)size, 1))
+        || !(page->sky = rlmalloc((size_t)(size + 1) * sizeof(struct rlsky))))
+    {
+        rlfree(page->pixels);
+        page->pixels = NULL;
+        return false;
+    }
+
+    page->nsky = 1;
+    page->sky[0] = (struct rlsky){0, 0, size};
+    page->dirty.x0 = size;
+    page->dirty.y0 = size;
+    page->dirty.x1 = -1;
+    page->dirty.y1 = -1;
+
+    cache->atlas.count += 1;
+    rlabytes += (size_t)size * (size_t)size;
+
+    this->stats.agrow += 1;
+    RL_TRACE_MARK("atlas growth", size * size);
+
+    return true;
+}
+
+/* Finds room for a glyph in the first atlas page that has it, starting a
+   new page when none does */
+static bool
+rltmap_pack(rltmap *this, int width, int height, int *page, int *x, int *y)
+{
+    struct rlcache *cache = this->cache;
+    int size = cache->atlas.size;
+
+    if (width > size || height > size)
+        return false;
+
+    for (*page = 0; *page < cache->atlas.count; ++*page)
+        if (rlpage_pack(&cache->atlas.pages[*page], size, width, height, x,
+            y))
+            return true;
+
+    if (!rltmap_addpg(this))
+        return false;
+
+    return rlpage_pack(&cache->atlas.pages[*page], size, width, height, x, y);
+}
+
+/* Switches an rltmap to a glyph cache, or to none if cache is NULL, leaving
+   the one it drew from, which is freed once no rltmap does. The tiles and
+   prototypes refer to glyphs of the old one, so they are emptied. */
+static void
+rltmap_use(rltmap *this, struct rlcache *cache)
+{
+    rltmap **link = NULL;
+
+    if (cache == this->cache)
+        return;
+
+    rltmap_flush(this);
+
+    if (this->cache)
+    {
+        link = &this->cache->maps;
+
+        while (*link && *link != this)
+            link = &(*link)->cnext;
+
+        if (*link)
+            *link = this->cnext;
+
+        if (!this->cache->maps)
+            rlcache_free(this->cache);
+    }
+
+    this->cache = cache;
+    this->cnext = NULL;
+
+    if (!cache)
+        return;
+
+    this->cnext = cache->maps;
+    cache->maps = this;
+
+    memset(this->tiles, 0, (size_t)(this->width * this->height)
+        * sizeof(struct rltinst));
+    this->proto.count = 0;
+
+    rltmap_dirty(this, 0, 0);
+    rltmap_dirty(this, this->width - 1, this->height - 1);
+}
+
+/* Loading thread of rltmap_async(7). It parses the font and rasterizes the
+   printable ASCII glyphs, touching nothing of the rltmap but load. */
+static void *
+rltmap_work(void *arg)
+{
+    rltmap *this = arg;
+    FT_GlyphSlot slot = NULL;
+    struct rlpre *pre = NULL;
+    int last = this->cnum < RL_ASYNC_LAST ? this->cnum : RL_ASYNC_LAST;
+    int count = last - RL_ASYNC_FIRST + 1;
+
+    if (FT_New_Library(&this->load.mem, &this->load.lib))
+        goto done;
+
+    FT_Add_Default_Modules(this->load.lib);
+
+    if (FT_New_Face(this->load.lib, this->load.path, 0, &this->load.face))
+    {
+        this->load.face = NULL;
+        goto done;
+    }
+
+    if (FT_Set_Pixel_Sizes(this->load.face, 0, (FT_UInt)this->csize))
+    {
+        FT_Done_Face(this->load.face);
+        this->load.face = NULL;
+        goto done;
+    }
+
+    if (count <= 0 || !(this->load.pre = rlft_lalloc(&this->load.mem,
+        (long)((size_t)count * sizeof(struct rlpre)))))
+        goto done;
+
+    slot = this->load.face->glyph;
+
+    for (int i = 0; i < count; ++i)
+    {
+        pre = &this->load.pre[i];
+        FT_Bitmap_Init(&pre->bitmap);
+        this->load.count += 1;
+
+        if (FT_Load_Char(this->load.face, (FT_ULong)(RL_ASYNC_FIRST + i),
+            FT_LOAD_RENDER))
+            continue;
+
+        pre->left = slot->bitmap_left;
+        pre->top = slot->bitmap_top;
+        FT_Bitmap_Copy(this->load.lib, &slot->bitmap, &pre->bitmap);
+    }
+
+done:
+
+    pthread_mutex_lock(&this->load.lock);
+    this->load.done = true;
+    pthread_mutex_unlock(&this->load.lock);
+
+    return NULL;
+}
+
+/* Waits for the loading thread of an rltmap_async(7) rltmap and takes over
+   its font, packing the glyphs it rasterized into the atlas. An rltmap whose
+   font failed to load is left without one, drawing no glyphs. */
+static void
+rltmap_adopt(rltmap *this)
+{
+    struct rlpre *pre = NULL;
+    struct rltglyph *entry = NULL;
+
+    pthread_join(this->load.thread, NULL);
+    pthread_mutex_destroy(&this->load.lock);
+    this->load.pending = false;
+
+    /* The blocks of the loading thread are counted like any other now */
+    rlalive += this->load.alive;
+    this->load.mem.alloc = rlft_alloc;
+    this->load.mem.realloc = rlft_realloc;
+    this->load.mem.free = rlft_free;
+
+    /* Kept to find the glyph cache shared in SDF mode */
+    this->path = this->load.path;
+    this->load.path = NULL;
+
+    this->font = this->load.face;
+    this->load.failed = !this->font;
+
+    for (int i = 0; i < this->load.count; ++i)
+    {
+        pre = &this->load.pre[i];
+
+        if (this->font && (entry = rltmap_entry(this, (wchar_t)(RL_ASYNC_FIRST
+            + i))) && !entry->ok)
+        {
+            *entry = rltgnone;
+            entry->left = (float)pre->left;
+            entry->top = -(float)pre->top;
+
+            /* One that doesn't fit is rasterized again when looked up */
+            entry->ok = rltmap_place(this, entry, &pre->bitmap);
+        }
+
+        FT_Bitmap_Done(this->load.lib, &pre->bitmap);
+    }
+
+    rlfree(this->load.pre);
+    this->load.pre = NULL;
+    this->load.count = 0;
+}
+
+/* Returns the glyph cache entry of a glyph, allocating its page of the
+   cache if needed */
+static struct rltglyph *
+rltmap_entry(rltmap *this, wchar_t glyph)
+{
+    struct rltglyph **list = NULL;
+    struct rlcache *cache = this->cache;
+    int index = (int)glyph / RL_GLYPH_PAGE;
+
+    /* Nothing else caches rasterized glyphs here, so the page table grows
+       to cover glyphs past cnum (e.g. from rltmap_wstrr(7)) */
+    if (index >= cache->glyph.pages)
+    {
+        if (!(list = rlrealloc(cache->glyph.list, (size_t)(index + 1)
+            * sizeof(struct rltglyph *))))
+            return NULL;
+
+        memset(&list[cache->glyph.pages], 0, (size_t)(index + 1
+            - cache->glyph.pages) * sizeof(struct rltglyph *));
+        cache->glyph.list = list;
+        cache->glyph.pages = index + 1;
+    }
+
+    if (!cache->glyph.list[index] && !(cache->glyph.list[index]
+        = rlcalloc(RL_GLYPH_PAGE, sizeof(struct rltglyph))))
+        return NULL;
+
+    return &cache->glyph.list[index][(int)glyph % RL_GLYPH_PAGE];
+}
+
+static const struct rltglyph *
+rltmap_glyph(rltmap *this, wchar_t glyph)
+{
+    struct rltglyph *entry = NULL;
+    int index = (int)glyph / RL_GLYPH_PAGE;
+
+    if (!this || glyph < 0)
+        return NULL;
+
+    if (this->load.pending)
+        rltmap_adopt(this);
+
+    /* Every glyph of a tilesheet is cached by rltmap_sheet */
+    if (!this->font && (index >= this->cache->glyph.pages
+        || !this->cache->glyph.list[index]))
+        return &rltgnone;
+
+    if (!(entry = rltmap_entry(this, glyph)))
+        return NULL;
+
+    if (entry->ok)
+    {
+        if (entry->rect.width)
+            this->cache->atlas.pages[entry->page].tick
+                = this->cache->atlas.tick;
+
+        return entry;
+    }
+
+    if (!this->font)
+        return &rltgnone;
+
+    this->stats.gmiss += 1;
+    rltmap_raster(this, glyph, entry, true);
+
+    return entry;
+}
+
+/* Loads a glyph into the glyph slot of the font of an rltmap, rendered as
+   coverage or as a signed distance field */
+static bool
+rltmap_load(rltmap *this, wchar_t glyph)
+{
+    if (!this->sdf.on)
+        return !FT_Load_Char(this->font, (FT_ULong)glyph, FT_LOAD_RENDER);
+
+#ifdef RL_SDF_SUPPORTED
+    return !FT_Load_Char(this->font, (FT_ULong)glyph, FT_LOAD_DEFAULT)
+        && !FT_Render_Glyph(this->font->glyph, FT_RENDER_MODE_SDF);
+#else
+    return false;
+#endif
+}
+
+/* Rasterizes a glyph into the atlas and caches it in entry. A glyph that
+   fails to load is cached as an empty one. A glyph that doesn't fit, even
+   after evicting a page if evict is set, is drawn empty but left out of the
+   cache, so it is tried again the next time it is looked up. */
+static void
+rltmap_raster(rltmap *this, wchar_t glyph, struct rltglyph *entry,
+    bool evict)
+{
+    *entry = rltgnone;
+
+    if (!rltmap_load(this, glyph))
+        return;
+
+    entry->left = (float)this->font->glyph->bitmap_left;
+    entry->top = -(float)this->font->glyph->bitmap_top;
+
+    if (rltmap_place(this, entry, &this->font->glyph->bitmap))
+        return;
+
+    /* Evicting a page rasterizes the glyphs still in use on it again, which
+       reuses the FreeType glyph slot, so this one is loaded again after. The
+       glyphs put back can fill the page again, so it can still not fit. */
+    if (evict && rltmap_evict(this) && rltmap_load(this, glyph)
+        && rltmap_place(this, entry, &this->font->glyph->bitmap))
+        return;
+
+    entry->ok = false;
+    this->stats.gfail += 1;
+}
+
+/* Packs a glyph bitmap into the atlas and points its cache entry at it.
+   Returns false only if the glyph doesn't fit, leaving the entry empty. */
+static bool
+rltmap_place(rltmap *this, struct rltglyph *entry, const FT_Bitmap *bitmap)
+{
+    int p, x, y, w, h, size, pad;
+    const uint8_t *src = NULL;
+    uint8_t *dst = NULL;
+    struct rlpage *page = NULL;
+    struct rlcache *cache = this->cache;
+
+    size = cache->atlas.size;
+    pad = cache->atlas.pad;
+    w = (int)bitmap->width;
+    h = (int)bitmap->rows;
+
+    if (!w || !h || w > RL_GLYPH_MAXIMUM || h > RL_GLYPH_MAXIMUM)
+        return true;
+
+    /* Glyphs are padded so filtering doesn't bleed into their neighbors */
+    if (!rltmap_pack(this, w + 2 * pad, h + 2 * pad, &p, &x, &y))
+        return false;
+
+    page = &cache->atlas.pages[p];
+    page->tick = cache->atlas.tick;
+    entry->page = p;
+    entry->rect = (struct rlrect){x + pad, y + pad, w, h};
+
+    for (int j = 0; j < h; ++j)
+    {
+        src = bitmap->buffer + j * bitmap->pitch;
+        dst = &page->pixels[(y + pad + j) * size + x + pad];
+
+        for (int i = 0; i < w; ++i)
+        {
+            if (bitmap->pixel_mode == FT_PIXEL_MODE_MONO)
+                dst[i] = ((src[i >> 3] >> (7 - (i & 7))) & 1) ? 255 : 0;
+            else
+                dst[i] = src[i];
+        }
+    }
+
+    /* The padding is uploaded along with the glyph, so the texture never
+       holds anything but zeros around it */
+    if (x < page->dirty.x0)
+        page->dirty.x0 = x;
+    if (y < page->dirty.y0)
+        page->dirty.y0 = y;
+    if (x + w + 2 * pad - 1 > page->dirty.x1)
+        page->dirty.x1 = x + w + 2 * pad - 1;
+    if (y + h + 2 * pad - 1 > page->dirty.y1)
+        page->dirty.y1 = y + h + 2 * pad - 1;
+
+    return true;
+}
+
+static int
+rlmove_cmp(const void *a, const void *b)
+{
+    uint32_t ka = ((const struct rlmove *)a)->key;
+    uint32_t kb = ((const struct rlmove *)b)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+/* Returns the glyph that a tile or prototype drawing from the page being
+   evicted draws, found by where it was on the page */
+static struct rlmove *
+rlmove_find(struct rlmove *moves, int count, const struct rltinst *t)
+{
+    struct rlmove key;
+
+    key.key = (uint32_t)t->rect[1] << 16 | t->rect[0];
+
+    return bsearch(&key, moves, (size_t)count, sizeof(struct rlmove),
+        rlmove_cmp);
+}
+
+/* Frees an atlas page for glyphs that fit nowhere. The victim is the page
+   drawn from by the fewest tiles and prototypes of the rltmaps sharing the
+   atlas, as the glyphs they draw are rasterized again, and the least
+   recently used one of those. The glyphs on it that nothing draws are
+   dropped from the cache, and the tiles and prototypes drawing the others
+   are patched to their new place. */
+static bool
+rltmap_evict(rltmap *this)
+{
+    int v = 0, n = 0, count;
+    int refs[RL_ATLAS_MAXPAGES] = {0};
+    rltmap *tmap = NULL;
+    struct rlcache *cache = this->cache;
+    struct rlpage *page = NULL;
+    struct rltinst *t = NULL;
+    struct rltglyph *entry = NULL;
+    struct rlmove *moves = NULL, *m = NULL;
+    RL_TRACE_BEGIN(t0);
+
+    if (!cache->atlas.count)
+        return false;
+
+    /* The rltmaps drawing from the cache are patched, so the draws held
+       back of any of them are made first */
+    for (tmap = cache->maps; tmap; tmap = tmap->cnext)
+        rltmap_flush(tmap);
+
+    for (tmap = cache->maps; tmap; tmap = tmap->cnext)
+    {
+        count = tmap->width * tmap->height;
+
+        for (int i = 0; i < count + tmap->proto.count; ++i)
+        {
+            t = i < count ? &tmap->tiles[i] : &tmap->proto.list[i - count];
+
+            if (t->rect[2])
+                refs[t->rect[3]] += 1;
+        }
+    }
+
+    for (int i = 1; i < cache->atlas.count; ++i)
+    {
+        if (refs[i] < refs[v] || (refs[i] == refs[v]
+            && cache->atlas.pages[i].tick < cache->atlas.pages[v].tick))
+            v = i;
+    }
+
+    /* Collect the glyphs on the victim with their place on it */
+    for (int i = 0; i < cache->glyph.pages; ++i)
+    for (int j = 0; cache->glyph.list[i] && j < RL_GLYPH_PAGE; ++j)
+    {
+        entry = &cache->glyph.list[i][j];
+        n += entry->ok && entry->rect.width && entry->page == v;
+    }
+
+    if (!(moves = rlmalloc((size_t)(n ? n : 1) * sizeof(struct rlmove))))
+        return false;
+
+    n = 0;
+
+    for (int i = 0; i < cache->glyph.pages; ++i)
+    for (int j = 0; cache->glyph.list[i] && j < RL_GLYPH_PAGE; ++j)
+    {
+        entry = &cache->glyph.list[i][j];
+
+        if (entry->ok && entry->rect.width && entry->page == v)
+            moves[n++] = (struct rlmove){(uint32_t)entry->rect.top << 16
+                | (uint32_t)entry->rect.left, (wchar_t)(i * RL_GLYPH_PAGE
+                + j), false};
+    }
+
+    qsort(moves, (size_t)n, sizeof(struct rlmove), rlmove_cmp);
+
+    for (tmap = cache->maps; tmap; tmap = tmap->cnext)
+    {
+        count = tmap->width * tmap->height;
+
+        for (int i = 0; i < count + tmap->proto.count; ++i)
+        {
+            t = i < count ? &tmap->tiles[i] : &tmap->proto.list[i - count];
+
+            if (t->rect[2] && t->rect[3] == v
+                && (m = rlmove_find(moves, n, t)))
+                m->live = true;
+        }
+    }
+
+    page = &cache->atlas.pages[v];
+    memset(page->pixels, 0, (size_t)cache->atlas.size
+        * (size_t)cache->atlas.size);
+    page->nsky = 1;
+    page->sky[0] = (struct rlsky){0, 0, cache->atlas.size};
+    page->dirty.x0 = 0;
+    page->dirty.y0 = 0;
+    page->dirty.x1 = cache->atlas.size - 1;
+    page->dirty.y1 = cache->atlas.size - 1;
+
+    for (int i = 0; i < n; ++i)
+    {
+        entry = &cache->glyph.list[moves[i].glyph / RL_GLYPH_PAGE]
+            [moves[i].glyph % RL_GLYPH_PAGE];
+
+        if (moves[i].live)
+        {
+            rltmap_raster(this, moves[i].glyph, entry, false);
+            this->stats.graster += 1;
+        }
+        else
+        {
+            entry->ok = false;
+            this->stats.gevict += 1;
+        }
+    }
+
+    /* Tiles still hold the old place of their glyph, so the glyph can be
+       found the same way as above */
+    for (tmap = cache->maps; tmap; tmap = tmap->cnext)
+    {
+        count = tmap->width * tmap->height;
+
+        for (int i = 0; i < count + tmap->proto.count; ++i)
+        {
+            t = i < count ? &tmap->tiles[i] : &tmap->proto.list[i - count];
+
+            if (!t->rect[2] || t->rect[3] != v
+                || !(m = rlmove_find(moves, n, t)))
+                continue;
+
+            entry = &cache->glyph.list[m->glyph / RL_GLYPH_PAGE]
+                [m->glyph % RL_GLYPH_PAGE];
+            t->rect[0] = (uint16_t)entry->rect.left;
+            t->rect[1] = (uint16_t)entry->rect.top;
+            t->rect[2] = (uint16_t)(entry->rect.width
+                | entry->rect.height << 8);
+            t->rect[3] = (uint16_t)entry->page;
+
+            if (i < count)
+                rltmap_dirty(tmap, i % tmap->width, i / tmap->width);
+        }
+    }
+
+    rlfree(moves);
+    RL_TRACE_END("rltmap_evict", t0, n);
+
+    return true;
+}
+
+static void
+rltmap_updtile(rltmap *this, rltile *t, int x, int y)
+{
+    float r, b;
+    const struct rltglyph *g = NULL;
+
+    if (RL_INVALID(!this || !t))
+        return;
+
+    rltmap_shift(this, t->glyph, t->type, t->right, t->bottom, &r, &b, &g);
+    rltinst_set(&this->tiles[rltmap_index(this, x, y)], g, r, b,
+        t->fghue, t->bghue);
+
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
+}
+
+static void
+rltmap_updcell(rltmap *this, const rlcell *c, int x, int y)
+{
+    float r, b;
+    const struct rltglyph *g = NULL;
+
+    if (RL_INVALID(!this || !c))
+        return;
+
+    rltmap_shift(this, c->glyph, c->type, c->right, c->bottom, &r, &b, &g);
+    rltinst_set(&this->tiles[rltmap_index(this, x, y)], g, r, b,
+        c->fghue, c->bghue);
+
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
+}
+
+static void
+rltmap_updhue(rltmap *this, bool fg, const rlhue *hues, int x, int y,
+    int width, int height)
+{
+    int xi, yi;
+    struct rltinst *t = NULL;
+    RL_TRACE_BEGIN(t0);
+
+    if (!this || !hues)
+        return;
+
+    for (int j = 0; j < height; ++j)
+    for (int i = 0; i < width; ++i)
+    {
+        xi = x + i;
+        yi = y + j;
+
+        if (xi < 0 || xi >= this->width || yi < 0 || yi >= this->height)
+            continue;
+
+        t = &this->tiles[rltmap_index(this, xi, yi)];
+
+        if (fg)
+            t->fg = hues[j * width + i];
+        else
+            t->bg = hues[j * width + i];
+
+        rltmap_dirty(this, xi, yi);
+        this->stats.tiles += 1;
+    }
+
+    RL_TRACE_END(fg ? "rltmap_vhuef" : "rltmap_vhueb", t0, width * height);
+}
+
+static GLuint
+rltmap_mktex(GLenum format, int width, int height, GLint filter)
+{
+    GLuint tex = 0;
+
+    rlgl.GenTextures(1, &tex);
+    rlgl.BindTexture(GL_TEXTURE_2D, tex);
+    rlgl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    rlgl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    rlgl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    rlgl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    rlgl.TexImage2D(GL_TEXTURE_2D, 0, (GLint)format, width, height, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    return tex;
+}
+
+/* Deletes a texture of an rltmap, unless the share group it was created in
+   is already gone and took it along */
+static void
+rltmap_deltex(rltmap *this, GLuint *tex)
+{
+    if (*tex && this->gl.gen == rlgen && rlgl_ctx())
+        rlgl.DeleteTextures(1, tex);
+
+    *tex = 0;
+}
+
+/* Brings the GL objects of an rltmap up to date with its client side copies,
+   creating them if needed, and returns the number of bytes uploaded */
+static size_t
+rltmap_sync(rltmap *this)
+{
+    size_t bytes = 0, first, count, size;
+
+    /* Objects of an earlier share group are gone, start over */
+    if (this->gl.gen != rlgen)
+    {
+        memset(&this->gl, 0, sizeof(this->gl));
+        this->gl.gen = rlgen;
+    }
+
+    count = (size_t)(this->width * this->height);
+    size = count * sizeof(struct rltinst);
+
+    if (!this->gl.tiles)
+    {
+        rlgl.GenBuffers(1, &this->gl.tiles);
+        rlgl.BindBuffer(GL_ARRAY_BUFFER, this->gl.tiles);
+        rlgl.BufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, this->tiles,
+            GL_DYNAMIC_DRAW);
+        bytes += size;
+    }
+    else if (this->dirty.x1 >= 0)
+    {
+        first = (size_t)(this->dirty.y0 * this->width);
+        count = (size_t)((this->dirty.y1 - this->dirty.y0 + 1) * this->width);
+        rlgl.BindBuffer(GL_ARRAY_BUFFER, this->gl.tiles);
+
+        /* A full rewrite orphans the buffer, so the driver hands out new
+           storage instead of waiting for draws still reading the old one */
+        if (count * sizeof(struct rltinst) == size)
+            rlgl.BufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, NULL,
+                GL_DYNAMIC_DRAW);
+
+        rlgl.BufferSubData(GL_ARRAY_BUFFER,
+            (GLintptr)(first * sizeof(struct rltinst)),
+            (GLsizeiptr)(count * sizeof(struct rltinst)), &this->tiles[first]);
+        bytes += count * sizeof(struct rltinst);
+    }
+
+    bytes += rlcache_sync(this->cache);
+
+    if (this->light.hues && !this->gl.light)
+    {
+        this->gl.light = rltmap_mktex(GL_RGBA8, this->width, this->height,
+            GL_NEAREST);
+        this->light.dirty0 = 0;
+        this->light.dirty1 = this->height - 1;
+    }
+
+    /* Only whole rows between the first and last dirty row are uploaded, as
+       they are contiguous in the light hue array */
+    if (this->light.hues && this->light.dirty0 >= 0)
+    {
+        rlgl.BindTexture(GL_TEXTURE_2D, this->gl.light);
+        rlgl.TexSubImage2D(GL_TEXTURE_2D, 0, 0, this->light.dirty0,
+            this->width, this->light.dirty1 - this->light.dirty0 + 1,
+            GL_RGBA, GL_UNSIGNED_BYTE,
+            &this->light.hues[this->light.dirty0 * this->width]);
+        bytes += (size_t)(this->width * (this->light.dirty1
+            - this->light.dirty0 + 1)) * sizeof(rlhue);
+
+        this->light.dirty0 = -1;
+        this->light.dirty1 = -1;
+    }
+
+    if (this->palet.hues && !this->gl.palet)
+    {
+        this->gl.palet = rltmap_mktex(GL_RGBA8, RL_PALET_SIZE, 1, GL_NEAREST);
+        this->palet.dirty = true;
+    }
+
+    if (this->palet.hues && this->palet.dirty)
+    {
+        rlgl.BindTexture(GL_TEXTURE_2D, this->gl.palet);
+        rlgl.TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, RL_PALET_SIZE, 1, GL_RGBA,
+            GL_UNSIGNED_BYTE, this->palet.hues);
+        bytes += RL_PALET_SIZE * sizeof(rlhue);
+
+        this->palet.dirty = false;
+    }
+
+    return bytes;
+}
+
+/* The transform of SFML: translated by the position, scaled and then rotated
+   about the origin, in column major order */
+static void
+rltmap_xform(rltmap *this, float *m)
+{
+    float c = cosf(this->rot * 3.14159265f / 180.0f);
+    float s = sinf(this->rot * 3.14159265f / 180.0f);
+
+    m[0] = this->scale * c;
+    m[1] = this->scale * s;
+    m[2] = 0.0f;
+    m[3] = -this->scale * s;
+    m[4] = this->scale * c;
+    m[5] = 0.0f;
+    m[6] = (float)this->x + this->scale * ((float)this->origx * (1.0f - c)
+        + (float)this->origy * s);
+    m[7] = (float)this->y + this->scale * ((float)this->origy * (1.0f - c)
+        - (float)this->origx * s);
+    m[8] = 1.0f;
+}
+
+/* The background of tile i as it is drawn, after the palette and the light,
+   rounded the way the shader's output is */
+static rlhue
+rltmap_bghue(rltmap *this, int i)
+{
+    rlhue bg = this->tiles[i].bg, l;
+
+    if (this->palet.hues)
+        bg = this->palet.hues[bg.r];
+
+    if (!this->light.hues)
+        return bg;
+
+    l = this->light.hues[i];
+
+    return (rlhue){
+        (uint8_t)((2 * bg.r * l.r + 255) / 510),
+        (uint8_t)((2 * bg.g * l.g + 255) / 510),
+        (uint8_t)((2 * bg.b * l.b + 255) / 510),
+        (uint8_t)((2 * bg.a * l.a + 255) / 510)
+    };
+}
+
+/* Whether the background of tile i covers its cell entirely, as it is drawn
+   after the palette and the light */
+static bool
+rltmap_opaque(rltmap *this, int i)
+{
+    return rltmap_bghue(this, i).a == 255;
+}
+
+/* Writes the bounds of what tile i draws, its cell and its glyph, in pixels
+   of the rltmap as left, top, right and bottom */
+static void
+rltmap_bounds(rltmap *this, int i, float *box)
+{
+    const struct rltinst *t = &this->tiles[i];
+    float l, u, w = (float)(t->rect[2] & 255), h = (float)(t->rect[2] >> 8);
+
+    box[0] = (float)(i % this->width * this->offx);
+    box[1] = (float)(i / this->width * this->offy);
+    box[2] = box[0] + (float)this->offx;
+    box[3] = box[1] + (float)this->offy;
+
+    if (!w || !h)
+        return;
+
+    l = box[0] + (float)t->shift[0] / RL_SHIFT_SUB;
+    u = box[1] + (float)t->shift[1] / RL_SHIFT_SUB;
+
+    box[0] = (l < box[0]) ? l : box[0];
+    box[1] = (u < box[1]) ? u : box[1];
+    l += w * this->sdf.texel;
+    u += h * this->sdf.texel;
+    box[2] = (l > box[2]) ? l : box[2];
+    box[3] = (u > box[3]) ? u : box[3];
+}
+
+/* Writes the bounds of what all of the tiles draw, as rltmap_bounds */
+static void
+rltmap_extent(rltmap *this, float *box)
+{
+    float b[4];
+
+    box[0] = box[1] = 0.0f;
+    box[2] = (float)(this->width * this->offx);
+    box[3] = (float)(this->height * this->offy);
+
+    for (int i = 0; i < this->width * this->height; ++i)
+    {
+        rltmap_bounds(this, i, b);
+        box[0] = (b[0] < box[0]) ? b[0] : box[0];
+        box[1] = (b[1] < box[1]) ? b[1] : box[1];
+        box[2] = (b[2] > box[2]) ? b[2] : box[2];
+        box[3] = (b[3] > box[3]) ? b[3] : box[3];
+    }
+}
+
+static const struct rlshader *
+rltmap_shader(rltmap *this, bool glyph, bool cull)
+{
+    int flags = 0;
+    const struct rlshader *shader = NULL;
+
+    if (!this)
+        return NULL;
+
+    if (this->light.hues)
+        flags |= RL_SHADER_LIGHT;
+
+    if (this->palet.hues)
+        flags |= RL_SHADER_PALET;
+
+    if (glyph)
+        flags |= RL_SHADER_GLYPH;
+
+    if (glyph && this->sdf.on)
+        flags |= RL_SHADER_SDF;
+
+    if (cull)
+        flags |= RL_SHADER_CULL;
+
+    if (!(shader = rlshader_get(flags)))
+        return NULL;
+
+    rlgl.UseProgram(shader->prog);
+
+    if (flags & RL_SHADER_GLYPH)
+    {
+        rlgl.ActiveTexture(GL_TEXTURE0);
+        rlgl.BindTexture(GL_TEXTURE_2D_ARRAY, this->cache->gl.atlas);
+    }
+
+    if (flags & RL_SHADER_LIGHT)
+    {
+        rlgl.ActiveTexture(GL_TEXTURE1);
+        rlgl.BindTexture(GL_TEXTURE_2D, this->gl.light);
+    }
+
+    if (flags & RL_SHADER_PALET)
+    {
+        rlgl.ActiveTexture(GL_TEXTURE2);
+        rlgl.BindTexture(GL_TEXTURE_2D, this->gl.palet);
+    }
+
+    if (flags & RL_SHADER_CULL)
+    {
+        rlgl.ActiveTexture(GL_TEXTURE3);
+        rlgl.BindTexture(GL_TEXTURE_2D, this->gl.cull);
+    }
+
+    rlgl.ActiveTexture(GL_TEXTURE0);
+
+    return shader;
+}
+
+static int
+rltmap_index(rltmap *this, int x, int y)
+{
+    if (RL_INVALID(!this))
+        return 0;
+
+    return (y * this->width) + x;
+}
+
+static void
+rltmap_dirty(rltmap *this, int x, int y)
+{
+    if (x < this->dirty.x0)
+        this->dirty.x0 = x;
+    if (x > this->dirty.x1)
+        this->dirty.x1 = x;
+    if (y < this->dirty.y0)
+        this->dirty.y0 = y;
+    if (y > this->dirty.y1)
+        this->dirty.y1 = y;
+}
+
+static void
+rltmap_clean(rltmap *this)
+{
+    this->dirty.x0 = this->width;
+    this->dirty.y0 = this->height;
+    this->dirty.x1 = -1;
+    this->dirty.y1 = -1;
+}
+
+/* Draws an rltmap an rldisp holds back before it is written to, as the draw
+   shows the tiles as they were when it was made */
+static void
+rltmap_flush(rltmap *this)
+{
+    if (this->queued)
+        rldisp_flush(this->queued);
+}
+
+static rltmap *
+rltmap_new(int csize, int cnum, int width, int height, int offx, int offy)
+{
+    rltmap *this = NULL;
+    struct rlcache *cache = NULL;
+
+    if (!(this = rlcalloc(1, sizeof(rltmap))))
+        return NULL;
+
+    rltcount += 1;
+    this->id = rltnext++;
+
+    if (!(this->tiles = rlcalloc((size_t)(width * height),
+        sizeof(struct rltinst))))
+        goto error;
+
+    this->x = 0;
+    this->y = 0;
+    this->origx = 0;
+    this->origy = 0;
+    this->rot = 0.0f;
+    this->offx = offx;
+    this->offy = offy;
+    this->cnum = cnum;
+    this->scale = 1.0f;
+    this->csize = csize;
+    this->width = width;
+    this->height = height;
+    this->sdf.texel = 1.0f;
+    this->light.dirty0 = -1;
+    this->light.dirty1 = -1;
+
+    if (!(cache = rlcache_get(NULL, csize, cnum, RL_ATLAS_SIZE,
+        RL_ATLAS_PAGES, RL_ATLAS_PAD)))
+        goto error;
+
+    rltmap_use(this, cache);
+    rltmap_clean(this);
+
+    return this;
+
+error:
+
+    rltmap_free(this);
+    return NULL;
+}
+
+rltmap *
+rltmap_init(const char *font, int csize, int cnum, int width, int height,
+    int offx, int offy)
+{
+    rltmap *this = NULL;
+
+    if (!(this = rltmap_new(csize, cnum, width, height, offx, offy)))
+        return NULL;
+
+    /* Initialize FreeType for the first rltmap with a font */
+    if (!rlftlib)
+    {
+        if (FT_New_Library(&rlftmem, &rlftlib))
+            goto error;
+
+        FT_Add_Default_Modules(rlftlib);
+    }
+
+    if (FT_New_Face(rlftlib, font, 0, &this->font))
+        goto error;
+
+    if (FT_Set_Pixel_Sizes(this->font, 0, (FT_UInt)csize))
+        goto error;
+
+    /* Kept to find the glyph cache shared in SDF mode */
+    if (!(this->path = rlstrdup(font)))
+        goto error;
+
+    return this;
+
+error:
+
+    rltmap_free(this);
+    return NULL;
+}
+
+rltmap *
+rltmap_async(const char *font, int csize, int cnum, int width, int height,
+    int offx, int offy)
+{
+    rltmap *this = NULL;
+
+    if (!font || !(this = rltmap_new(csize, cnum, width, height, offx,
+        offy)))
+        return NULL;
+
+    if (!(this->load.path = rlstrdup(font)))
+        goto error;
+
+    /* rlalloc_set(1) refuses to change the hooks while this rltmap is
+       alive, so the copy is the same as rlahooks when the blocks of the
+       loading thread are handed over */
+    this->load.hooks = rlahooks;
+    this->load.mem = (struct FT_MemoryRec_){this, rlft_lalloc, rlft_lfree,
+        rlft_lrealloc};
+
+    if (pthread_mutex_init(&this->load.lock, NULL))
+        goto error;
+
+    if (pthread_create(&this->load.thread, NULL, rltmap_work, this))
+    {
+        pthread_mutex_destroy(&this->load.lock);
+        goto error;
+    }
+
+    this->load.pending = true;
+
+    return this;
+
+error:
+
+    rltmap_free(this);
+    return NULL;
+}
+
+bool
+rltmap_ready(rltmap *this, bool wait)
+{
+    bool done = false;
+
+    if (!this)
+        return false;
+
+    if (this->load.pending && !wait)
+    {
+        pthread_mutex_lock(&this->load.lock);
+        done = this->load.done;
+        pthread_mutex_unlock(&this->load.lock);
+
+        if (!done)
+            return false;
+    }
+
+    if (this->load.pending)
+        rltmap_adopt(this);
+
+    return !this->load.failed;
+}
+
+rltmap *
+rltmap_sheet(const char *sheet, int cwidth, int cheight, const wchar_t *map,
+    int count, int width, int height, int offx, int offy)
+{
+    int cols, cells, size, index, cnum = 0;
+    bool opaque = true;
+    uint8_t *p = NULL;
+    png_image png;
+    rltmap *this = NULL;
+    struct rlpage *page = NULL;
+    struct rlcache *cache = NULL;
+    struct rltglyph *entry = NULL;
+
+    if (cwidth <= 0 || cheight <= 0 || cwidth > RL_GLYPH_MAXIMUM
+        || cheight > RL_GLYPH_MAXIMUM || (map && count <= 0))
+        return NULL;
+
+    if (!map)
+    {
+        map = rlcp437;
+        count = 256;
+    }
+
+    for (int i = 0; i < count; ++i)
+        cnum = (int)map[i] > cnum ? (int)map[i] : cnum;
+
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_file(&png, sheet))
+        return NULL;
+
+    png.format = PNG_FORMAT_RGBA;
+    size = (int)(png.width > png.height ? png.width : png.height);
+    cols = (int)png.width / cwidth;
+    cells = cols * ((int)png.height / cheight);
+
+    if (!cells || size > RL_ATLAS_MAXSIZE || !(this = rltmap_new(cheight,
+        cnum, width, height, offx, offy)))
+    {
+        png_image_free(&png);
+        goto error;
+    }
+
+    /* The sheet is the only page of a square atlas, read into its top left
+       corner. Nothing is ever packed into it. */
+    cache = this->cache;
+    cache->atlas.size = size;
+    cache->atlas.bpp = 4;
+    cache->atlas.pad = 0;
+    cache->atlas.limit = 1;
+    page = &cache->atlas.pages[0];
+
+    if (!(page->pixels = rlcalloc((size_t)size * (size_t)size, 4)))
+    {
+        png_image_free(&png);
+        goto error;
+    }
+
+    cache->atlas.count = 1;
+    rlabytes += (size_t)size * (size_t)size * 4;
+
+    if (!png_image_finish_read(&png, NULL, page->pixels, size * 4, NULL))
+        goto error;
+
+    page->dirty.x0 = 0;
+    page->dirty.y0 = 0;
+    page->dirty.x1 = (int)png.width - 1;
+    page->dirty.y1 = (int)png.height - 1;
+
+    for (int j = 0; opaque && j < (int)png.height; ++j)
+    for (int i = 0; opaque && i < (int)png.width; ++i)
+        opaque = page->pixels[(j * size + i) * 4 + 3] == 255;
+
+    /* A sheet without transparency is a mask of white glyphs on black */
+    for (int j = 0; opaque && j < (int)png.height; ++j)
+    for (int i = 0; i < (int)png.width; ++i)
+    {
+        p = &page->pixels[(j * size + i) * 4];
+        p[3] = p[0] > p[1] ? p[0] : p[1];
+        p[3] = p[3] > p[2] ? p[3] : p[2];
+        p[0] = p[1] = p[2] = 255;
+    }
+
+    for (int i = 0; i < count && i < cells; ++i)
+    {
+        if (map[i] < 0)
+            continue;
+
+        index = (int)map[i] / RL_GLYPH_PAGE;
+
+        if (!cache->glyph.list[index] && !(cache->glyph.list[index]
+            = rlcalloc(RL_GLYPH_PAGE, sizeof(struct rltglyph))))
+            goto error;
+
+        entry = &cache->glyph.list[index][(int)map[i] % RL_GLYPH_PAGE];
+        entry->ok = true;
+        entry->page = 0;
+        entry->left = 0.0f;
+        entry->top = (float)-cheight;
+        entry->rect = (struct rlrect){i % cols * cwidth, i / cols * cheight,
+            cwidth, cheight};
+    }
+
+    return this;
+
+error:
+
+    rltmap_free(this);
+    return NULL;
+}
+
+void
+rltmap_dpos(rltmap *this, int x, int y)
+{
+    if (!this)
+        return;
+
+    this->x = x;
+    this->y = y;
+}
+
+extern void
+rltmap_move(rltmap *this, int dx, int dy)
+{
+    if (!this)
+        return;
+
+    this->x += dx;
+    this->y += dy;
+}
+
+extern void
+rltmap_scale(rltmap *this, float scale)
+{
+    if (!this)
+        return;
+
+    this->scale = scale;
+}
+
+extern void
+rltmap_orign(rltmap *this, int origx, int origy)
+{
+    if (!this)
+        return;
+
+    this->origx = origx;
+    this->origy = origy;
+}
+
+extern void
+rltmap_angle(rltmap *this, float rot)
+{
+    if (!this)
+        return;
+
+    this->rot = rot;
+}
+
+void
+rltmap_ptile(rltmap *this, rltile *tile, int x, int y)
+{
+    if (RL_INVALID(!this || !tile || tile->glyph > this->cnum))
+        return;
+
+    rltmap_flush(this);
+    rltmap_updtile(this, tile, x, y);
+}
+
+extern void
+rltmap_pcell(rltmap *this, rlcell cell, int x, int y)
+{
+    if (RL_INVALID(!this || cell.glyph > this->cnum))
+        return;
+
+    rltmap_flush(this);
+    rltmap_updcell(this, &cell, x, y);
+}
+
+extern void
+rltmap_pcells(rltmap *this, const rlcell *cells, int x, int y, int width,
+    int height)
+{
+    int xi, yi;
+    const rlcell *c = NULL;
+    RL_TRACE_BEGIN(t0);
+
+    if (!this || !cells)
+        return;
+
+    rltmap_flush(this);
+
+    for (int j = 0; j < height; ++j)
+    for (int i = 0; i < width; ++i)
+    {
+        xi = x + i;
+        yi = y + j;
+        c = &cells[j * width + i];
+
+        if (xi >= 0 && xi < this->width && yi >= 0 && yi < this->height
+            && c->glyph <= this->cnum)
+            rltmap_updcell(this, c, xi, yi);
+    }
+
+    RL_TRACE_END("rltmap_pcells", t0, width * height);
+}
+
+extern int
+rltmap_proto(rltmap *this, rlcell cell)
+{
+    float r, b;
+    const struct rltglyph *g = NULL;
+    struct rltinst *p = NULL;
+
+    if (!this || cell.glyph > this->cnum
+        || this->proto.count >= RL_PROTO_MAXIMUM)
+        return -1;
+
+    if (this->proto.count == this->proto.capacity)
+    {
+        if (!(p = rlrealloc(this->proto.list, (size_t)(this->proto.capacity
+            ? this->proto.capacity * 2 : 64) * sizeof(struct rltinst))))
+            return -1;
+
+        this->proto.list = p;
+        this->proto.capacity = this->proto.capacity
+            ? this->proto.capacity * 2 : 64;
+    }
+
+    rltmap_shift(this, cell.glyph, cell.type, cell.right, cell.bottom, &r, &b,
+        &g);
+
+    /* A prototype is the instance record of its tile, copied as is */
+    rltinst_set(&this->proto.list[this->proto.count], g, r, b,
+        cell.fghue, cell.bghue);
+
+    return this->proto.count++;
+}
+
+extern void
+rltmap_pid(rltmap *this, uint16_t id, int x, int y)
+{
+    if (RL_INVALID(!this || x < 0 || x >= this->width || y < 0
+        || y >= this->height))
+        return;
+
+    /* Skipped like in rltmap_pgrid, it indexes the prototype list */
+    if (id >= this->proto.count)
+        return;
+
+    rltmap_flush(this);
+
+    this->tiles[rltmap_index(this, x, y)] = this->proto.list[id];
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
+}
+
+extern void
+rltmap_pgrid(rltmap *this, const uint16_t *ids, int x, int y, int width,
+    int height)
+{
+    int x0, x1, y0, y1;
+    const uint16_t *row = NULL;
+    struct rltinst *dst = NULL;
+    RL_TRACE_BEGIN(t0);
+
+    if (!this || !ids)
+        return;
+
+    rltmap_flush(this);
+
+    /* Clip the region to the rltmap once instead of per tile */
+    x0 = (x < 0) ? -x : 0;
+    y0 = (y < 0) ? -y : 0;
+    x1 = (x + width > this->width) ? this->width - x : width;
+    y1 = (y + height > this->height) ? this->height - y : height;
+
+    for (int j = y0; j < y1; ++j)
+    {
+        row = &ids[j * width];
+        dst = &this->tiles[rltmap_index(this, x, y + j)];
+
+        for (int i = x0; i < x1; ++i)
+        {
+            if (row[i] >= this->proto.count)
+                continue;
+
+            dst[i] = this->proto.list[row[i]];
+            rltmap_dirty(this, x + i, y + j);
+            this->stats.tiles += 1;
+        }
+    }
+
+    RL_TRACE_END("rltmap_pgrid", t0, width * height);
+}
+
+extern void
+rltmap_phuef(rltmap *this, rlhue hue, int x, int y)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    rltmap_flush(this);
+
+    this->tiles[rltmap_index(this, x, y)].fg = hue;
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
+}
+
+extern void
+rltmap_phueb(rltmap *this, rlhue hue, int x, int y)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    rltmap_flush(this);
+
+    this->tiles[rltmap_index(this, x, y)].bg = hue;
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
+}
+
+extern void
+rltmap_vhuef(rltmap *this, const rlhue *hues, int x, int y, int width,
+    int height)
+{
+    if (!this || !hues)
+        return;
+
+    rltmap_flush(this);
+    rltmap_updhue(this, true, hues, x, y, width, height);
+}
+
+extern void
+rltmap_vhueb(rltmap *this, const rlhue *hues, int x, int y, int width,
+    int height)
+{
+    if (!this || !hues)
+        return;
+
+    rltmap_flush(this);
+    rltmap_updhue(this, false, hues, x, y, width, height);
+}
+
+extern void
+rltmap_wstrr(rltmap *this, wchar_t *wstr, rlhue fg, rlhue bg, rlttype type,
+    int x, int y)
+{
+    int xi, yi, len;
+    rlcell cell = {L'\0', fg, bg, 0.0f, 0.0f, type};
+
+    if (!this || !wstr)
+        return;
+
+    rltmap_flush(this);
+
+    len = (int)wcslen(wstr);
+
+    for (int i = 0; i < len; ++i)
+    {
+        xi = (x + i) % this->width;
+        yi = y + ((x + i) / this->width);
+
+        if (xi >= 0 && xi < this->width && yi >= 0 && yi < this->height)
+        {
+            cell.glyph = wstr[i];
+            rltmap_updcell(this, &cell, xi, yi);
+        }
+    }
+}
+
+extern void
+rltmap_wstrb(rltmap *this, wchar_t *wstr, rlhue fg, rlhue bg, rlttype type,
+    int x, int y)
+{
+    int xi, yi, len;
+    rlcell cell = {L'\0', fg, bg, 0.0f, 0.0f, type};
+
+    if (!this || !wstr)
+        return;
+
+    rltmap_flush(this);
+
+    len = (int)wcslen(wstr);
+
+    for (int i = 0; i < len; ++i)
+    {
+        xi = x + ((y + i) / this->height);
+        yi = (y + i) % this->height;
+
+        if (xi >= 0 && xi < this->width && yi >= 0 && yi < this->height)
+        {
+            cell.glyph = wstr[i];
+            rltmap_updcell(this, &cell, xi, yi);
+        }
+    }
+}
+
+void
+rltmap_free(rltmap *this)
+{
+    if (!this)
+        return;
+
+    if (this->load.pending)
+        rltmap_adopt(this);
+
+    /* An rltmap held back for occlusion culling is drawn while it lasts */
+    if (this->queued)
+        rldisp_flush(this->queued);
+
+    rltmap_light(this, false);
+    rltmap_palet(this, false);
+    rltmap_use(this, NULL);
+    rltmap_deltex(this, &this->gl.cull);
+
+    if (this->gl.tiles && this->gl.gen == rlgen && rlgl_ctx())
+        rlgl.DeleteBuffers(1, &this->gl.tiles);
+
+    if (this->font)
+        FT_Done_Face(this->font);
+
+    if (this->load.lib)
+        FT_Done_Library(this->load.lib);
+
+    rlfree(this->load.path);
+    rlfree(this->path);
+    rlfree(this->tiles);
+    rlfree(this->proto.list);
+
+    rltcount -= 1;
+
+    /* If this is the last rltmap, free FreeType */
+    if (rltcount == 0 && rlftlib)
+    {
+        FT_Done_Library(rlftlib);
+        rlftlib = NULL;
+    }
+
+    if (this)
+        rlfree(this);
+}
+
+extern bool
+rltmap_cmpct(rltmap *this, bool enabled)
+{
+    UNUSED(enabled);
+
+    /* Tiles are always stored as 20 byte instance records */
+    return this != NULL;
+}
+
+extern bool
+rltmap_atlas(rltmap *this, int size, int pages, int pad)
+{
+    struct rlcache *cache = NULL;
+
+    if (this && this->load.pending)
+        rltmap_adopt(this);
+
+    /* The atlas of a tilesheet is the sheet itself */
+    if (!this || !this->font || size < RL_ATLAS_MINSIZE
+        || size > RL_ATLAS_MAXSIZE || pages < 1 || pages > RL_ATLAS_MAXPAGES
+        || pad < 0 || pad > RL_ATLAS_MAXPAD)
+        return false;
+
+    /* An SDF rltmap moves to the shared cache with that layout */
+    if (!(cache = rlcache_get(this->sdf.on ? this->path : NULL,
+        this->cache->rsize, this->cnum, size, pages, pad)))
+        return false;
+
+    rltmap_use(this, cache);
+
+    return true;
+}
+
+extern bool
+rltmap_sdf(rltmap *this, bool enabled)
+{
+    int size;
+    FT_Int spread = RL_SDF_SPREAD;
+    FT_Library lib = NULL;
+    struct rlcache *cache = NULL;
+
+    if (this && this->load.pending)
+        rltmap_adopt(this);
+
+    /* Tilesheets are drawn as they are */
+    if (!this || !this->font)
+        return false;
+
+    if (enabled == this->sdf.on)
+        return true;
+
+#ifndef RL_SDF_SUPPORTED
+    if (enabled)
+        return false;
+#endif
+
+    rltmap_flush(this);
+
+    size = (enabled && this->csize < RL_SDF_SIZE) ? RL_SDF_SIZE
+        : this->csize;
+
+    if (FT_Set_Pixel_Sizes(this->font, 0, (FT_UInt)size))
+        return false;
+
+    /* Distance fields are shared by the SDF rltmaps of the font, coverage
+       glyphs are rasterized into a cache of the rltmap's own */
+    if (!(cache = rlcache_get(enabled ? this->path : NULL, size, this->cnum,
+        this->cache->atlas.size, this->cache->atlas.limit,
+        this->cache->atlas.pad)))
+    {
+        FT_Set_Pixel_Sizes(this->font, 0, (FT_UInt)this->cache->rsize);
+        return false;
+    }
+
+    /* Set every time, as FreeType is shared by all the rltmaps but those
+       of rltmap_async(7) */
+    lib = this->load.lib ? this->load.lib : rlftlib;
+    FT_Property_Set(lib, "sdf", "spread", &spread);
+    FT_Property_Set(lib, "bsdf", "spread", &spread);
+
+    this->sdf.on = enabled;
+    this->sdf.texel = (float)this->csize / (float)size;
+    this->sdf.border = enabled ? (float)RL_SDF_SPREAD * this->sdf.texel
+        : 0.0f;
+
+    rltmap_use(this, cache);
+
+    return true;
+}
+
+extern bool
+rltmap_light(rltmap *this, bool enabled)
+{
+    rlhue white = {255, 255, 255, 255};
+
+    if (!this)
+        return false;
+
+    rltmap_flush(this);
+
+    if (!enabled)
+    {
+        rltmap_deltex(this, &this->gl.light);
+        rlfree(this->light.hues);
+
+        this->light.hues = NULL;
+        return true;
+    }
+
+    if (this->light.hues)
+        return true;
+
+    if (!(this->light.hues = rlmalloc((size_t)(this->width * this->height)
+        * sizeof(rlhue))))
+        return false;
+
+    for (int i = 0; i < this->width * this->height; ++i)
+        this->light.hues[i] = white;
+
+    this->light.dirty0 = 0;
+    this->light.dirty1 = this->height - 1;
+
+    return true;
+}
+
+extern bool
+rltmap_palet(rltmap *this, bool enabled)
+{
+    if (!this)
+        return false;
+
+    rltmap_flush(this);
+
+    if (!enabled)
+    {
+        rltmap_deltex(this, &this->gl.palet);
+        rlfree(this->palet.hues);
+
+        this->palet.hues = NULL;
+        return true;
+    }
+
+    if (this->palet.hues)
+        return true;
+
+    if (!(this->palet.hues = rlmalloc(RL_PALET_SIZE * sizeof(rlhue))))
+        return false;
+
+    for (int i = 0; i < RL_PALET_SIZE; ++i)
+        rlhue_set(&this->palet.hues[i], (uint8_t)i, (uint8_t)i, (uint8_t)i,
+            255);
+
+    this->palet.dirty = true;
+
+    return true;
+}
+
+extern void
+rltmap_ppal(rltmap *this, uint8_t index, rlhue hue)
+{
+    rltmap_vpal(this, &hue, index, 1);
+}
+
+extern void
+rltmap_vpal(rltmap *this, const rlhue *hues, int first, int count)
+{
+    if (!this || !this->palet.hues || !hues || first < 0)
+        return;
+
+    rltmap_flush(this);
+
+    for (int i = 0; i < count && first + i < RL_PALET_SIZE; ++i)
+        this->palet.hues[first + i] = hues[i];
+
+    this->palet.dirty = true;
+}
+
+extern void
+rltmap_pindx(rltmap *this, uint8_t fg, uint8_t bg, int x, int y)
+{
+    if (RL_INVALID(!this || x < 0 || x >= this->width || y < 0
+        || y >= this->height))
+        return;
+
+    rltmap_phuef(this, (rlhue){fg, 0, 0, 255}, x, y);
+    rltmap_phueb(this, (rlhue){bg, 0, 0, 255}, x, y);
+}
+
+extern void
+rltmap_plight(rltmap *this, rlhue hue, int x, int y)
+{
+    rltmap_vlight(this, &hue, x, y, 1, 1);
+}
+
+extern void
+rltmap_vlight(rltmap *this, const rlhue *hues, int x, int y, int width,
+    int height)
+{
+    int xi, yi;
+
+    if (RL_INVALID(!this || !hues))
+        return;
+
+    /* Not an argument check, maps without a light map ignore writes */
+    if (!this->light.hues)
+        return;
+
+    rltmap_flush(this);
+
+    for (int j = 0; j < height; ++j)
+    {
+        yi = y + j;
+
+        if (yi < 0 || yi >= this->height)
+            continue;
+
+        for (int i = 0; i < width; ++i)
+        {
+            xi = x + i;
+
+            if (xi >= 0 && xi < this->width)
+                this->light.hues[rltmap_index(this, xi, yi)]
+                    = hues[j * width + i];
+        }
+
+        if (this->light.dirty0 < 0 || yi < this->light.dirty0)
+            this->light.dirty0 = yi;
+
+        if (yi > this->light.dirty1)
+            this->light.dirty1 = yi;
+    }
+}
+
+int
+rltmap_mousx(rltmap *this, rldisp *disp)
+{
+    int x;
+
+    if (!this || !disp || !disp->window.handle)
+        return 0;
+
+    x = rldisp_mousx(disp);
+
+    if (x != -1)
+    {
+        x -= this->x;
+        x /= this->offx;
+    }
+
+    return x;
+}
+
+int
+rltmap_mousy(rltmap *this, rldisp *disp)
+{
+    int y;
+
+    if (!this || !disp || !disp->window.handle)
+        return 0;
+
+    y = rldisp_mousy(disp);
+
+    if (y != -1)
+    {
+        y -= this->y;
+        y /= this->offy;
+    }
+
+    return y;
+}
+
+void
+rltmap_mouse(rltmap *this, rldisp *disp, int *x, int *y)
+{
+    if (!this || !disp || !disp->window.handle || !x || !y)
+        return;
+
+    rldisp_mouse(disp, x, y);
+
+    if (*x != -1)
+    {
+        *x -= this->x;
+        *x /= this->offx;
+    }
+    if (*y != -1)
+    {
+        *y -= this->y;
+        *y /= this->offy;
+    }
+}
+
+/******************************************************************************
+rlhue function implementations
+******************************************************************************/
+
+extern void
+rlhue_set(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    this->r = r;
+    this->g = g;
+    this->b = b;
+    this->a = a;
+}
+
+extern void
+rlhue_add(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    this->r = (uint8_t)(this->r + r);
+    this->g = (uint8_t)(this->g + g);
+    this->b = (uint8_t)(this->b + b);
+    this->a = (uint8_t)(this->a + a);
+}
+
+extern void
+rlhue_sub(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    this->r = (uint8_t)(this->r - r);
+    this->g = (uint8_t)(this->g - g);
+    this->b = (uint8_t)(this->b - b);
+    this->a = (uint8_t)(this->a - a);
+}
+
+/******************************************************************************
+rlalloc function implementations
+******************************************************************************/
+
+bool
+rlalloc_set(const rlalloc *alloc)
+{
+    /* Memory from one allocator must not be returned to another */
+    if (rlalive)
+        return false;
+
+    if (!alloc)
+    {
+        rlahooks = (rlalloc){rlalloc_dmalloc, rlalloc_drealloc, rlalloc_dfree,
+            NULL};
+        return true;
+    }
+
+    if (!alloc->alloc || !alloc->realloc || !alloc->free)
+        return false;
+
+    rlahooks = *alloc;
+    return true;
+}
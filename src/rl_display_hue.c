@@ -0,0 +1,849 @@
+/*
+Copyright (c) 2017 Jacob P Adkins
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Batch rlhue kernels. These are backend independent, so this file is shared
+ * by every rl_display implementation.
+ *
+ * Every kernel has a scalar version, which is also used for the tail of an
+ * array that does not fill a whole vector. The vector versions must produce
+ * exactly the same results as the scalar ones.
+ */
+
+#include "rl_display.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__SSE2__)
+#define RLHUE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define RLHUE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RLHUE_NEON
+#include <arm_neon.h>
+#endif
+
+/******************************************************************************
+Struct definitions
+******************************************************************************/
+
+struct rlhue_kern
+{
+    const char *name;
+    void (*add)(rlhue *hues, size_t count, rlhue hue);
+    void (*sub)(rlhue *hues, size_t count, rlhue hue);
+    void (*mul)(rlhue *hues, size_t count, rlhue hue);
+    void (*lerp)(rlhue *hues, const rlhue *to, size_t count, uint8_t t);
+    void (*over)(rlhue *hues, const rlhue *src, size_t count);
+    void (*gray)(rlhue *hues, size_t count, uint8_t amount);
+};
+
+/******************************************************************************
+Static function declarations
+******************************************************************************/
+
+/* misc */
+static uint8_t
+rlhue_div255(unsigned v);
+
+static uint32_t
+rlhue_pack(rlhue hue);
+
+static const struct rlhue_kern *
+rlhue_kern(void);
+
+/* scalar */
+static void
+rlhue_cadd(rlhue *hues, size_t count, rlhue hue);
+
+static void
+rlhue_csub(rlhue *hues, size_t count, rlhue hue);
+
+static void
+rlhue_cmul(rlhue *hues, size_t count, rlhue hue);
+
+static void
+rlhue_clerp(rlhue *hues, const rlhue *to, size_t count, uint8_t t);
+
+static void
+rlhue_cover(rlhue *hues, const rlhue *src, size_t count);
+
+static void
+rlhue_cgray(rlhue *hues, size_t count, uint8_t amount);
+
+/******************************************************************************
+Static global variables
+******************************************************************************/
+
+static const struct rlhue_kern rlhue_kscalar = {
+    "scalar", rlhue_cadd, rlhue_csub, rlhue_cmul, rlhue_clerp, rlhue_cover,
+    rlhue_cgray
+};
+
+static const struct rlhue_kern *rlhue_kcur = NULL;
+
+/******************************************************************************
+Misc static function implementations
+******************************************************************************/
+
+/* Rounded division by 255 for v <= 255 * 255 */
+static uint8_t
+rlhue_div255(unsigned v)
+{
+    v += 128;
+    return (uint8_t)((v + (v >> 8)) >> 8);
+}
+
+static uint32_t
+rlhue_pack(rlhue hue)
+{
+    uint32_t p;
+
+    memcpy(&p, &hue, sizeof(p));
+    return p;
+}
+
+/******************************************************************************
+Scalar kernels
+******************************************************************************/
+
+static void
+rlhue_cadd(rlhue *hues, size_t count, rlhue hue)
+{
+    unsigned v;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        v = (unsigned)hues[i].r + hue.r;
+        hues[i].r = (uint8_t)(v > 255 ? 255 : v);
+        v = (unsigned)hues[i].g + hue.g;
+        hues[i].g = (uint8_t)(v > 255 ? 255 : v);
+        v = (unsigned)hues[i].b + hue.b;
+        hues[i].b = (uint8_t)(v > 255 ? 255 : v);
+        v = (unsigned)hues[i].a + hue.a;
+        hues[i].a = (uint8_t)(v > 255 ? 255 : v);
+    }
+}
+
+static void
+rlhue_csub(rlhue *hues, size_t count, rlhue hue)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        hues[i].r = (uint8_t)(hues[i].r > hue.r ? hues[i].r - hue.r : 0);
+        hues[i].g = (uint8_t)(hues[i].g > hue.g ? hues[i].g - hue.g : 0);
+        hues[i].b = (uint8_t)(hues[i].b > hue.b ? hues[i].b - hue.b : 0);
+        hues[i].a = (uint8_t)(hues[i].a > hue.a ? hues[i].a - hue.a : 0);
+    }
+}
+
+static void
+rlhue_cmul(rlhue *hues, size_t count, rlhue hue)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        hues[i].r = rlhue_div255((unsigned)hues[i].r * hue.r);
+        hues[i].g = rlhue_div255((unsigned)hues[i].g * hue.g);
+        hues[i].b = rlhue_div255((unsigned)hues[i].b * hue.b);
+        hues[i].a = rlhue_div255((unsigned)hues[i].a * hue.a);
+    }
+}
+
+static void
+rlhue_clerp(rlhue *hues, const rlhue *to, size_t count, uint8_t t)
+{
+    unsigned s = 255u - t;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        hues[i].r = rlhue_div255(hues[i].r * s + to[i].r * (unsigned)t);
+        hues[i].g = rlhue_div255(hues[i].g * s + to[i].g * (unsigned)t);
+        hues[i].b = rlhue_div255(hues[i].b * s + to[i].b * (unsigned)t);
+        hues[i].a = rlhue_div255(hues[i].a * s + to[i].a * (unsigned)t);
+    }
+}
+
+static void
+rlhue_cover(rlhue *hues, const rlhue *src, size_t count)
+{
+    unsigned a, s;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        a = src[i].a;
+        s = 255u - a;
+
+        hues[i].r = rlhue_div255(src[i].r * a + hues[i].r * s);
+        hues[i].g = rlhue_div255(src[i].g * a + hues[i].g * s);
+        hues[i].b = rlhue_div255(src[i].b * a + hues[i].b * s);
+        hues[i].a = rlhue_div255(255u * a + hues[i].a * s);
+    }
+}
+
+static void
+rlhue_cgray(rlhue *hues, size_t count, uint8_t amount)
+{
+    unsigned y, s = 255u - amount;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        y = (77u * hues[i].r + 150u * hues[i].g + 29u * hues[i].b + 128u) >> 8;
+        y *= amount;
+
+        hues[i].r = rlhue_div255(hues[i].r * s + y);
+        hues[i].g = rlhue_div255(hues[i].g * s + y);
+        hues[i].b = rlhue_div255(hues[i].b * s + y);
+    }
+}
+
+/******************************************************************************
+SSE2 kernels
+******************************************************************************/
+
+#ifdef RLHUE_SSE2
+
+static __m128i
+rlhue_sdiv(__m128i v)
+{
+    v = _mm_add_epi16(v, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+}
+
+static void
+rlhue_sadd(rlhue *hues, size_t count, rlhue hue)
+{
+    size_t i = 0;
+    __m128i v, k = _mm_set1_epi32((int)rlhue_pack(hue));
+
+    for (; i + 4 <= count; i += 4)
+    {
+        v = _mm_loadu_si128((const __m128i *)(void *)&hues[i]);
+        _mm_storeu_si128((__m128i *)(void *)&hues[i], _mm_adds_epu8(v, k));
+    }
+
+    rlhue_cadd(hues + i, count - i, hue);
+}
+
+static void
+rlhue_ssub(rlhue *hues, size_t count, rlhue hue)
+{
+    size_t i = 0;
+    __m128i v, k = _mm_set1_epi32((int)rlhue_pack(hue));
+
+    for (; i + 4 <= count; i += 4)
+    {
+        v = _mm_loadu_si128((const __m128i *)(void *)&hues[i]);
+        _mm_storeu_si128((__m128i *)(void *)&hues[i], _mm_subs_epu8(v, k));
+    }
+
+    rlhue_csub(hues + i, count - i, hue);
+}
+
+static void
+rlhue_smul(rlhue *hues, size_t count, rlhue hue)
+{
+    size_t i = 0;
+    __m128i v, lo, hi, z = _mm_setzero_si128();
+    __m128i k = _mm_unpacklo_epi8(_mm_set1_epi32((int)rlhue_pack(hue)), z);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        v = _mm_loadu_si128((const __m128i *)(void *)&hues[i]);
+        lo = rlhue_sdiv(_mm_mullo_epi16(_mm_unpacklo_epi8(v, z), k));
+        hi = rlhue_sdiv(_mm_mullo_epi16(_mm_unpackhi_epi8(v, z), k));
+        _mm_storeu_si128((__m128i *)(void *)&hues[i],
+            _mm_packus_epi16(lo, hi));
+    }
+
+    rlhue_cmul(hues + i, count - i, hue);
+}
+
+static void
+rlhue_slerp(rlhue *hues, const rlhue *to, size_t count, uint8_t t)
+{
+    size_t i = 0;
+    __m128i a, b, lo, hi, z = _mm_setzero_si128();
+    __m128i w0 = _mm_set1_epi16((short)(255 - t));
+    __m128i w1 = _mm_set1_epi16((short)t);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        a = _mm_loadu_si128((const __m128i *)(const void *)&hues[i]);
+        b = _mm_loadu_si128((const __m128i *)(const void *)&to[i]);
+
+        lo = rlhue_sdiv(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpacklo_epi8(a, z), w0),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(b, z), w1)));
+        hi = rlhue_sdiv(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(a, z), w0),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(b, z), w1)));
+
+        _mm_storeu_si128((__m128i *)(void *)&hues[i],
+            _mm_packus_epi16(lo, hi));
+    }
+
+    rlhue_clerp(hues + i, to + i, count - i, t);
+}
+
+static void
+rlhue_sover(rlhue *hues, const rlhue *src, size_t count)
+{
+    size_t i = 0;
+    __m128i s, d, sa, lo, hi, z = _mm_setzero_si128();
+    __m128i full = _mm_set1_epi16(255);
+    __m128i amask = _mm_set1_epi32((int)0xff000000u);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        d = _mm_loadu_si128((const __m128i *)(const void *)&hues[i]);
+        s = _mm_loadu_si128((const __m128i *)(const void *)&src[i]);
+
+        /* The source alpha is broadcast across its pixel, and the source
+           alpha channel itself is replaced with 255 so the output alpha
+           becomes sa + da * (255 - sa) / 255 */
+        sa = _mm_unpacklo_epi8(s, z);
+        sa = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sa, 0xff), 0xff);
+        lo = rlhue_sdiv(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_or_si128(s, amask), z), sa),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(d, z), _mm_sub_epi16(full, sa))));
+
+        sa = _mm_unpackhi_epi8(s, z);
+        sa = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sa, 0xff), 0xff);
+        hi = rlhue_sdiv(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(_mm_or_si128(s, amask), z), sa),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(d, z), _mm_sub_epi16(full, sa))));
+
+        _mm_storeu_si128((__m128i *)(void *)&hues[i],
+            _mm_packus_epi16(lo, hi));
+    }
+
+    rlhue_cover(hues + i, src + i, count - i);
+}
+
+/* Grays two unpacked pixels, leaving their alpha untouched */
+static __m128i
+rlhue_sgray2(__m128i v, __m128i w0, __m128i w1)
+{
+    __m128i y;
+    __m128i amask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+
+    y = _mm_madd_epi16(v, _mm_set_epi16(0, 29, 150, 77, 0, 29, 150, 77));
+    y = _mm_add_epi32(y, _mm_shuffle_epi32(y, 0xb1));
+    y = _mm_srli_epi32(_mm_add_epi32(y, _mm_set1_epi32(128)), 8);
+    y = _mm_or_si128(y, _mm_slli_epi32(y, 16));
+
+    y = rlhue_sdiv(_mm_add_epi16(_mm_mullo_epi16(v, w0),
+        _mm_mullo_epi16(y, w1)));
+
+    return _mm_or_si128(_mm_andnot_si128(amask, y), _mm_and_si128(amask, v));
+}
+
+static void
+rlhue_sgray(rlhue *hues, size_t count, uint8_t amount)
+{
+    size_t i = 0;
+    __m128i v, lo, hi, z = _mm_setzero_si128();
+    __m128i w0 = _mm_set1_epi16((short)(255 - amount));
+    __m128i w1 = _mm_set1_epi16((short)amount);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        v = _mm_loadu_si128((const __m128i *)(void *)&hues[i]);
+        lo = rlhue_sgray2(_mm_unpacklo_epi8(v, z), w0, w1);
+        hi = rlhue_sgray2(_mm_unpackhi_epi8(v, z), w0, w1);
+        _mm_storeu_si128((__m128i *)(void *)&hues[i],
+            _mm_packus_epi16(lo, hi));
+    }
+
+    rlhue_cgray(hues + i, count - i, amount);
+}
+
+static const struct rlhue_kern rlhue_ksse2 = {
+    "sse2", rlhue_sadd, rlhue_ssub, rlhue_smul, rlhue_slerp, rlhue_sover,
+    rlhue_sgray
+};
+
+#endif /* RLHUE_SSE2 */
+
+/******************************************************************************
+AVX2 kernels
+******************************************************************************/
+
+#ifdef RLHUE_AVX2
+
+#define RLHUE_TAVX2 __attribute__((target("avx2")))
+
+RLHUE_TAVX2 static __m256i
+rlhue_vdiv(__m256i v)
+{
+    v = _mm256_add_epi16(v, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)), 8);
+}
+
+RLHUE_TAVX2 static void
+rlhue_vadd8(rlhue *hues, size_t count, rlhue hue)
+{
+    size_t i = 0;
+    __m256i v, k = _mm256_set1_epi32((int)rlhue_pack(hue));
+
+    for (; i + 8 <= count; i += 8)
+    {
+        v = _mm256_loadu_si256((const __m256i *)(void *)&hues[i]);
+        _mm256_storeu_si256((__m256i *)(void *)&hues[i],
+            _mm256_adds_epu8(v, k));
+    }
+
+    rlhue_cadd(hues + i, count - i, hue);
+}
+
+RLHUE_TAVX2 static void
+rlhue_vsub8(rlhue *hues, size_t count, rlhue hue)
+{
+    size_t i = 0;
+    __m256i v, k = _mm256_set1_epi32((int)rlhue_pack(hue));
+
+    for (; i + 8 <= count; i += 8)
+    {
+        v = _mm256_loadu_si256((const __m256i *)(void *)&hues[i]);
+        _mm256_storeu_si256((__m256i *)(void *)&hues[i],
+            _mm256_subs_epu8(v, k));
+    }
+
+    rlhue_csub(hues + i, count - i, hue);
+}
+
+RLHUE_TAVX2 static void
+rlhue_vmul8(rlhue *hues, size_t count, rlhue hue)
+{
+    size_t i = 0;
+    __m256i v, lo, hi, z = _mm256_setzero_si256();
+    __m256i k = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)rlhue_pack(hue)),
+        z);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        v = _mm256_loadu_si256((const __m256i *)(void *)&hues[i]);
+        lo = rlhue_vdiv(_mm256_mullo_epi16(_mm256_unpacklo_epi8(v, z), k));
+        hi = rlhue_vdiv(_mm256_mullo_epi16(_mm256_unpackhi_epi8(v, z), k));
+        _mm256_storeu_si256((__m256i *)(void *)&hues[i],
+            _mm256_packus_epi16(lo, hi));
+    }
+
+    rlhue_cmul(hues + i, count - i, hue);
+}
+
+RLHUE_TAVX2 static void
+rlhue_vlerp8(rlhue *hues, const rlhue *to, size_t count, uint8_t t)
+{
+    size_t i = 0;
+    __m256i a, b, lo, hi, z = _mm256_setzero_si256();
+    __m256i w0 = _mm256_set1_epi16((short)(255 - t));
+    __m256i w1 = _mm256_set1_epi16((short)t);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        a = _mm256_loadu_si256((const __m256i *)(const void *)&hues[i]);
+        b = _mm256_loadu_si256((const __m256i *)(const void *)&to[i]);
+
+        lo = rlhue_vdiv(_mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(a, z), w0),
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, z), w1)));
+        hi = rlhue_vdiv(_mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(a, z), w0),
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, z), w1)));
+
+        _mm256_storeu_si256((__m256i *)(void *)&hues[i],
+            _mm256_packus_epi16(lo, hi));
+    }
+
+    rlhue_clerp(hues + i, to + i, count - i, t);
+}
+
+RLHUE_TAVX2 static void
+rlhue_vover8(rlhue *hues, const rlhue *src, size_t count)
+{
+    size_t i = 0;
+    __m256i s, so, d, sa, lo, hi, z = _mm256_setzero_si256();
+    __m256i full = _mm256_set1_epi16(255);
+    __m256i amask = _mm256_set1_epi32((int)0xff000000u);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        d = _mm256_loadu_si256((const __m256i *)(const void *)&hues[i]);
+        s = _mm256_loadu_si256((const __m256i *)(const void *)&src[i]);
+        so = _mm256_or_si256(s, amask);
+
+        sa = _mm256_unpacklo_epi8(s, z);
+        sa = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sa, 0xff), 0xff);
+        lo = rlhue_vdiv(_mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(so, z), sa),
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, z),
+                _mm256_sub_epi16(full, sa))));
+
+        sa = _mm256_unpackhi_epi8(s, z);
+        sa = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sa, 0xff), 0xff);
+        hi = rlhue_vdiv(_mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(so, z), sa),
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, z),
+                _mm256_sub_epi16(full, sa))));
+
+        _mm256_storeu_si256((__m256i *)(void *)&hues[i],
+            _mm256_packus_epi16(lo, hi));
+    }
+
+    rlhue_cover(hues + i, src + i, count - i);
+}
+
+RLHUE_TAVX2 static __m256i
+rlhue_vgray4(__m256i v, __m256i w0, __m256i w1)
+{
+    __m256i y;
+    __m256i amask = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0,
+        -1, 0, 0, 0, -1, 0, 0, 0);
+
+    y = _mm256_madd_epi16(v, _mm256_set_epi16(0, 29, 150, 77, 0, 29, 150, 77,
+        0, 29, 150, 77, 0, 29, 150, 77));
+    y = _mm256_add_epi32(y, _mm256_shuffle_epi32(y, 0xb1));
+    y = _mm256_srli_epi32(_mm256_add_epi32(y, _mm256_set1_epi32(128)), 8);
+    y = _mm256_or_si256(y, _mm256_slli_epi32(y, 16));
+
+    y = rlhue_vdiv(_mm256_add_epi16(_mm256_mullo_epi16(v, w0),
+        _mm256_mullo_epi16(y, w1)));
+
+    return _mm256_or_si256(_mm256_andnot_si256(amask, y),
+        _mm256_and_si256(amask, v));
+}
+
+RLHUE_TAVX2 static void
+rlhue_vgray8(rlhue *hues, size_t count, uint8_t amount)
+{
+    size_t i = 0;
+    __m256i v, lo, hi, z = _mm256_setzero_si256();
+    __m256i w0 = _mm256_set1_epi16((short)(255 - amount));
+    __m256i w1 = _mm256_set1_epi16((short)amount);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        v = _mm256_loadu_si256((const __m256i *)(void *)&hues[i]);
+        lo = rlhue_vgray4(_mm256_unpacklo_epi8(v, z), w0, w1);
+        hi = rlhue_vgray4(_mm256_unpackhi_epi8(v, z), w0, w1);
+        _mm256_storeu_si256((__m256i *)(void *)&hues[i],
+            _mm256_packus_epi16(lo, hi));
+    }
+
+    rlhue_cgray(hues + i, count - i, amount);
+}
+
+static const struct rlhue_kern rlhue_kavx2 = {
+    "avx2", rlhue_vadd8, rlhue_vsub8, rlhue_vmul8, rlhue_vlerp8, rlhue_vover8,
+    rlhue_vgray8
+};
+
+#endif /* RLHUE_AVX2 */
+
+/******************************************************************************
+NEON kernels
+******************************************************************************/
+
+#ifdef RLHUE_NEON
+
+static uint8x8_t
+rlhue_ndiv(uint16x8_t v)
+{
+    return vraddhn_u16(v, vrshrq_n_u16(v, 8));
+}
+
+static void
+rlhue_nadd(rlhue *hues, size_t count, rlhue hue)
+{
+    size_t i = 0;
+    uint8x16_t k = vreinterpretq_u8_u32(vdupq_n_u32(rlhue_pack(hue)));
+
+    for (; i + 4 <= count; i += 4)
+        vst1q_u8((uint8_t *)&hues[i],
+            vqaddq_u8(vld1q_u8((const uint8_t *)&hues[i]), k));
+
+    rlhue_cadd(hues + i, count - i, hue);
+}
+
+static void
+rlhue_nsub(rlhue *hues, size_t count, rlhue hue)
+{
+    size_t i = 0;
+    uint8x16_t k = vreinterpretq_u8_u32(vdupq_n_u32(rlhue_pack(hue)));
+
+    for (; i + 4 <= count; i += 4)
+        vst1q_u8((uint8_t *)&hues[i],
+            vqsubq_u8(vld1q_u8((const uint8_t *)&hues[i]), k));
+
+    rlhue_csub(hues + i, count - i, hue);
+}
+
+static void
+rlhue_nmul(rlhue *hues, size_t count, rlhue hue)
+{
+    size_t i = 0;
+    uint8x16_t v;
+    uint8x8_t k = vreinterpret_u8_u32(vdup_n_u32(rlhue_pack(hue)));
+
+    for (; i + 4 <= count; i += 4)
+    {
+        v = vld1q_u8((const uint8_t *)&hues[i]);
+        vst1q_u8((uint8_t *)&hues[i], vcombine_u8(
+            rlhue_ndiv(vmull_u8(vget_low_u8(v), k)),
+            rlhue_ndiv(vmull_u8(vget_high_u8(v), k))));
+    }
+
+    rlhue_cmul(hues + i, count - i, hue);
+}
+
+static void
+rlhue_nlerp(rlhue *hues, const rlhue *to, size_t count, uint8_t t)
+{
+    size_t i = 0;
+    uint8x16_t a, b;
+    uint8x8_t w0 = vdup_n_u8((uint8_t)(255 - t)), w1 = vdup_n_u8(t);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        a = vld1q_u8((const uint8_t *)&hues[i]);
+        b = vld1q_u8((const uint8_t *)&to[i]);
+        vst1q_u8((uint8_t *)&hues[i], vcombine_u8(
+            rlhue_ndiv(vmlal_u8(vmull_u8(vget_low_u8(a), w0),
+                vget_low_u8(b), w1)),
+            rlhue_ndiv(vmlal_u8(vmull_u8(vget_high_u8(a), w0),
+                vget_high_u8(b), w1))));
+    }
+
+    rlhue_clerp(hues + i, to + i, count - i, t);
+}
+
+/* Blends one channel plane of 16 pixels */
+static uint8x16_t
+rlhue_nblend(uint8x16_t s, uint8x16_t d, uint8x16_t a, uint8x16_t ia)
+{
+    return vcombine_u8(
+        rlhue_ndiv(vmlal_u8(vmull_u8(vget_low_u8(s), vget_low_u8(a)),
+            vget_low_u8(d), vget_low_u8(ia))),
+        rlhue_ndiv(vmlal_u8(vmull_u8(vget_high_u8(s), vget_high_u8(a)),
+            vget_high_u8(d), vget_high_u8(ia))));
+}
+
+static void
+rlhue_nover(rlhue *hues, const rlhue *src, size_t count)
+{
+    size_t i = 0;
+    uint8x16x4_t s, d;
+    uint8x16_t ia, full = vdupq_n_u8(255);
+
+    for (; i + 16 <= count; i += 16)
+    {
+        d = vld4q_u8((const uint8_t *)&hues[i]);
+        s = vld4q_u8((const uint8_t *)&src[i]);
+        ia = vmvnq_u8(s.val[3]);
+
+        d.val[0] = rlhue_nblend(s.val[0], d.val[0], s.val[3], ia);
+        d.val[1] = rlhue_nblend(s.val[1], d.val[1], s.val[3], ia);
+        d.val[2] = rlhue_nblend(s.val[2], d.val[2], s.val[3], ia);
+        d.val[3] = rlhue_nblend(full, d.val[3], s.val[3], ia);
+
+        vst4q_u8((uint8_t *)&hues[i], d);
+    }
+
+    rlhue_cover(hues + i, src + i, count - i);
+}
+
+static void
+rlhue_ngray(rlhue *hues, size_t count, uint8_t amount)
+{
+    size_t i = 0;
+    uint8x16x4_t v;
+    uint8x16_t y, w0, w1;
+    uint16x8_t lo, hi;
+
+    w0 = vdupq_n_u8((uint8_t)(255 - amount));
+    w1 = vdupq_n_u8(amount);
+
+    for (; i + 16 <= count; i += 16)
+    {
+        v = vld4q_u8((const uint8_t *)&hues[i]);
+
+        lo = vmull_u8(vget_low_u8(v.val[0]), vdup_n_u8(77));
+        lo = vmlal_u8(lo, vget_low_u8(v.val[1]), vdup_n_u8(150));
+        lo = vmlal_u8(lo, vget_low_u8(v.val[2]), vdup_n_u8(29));
+        hi = vmull_u8(vget_high_u8(v.val[0]), vdup_n_u8(77));
+        hi = vmlal_u8(hi, vget_high_u8(v.val[1]), vdup_n_u8(150));
+        hi = vmlal_u8(hi, vget_high_u8(v.val[2]), vdup_n_u8(29));
+        y = vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8));
+
+        v.val[0] = rlhue_nblend(y, v.val[0], w1, w0);
+        v.val[1] = rlhue_nblend(y, v.val[1], w1, w0);
+        v.val[2] = rlhue_nblend(y, v.val[2], w1, w0);
+
+        vst4q_u8((uint8_t *)&hues[i], v);
+    }
+
+    rlhue_cgray(hues + i, count - i, amount);
+}
+
+static const struct rlhue_kern rlhue_kneon = {
+    "neon", rlhue_nadd, rlhue_nsub, rlhue_nmul, rlhue_nlerp, rlhue_nover,
+    rlhue_ngray
+};
+
+#endif /* RLHUE_NEON */
+
+/******************************************************************************
+Dispatch
+******************************************************************************/
+
+static const struct rlhue_kern *
+rlhue_kern(void)
+{
+    if (rlhue_kcur)
+        return rlhue_kcur;
+
+    rlhue_kcur = &rlhue_kscalar;
+
+#ifdef RLHUE_SSE2
+    rlhue_kcur = &rlhue_ksse2;
+#endif
+
+#ifdef RLHUE_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        rlhue_kcur = &rlhue_kavx2;
+#endif
+
+#ifdef RLHUE_NEON
+    rlhue_kcur = &rlhue_kneon;
+#endif
+
+    return rlhue_kcur;
+}
+
+/******************************************************************************
+rlhue batch function implementations
+******************************************************************************/
+
+extern void
+rlhue_vadd(rlhue *hues, size_t count, rlhue hue)
+{
+    if (!hues)
+        return;
+
+    rlhue_kern()->add(hues, count, hue);
+}
+
+extern void
+rlhue_vsub(rlhue *hues, size_t count, rlhue hue)
+{
+    if (!hues)
+        return;
+
+    rlhue_kern()->sub(hues, count, hue);
+}
+
+extern void
+rlhue_vmul(rlhue *hues, size_t count, rlhue hue)
+{
+    if (!hues)
+        return;
+
+    rlhue_kern()->mul(hues, count, hue);
+}
+
+extern void
+rlhue_vlerp(rlhue *hues, const rlhue *to, size_t count, uint8_t t)
+{
+    if (!hues || !to)
+        return;
+
+    rlhue_kern()->lerp(hues, to, count, t);
+}
+
+extern void
+rlhue_vover(rlhue *hues, const rlhue *src, size_t count)
+{
+    if (!hues || !src)
+        return;
+
+    rlhue_kern()->over(hues, src, count);
+}
+
+extern void
+rlhue_vgray(rlhue *hues, size_t count, uint8_t amount)
+{
+    if (!hues)
+        return;
+
+    rlhue_kern()->gray(hues, count, amount);
+}
+
+extern const char *
+rlhue_vname(void)
+{
+    return rlhue_kern()->name;
+}
+
+extern bool
+rlhue_vimpl(const char *name)
+{
+    const struct rlhue_kern *k = NULL;
+
+    if (!name)
+    {
+        rlhue_kcur = NULL;
+        rlhue_kern();
+        return true;
+    }
+
+    if (!strcmp(name, rlhue_kscalar.name))
+        k = &rlhue_kscalar;
+
+#ifdef RLHUE_SSE2
+    if (!strcmp(name, rlhue_ksse2.name))
+        k = &rlhue_ksse2;
+#endif
+
+#ifdef RLHUE_AVX2
+    if (!strcmp(name, rlhue_kavx2.name) && __builtin_cpu_supports("avx2"))
+        k = &rlhue_kavx2;
+#endif
+
+#ifdef RLHUE_NEON
+    if (!strcmp(name, rlhue_kneon.name))
+        k = &rlhue_kneon;
+#endif
+
+    if (!k)
+        return false;
+
+    rlhue_kcur = k;
+    return true;
+}
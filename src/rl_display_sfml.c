@@ -23,6 +23,7 @@ SOFTWARE.
 #include "rl_display.h"
 
 #include <math.h>
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,83 @@ SOFTWARE.
 
 #define UNUSED(x) (void)x
 
+/* Argument validation of the hot paths. Defining RL_DISPLAY_NO_CHECKS
+   compiles it out, making invalid arguments undefined behavior. */
+#ifdef RL_DISPLAY_NO_CHECKS
+#define RL_INVALID(cond) 0
+#else
+#define RL_INVALID(cond) (cond)
+#endif
+
+/* Feature flags of the rltmap shader variants */
+#define RL_SHADER_LIGHT     0x1
+#define RL_SHADER_PALET     0x2
+#define RL_SHADER_MAXIMUM   0x4
+
+/* Number of entries in an rltmap palette */
+#define RL_PALET_SIZE       256
+
+/* Maximum number of tile prototypes per rltmap */
+#define RL_PROTO_MAXIMUM    65536
+
+/* Number of glyphs per page of an rltmap glyph cache */
+#define RL_GLYPH_PAGE       256
+
+/* Height of the white strip above a tilesheet sampled by tile backgrounds */
+#define RL_SHEET_STRIP      2
+
+/* Milliseconds between polls of an idle rldisp waiting with a timeout, as
+   sfRenderWindow_waitEvent can't time out */
+#define RL_IDLE_POLL        1
+
+/* Hardware cursors kept by an rldisp for rldisp_cursor(6), and the largest
+   side of a cursor image in pixels */
+#define RL_CURSOR_CACHE     16
+#define RL_CURSOR_MAXIMUM   256
+
+/* Number of draws an rldisp holds back for occlusion culling or deferred
+   drawing before it submits them (see rldisp_occl(2), rldisp_defer(2)) */
+#define RL_QUEUE_DRAWS      64
+
+/* Size of the HUD rltmap in tiles and of its tiles in pixels. The frame time
+   graph fills the bottom RL_HUD_GRAPH rows, scaled so that a full column is
+   RL_HUD_SCALE seconds. */
+#define RL_HUD_WIDTH        40
+#define RL_HUD_HEIGHT       6
+#define RL_HUD_GRAPH        2
+#define RL_HUD_TILEX        8
+#define RL_HUD_TILEY        16
+#define RL_HUD_SCALE        (1.0 / 30.0)
+
+/* Input events waiting for a present to measure their latency against */
+#define RL_LATENCY_PENDING  64
+
+/* Sub pixel precision of the tile shifts stored by compact rltmaps, and the
+   number of tiles expanded into vertices per draw call */
+#define RL_CMPCT_SUB        16.0f
+#define RL_CMPCT_CHUNK      4096
+
+/* Capacity of the trace event ring buffer */
+#ifndef RL_TRACE_EVENTS
+#define RL_TRACE_EVENTS     16384
+#endif
+
+/* Trace points. Each one expands to a single test of rltrace.on when RL_TRACE
+   is defined and to nothing otherwise. RL_TRACE_END(3) takes the start time
+   of the scope in seconds and RL_TRACE_MARK(2) records an instant event. */
+#ifdef RL_TRACE
+#define RL_TRACE_BEGIN(t0) \
+    double t0 = rltrace.on ? rlstats_now() : 0.0
+#define RL_TRACE_END(name, t0, count) \
+    do { if (rltrace.on) rltrace_push(name, t0, count); } while (0)
+#define RL_TRACE_MARK(name, count) \
+    do { if (rltrace.on) rltrace_push(name, -1.0, count); } while (0)
+#else
+#define RL_TRACE_BEGIN(t0)
+#define RL_TRACE_END(name, t0, count)
+#define RL_TRACE_MARK(name, count)
+#endif
+
 /******************************************************************************
 Struct definitions
 ******************************************************************************/
@@ -45,6 +123,62 @@ struct rltile {
     sfColor bghue[4];
 };
 
+/* Cached glyph metrics needed to place a tile */
+struct rltglyph
+{
+    bool ok;
+    float left;
+    float top;
+    sfIntRect rect;
+};
+
+/* A tile of a compact rltmap: its glyph, hues and shift in 1/RL_CMPCT_SUB
+   pixels. The position of the tile follows from its index and the glyph's
+   texture rect from the glyph cache, so 16 bytes are enough to expand the
+   8 vertices of the tile at draw time. Palette indices are kept in the red
+   channel of the hues, as the shader reads them from the vertex colors, so
+   palette mode doesn't make the tiles any smaller. */
+struct rltcmp
+{
+    uint32_t glyph;
+    sfColor fg;
+    sfColor bg;
+    int16_t right;
+    int16_t bottom;
+};
+
+/* Precomputed vertices of a tile prototype, relative to the top left of the
+   tile, and the same tile in compact form */
+struct rltproto
+{
+    sfVertex fg[4];
+    sfColor bg;
+    struct rltcmp cmp;
+};
+
+/* A run of tile backgrounds of one hue in a row of an rltmap, from x0 to x1,
+   and the rect it was merged into. A raw run is a single background that is
+   not a plain quad of one hue over its tile (e.g. one with a hue per corner)
+   and is drawn as it is. */
+struct rlbrun
+{
+    int x0;
+    int x1;
+    int rect;
+    bool raw;
+    sfColor hue;
+};
+
+/* Tile backgrounds of one hue from x0, y0 to x1, y1, drawn as one quad */
+struct rlbrect
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    sfColor hue;
+};
+
 struct rltmap
 {
     int x;
@@ -59,37 +193,406 @@ struct rltmap
     int width;
     int height;
     float scale;
+
+    /* Tells the rltmap apart from those made before, whose address it can
+       take once they are freed */
+    unsigned id;
     sfFont *font;
+
+    /* Tilesheet used as the glyph texture, NULL unless made by rltmap_sheet */
+    sfTexture *sheet;
     sfVertexArray *fg;
     sfVertexArray *bg;
+
+    /* Tiles in compact form, NULL unless the rltmap is compact */
+    struct rltcmp *cmpct;
+
+    /* The rldisp holding the rltmap back for occlusion culling, if any */
+    rldisp *queued;
+
+    /* Bounds of the tiles written since the last draw, empty when x1 < x0 */
+    struct {
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+    } dirty;
+
+    /* scratch holds the last glyph looked up past the cached pages */
+    struct {
+        int pages;
+        sfVector2u size;
+        struct rltglyph **list;
+        struct rltglyph scratch;
+    } glyph;
+
+    struct {
+        int dirty0;
+        int dirty1;
+        rlhue *hues;
+        sfTexture *handle;
+    } light;
+
+    struct {
+        bool dirty;
+        rlhue *hues;
+        sfTexture *handle;
+    } palet;
+
+    struct {
+        int count;
+        int capacity;
+        struct rltproto *list;
+    } proto;
+
+    /* Font loaded by rltmap_async(7). While pending, the loading thread owns
+       path and font, and sets done under lock when it is finished. */
+    struct {
+        bool pending;
+        bool done;
+        bool failed;
+        char *path;
+        sfFont *font;
+        sfMutex *lock;
+        sfThread *thread;
+    } load;
+
+    /* Backgrounds merged into as few quads as possible, drawn in place of
+       bg or of the backgrounds of cmpct. spans holds the longest runs of each
+       row, rebuilt for the dirty rows, or for every row when stale. They are
+       cut into runs that stack into rects down the rows, from the first
+       dirty row on, as the rows above keep theirs. nspans and count hold
+       the number of spans and runs of each row, and first the number of
+       rects begun above each row. */
+    struct {
+        bool stale;
+        int *nspans;
+        int *count;
+        int *first;
+        struct rlbrun *spans;
+        struct rlbrun *runs;
+        struct rlbrect *rects;
+        sfVertexArray *verts;
+    } merge;
+
+    /* Counters of the rlstats of the frame that draws the rltmap next */
+    struct {
+        int tiles;
+        int gmiss;
+        int agrow;
+        int draws;
+        size_t bytes;
+    } stats;
+};
+
+union rltnode
+{
+    struct rltile tile;
+    union rltnode *next;
+};
+
+struct rltslab
+{
+    struct rltslab *next;
+    union rltnode nodes[];
+};
+
+struct rltpool
+{
+    int count;
+    union rltnode *head;
+    struct rltslab *slabs;
+};
+
+/* A draw held back by an rldisp. An rltmap with its transform when it was
+   drawn, the offset of its cells in the cull mask of the rldisp and how
+   many of them are hidden, or when tmap is NULL, count vertices of
+   primitive quads from first in the queue. box bounds all it draws and
+   bbox its backgrounds in frame coordinates, and batch is the batch its
+   backgrounds or primitives are submitted in. */
+struct rlqdraw
+{
+    rltmap *tmap;
+    sfTransform xform;
+    size_t mask;
+    int culled;
+    int first;
+    int count;
+    float box[4];
+    float bbox[4];
+    int batch;
+};
+
+/* Draws submitted together. Either the glyphs, or the backgrounds when they
+   need the shader, of the rltmap held back at draw, or when draw is -1, the
+   backgrounds and primitives merged into one buffer. box bounds what it
+   draws in frame coordinates. */
+struct rlbatch
+{
+    int draw;
+    bool glyph;
+    float box[4];
+};
+
+/* A hardware cursor made by rldisp_cursor(6) and what it was made from,
+   the rltmap by its id */
+struct rlcursor
+{
+    unsigned tmap;
+    wchar_t glyph;
+    rlhue fghue;
+    rlhue bghue;
+    int scale;
+    int hotx;
+    int hoty;
+    sfCursor *handle;
 };
 
 struct rldisp
 {
+    /* wwidth and wheight are the size of the window when windowed, kept
+       while it is fullscreen. vsync, limit and cursor are the settings of
+       the window, applied again when it is recreated. */
     struct {
         int width;
         int height;
+        int wwidth;
+        int wheight;
         int scroll;
         char *name;
         bool fscrn;
+        bool vsync;
+        int limit;
+        bool cursor;
         sfRenderWindow *handle;
     } window;
     
+    /* dirty is set when the frame is drawn to, or has to be shown again,
+       and cleared by rldisp_prsnt(1). clear is set while nothing was drawn
+       to the frame since rldisp_clear(1) cleared it. */
     struct {
         int width;
         int height;
+        bool dirty;
+        bool clear;
         sfColor clrhue;
         sfVector2f scale;
+        sfSprite *sprite;
         sfRenderTexture *handle;
     } frame;
+
+    /* Idle mode, in which rldisp_evtflsh(1) waits up to timeout seconds for
+       input (without limit if 0), or until wake if that is sooner and not
+       0 */
+    struct {
+        bool on;
+        double timeout;
+        double wake;
+    } idle;
+
+    /* Reused by the primitive calls instead of being created per draw */
+    struct {
+        sfRectangleShape *rect;
+    } prim;
+
+    /* Vertices of compact rltmaps, expanded RL_CMPCT_CHUNK tiles at a time
+       to be drawn */
+    sfVertex *scratch;
+
+    struct {
+        int head;
+        int count;
+        bool noalloc;
+        double prev;
+        double born;
+        double tfirst;
+        double switched;
+        double tmode;
+        int allocs;
+        rlstats acc;
+        rlstats last;
+        double frames[RL_STATS_FRAMES];
+    } stats;
+
+    struct {
+        int count;
+        double psum;
+        double ssum;
+        rllatency last;
+        double arrival[RL_LATENCY_PENDING];
+    } latency;
+
+    struct {
+        bool shown;
+        bool down;
+        rlkey key;
+        rltmap *tmap;
+        int count;
+        sfIntRect dirty[RL_STATS_MAPS];
+    } hud;
+
+    /* Cached hardware cursors, of which count are made. Once all are, next
+       is the one replaced. shown is the one installed, NULL for the system
+       cursor, which SFML needs a cursor of its own to go back to. */
+    struct {
+        int count;
+        int next;
+        struct rlcursor *shown;
+        sfCursor *system;
+        struct rlcursor list[RL_CURSOR_CACHE];
+    } cursor;
+
+    /* Occlusion culling. The rltmaps held back are drawn without the cells
+       that later ones hide. mask has a byte per cell of each, 255 when
+       hidden, and sat is the summed area table of the opaque cells of the
+       rltmap hiding them. */
+    struct {
+        bool on;
+        uint8_t *mask;
+        size_t msize;
+        int *sat;
+        size_t ssize;
+    } occl;
+
+    /* Draws held back for occlusion culling, or for deferred drawing where
+       primitives are held back too, their quads in prims. batch is where
+       backgrounds and primitives are merged on submission. */
+    struct {
+        bool defer;
+        int count;
+        struct rlqdraw list[RL_QUEUE_DRAWS];
+        sfVertex *prims;
+        int pcount;
+        int psize;
+        sfVertex *batch;
+        int bsize;
+    } queue;
+};
+
+#ifdef RL_TRACE
+struct rltevt
+{
+    const char *name;
+    double ts;
+    double dur;
+    int count;
 };
+#endif
+
+/* Default allocator hooks, declared here since rlahooks refers to them */
+static void *
+rlalloc_dmalloc(void *user, size_t size);
+
+static void *
+rlalloc_drealloc(void *user, void *ptr, size_t size);
+
+static void
+rlalloc_dfree(void *user, void *ptr);
 
 /******************************************************************************
 Static global variables
 ******************************************************************************/
 
 static int rldcount = 0;
+static int rltcount = 0;
+static unsigned rltnext = 0;
 static sfClock *rldclock = NULL;
+static sfClock *rlsclock = NULL;
+static int rlacount = 0;
+static size_t rlabytes = 0;
+static sfShader *rlshaders[RL_SHADER_MAXIMUM];
+static int rlalive = 0;
+static rlalloc rlahooks = {rlalloc_dmalloc, rlalloc_drealloc, rlalloc_dfree,
+    NULL};
+static const struct rltglyph rltgnone = {true, 0.0f, 0.0f, {0, 0, 0, 0}};
+
+/* Unicode equivalents of the characters of code page 437, the layout of
+   tilesheets without a codepoint map */
+static const wchar_t rlcp437[256] = {
+    0x0000, 0x263A, 0x263B, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022,
+    0x25D8, 0x25CB, 0x25D9, 0x2642, 0x2640, 0x266A, 0x266B, 0x263C,
+    0x25BA, 0x25C4, 0x2195, 0x203C, 0x00B6, 0x00A7, 0x25AC, 0x21A8,
+    0x2191, 0x2193, 0x2192, 0x2190, 0x221F, 0x2194, 0x25B2, 0x25BC,
+    0x0020, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027,
+    0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+    0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+    0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+    0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+    0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+    0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+    0x0058, 0x0059, 0x005A, 0x005B, 0x005C, 0x005D, 0x005E, 0x005F,
+    0x0060, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+    0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+    0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+    0x0078, 0x0079, 0x007A, 0x007B, 0x007C, 0x007D, 0x007E, 0x2302,
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+    0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0,
+};
+
+#ifdef RL_TRACE
+static struct
+{
+    bool on;
+    bool wrap;
+    int head;
+    struct rltevt evts[RL_TRACE_EVENTS];
+} rltrace;
+#endif
+
+/******************************************************************************
+Shader sources
+******************************************************************************/
+
+/* The rltmap shaders are assembled from these sources, prefixed with a
+   #define for each RL_SHADER_* flag that the shader variant enables. They are
+   written against GLSL 1.10 so they run on any GL 2.0 driver, including
+   software rasterizers. */
+
+static const char *rlshader_vert =
+    "uniform vec2 rl_cell;\n"
+    "varying vec2 rl_pos;\n"
+    "void main()\n"
+    "{\n"
+    "#ifdef RL_SHADER_LIGHT\n"
+    "    rl_pos = gl_Vertex.xy / rl_cell;\n"
+    "#endif\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+    "    gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "}\n";
+
+static const char *rlshader_frag =
+    "uniform sampler2D texture;\n"
+    "uniform sampler2D rl_light;\n"
+    "uniform sampler2D rl_palet;\n"
+    "uniform vec2 rl_size;\n"
+    "varying vec2 rl_pos;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 hue = gl_Color;\n"
+    "#ifdef RL_SHADER_PALET\n"
+    "    hue = texture2D(rl_palet,\n"
+    "        vec2((floor(hue.r * 255.0 + 0.5) + 0.5) / 256.0, 0.5));\n"
+    "#endif\n"
+    "#ifdef RL_SHADER_LIGHT\n"
+    "    hue *= texture2D(rl_light, (floor(rl_pos) + 0.5) / rl_size);\n"
+    "#endif\n"
+    "    gl_FragColor = hue * texture2D(texture, gl_TexCoord[0].xy);\n"
+    "}\n";
 
 /******************************************************************************
 Static function declarations
@@ -97,479 +600,2507 @@ Static function declarations
 
 /* misc */
 static char *
-strdup(const char *s);
+rlstrdup(const char *s);
 
-/* rldisp */
-static void
-rldisp_updscl(rldisp *this);
+/* memory */
+static void *
+rlmalloc(size_t size);
+
+static void *
+rlcalloc(size_t count, size_t size);
+
+static void *
+rlrealloc(void *ptr, size_t size);
 
 static void
-rldisp_rsizd(rldisp *this, int w, int h);
+rlfree(void *ptr);
+
+/* stats */
+static double
+rlstats_now(void);
 
-/* rltmap */
 static int
-rltmap_index(rltmap *this, int x, int y);
+rlstats_cmp(const void *a, const void *b);
 
+#ifdef RL_TRACE
+/* trace */
 static void
-rltmap_updtile(rltmap *this, rltile *t, int x, int y);
+rltrace_push(const char *name, double t0, int count);
+#endif
 
+/* rldisp */
 static void
-rltmap_updbg(rltmap *this, int i, rltile *t, int x, int y);
+rldisp_updscl(rldisp *this);
 
 static void
-rltmap_updfg(rltmap *this, int i, rltile *t, int x, int y, float r,
-    float b, sfIntRect *rect);
+rldisp_updstats(rldisp *this, double now);
 
-/******************************************************************************
-Misc static function implementations
-******************************************************************************/
+static void
+rldisp_evtarr(rldisp *this);
 
-static char *
-strdup(const char *s)
-{
-    char *d = NULL;
-    size_t len = strlen(s);
+static void
+rldisp_evthdl(rldisp *this, const sfEvent *evt);
 
-    if (!s || !(d = malloc(len + 1)))
-        return NULL;
+static double
+rldisp_until(rldisp *this, double now);
 
-    d[len] = '\0';
-    strcpy(d, s);
-    return d;
-}
+static double
+rldisp_wait(rldisp *this);
 
-/******************************************************************************
-rldisp function implementations
-******************************************************************************/
+static rlhue
+rldisp_curpix(const sfUint8 *src, rlhue fghue, rlhue bghue);
+
+static sfCursor *
+rldisp_mkcur(rltmap *tmap, rlcell cell, int scale, int hotx, int hoty);
 
 static void
-rldisp_rsizd(rldisp *this, int width, int height)
-{
-    if (!this)
-        return;
+rldisp_updlat(rldisp *this, double present, double swap);
 
-    this->window.width = width;
-    this->window.height = height;
+static void
+rldisp_drwhud(rldisp *this);
 
-    rldisp_updscl(this);
-}
+static void
+rldisp_drwmap(rldisp *this, rltmap *tmap, const sfTransform *xform,
+    const uint8_t *mask, int culled);
 
 static void
-rldisp_updscl(rldisp *this)
-{
-    if (!this)
-        return;
+rldisp_flush(rldisp *this);
 
-    this->frame.scale = (sfVector2f){
-        (float)this->window.width / (float)this->frame.width,
-        (float)this->window.height / (float)this->frame.height
-    };
-}
+static int
+rldisp_sat(rldisp *this, rltmap *tmap);
 
-rldisp *
-rldisp_init(int wwidth, int wheight, int fwidth, int fheight, const char *name,
-    bool fscrn)
-{
-    size_t mcount;
-    rldisp *this = NULL;
-    sfVideoMode mode = {(unsigned)wwidth, (unsigned)wheight, 32u};
-    sfUint32 style = (fscrn) ? sfFullscreen : sfClose | sfTitlebar;
+static int
+rldisp_hide(rldisp *this, const struct rlqdraw *back,
+    const struct rlqdraw *front);
 
-    /* Increment total open display count */
-    rldcount += 1;
+static size_t
+rldisp_drwbg(rldisp *this, rltmap *tmap, sfRenderStates *states,
+    const uint8_t *mask);
 
-    /* Initialize global clock if this is the only display */
-    if (rldcount == 1 && !rldclock && !(rldclock = sfClock_create()))
-        goto error;
+static size_t
+rldisp_drwfg(rldisp *this, rltmap *tmap, sfRenderStates *states,
+    const uint8_t *mask);
 
-    /* If both wwidth and wheight are 0, then select the largest possible
-       video mode to use */
-    if (!wwidth && !wheight)
-    {
-        mode = sfVideoMode_getFullscreenModes(&mcount)[0];
-    }
+static void
+rldisp_endmap(rldisp *this, rltmap *tmap);
 
-    /* TODO: Sanity check for size parameters? */
+static void
+rldisp_tstats(rldisp *this, rltmap *tmap);
 
-    if (!(this = malloc(sizeof(rldisp))))
-        goto error;
+static void
+rldisp_submit(rldisp *this, int count);
 
-    if (!(this->window.name = strdup(name)))
-        goto error;
+static int
+rldisp_expbg(rldisp *this, struct rlqdraw *q, const uint8_t *mask,
+    sfVertex *verts);
 
-    if (!(this->window.handle = sfRenderWindow_create(mode, name, style,
-        NULL)))
-        goto error;
+static int
+rldisp_xquad(sfVertex *verts, const sfTransform *xform, const sfVertex *src);
 
-    this->window.scroll = 0;
-    this->window.fscrn = fscrn;
-    this->window.width = wwidth;
-    this->window.height = wheight;
+static void
+rldisp_xbox(const sfTransform *xform, const float *box, float *out);
 
-    if (!(this->frame.handle = sfRenderTexture_create((unsigned)fwidth,
-        (unsigned)fheight, false)))
-        goto error;
+static bool
+rldisp_hit(const float *a, const float *b);
 
-    sfRenderWindow_setActive(this->window.handle, true);
+static int
+rldisp_quad(sfVertex *verts, float l, float t, float r, float b, rlhue hue);
 
-    this->frame.width = fwidth;
-    this->frame.height = fheight;
-    this->frame.clrhue = sfBlack;
+static void
+rldisp_qbox(rldisp *this, float l, float t, float r, float b, float d,
+    rlhue hue);
 
-    rldisp_updscl(this);
+static void
+rldisp_qprim(rldisp *this, const sfVertex *verts, int count);
 
-    return this;
+static void
+rldisp_dquads(rldisp *this, const sfVertex *verts, int count);
 
-error:
+static void
+rldisp_hudln(rldisp *this, wchar_t *line, int y, rlhue fg, rlhue bg);
 
-    rldisp_free(this);
-    return NULL;
-}
+static void
+rldisp_rsizd(rldisp *this, int w, int h);
 
-void
-rldisp_fscrn(rldisp *this, bool fscrn)
-{
-    sfUint32 style = (fscrn) ? sfFullscreen : sfClose | sfTitlebar;
-    sfVideoMode mode = {(unsigned)this->window.width,
-        (unsigned)this->window.height, 32};
+static bool
+rldisp_mkwin(rldisp *this);
 
-    if (!this || !this->window.handle)
-        return;
+/* rltile */
+static void
+rltile_set(rltile *this, wchar_t glyph, rlhue fghue, rlhue bghue,
+    rlttype type, float right, float bottom);
 
-    this->window.fscrn = fscrn;
+/* rltpool */
+static bool
+rltpool_grow(rltpool *this);
 
-    sfRenderWindow_destroy(this->window.handle);
-    this->window.handle = sfRenderWindow_create(mode, this->window.name, style,
-        NULL);
-}
+/* rltmap */
+static rltmap *
+rltmap_new(int csize, int cnum, int width, int height, int offx, int offy);
 
-void
-rldisp_rsize(rldisp *this, int width, int height)
-{
-    sfVideoMode mode = {(unsigned)width, (unsigned)height, 32u};
-    sfUint32 style = (this->window.fscrn) ? sfFullscreen
-        : sfClose | sfTitlebar;
+static int
+rltmap_index(rltmap *this, int x, int y);
 
-    if (!this || !this->window.handle)
-        return;
+static void
+rltmap_dirty(rltmap *this, int x, int y);
 
-    this->window.width = width;
-    this->window.height = height;
-    rldisp_updscl(this);
+static void
+rltmap_clean(rltmap *this);
 
-    sfRenderWindow_destroy(this->window.handle);
-    this->window.handle = sfRenderWindow_create(mode, this->window.name, style,
-        NULL);
-}
+static void
+rltmap_flush(rltmap *this);
 
-void
-rldisp_rname(rldisp *this, const char *name)
-{
-    if (!this || !this->window.name)
-        return;
+static void
+rltmap_work(void *arg);
 
-    free(this->window.name);
+static void
+rltmap_adopt(rltmap *this);
 
-    this->window.name = strdup(name);
+static const struct rltglyph *
+rltmap_glyph(rltmap *this, wchar_t glyph);
 
-    sfRenderWindow_setTitle(this->window.handle, name);
-}
+static void
+rltmap_updtile(rltmap *this, rltile *t, int x, int y);
 
-void
-rldisp_vsync(rldisp *this, bool enabled)
-{
-    if (!this || !this->window.handle)
-        return;
+static void
+rltmap_updcell(rltmap *this, const rlcell *c, int x, int y);
 
-    sfRenderWindow_setVerticalSyncEnabled(this->window.handle, enabled);
-}
+static void
+rltmap_shift(rltmap *this, wchar_t glyph, rlttype type, float right,
+    float bottom, float *r, float *b, sfIntRect *rect);
 
-void
-rldisp_shwcur(rldisp *this, bool visible)
-{
-    if (!this || !this->window.handle)
-        return;
+static void
+rltmap_updbg(rltmap *this, int i, const sfColor *hue, int x, int y);
 
-    sfRenderWindow_setMouseCursorVisible(this->window.handle, visible);
-}
+static void
+rltmap_updfg(rltmap *this, int i, const sfColor *hue, int x, int y, float r,
+    float b, sfIntRect *rect);
 
-extern void
-rldisp_filter(rldisp *this, bool filter)
-{
-    if (!this || !this->frame.handle)
-        return;
+static void
+rltmap_updhue(rltmap *this, sfVertexArray *va, const rlhue *hues, int x,
+    int y, int width, int height);
 
-    sfRenderTexture_setSmooth(this->frame.handle, filter);
-}
+static void
+rltmap_updproto(rltmap *this, const struct rltproto *p, int x, int y);
 
-void
-rldisp_fpslim(rldisp *this, int limit)
-{
-    if (!this || !this->window.handle)
-        return;
+static void
+rltmap_updcmp(rltmap *this, int i, wchar_t glyph, sfColor fg, sfColor bg,
+    float r, float b);
 
-    sfRenderWindow_setFramerateLimit(this->window.handle, (unsigned)limit);
-}
+static size_t
+rltmap_drwcmp(rltmap *this, sfRenderTexture *target, sfRenderStates *states,
+    sfVertex *scratch, const uint8_t *mask, bool fg);
 
-void
-rldisp_free(rldisp *this)
-{
-    if (!this)
-        return;
+static size_t
+rltmap_drwcul(rltmap *this, sfRenderTexture *target, sfRenderStates *states,
+    sfVertex *scratch, const uint8_t *mask, bool fg);
 
-    rldcount -= 1;
+static void
+rltmap_drwscr(rltmap *this, sfRenderTexture *target, sfRenderStates *states,
+    const sfVertex *scratch, int n);
 
-    /* If this is the last rldisp, free the global clock */
-    if (rldcount == 0)
-    {
-        sfClock_destroy(rldclock);
-        rldclock = NULL;
-    }
+static void
+rltmap_runbg(rltmap *this, int y);
 
-    if (this->frame.handle)
-        sfRenderTexture_destroy(this->frame.handle);
+static int
+rltmap_stkbg(rltmap *this, int y, int rects);
 
-    if (this->window.handle)
-        sfRenderWindow_destroy(this->window.handle);
+static void
+rltmap_quadbg(rltmap *this, int i);
 
-    if (this->window.name)
-        free(this->window.name);
+static bool
+rltmap_mrgbg(rltmap *this);
 
-    if (this)
-        free(this);
-}
+static void
+rltmap_freebg(rltmap *this);
 
-bool
-rldisp_status(rldisp *this)
-{
-    if (!this || !this->window.handle)
-        return false;
+static void
+rltmap_updlight(rltmap *this);
 
-    return sfRenderWindow_isOpen(this->window.handle);
-}
+static sfShader *
+rltmap_shader(rltmap *this);
 
-void
-rldisp_evtflsh(rldisp *this)
+static void
+rltmap_xform(rltmap *this, sfTransform *xform);
+
+static void
+rltmap_states(rltmap *this, const sfTransform *xform,
+    sfRenderStates *states);
+
+static bool
+rltmap_opaque(rltmap *this, int i);
+
+static void
+rltmap_bounds(rltmap *this, int i, float *box);
+
+static void
+rltmap_extent(rltmap *this, float *box);
+
+/* shaders */
+static sfShader *
+rlshader_get(int flags);
+
+static void
+rlshader_free(void);
+
+/******************************************************************************
+Misc static function implementations
+******************************************************************************/
+
+static char *
+rlstrdup(const char *s)
 {
-    static sfEvent evt;
+    char *d = NULL;
+    size_t len;
 
-    if (!this || !this->window.handle)
-        return;
+    if (!s)
+        return NULL;
 
-    while (sfRenderWindow_pollEvent(this->window.handle, &evt))
-    {
-        switch (evt.type)
-        {
-            case sfEvtClosed:
-                sfRenderWindow_close(this->window.handle);
-                break;
-            case sfEvtResized:
-                rldisp_rsizd(this, (int)evt.size.width,
-                    (int)evt.size.height);
-                break;
-            case sfEvtMouseWheelScrolled:
-                this->window.scroll += (int)evt.mouseWheelScroll.delta;
-                break;
-            default:
-                break;
-        }
-    }
+    len = strlen(s);
+
+    if (!(d = rlmalloc(len + 1)))
+        return NULL;
+
+    d[len] = '\0';
+    strcpy(d, s);
+    return d;
 }
 
-void
-rldisp_clear(rldisp *this)
-{
-    if (!this || !this->window.handle)
-        return;
+/******************************************************************************
+Memory static function implementations
+******************************************************************************/
 
-    sfRenderTexture_clear(this->frame.handle, this->frame.clrhue);
+static void *
+rlalloc_dmalloc(void *user, size_t size)
+{
+    UNUSED(user);
+    return malloc(size);
 }
 
-void
-rldisp_clrhue(rldisp *this, rlhue hue)
+static void *
+rlalloc_drealloc(void *user, void *ptr, size_t size)
 {
-    if (!this)
-        return;
+    UNUSED(user);
+    return realloc(ptr, size);
+}
 
-    this->frame.clrhue = (sfColor){hue.r, hue.g, hue.b, hue.a};
+static void
+rlalloc_dfree(void *user, void *ptr)
+{
+    UNUSED(user);
+    free(ptr);
 }
 
-void
-rldisp_dtmap(rldisp *this, rltmap *tmap)
+static void *
+rlmalloc(size_t size)
 {
-    sfRenderStates states;
+    void *ptr = NULL;
 
-    if (!this || !this->frame.handle || !tmap)
-        return;
+    if (!(ptr = rlahooks.alloc(rlahooks.user, size)))
+        return NULL;
+
+    rlalive += 1;
+    rlacount += 1;
+    return ptr;
+}
 
-    states.shader = NULL;
-    states.blendMode = sfBlendAlpha;
-    states.transform = sfTransform_Identity;
-    states.texture = sfFont_getTexture(tmap->font, (unsigned)tmap->csize);
-    sfTransform_translate(&states.transform, (float)tmap->x, (float)tmap->y);
+static void *
+rlcalloc(size_t count, size_t size)
+{
+    void *ptr = NULL;
 
-    sfTransform_scale(&states.transform, (float)tmap->scale,
-        (float)tmap->scale);
+    if (size && count > (size_t)-1 / size)
+        return NULL;
 
-    sfTransform_rotateWithCenter(&states.transform, tmap->rot,
-        (float)tmap->origx, (float)tmap->origy);
+    if (!(ptr = rlmalloc(count * size)))
+        return NULL;
 
-    sfRenderTexture_drawVertexArray(this->frame.handle, tmap->bg, &states);
-    sfRenderTexture_drawVertexArray(this->frame.handle, tmap->fg, &states);
+    memset(ptr, 0, count * size);
+    return ptr;
 }
 
-extern void
-rldisp_dline(rldisp *this, int x0, int y0, int x1, int y1, int thick,
-    rlhue hue)
+static void *
+rlrealloc(void *ptr, size_t size)
 {
-    float unit;
-    sfVertex vert[4];
-    sfVector2f dir, udir, perp, off;
+    void *next = NULL;
 
-    if (!this || !this->frame.handle)
-        return;
+    if (!(next = rlahooks.realloc(rlahooks.user, ptr, size)))
+        return NULL;
 
-    dir.x = (float)x1 - (float)x0;
-    dir.y = (float)y1 - (float)y0;
+    if (!ptr)
+        rlalive += 1;
 
-    unit = sqrtf(dir.x * dir.x + dir.y * dir.y);
+    rlacount += 1;
+    return next;
+}
 
-    udir.x = dir.x / unit;
-    udir.y = dir.y / unit;
+static void
+rlfree(void *ptr)
+{
+    if (!ptr)
+        return;
 
-    perp.x = -udir.y;
-    perp.y = udir.x;
+    rlalive -= 1;
+    rlahooks.free(rlahooks.user, ptr);
+}
 
-    off.x = perp.x * ((float)thick / 2.0f);
-    off.y = perp.y * ((float)thick / 2.0f);
+/******************************************************************************
+Stats static function implementations
+******************************************************************************/
 
-    vert[0].position.x = (float)x0 + off.x;
-    vert[0].position.y = (float)y0 + off.y;
+static double
+rlstats_now(void)
+{
+    if (!rlsclock)
+        return 0.0;
 
-    vert[1].position.x = (float)x1 + off.x;
-    vert[1].position.y = (float)y1 + off.y;
+    return (double)sfTime_asMicroseconds(sfClock_getElapsedTime(rlsclock))
+        / 1000000.0;
+}
 
-    vert[2].position.x = (float)x1 - off.x;
-    vert[2].position.y = (float)y1 - off.y;
+static int
+rlstats_cmp(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
 
-    vert[3].position.x = (float)x0 - off.x;
-    vert[3].position.y = (float)y0 - off.x;
+    return (da > db) - (da < db);
+}
 
-    for (int i = 0; i < 4; ++i)
-        vert[i].color = (sfColor){hue.r, hue.g, hue.b, hue.a};
+/******************************************************************************
+Trace static function implementations
+******************************************************************************/
+
+#ifdef RL_TRACE
+static void
+rltrace_push(const char *name, double t0, int count)
+{
+    double now = rlstats_now();
+    struct rltevt *evt = &rltrace.evts[rltrace.head];
+
+    evt->name = name;
+    evt->ts = (t0 < 0.0) ? now : t0;
+    evt->dur = (t0 < 0.0) ? -1.0 : now - t0;
+    evt->count = count;
 
-    sfRenderTexture_drawPrimitives(this->frame.handle, vert, 4, sfQuads, NULL);
+    if (++rltrace.head == RL_TRACE_EVENTS)
+    {
+        rltrace.head = 0;
+        rltrace.wrap = true;
+    }
 }
+#endif
 
-extern void
-rldisp_dboxo(rldisp *this, int x, int y, int width, int height, int thick,
-    rlhue hue)
+/******************************************************************************
+Shader static function implementations
+******************************************************************************/
+
+static sfShader *
+rlshader_get(int flags)
 {
-    sfColor color;
-    sfRectangleShape *rect;
-    sfVector2f pos = {(float)x, (float)y};
-    sfVector2f size = {(float)width, (float)height};
+    char vert[1024], frag[2048], defs[128] = "";
 
-    if (!this || !this->frame.handle || !(rect = sfRectangleShape_create()))
-        return;
+    if (flags <= 0 || flags >= RL_SHADER_MAXIMUM)
+        return NULL;
 
-    color = (sfColor){hue.r, hue.g, hue.b, hue.a};
+    if (rlshaders[flags])
+        return rlshaders[flags];
 
-    sfRectangleShape_setSize(rect, size);
-    sfRectangleShape_setPosition(rect, pos);
-    sfRectangleShape_setOutlineColor(rect, color);
-    sfRectangleShape_setFillColor(rect, sfTransparent);
-    sfRectangleShape_setOutlineThickness(rect, (float)thick);
+    if (!sfShader_isAvailable())
+        return NULL;
 
-    sfRenderTexture_drawRectangleShape(this->frame.handle, rect, NULL);
+    if (flags & RL_SHADER_LIGHT)
+        strcat(defs, "#define RL_SHADER_LIGHT\n");
 
-    sfRectangleShape_destroy(rect);
+    if (flags & RL_SHADER_PALET)
+        strcat(defs, "#define RL_SHADER_PALET\n");
+
+    snprintf(vert, sizeof(vert), "%s%s", defs, rlshader_vert);
+    snprintf(frag, sizeof(frag), "%s%s", defs, rlshader_frag);
+
+    rlshaders[flags] = sfShader_createFromMemory(vert, NULL, frag);
+
+    return rlshaders[flags];
 }
 
-extern void
-rldisp_dboxi(rldisp *this, int x, int y, int width, int height, int thick,
-    rlhue hue)
+static void
+rlshader_free(void)
 {
-    sfColor color;
-    sfRectangleShape *rect;
-    sfVector2f pos = {(float)(x + thick), (float)(y + thick)};
-    sfVector2f size = {(float)(width - 2 * thick),
-        (float)(height - 2 * thick)};
+    for (int i = 0; i < RL_SHADER_MAXIMUM; ++i)
+    {
+        if (rlshaders[i])
+            sfShader_destroy(rlshaders[i]);
 
-    if (!this || !this->frame.handle || !(rect = sfRectangleShape_create()))
-        return;
+        rlshaders[i] = NULL;
+    }
+}
 
-    color = (sfColor){hue.r, hue.g, hue.b, hue.a};
+/******************************************************************************
+rldisp function implementations
+******************************************************************************/
 
-    sfRectangleShape_setSize(rect, size);
-    sfRectangleShape_setPosition(rect, pos);
-    sfRectangleShape_setOutlineColor(rect, color);
-    sfRectangleShape_setFillColor(rect, sfTransparent);
-    sfRectangleShape_setOutlineThickness(rect, (float)thick);
+static void
+rldisp_rsizd(rldisp *this, int width, int height)
+{
+    if (!this)
+        return;
 
-    sfRenderTexture_drawRectangleShape(this->frame.handle, rect, NULL);
+    this->window.width = width;
+    this->window.height = height;
+    this->frame.dirty = true;
 
-    sfRectangleShape_destroy(rect);
+    rldisp_updscl(this);
 }
 
-extern void
-rldisp_dboxf(rldisp *this, int x, int y, int width, int height, rlhue hue)
+/* Creates the window of an rldisp for its fullscreen state, replacing the
+   one it has. Textures, shaders and the frame live in the context SFML
+   shares between windows, so they outlast the window. */
+static bool
+rldisp_mkwin(rldisp *this)
 {
-    sfColor color;
-    sfRectangleShape *rect;
-    sfVector2f pos = {(float)x, (float)y};
-    sfVector2f size = {(float)width, (float)height};
+    sfRenderWindow *handle = NULL;
+    sfVideoMode mode = sfVideoMode_getDesktopMode();
+    sfUint32 style = sfNone;
 
-    if (!this || !this->frame.handle || !(rect = sfRectangleShape_create()))
-        return;
+    /* Fullscreen windows are borderless ones covering the desktop, so the
+       monitor never changes modes */
+    if (!this->window.fscrn)
+    {
+        mode.width = (unsigned)this->window.wwidth;
+        mode.height = (unsigned)this->window.wheight;
+        style = sfClose | sfTitlebar;
+    }
 
-    color = (sfColor){hue.r, hue.g, hue.b, hue.a};
+    /* The old window is only destroyed once the new one exists, so it is
+       kept, and made active again, when that fails */
+    if (!(handle = sfRenderWindow_create(mode, this->window.name, style,
+        NULL)))
+    {
+        if (this->window.handle)
+            sfRenderWindow_setActive(this->window.handle, true);
 
-    sfRectangleShape_setSize(rect, size);
-    sfRectangleShape_setPosition(rect, pos);
-    sfRectangleShape_setFillColor(rect, color);
-    sfRectangleShape_setOutlineColor(rect, color);
+        return false;
+    }
 
-    sfRenderTexture_drawRectangleShape(this->frame.handle, rect, NULL);
+    if (this->window.handle)
+        sfRenderWindow_destroy(this->window.handle);
+
+    this->window.handle = handle;
+
+    sfRenderWindow_setVerticalSyncEnabled(handle, this->window.vsync);
+    sfRenderWindow_setFramerateLimit(handle, (unsigned)this->window.limit);
+    sfRenderWindow_setMouseCursorVisible(handle, this->window.cursor);
+    sfRenderWindow_setActive(handle, true);
+
+    if (this->cursor.shown)
+        sfRenderWindow_setMouseCursor(handle, this->cursor.shown->handle);
+
+    this->window.width = (int)mode.width;
+    this->window.height = (int)mode.height;
+    this->frame.dirty = true;
+    rldisp_updscl(this);
 
-    sfRectangleShape_destroy(rect);
+    return true;
 }
 
-void
-rldisp_prsnt(rldisp *this)
+static void
+rldisp_updscl(rldisp *this)
 {
-    sfSprite *sprite = NULL;
-
-    if (!this || !this->window.handle || !this->frame.handle
-        || !(sprite = sfSprite_create()))
+    if (!this)
         return;
 
-    this->window.scroll = 0;
-    sfRenderTexture_display(this->frame.handle);
-    
-    sfSprite_setScale(sprite, this->frame.scale);
-    sfSprite_setTexture(sprite, sfRenderTexture_getTexture(this->frame.handle),
-        false);
-
-    sfRenderWindow_drawSprite(this->window.handle, sprite, NULL);
-    sfRenderWindow_display(this->window.handle);
-    sfSprite_destroy(sprite);
+    this->frame.scale = (sfVector2f){
+        (float)this->window.width / (float)this->frame.width,
+        (float)this->window.height / (float)this->frame.height
+    };
 }
 
-bool
-rldisp_key(rldisp *this, rlkey key)
+rldisp *
+rldisp_init(int wwidth, int wheight, int fwidth, int fheight, const char *name,
+    bool fscrn)
 {
-    if (!this || key < 0 || key >= RL_KEY_MAXIMUM)
-        return false;
+    size_t mcount;
+    double born;
+    rldisp *this = NULL;
+    sfVideoMode mode = {(unsigned)wwidth, (unsigned)wheight, 32u};
 
-    /* *this is unused in the SFML renderer implementation, but the interface
-       requires it to be passed for compatibility with other backends */
-    UNUSED(this);
+    /* Increment total open display count */
+    rldcount += 1;
 
-    switch (key)
-    {
-    case RL_KEY_A:
-        return sfKeyboard_isKeyPressed(sfKeyA);
+    /* Initialize global clocks if this is the only display */
+    if (rldcount == 1 && !rldclock && !(rldclock = sfClock_create()))
+        goto error;
+
+    if (rldcount == 1 && !rlsclock && !(rlsclock = sfClock_create()))
+        goto error;
+
+    born = rlstats_now();
+
+    /* If both wwidth and wheight are 0, then select the largest possible
+       video mode to use */
+    if (!wwidth && !wheight)
+    {
+        mode = sfVideoMode_getFullscreenModes(&mcount)[0];
+    }
+
+    /* TODO: Sanity check for size parameters? */
+
+    if (!(this = rlcalloc(1, sizeof(rldisp))))
+        goto error;
+
+    if (!(this->window.name = rlstrdup(name)))
+        goto error;
+
+    this->window.scroll = 0;
+    this->window.fscrn = fscrn;
+    this->window.wwidth = (int)mode.width;
+    this->window.wheight = (int)mode.height;
+    this->window.cursor = true;
+    this->frame.width = fwidth;
+    this->frame.height = fheight;
+
+    if (!rldisp_mkwin(this))
+        goto error;
+
+    if (!(this->frame.handle = sfRenderTexture_create((unsigned)fwidth,
+        (unsigned)fheight, false)))
+        goto error;
+
+    if (!(this->frame.sprite = sfSprite_create()))
+        goto error;
+
+    if (!(this->prim.rect = sfRectangleShape_create()))
+        goto error;
+
+    if (!(this->scratch = rlmalloc(RL_CMPCT_CHUNK * 4 * sizeof(sfVertex))))
+        goto error;
+
+    this->frame.clrhue = sfBlack;
+    this->stats.prev = rlstats_now();
+    this->stats.born = born;
+    this->stats.allocs = rlacount;
+    this->hud.key = RL_KEY_MAXIMUM;
+
+    rldisp_updscl(this);
+
+    return this;
+
+error:
+
+    rldisp_free(this);
+    return NULL;
+}
+
+bool
+rldisp_fscrn(rldisp *this, bool fscrn)
+{
+    if (!this || !this->window.handle)
+        return false;
+
+    if (fscrn == this->window.fscrn)
+        return true;
+
+    /* The style of an SFML window is fixed once created, so it is created
+       again, with its settings */
+    this->window.fscrn = fscrn;
+
+    if (!rldisp_mkwin(this))
+    {
+        this->window.fscrn = !fscrn;
+        return false;
+    }
+
+    this->stats.switched = rlstats_now();
+
+    return true;
+}
+
+void
+rldisp_rsize(rldisp *this, int width, int height)
+{
+    if (!this || !this->window.handle)
+        return;
+
+    this->window.wwidth = width;
+    this->window.wheight = height;
+    this->stats.switched = rlstats_now();
+
+    /* A fullscreen window keeps covering the desktop, taking the new size
+       once it leaves fullscreen */
+    if (this->window.fscrn)
+        return;
+
+    this->window.width = width;
+    this->window.height = height;
+    rldisp_updscl(this);
+
+    sfRenderWindow_setSize(this->window.handle,
+        (sfVector2u){(unsigned)width, (unsigned)height});
+}
+
+void
+rldisp_rname(rldisp *this, const char *name)
+{
+    if (!this || !this->window.name)
+        return;
+
+    rlfree(this->window.name);
+
+    this->window.name = rlstrdup(name);
+
+    sfRenderWindow_setTitle(this->window.handle, name);
+}
+
+void
+rldisp_vsync(rldisp *this, bool enabled)
+{
+    if (!this || !this->window.handle)
+        return;
+
+    this->window.vsync = enabled;
+    sfRenderWindow_setVerticalSyncEnabled(this->window.handle, enabled);
+}
+
+void
+rldisp_shwcur(rldisp *this, bool visible)
+{
+    if (!this || !this->window.handle)
+        return;
+
+    this->window.cursor = visible;
+    sfRenderWindow_setMouseCursorVisible(this->window.handle, visible);
+}
+
+extern bool
+rldisp_cursor(rldisp *this, rltmap *tmap, rlcell cell, int scale, int hotx,
+    int hoty)
+{
+    struct rlcursor *cur = NULL;
+    sfCursor *handle = NULL;
+
+    if (!this || !this->window.handle || (tmap && scale < 1))
+        return false;
+
+    if (!tmap)
+    {
+        if (!this->cursor.system && !(this->cursor.system
+            = sfCursor_createFromSystem(sfCursorArrow)))
+            return false;
+
+        sfRenderWindow_setMouseCursor(this->window.handle,
+            this->cursor.system);
+        this->cursor.shown = NULL;
+        return true;
+    }
+
+    for (int i = 0; i < this->cursor.count && !cur; ++i)
+    {
+        cur = &this->cursor.list[i];
+
+        if (cur->tmap != tmap->id || cur->glyph != cell.glyph
+            || memcmp(&cur->fghue, &cell.fghue, sizeof(rlhue))
+            || memcmp(&cur->bghue, &cell.bghue, sizeof(rlhue))
+            || cur->scale != scale || cur->hotx != hotx || cur->hoty != hoty)
+            cur = NULL;
+    }
+
+    if (!cur)
+    {
+        if (!(handle = rldisp_mkcur(tmap, cell, scale, hotx, hoty)))
+            return false;
+
+        /* The cursor installed is never the one replaced */
+        if (this->cursor.count < RL_CURSOR_CACHE)
+            cur = &this->cursor.list[this->cursor.count++];
+        else
+        {
+            cur = &this->cursor.list[this->cursor.next];
+
+            if (cur == this->cursor.shown)
+            {
+                this->cursor.next = (this->cursor.next + 1) % RL_CURSOR_CACHE;
+                cur = &this->cursor.list[this->cursor.next];
+            }
+
+            this->cursor.next = (this->cursor.next + 1) % RL_CURSOR_CACHE;
+            sfCursor_destroy(cur->handle);
+        }
+
+        *cur = (struct rlcursor){tmap->id, cell.glyph, cell.fghue, cell.bghue,
+            scale, hotx, hoty, handle};
+    }
+
+    if (cur != this->cursor.shown)
+        sfRenderWindow_setMouseCursor(this->window.handle, cur->handle);
+
+    this->cursor.shown = cur;
+    return true;
+}
+
+extern void
+rldisp_filter(rldisp *this, bool filter)
+{
+    if (!this || !this->frame.handle)
+        return;
+
+    sfRenderTexture_setSmooth(this->frame.handle, filter);
+    this->frame.dirty = true;
+}
+
+void
+rldisp_fpslim(rldisp *this, int limit)
+{
+    if (!this || !this->window.handle)
+        return;
+
+    this->window.limit = (limit > 0) ? limit : 0;
+    sfRenderWindow_setFramerateLimit(this->window.handle,
+        (unsigned)this->window.limit);
+}
+
+void
+rldisp_free(rldisp *this)
+{
+    if (!this)
+        return;
+
+    rldcount -= 1;
+
+    /* If this is the last rldisp, free the global clocks */
+    if (rldcount == 0)
+    {
+        sfClock_destroy(rldclock);
+        sfClock_destroy(rlsclock);
+        rldclock = NULL;
+        rlsclock = NULL;
+    }
+
+    /* The draws held back are dropped along with the frame */
+    for (int i = 0; i < this->queue.count; ++i)
+        if (this->queue.list[i].tmap
+            && this->queue.list[i].tmap->queued == this)
+            this->queue.list[i].tmap->queued = NULL;
+
+    this->queue.count = 0;
+
+    if (this->hud.tmap)
+        rltmap_free(this->hud.tmap);
+
+    if (this->prim.rect)
+        sfRectangleShape_destroy(this->prim.rect);
+
+    if (this->frame.sprite)
+        sfSprite_destroy(this->frame.sprite);
+
+    if (this->frame.handle)
+        sfRenderTexture_destroy(this->frame.handle);
+
+    if (this->window.handle)
+        sfRenderWindow_destroy(this->window.handle);
+
+    /* Cursors have to outlive the window they are installed on */
+    for (int i = 0; i < this->cursor.count; ++i)
+        sfCursor_destroy(this->cursor.list[i].handle);
+
+    if (this->cursor.system)
+        sfCursor_destroy(this->cursor.system);
+
+    if (this->window.name)
+        rlfree(this->window.name);
+
+    rlfree(this->occl.mask);
+    rlfree(this->occl.sat);
+    rlfree(this->queue.prims);
+    rlfree(this->queue.batch);
+    rlfree(this->scratch);
+
+    if (this)
+        rlfree(this);
+}
+
+bool
+rldisp_status(rldisp *this)
+{
+    if (!this || !this->window.handle)
+        return false;
+
+    return sfRenderWindow_isOpen(this->window.handle);
+}
+
+void
+rldisp_evtflsh(rldisp *this)
+{
+    static sfEvent evt;
+    double t0 = rlstats_now(), idle = 0.0;
+
+    if (!this || !this->window.handle)
+        return;
+
+    if (this->idle.on)
+        idle = rldisp_wait(this);
+
+    while (sfRenderWindow_pollEvent(this->window.handle, &evt))
+        rldisp_evthdl(this, &evt);
+
+    /* Toggle the HUD on the press of its key, not while it is held */
+    if (this->hud.tmap && this->hud.key != RL_KEY_MAXIMUM)
+    {
+        if (rldisp_key(this, this->hud.key) && !this->hud.down)
+        {
+            this->hud.shown = !this->hud.shown;
+            this->frame.dirty = true;
+        }
+
+        this->hud.down = rldisp_key(this, this->hud.key);
+    }
+
+    this->stats.acc.tidle += idle;
+    this->stats.acc.tevt += rlstats_now() - t0 - idle;
+    RL_TRACE_END("rldisp_evtflsh", t0, 0);
+}
+
+void
+rldisp_idle(rldisp *this, bool enabled, double timeout)
+{
+    if (!this)
+        return;
+
+    this->idle.on = enabled;
+    this->idle.timeout = (timeout > 0.0) ? timeout : 0.0;
+    this->frame.dirty = true;
+}
+
+void
+rldisp_wake(rldisp *this, double delay)
+{
+    double wake;
+
+    if (!this)
+        return;
+
+    wake = rlstats_now() + (delay > 0.0 ? delay : 0.0);
+
+    /* The soonest deadline wins */
+    if (this->idle.wake == 0.0 || wake < this->idle.wake)
+        this->idle.wake = wake;
+}
+
+void
+rldisp_clear(rldisp *this)
+{
+    RL_TRACE_BEGIN(t0);
+
+    if (!this || !this->window.handle)
+        return;
+
+    rldisp_flush(this);
+
+    /* Clearing a frame that nothing was drawn to changes nothing, which
+       keeps a loop clearing every frame idle */
+    if (this->frame.clear)
+        return;
+
+    sfRenderTexture_clear(this->frame.handle, this->frame.clrhue);
+    this->frame.dirty = true;
+    this->frame.clear = true;
+    RL_TRACE_END("rldisp_clear", t0, 0);
+}
+
+void
+rldisp_clrhue(rldisp *this, rlhue hue)
+{
+    if (!this)
+        return;
+
+    this->frame.clrhue = (sfColor){hue.r, hue.g, hue.b, hue.a};
+    this->frame.clear = false;
+}
+
+void
+rldisp_dtmap(rldisp *this, rltmap *tmap)
+{
+    sfTransform xform;
+    struct rlqdraw *q = NULL;
+
+    if (!this || !this->frame.handle || !tmap)
+        return;
+
+    /* An rltmap still loading its font is drawn once it is done */
+    if (tmap->load.pending && !rltmap_ready(tmap, false))
+        return;
+
+    this->frame.dirty = true;
+    this->frame.clear = false;
+
+    if (!this->occl.on && !this->queue.defer)
+    {
+        rltmap_xform(tmap, &xform);
+        rldisp_drwmap(this, tmap, &xform, NULL, 0);
+        return;
+    }
+
+    /* An rltmap is held back by one rldisp at a time */
+    if (tmap->queued && tmap->queued != this)
+        rldisp_flush(tmap->queued);
+
+    if (this->queue.count == RL_QUEUE_DRAWS)
+        rldisp_flush(this);
+
+    q = &this->queue.list[this->queue.count++];
+    q->tmap = tmap;
+    rltmap_xform(tmap, &q->xform);
+    tmap->queued = this;
+}
+
+void
+rldisp_occl(rldisp *this, bool enabled)
+{
+    if (!this)
+        return;
+
+    if (!enabled)
+        rldisp_flush(this);
+
+    this->occl.on = enabled;
+}
+
+void
+rldisp_defer(rldisp *this, bool enabled)
+{
+    if (!this)
+        return;
+
+    if (!enabled)
+        rldisp_flush(this);
+
+    this->queue.defer = enabled;
+}
+
+/* Draws an rltmap with the transform xform, skipping the tiles marked in
+   mask if it is not NULL, of which there are culled */
+static void
+rldisp_drwmap(rldisp *this, rltmap *tmap, const sfTransform *xform,
+    const uint8_t *mask, int culled)
+{
+    double t0 = rlstats_now();
+    sfRenderStates states;
+    size_t verts;
+
+    rltmap_states(tmap, xform, &states);
+
+    /* All the backgrounds are drawn before any glyph, so glyphs overhanging
+       their tile are not covered by the background of a later tile */
+    verts = rldisp_drwbg(this, tmap, &states, mask);
+    verts += rldisp_drwfg(this, tmap, &states, mask);
+
+    this->stats.acc.bcells += tmap->width * tmap->height - culled;
+    rldisp_endmap(this, tmap);
+
+    if (this->stats.acc.nmaps < RL_STATS_MAPS)
+        this->stats.acc.tmaps[this->stats.acc.nmaps] = rlstats_now()
+            - t0;
+
+    this->stats.acc.nmaps += 1;
+    this->stats.acc.tmap += rlstats_now() - t0;
+    RL_TRACE_END("rldisp_dtmap", t0, (int)verts);
+}
+
+/* Draws the backgrounds of the tiles of an rltmap not marked in mask if it
+   is not NULL, and returns the number of vertices drawn */
+static size_t
+rldisp_drwbg(rldisp *this, rltmap *tmap, sfRenderStates *states,
+    const uint8_t *mask)
+{
+    sfVertexArray *bg = NULL;
+    size_t verts;
+    bool merged = rltmap_mrgbg(tmap);
+
+    /* SFML draws vertex arrays from client memory, so every vertex is sent
+       to the GPU again on every draw. The tile backgrounds are drawn as
+       they are if they can't be merged. */
+    if (tmap->cmpct && !merged)
+        verts = rltmap_drwcmp(tmap, this->frame.handle, states,
+            this->scratch, mask, false);
+    else if (mask)
+        verts = rltmap_drwcul(tmap, this->frame.handle, states,
+            this->scratch, mask, false);
+    else
+    {
+        bg = merged ? tmap->merge.verts : tmap->bg;
+        sfRenderTexture_drawVertexArray(this->frame.handle, bg, states);
+        verts = sfVertexArray_getVertexCount(bg);
+        this->stats.acc.draws += 1;
+    }
+
+    this->stats.acc.bquads += (int)(verts / 4);
+    this->stats.acc.verts += (int)verts;
+    this->stats.acc.bytes += verts * sizeof(sfVertex);
+
+    return verts;
+}
+
+/* Draws the glyphs of the tiles of an rltmap not marked in mask if it is not
+   NULL, and returns the number of vertices drawn */
+static size_t
+rldisp_drwfg(rldisp *this, rltmap *tmap, sfRenderStates *states,
+    const uint8_t *mask)
+{
+    size_t verts;
+
+    if (tmap->cmpct)
+        verts = rltmap_drwcmp(tmap, this->frame.handle, states,
+            this->scratch, mask, true);
+    else if (mask)
+        verts = rltmap_drwcul(tmap, this->frame.handle, states,
+            this->scratch, mask, true);
+    else
+    {
+        sfRenderTexture_drawVertexArray(this->frame.handle, tmap->fg,
+            states);
+        verts = sfVertexArray_getVertexCount(tmap->fg);
+        this->stats.acc.draws += 1;
+    }
+
+    this->stats.acc.verts += (int)verts;
+    this->stats.acc.bytes += verts * sizeof(sfVertex);
+
+    return verts;
+}
+
+/* Finishes the draw of an rltmap once all of it is drawn */
+static void
+rldisp_endmap(rldisp *this, rltmap *tmap)
+{
+    /* Remember the region of the rltmap redrawn this frame for the HUD. The
+       rotation of the rltmap is not taken into account. */
+    if (this->hud.shown && tmap != this->hud.tmap && tmap->dirty.x1 >= 0
+        && this->hud.count < RL_STATS_MAPS)
+    {
+        this->hud.dirty[this->hud.count++] = (sfIntRect){
+            tmap->x + (int)((float)(tmap->dirty.x0 * tmap->offx)
+                * tmap->scale),
+            tmap->y + (int)((float)(tmap->dirty.y0 * tmap->offy)
+                * tmap->scale),
+            (int)((float)((tmap->dirty.x1 - tmap->dirty.x0 + 1)
+                * tmap->offx) * tmap->scale),
+            (int)((float)((tmap->dirty.y1 - tmap->dirty.y0 + 1)
+                * tmap->offy) * tmap->scale)
+        };
+    }
+
+    rldisp_tstats(this, tmap);
+    rltmap_clean(tmap);
+}
+
+/* Moves the counters of an rltmap over to the frame drawing it */
+static void
+rldisp_tstats(rldisp *this, rltmap *tmap)
+{
+    this->stats.acc.tiles += tmap->stats.tiles;
+    this->stats.acc.gmiss += tmap->stats.gmiss;
+    this->stats.acc.agrow += tmap->stats.agrow;
+    this->stats.acc.draws += tmap->stats.draws;
+    this->stats.acc.bytes += tmap->stats.bytes;
+    memset(&tmap->stats, 0, sizeof(tmap->stats));
+}
+
+/* Submits the draws held back, in the order they were made in. Hidden
+   tiles are culled first if occlusion culling is on. An rltmap hidden
+   entirely is not drawn at all. */
+static void
+rldisp_flush(rldisp *this)
+{
+    void *p = NULL;
+    struct rlqdraw *q = NULL;
+    size_t cells = 0;
+    int count = this->queue.count, maps = 0;
+    double t0 = rlstats_now();
+
+    if (!count)
+        return;
+
+    this->queue.count = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        q = &this->queue.list[i];
+        q->mask = cells;
+        q->culled = 0;
+
+        if (!q->tmap)
+            continue;
+
+        cells += (size_t)(q->tmap->width * q->tmap->height);
+        maps += 1;
+
+        if (q->tmap->queued == this)
+            q->tmap->queued = NULL;
+    }
+
+    /* The mask is kept between frames. Without room for it nothing is
+       culled. */
+    if (this->occl.on && maps > 1 && cells > this->occl.msize
+        && (p = rlrealloc(this->occl.mask, cells)))
+    {
+        this->occl.mask = p;
+        this->occl.msize = cells;
+    }
+
+    if (this->occl.on && maps > 1 && cells <= this->occl.msize)
+    {
+        memset(this->occl.mask, 0, cells);
+
+        /* Every rltmap is tested against each one drawn after it. The cells
+           an rltmap hides are the ones its own cells hide. */
+        for (int j = count - 1; j > 0; --j)
+        {
+            if (!this->queue.list[j].tmap
+                || !rldisp_sat(this, this->queue.list[j].tmap))
+                continue;
+
+            for (int i = 0; i < j; ++i)
+                if (this->queue.list[i].tmap)
+                    this->queue.list[i].culled += rldisp_hide(this,
+                        &this->queue.list[i], &this->queue.list[j]);
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+        this->stats.acc.culled += this->queue.list[i].culled;
+
+    this->stats.acc.tmap += rlstats_now() - t0;
+    RL_TRACE_END("rldisp_occl", t0, count);
+
+    if (this->queue.defer)
+    {
+        rldisp_submit(this, count);
+        this->queue.pcount = 0;
+        return;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        q = &this->queue.list[i];
+
+        if (q->culled < q->tmap->width * q->tmap->height)
+            rldisp_drwmap(this, q->tmap, &q->xform, q->culled
+                ? &this->occl.mask[q->mask] : NULL, q->culled);
+    }
+}
+
+/* Submits the draws held back in deferred drawing with as few draw calls as
+   painter's order allows. The backgrounds of the rltmaps and the
+   primitives are merged into batches drawn with one call each, and the
+   glyphs of each rltmap are drawn with a call of their own, as no two
+   rltmaps share a texture. Backgrounds that need the light or palette
+   shader are drawn on their own too. A draw joins the last batch before it
+   as long as nothing drawn in between overlaps it, so only draws that don't
+   overlap are reordered. */
+static void
+rldisp_submit(rldisp *this, int count)
+{
+    void *p = NULL;
+    sfRenderStates states;
+    struct rlqdraw *q = NULL, *only = NULL;
+    struct rlbatch batch[RL_QUEUE_DRAWS * 2];
+    const uint8_t *mask = NULL;
+    int n = 0, b, verts, size, members;
+    float box[4];
+    bool solid;
+    double t0 = rlstats_now();
+
+    /* Plan the batches */
+    for (int i = 0; i < count; ++i)
+    {
+        q = &this->queue.list[i];
+        q->batch = -1;
+
+        if (q->tmap && q->culled == q->tmap->width * q->tmap->height)
+            continue;
+
+        if (q->tmap)
+        {
+            box[0] = 0.0f;
+            box[1] = 0.0f;
+            box[2] = (float)(q->tmap->width * q->tmap->offx);
+            box[3] = (float)(q->tmap->height * q->tmap->offy);
+            rldisp_xbox(&q->xform, box, q->bbox);
+            rltmap_extent(q->tmap, box);
+            rldisp_xbox(&q->xform, box, q->box);
+        }
+
+        solid = !q->tmap || (!q->tmap->light.handle
+            && !q->tmap->palet.handle);
+
+        if (solid)
+        {
+            for (b = n - 1; b >= 0; --b)
+                if (batch[b].draw < 0 || rldisp_hit(batch[b].box, q->bbox))
+                    break;
+
+            if (b < 0 || batch[b].draw >= 0)
+            {
+                b = n++;
+                batch[b].draw = -1;
+                memcpy(batch[b].box, q->bbox, sizeof(box));
+            }
+
+            batch[b].box[0] = fminf(batch[b].box[0], q->bbox[0]);
+            batch[b].box[1] = fminf(batch[b].box[1], q->bbox[1]);
+            batch[b].box[2] = fmaxf(batch[b].box[2], q->bbox[2]);
+            batch[b].box[3] = fmaxf(batch[b].box[3], q->bbox[3]);
+            q->batch = b;
+        }
+        else
+        {
+            q->batch = n;
+            batch[n].draw = i;
+            batch[n].glyph = false;
+            memcpy(batch[n++].box, q->bbox, sizeof(box));
+        }
+
+        if (!q->tmap)
+            continue;
+
+        batch[n].draw = i;
+        batch[n].glyph = true;
+        memcpy(batch[n++].box, q->box, sizeof(box));
+    }
+
+    for (b = 0; b < n; ++b)
+    {
+        if (batch[b].draw >= 0)
+        {
+            q = &this->queue.list[batch[b].draw];
+            mask = q->culled ? &this->occl.mask[q->mask] : NULL;
+            rltmap_states(q->tmap, &q->xform, &states);
+
+            if (batch[b].glyph)
+                rldisp_drwfg(this, q->tmap, &states, mask);
+            else
+                rldisp_drwbg(this, q->tmap, &states, mask);
+
+            continue;
+        }
+
+        size = 0;
+        members = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            q = &this->queue.list[i];
+
+            if (q->batch != b)
+                continue;
+
+            size += q->tmap ? q->tmap->width * q->tmap->height * 4 : q->count;
+            only = q;
+            members += 1;
+        }
+
+        if (size > this->queue.bsize && (p = rlrealloc(this->queue.batch,
+            (size_t)size * sizeof(sfVertex))))
+        {
+            this->queue.batch = p;
+            this->queue.bsize = size;
+        }
+
+        /* An rltmap alone in its batch is cheaper drawn from its own
+           vertices, as is every rltmap if there is no room to merge them */
+        if ((members == 1 && only->tmap) || size > this->queue.bsize)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                q = &this->queue.list[i];
+                mask = q->culled ? &this->occl.mask[q->mask] : NULL;
+
+                if (q->batch == b && q->tmap)
+                {
+                    rltmap_states(q->tmap, &q->xform, &states);
+                    rldisp_drwbg(this, q->tmap, &states, mask);
+                }
+                else if (q->batch == b)
+                    rldisp_dquads(this, &this->queue.prims[q->first],
+                        q->count);
+            }
+
+            continue;
+        }
+
+        verts = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            q = &this->queue.list[i];
+            mask = q->culled ? &this->occl.mask[q->mask] : NULL;
+
+            if (q->batch == b && q->tmap)
+                verts += rldisp_expbg(this, q, mask,
+                    &this->queue.batch[verts]);
+            else if (q->batch == b)
+            {
+                memcpy(&this->queue.batch[verts],
+                    &this->queue.prims[q->first],
+                    (size_t)q->count * sizeof(sfVertex));
+                verts += q->count;
+            }
+        }
+
+        if (verts)
+            rldisp_dquads(this, this->queue.batch, verts);
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        q = &this->queue.list[i];
+
+        if (!q->tmap || q->batch < 0)
+            continue;
+
+        this->stats.acc.bcells += q->tmap->width * q->tmap->height - q->culled;
+        this->stats.acc.nmaps += 1;
+        rldisp_endmap(this, q->tmap);
+    }
+
+    this->stats.acc.tmap += rlstats_now() - t0;
+    RL_TRACE_END("rldisp_submit", t0, n);
+}
+
+/* Writes the backgrounds of an rltmap held back to verts as quads in frame
+   coordinates, without their texture coordinates. Tiles are written as
+   their merged backgrounds, or compact ones that can't be merged as a quad
+   per run of tiles of one hue in a row. Hidden tiles, marked in mask if it
+   is not NULL, and transparent ones are left out. Returns the number of
+   vertices written. */
+static int
+rldisp_expbg(rldisp *this, struct rlqdraw *q, const uint8_t *mask,
+    sfVertex *verts)
+{
+    rltmap *t = q->tmap;
+    sfColor hue = {0, 0, 0, 0}, run = {0, 0, 0, 0};
+    sfVertex quad[4];
+    int n = 0, w = t->width, x0, runs, i;
+    bool merged, shown;
+    const sfVertex *src = NULL;
+    const struct rlbrun *row = NULL;
+    const struct rlbrect *r = NULL;
+    float ox = (float)t->offx, oy = (float)t->offy;
+
+    merged = rltmap_mrgbg(t);
+
+    for (int y = 0; t->cmpct && !merged && y < t->height; ++y)
+    {
+        x0 = -1;
+
+        for (int x = 0; x <= w; ++x)
+        {
+            i = y * w + x;
+            shown = x < w && (!mask || !mask[i]);
+
+            if (shown)
+            {
+                hue = t->cmpct[i].bg;
+                shown = hue.a > 0;
+            }
+
+            if (x0 >= 0 && (!shown || memcmp(&hue, &run, sizeof(sfColor))))
+            {
+                quad[0].position = (sfVector2f){(float)x0 * ox,
+                    (float)y * oy};
+                quad[1].position = (sfVector2f){(float)x * ox, (float)y * oy};
+                quad[2].position = (sfVector2f){(float)x * ox,
+                    (float)(y + 1) * oy};
+                quad[3].position = (sfVector2f){(float)x0 * ox,
+                    (float)(y + 1) * oy};
+
+                for (int k = 0; k < 4; ++k)
+                    quad[k].color = run;
+
+                n += rldisp_xquad(&verts[n], &q->xform, quad);
+                x0 = -1;
+            }
+
+            if (shown && x0 < 0)
+            {
+                x0 = x;
+                run = hue;
+            }
+        }
+    }
+
+    /* The same quads rltmap_drwcul(5) draws */
+    for (int y = 0; (merged || !t->cmpct) && y < t->height; ++y)
+    {
+        row = merged ? &t->merge.runs[y * w] : NULL;
+        runs = merged ? t->merge.count[y] : w;
+
+        for (int k = 0; k < runs; ++k)
+        {
+            src = NULL;
+
+            if (!row && (!mask || !mask[y * w + k]))
+                src = sfVertexArray_getVertex(t->bg, (size_t)(y * w + k) * 4);
+            else if (row && row[k].raw && (!mask || !mask[y * w + row[k].x0]))
+                src = sfVertexArray_getVertex(t->bg,
+                    (size_t)(y * w + row[k].x0) * 4);
+            else if (row && !row[k].raw && t->merge.rects[row[k].rect].y0 == y
+                && t->merge.rects[row[k].rect].hue.a > 0)
+            {
+                r = &t->merge.rects[row[k].rect];
+                shown = !mask;
+
+                for (int ry = r->y0; !shown && ry <= r->y1; ++ry)
+                for (int rx = r->x0; !shown && rx <= r->x1; ++rx)
+                    shown = !mask[ry * w + rx];
+
+                if (shown)
+                    src = sfVertexArray_getVertex(t->merge.verts,
+                        (size_t)row[k].rect * 4);
+            }
+
+            if (src)
+                n += rldisp_xquad(&verts[n], &q->xform, src);
+        }
+    }
+
+    this->stats.acc.bquads += n / 4;
+    return n;
+}
+
+/* Writes the quad src transformed by xform, without its texture
+   coordinates, and returns the number of vertices */
+static int
+rldisp_xquad(sfVertex *verts, const sfTransform *xform, const sfVertex *src)
+{
+    for (int k = 0; k < 4; ++k)
+        verts[k] = (sfVertex){sfTransform_transformPoint(xform,
+            src[k].position), src[k].color, {0.0f, 0.0f}};
+
+    return 4;
+}
+
+/* Writes the bounds in frame coordinates of box transformed by xform to
+   out, both as left, top, right and bottom */
+static void
+rldisp_xbox(const sfTransform *xform, const float *box, float *out)
+{
+    sfVector2f c;
+
+    out[0] = out[1] = HUGE_VALF;
+    out[2] = out[3] = -HUGE_VALF;
+
+    for (int k = 0; k < 4; ++k)
+    {
+        c = sfTransform_transformPoint(xform, (sfVector2f){
+            box[(k & 1) ? 2 : 0], box[(k & 2) ? 3 : 1]});
+        out[0] = fminf(out[0], c.x);
+        out[1] = fminf(out[1], c.y);
+        out[2] = fmaxf(out[2], c.x);
+        out[3] = fmaxf(out[3], c.y);
+    }
+}
+
+/* Whether two bounds as left, top, right and bottom overlap */
+static bool
+rldisp_hit(const float *a, const float *b)
+{
+    return a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3];
+}
+
+/* Fills the summed area table of the opaque cells of an rltmap and returns
+   their number, 0 if there are none or no room for the table. Entry
+   (x, y) of the table counts the opaque cells above and left of cell
+   (x, y), with an extra row and column of zeros. */
+static int
+rldisp_sat(rldisp *this, rltmap *tmap)
+{
+    void *p = NULL;
+    int *sat = NULL, w = tmap->width, row;
+    size_t size = (size_t)((tmap->width + 1) * (tmap->height + 1));
+
+    if (size > this->occl.ssize)
+    {
+        if (!(p = rlrealloc(this->occl.sat, size * sizeof(int))))
+            return 0;
+
+        this->occl.sat = p;
+        this->occl.ssize = size;
+    }
+
+    sat = this->occl.sat;
+    memset(sat, 0, (size_t)(w + 1) * sizeof(int));
+
+    for (int y = 0; y < tmap->height; ++y)
+    {
+        row = 0;
+        sat[(y + 1) * (w + 1)] = 0;
+
+        for (int x = 0; x < w; ++x)
+        {
+            row += rltmap_opaque(tmap, y * w + x);
+            sat[(y + 1) * (w + 1) + x + 1] = sat[y * (w + 1) + x + 1] + row;
+        }
+    }
+
+    return sat[size - 1];
+}
+
+/* Marks the cells of back that front hides in the cull mask and returns how
+   many were marked. A cell is hidden when the bounds of all it draws, mapped
+   into front, fall within opaque cells of front. Bounds within 1/256 of a
+   pixel of a cell edge, the precision vertices are snapped to when they are
+   rasterized, count as on it, so rltmaps on the same grid hide each other
+   despite rounding. */
+static int
+rldisp_hide(rldisp *this, const struct rlqdraw *back,
+    const struct rlqdraw *front)
+{
+    const float *b = back->xform.matrix, *f = front->xform.matrix;
+    double det, i00, i01, i10, i11, a[6], x, y, qx, qy, eps, lo[2], hi[2];
+    double x0, y0, x1, y1;
+    float box[4];
+    int w = front->tmap->width, h = front->tmap->height, hidden = 0, n;
+    int count = back->tmap->width * back->tmap->height;
+    const int *sat = this->occl.sat;
+    uint8_t *mask = &this->occl.mask[back->mask];
+
+    /* A front squashed to nothing hides nothing */
+    det = (double)f[0] * f[4] - (double)f[1] * f[3];
+
+    if (fabs(det) < 1e-12)
+        return 0;
+
+    /* The transform from back into front, the inverse of the transform of
+       front after that of back. SFML's matrices are in row major order. */
+    i00 = f[4] / det;
+    i01 = -f[1] / det;
+    i10 = -f[3] / det;
+    i11 = f[0] / det;
+
+    a[0] = i00 * b[0] + i01 * b[3];
+    a[1] = i00 * b[1] + i01 * b[4];
+    a[2] = i00 * (b[2] - f[2]) + i01 * (b[5] - f[5]);
+    a[3] = i10 * b[0] + i11 * b[3];
+    a[4] = i10 * b[1] + i11 * b[4];
+    a[5] = i10 * (b[2] - f[2]) + i11 * (b[5] - f[5]);
+
+    eps = 1.0 / (256.0 * sqrt(fabs(det)));
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (mask[i])
+            continue;
+
+        rltmap_bounds(back->tmap, i, box);
+        lo[0] = lo[1] = HUGE_VAL;
+        hi[0] = hi[1] = -HUGE_VAL;
+
+        for (int k = 0; k < 4; ++k)
+        {
+            x = box[(k & 1) ? 2 : 0];
+            y = box[(k & 2) ? 3 : 1];
+            qx = a[0] * x + a[1] * y + a[2];
+            qy = a[3] * x + a[4] * y + a[5];
+            lo[0] = (qx < lo[0]) ? qx : lo[0];
+            lo[1] = (qy < lo[1]) ? qy : lo[1];
+            hi[0] = (qx > hi[0]) ? qx : hi[0];
+            hi[1] = (qy > hi[1]) ? qy : hi[1];
+        }
+
+        /* The cells of front the bounds overlap */
+        x0 = floor((lo[0] + eps) / (double)front->tmap->offx);
+        y0 = floor((lo[1] + eps) / (double)front->tmap->offy);
+        x1 = ceil((hi[0] - eps) / (double)front->tmap->offx) - 1.0;
+        y1 = ceil((hi[1] - eps) / (double)front->tmap->offy) - 1.0;
+
+        if (!(x0 >= 0.0 && y0 >= 0.0 && x1 < (double)w && y1 < (double)h
+            && x1 >= x0 && y1 >= y0))
+            continue;
+
+        n = sat[((int)y1 + 1) * (w + 1) + (int)x1 + 1]
+            - sat[(int)y0 * (w + 1) + (int)x1 + 1]
+            - sat[((int)y1 + 1) * (w + 1) + (int)x0]
+            + sat[(int)y0 * (w + 1) + (int)x0];
+
+        if (n == (int)((x1 - x0 + 1.0) * (y1 - y0 + 1.0)))
+        {
+            mask[i] = 255;
+            hidden += 1;
+        }
+    }
+
+    return hidden;
+}
+
+/* Writes a quad of one hue and returns the number of vertices */
+static int
+rldisp_quad(sfVertex *verts, float l, float t, float r, float b, rlhue hue)
+{
+    sfColor color = {hue.r, hue.g, hue.b, hue.a};
+
+    verts[0] = (sfVertex){{l, t}, color, {0.0f, 0.0f}};
+    verts[1] = (sfVertex){{r, t}, color, {0.0f, 0.0f}};
+    verts[2] = (sfVertex){{r, b}, color, {0.0f, 0.0f}};
+    verts[3] = (sfVertex){{l, b}, color, {0.0f, 0.0f}};
+
+    return 4;
+}
+
+/* Holds back an outline of thickness d around a rect as four quads, the
+   area an outlined sfRectangleShape covers */
+static void
+rldisp_qbox(rldisp *this, float l, float t, float r, float b, float d,
+    rlhue hue)
+{
+    int n = 0;
+    sfVertex vert[16];
+
+    n += rldisp_quad(&vert[n], l - d, t - d, r + d, t, hue);
+    n += rldisp_quad(&vert[n], l - d, b, r + d, b + d, hue);
+    n += rldisp_quad(&vert[n], l - d, t, l, b, hue);
+    n += rldisp_quad(&vert[n], r, t, r + d, b, hue);
+
+    rldisp_qprim(this, vert, n);
+}
+
+/* Holds back quads in frame coordinates in deferred drawing, to be merged
+   with other primitives and backgrounds */
+static void
+rldisp_qprim(rldisp *this, const sfVertex *verts, int count)
+{
+    void *p = NULL;
+    struct rlqdraw *q = NULL;
+    int size;
+
+    this->frame.dirty = true;
+    this->frame.clear = false;
+
+    if (this->queue.count == RL_QUEUE_DRAWS)
+        rldisp_flush(this);
+
+    if (this->queue.pcount + count > this->queue.psize)
+    {
+        size = (this->queue.pcount + count) * 2;
+
+        /* Without room to hold them back the quads are drawn now */
+        if (!(p = rlrealloc(this->queue.prims,
+            (size_t)size * sizeof(sfVertex))))
+        {
+            rldisp_flush(this);
+            rldisp_dquads(this, verts, count);
+            return;
+        }
+
+        this->queue.prims = p;
+        this->queue.psize = size;
+    }
+
+    q = &this->queue.list[this->queue.count++];
+    q->tmap = NULL;
+    q->first = this->queue.pcount;
+    q->count = count;
+    q->bbox[0] = q->bbox[1] = HUGE_VALF;
+    q->bbox[2] = q->bbox[3] = -HUGE_VALF;
+
+    for (int i = 0; i < count; ++i)
+    {
+        q->bbox[0] = fminf(q->bbox[0], verts[i].position.x);
+        q->bbox[1] = fminf(q->bbox[1], verts[i].position.y);
+        q->bbox[2] = fmaxf(q->bbox[2], verts[i].position.x);
+        q->bbox[3] = fmaxf(q->bbox[3], verts[i].position.y);
+    }
+
+    memcpy(q->box, q->bbox, sizeof(q->box));
+    memcpy(&this->queue.prims[q->first], verts,
+        (size_t)count * sizeof(sfVertex));
+    this->queue.pcount += count;
+}
+
+/* Draws quads of one hue each in frame coordinates */
+static void
+rldisp_dquads(rldisp *this, const sfVertex *verts, int count)
+{
+    sfRenderTexture_drawPrimitives(this->frame.handle, verts, (size_t)count,
+        sfQuads, NULL);
+
+    this->stats.acc.draws += 1;
+    this->stats.acc.verts += count;
+    this->stats.acc.bytes += (size_t)count * sizeof(sfVertex);
+}
+
+extern void
+rldisp_dline(rldisp *this, int x0, int y0, int x1, int y1, int thick,
+    rlhue hue)
+{
+    float unit;
+    sfVertex vert[4];
+    double t0 = rlstats_now();
+    sfVector2f dir, udir, perp, off;
+
+    if (!this || !this->frame.handle)
+        return;
+
+    dir.x = (float)x1 - (float)x0;
+    dir.y = (float)y1 - (float)y0;
+
+    unit = sqrtf(dir.x * dir.x + dir.y * dir.y);
+
+    udir.x = dir.x / unit;
+    udir.y = dir.y / unit;
+
+    perp.x = -udir.y;
+    perp.y = udir.x;
+
+    off.x = perp.x * ((float)thick / 2.0f);
+    off.y = perp.y * ((float)thick / 2.0f);
+
+    vert[0].position.x = (float)x0 + off.x;
+    vert[0].position.y = (float)y0 + off.y;
+
+    vert[1].position.x = (float)x1 + off.x;
+    vert[1].position.y = (float)y1 + off.y;
+
+    vert[2].position.x = (float)x1 - off.x;
+    vert[2].position.y = (float)y1 - off.y;
+
+    vert[3].position.x = (float)x0 - off.x;
+    vert[3].position.y = (float)y0 - off.x;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        vert[i].color = (sfColor){hue.r, hue.g, hue.b, hue.a};
+        vert[i].texCoords = (sfVector2f){0.0f, 0.0f};
+    }
+
+    if (this->queue.defer)
+        rldisp_qprim(this, vert, 4);
+    else
+    {
+        /* The rltmaps held back are drawn first, under the primitive */
+        rldisp_flush(this);
+        rldisp_dquads(this, vert, 4);
+    }
+
+    this->frame.dirty = true;
+    this->frame.clear = false;
+    this->stats.acc.tprim += rlstats_now() - t0;
+}
+
+extern void
+rldisp_dboxo(rldisp *this, int x, int y, int width, int height, int thick,
+    rlhue hue)
+{
+    sfColor color;
+    sfRectangleShape *rect;
+    double t0 = rlstats_now();
+    sfVector2f pos = {(float)x, (float)y};
+    sfVector2f size = {(float)width, (float)height};
+
+    if (!this || !this->frame.handle || !(rect = this->prim.rect))
+        return;
+
+    if (this->queue.defer)
+    {
+        rldisp_qbox(this, pos.x, pos.y, pos.x + size.x, pos.y + size.y,
+            (float)thick, hue);
+        this->stats.acc.tprim += rlstats_now() - t0;
+        return;
+    }
+
+    rldisp_flush(this);
+    color = (sfColor){hue.r, hue.g, hue.b, hue.a};
+
+    sfRectangleShape_setSize(rect, size);
+    sfRectangleShape_setPosition(rect, pos);
+    sfRectangleShape_setOutlineColor(rect, color);
+    sfRectangleShape_setFillColor(rect, sfTransparent);
+    sfRectangleShape_setOutlineThickness(rect, (float)thick);
+
+    sfRenderTexture_drawRectangleShape(this->frame.handle, rect, NULL);
+    this->frame.dirty = true;
+    this->frame.clear = false;
+
+    /* An outlined sfRectangleShape is a 6 vertex fan for the (transparent)
+       fill plus a 10 vertex strip for the outline */
+    this->stats.acc.draws += 2;
+    this->stats.acc.verts += 16;
+    this->stats.acc.bytes += 16 * sizeof(sfVertex);
+    this->stats.acc.tprim += rlstats_now() - t0;
+}
+
+extern void
+rldisp_dboxi(rldisp *this, int x, int y, int width, int height, int thick,
+    rlhue hue)
+{
+    sfColor color;
+    sfRectangleShape *rect;
+    double t0 = rlstats_now();
+    sfVector2f pos = {(float)(x + thick), (float)(y + thick)};
+    sfVector2f size = {(float)(width - 2 * thick),
+        (float)(height - 2 * thick)};
+
+    if (!this || !this->frame.handle || !(rect = this->prim.rect))
+        return;
+
+    if (this->queue.defer)
+    {
+        rldisp_qbox(this, pos.x, pos.y, pos.x + size.x, pos.y + size.y,
+            (float)thick, hue);
+        this->stats.acc.tprim += rlstats_now() - t0;
+        return;
+    }
+
+    rldisp_flush(this);
+    color = (sfColor){hue.r, hue.g, hue.b, hue.a};
+
+    sfRectangleShape_setSize(rect, size);
+    sfRectangleShape_setPosition(rect, pos);
+    sfRectangleShape_setOutlineColor(rect, color);
+    sfRectangleShape_setFillColor(rect, sfTransparent);
+    sfRectangleShape_setOutlineThickness(rect, (float)thick);
+
+    sfRenderTexture_drawRectangleShape(this->frame.handle, rect, NULL);
+    this->frame.dirty = true;
+    this->frame.clear = false;
+
+    /* An outlined sfRectangleShape is a 6 vertex fan for the (transparent)
+       fill plus a 10 vertex strip for the outline */
+    this->stats.acc.draws += 2;
+    this->stats.acc.verts += 16;
+    this->stats.acc.bytes += 16 * sizeof(sfVertex);
+    this->stats.acc.tprim += rlstats_now() - t0;
+}
+
+extern void
+rldisp_dboxf(rldisp *this, int x, int y, int width, int height, rlhue hue)
+{
+    sfVertex vert[4];
+    sfColor color;
+    sfRectangleShape *rect;
+    double t0 = rlstats_now();
+    sfVector2f pos = {(float)x, (float)y};
+    sfVector2f size = {(float)width, (float)height};
+
+    if (!this || !this->frame.handle || !(rect = this->prim.rect))
+        return;
+
+    if (this->queue.defer)
+    {
+        rldisp_quad(vert, pos.x, pos.y, pos.x + size.x, pos.y + size.y, hue);
+        rldisp_qprim(this, vert, 4);
+        this->stats.acc.tprim += rlstats_now() - t0;
+        return;
+    }
+
+    rldisp_flush(this);
+    color = (sfColor){hue.r, hue.g, hue.b, hue.a};
+
+    sfRectangleShape_setSize(rect, size);
+    sfRectangleShape_setPosition(rect, pos);
+    sfRectangleShape_setFillColor(rect, color);
+    sfRectangleShape_setOutlineColor(rect, color);
+    sfRectangleShape_setOutlineThickness(rect, 0.0f);
+
+    sfRenderTexture_drawRectangleShape(this->frame.handle, rect, NULL);
+    this->frame.dirty = true;
+    this->frame.clear = false;
+
+    this->stats.acc.draws += 1;
+    this->stats.acc.verts += 6;
+    this->stats.acc.bytes += 6 * sizeof(sfVertex);
+    this->stats.acc.tprim += rlstats_now() - t0;
+}
+
+static void
+rldisp_evtarr(rldisp *this)
+{
+    /* Events beyond the pending limit in a single frame are not measured */
+    if (this->latency.count < RL_LATENCY_PENDING)
+        this->latency.arrival[this->latency.count++] = rlstats_now();
+}
+
+static void
+rldisp_evthdl(rldisp *this, const sfEvent *evt)
+{
+    switch (evt->type)
+    {
+        case sfEvtClosed:
+            sfRenderWindow_close(this->window.handle);
+            break;
+        case sfEvtResized:
+            rldisp_rsizd(this, (int)evt->size.width, (int)evt->size.height);
+            break;
+        case sfEvtGainedFocus:
+            /* SFML has no expose event, so the frame is shown again when
+               the window comes back to the front */
+            this->frame.dirty = true;
+            break;
+        case sfEvtMouseWheelScrolled:
+            this->window.scroll += (int)evt->mouseWheelScroll.delta;
+            rldisp_evtarr(this);
+            break;
+        case sfEvtKeyPressed:
+        case sfEvtMouseButtonPressed:
+            rldisp_evtarr(this);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Returns the time an idle rldisp waits for input until, or a negative
+   value to wait without limit */
+static double
+rldisp_until(rldisp *this, double now)
+{
+    double until = (this->idle.timeout > 0.0) ? now + this->idle.timeout
+        : -1.0;
+
+    if (this->idle.wake != 0.0 && (until < 0.0 || this->idle.wake < until))
+        until = this->idle.wake;
+
+    return until;
+}
+
+/* Blocks an idle rldisp until input arrives or its wait is over, and
+   returns the time it was blocked. A present still due doesn't wait. */
+static double
+rldisp_wait(rldisp *this)
+{
+    sfEvent evt;
+    bool got = false;
+    double t0 = rlstats_now(), until = rldisp_until(this, t0);
+
+    if (this->frame.dirty)
+        return 0.0;
+
+    if (until < 0.0)
+        got = sfRenderWindow_waitEvent(this->window.handle, &evt);
+    else
+        while (!(got = sfRenderWindow_pollEvent(this->window.handle, &evt))
+            && rlstats_now() < until)
+            sfSleep(sfMilliseconds(RL_IDLE_POLL));
+
+    if (got)
+        rldisp_evthdl(this, &evt);
+
+    if (this->idle.wake != 0.0 && rlstats_now() >= this->idle.wake)
+        this->idle.wake = 0.0;
+
+    return rlstats_now() - t0;
+}
+
+/* Returns a pixel of a glyph texture tinted with fghue and drawn over
+   bghue */
+static rlhue
+rldisp_curpix(const sfUint8 *src, rlhue fghue, rlhue bghue)
+{
+    int fa, ba, a;
+    rlhue hue;
+
+    fa = src[3] * fghue.a / 255;
+    ba = bghue.a * (255 - fa) / 255;
+
+    if (!(a = fa + ba))
+        return (rlhue){0, 0, 0, 0};
+
+    hue.r = (uint8_t)((src[0] * fghue.r / 255 * fa + bghue.r * ba) / a);
+    hue.g = (uint8_t)((src[1] * fghue.g / 255 * fa + bghue.g * ba) / a);
+    hue.b = (uint8_t)((src[2] * fghue.b / 255 * fa + bghue.b * ba) / a);
+    hue.a = (uint8_t)a;
+
+    return hue;
+}
+
+/* Makes a hardware cursor of the pixels of a glyph of an rltmap, scale times
+   their size. A font glyph is looked up at that size, a tilesheet cell is
+   scaled up. */
+static sfCursor *
+rldisp_mkcur(rltmap *tmap, rlcell cell, int scale, int hotx, int hoty)
+{
+    int w, h, step;
+    unsigned size;
+    size_t pitch;
+    sfGlyph g;
+    sfIntRect rect;
+    sfVector2u isize;
+    const sfTexture *texture = NULL;
+    const sfUint8 *src = NULL;
+    const struct rltglyph *entry = NULL;
+    sfImage *image = NULL;
+    rlhue *pixels = NULL;
+    sfCursor *handle = NULL;
+
+    if (tmap->load.pending)
+        rltmap_adopt(tmap);
+
+    if (cell.glyph < 0)
+        return NULL;
+
+    if (tmap->sheet)
+    {
+        if (!(entry = rltmap_glyph(tmap, cell.glyph)))
+            return NULL;
+
+        rect = entry->rect;
+        texture = tmap->sheet;
+        step = scale;
+    }
+    else if (tmap->font)
+    {
+        /* SFML keeps the glyphs of every size in textures of the font */
+        size = (unsigned)(tmap->csize * scale);
+        g = sfFont_getGlyph(tmap->font, (unsigned)cell.glyph, size, false,
+            0.0f);
+        rect = g.textureRect;
+        texture = sfFont_getTexture(tmap->font, size);
+        step = 1;
+    }
+    else
+        return NULL;
+
+    w = rect.width * step;
+    h = rect.height * step;
+
+    if (!w || !h || w > RL_CURSOR_MAXIMUM || h > RL_CURSOR_MAXIMUM)
+        return NULL;
+
+    /* The texture is read back whole, which only happens once per cursor */
+    if (!(image = sfTexture_copyToImage(texture))
+        || !(pixels = rlmalloc((size_t)(w * h) * sizeof(rlhue))))
+        goto error;
+
+    /* The rect is checked against the texture as it was read back */
+    isize = sfImage_getSize(image);
+
+    if (rect.left < 0 || rect.top < 0
+        || (unsigned)(rect.left + rect.width) > isize.x
+        || (unsigned)(rect.top + rect.height) > isize.y)
+        goto error;
+
+    src = sfImage_getPixelsPtr(image);
+    pitch = (size_t)isize.x * 4;
+
+    for (int j = 0; j < h; ++j)
+    for (int i = 0; i < w; ++i)
+        pixels[j * w + i] = rldisp_curpix(&src[(size_t)(rect.top + j / step)
+            * pitch + (size_t)(rect.left + i / step) * 4], cell.fghue,
+            cell.bghue);
+
+    /* The hot spot is kept inside the image */
+    hotx = (hotx < 0) ? 0 : (hotx * scale < w) ? hotx * scale : w - 1;
+    hoty = (hoty < 0) ? 0 : (hoty * scale < h) ? hoty * scale : h - 1;
+
+    handle = sfCursor_createFromPixels((const sfUint8 *)pixels,
+        (sfVector2u){(unsigned)w, (unsigned)h},
+        (sfVector2u){(unsigned)hotx, (unsigned)hoty});
+
+error:
+
+    rlfree(pixels);
+
+    if (image)
+        sfImage_destroy(image);
+
+    return handle;
+}
+
+static void
+rldisp_updlat(rldisp *this, double present, double swap)
+{
+    int b;
+    double p, s;
+    rllatency *l = &this->latency.last;
+
+    for (int i = 0; i < this->latency.count; ++i)
+    {
+        p = present - this->latency.arrival[i];
+        s = swap - this->latency.arrival[i];
+
+        if (!l->events || p < l->pmin)
+            l->pmin = p;
+        if (!l->events || s < l->smin)
+            l->smin = s;
+        if (p > l->pmax)
+            l->pmax = p;
+        if (s > l->smax)
+            l->smax = s;
+
+        b = (int)(p * 1000.0);
+        l->phist[(b < RL_LATENCY_BUCKETS) ? b : RL_LATENCY_BUCKETS - 1] += 1;
+        b = (int)(s * 1000.0);
+        l->shist[(b < RL_LATENCY_BUCKETS) ? b : RL_LATENCY_BUCKETS - 1] += 1;
+
+        this->latency.psum += p;
+        this->latency.ssum += s;
+        l->events += 1;
+    }
+
+    this->latency.count = 0;
+}
+
+static void
+rldisp_drwhud(rldisp *this)
+{
+    int n, level;
+    double t0, frame;
+    rlstats keep, last;
+    wchar_t line[RL_HUD_WIDTH + 1];
+    rlhue fg = {255, 255, 255, 255}, bg = {0, 0, 0, 192};
+    rlhue hot = {255, 220, 0, 255}, bar;
+
+    if (!this->hud.shown || !this->hud.tmap)
+    {
+        this->hud.count = 0;
+        return;
+    }
+
+    /* Everything the HUD draws is kept out of the frame's statistics and
+       reported as thud instead. Its allocations are counted all the same,
+       as they are taken from rlacount when the frame ends. */
+    t0 = rlstats_now();
+    keep = this->stats.acc;
+    rldisp_stats(this, &last);
+
+    for (int i = 0; i < this->hud.count; ++i)
+        rldisp_dboxo(this, this->hud.dirty[i].left, this->hud.dirty[i].top,
+            this->hud.dirty[i].width, this->hud.dirty[i].height, 1, hot);
+
+    this->hud.count = 0;
+
+    swprintf(line, RL_HUD_WIDTH + 1, L" %5.1f fps %6.2f ms p99 %6.2f ms",
+        last.tframe > 0.0 ? 1.0 / last.tframe : 0.0, last.tframe * 1000.0,
+        last.fp99 * 1000.0);
+    rldisp_hudln(this, line, 0, fg, bg);
+
+    swprintf(line, RL_HUD_WIDTH + 1, L" draws %d verts %d tiles %d",
+        last.draws, last.verts, last.tiles);
+    rldisp_hudln(this, line, 1, fg, bg);
+
+    swprintf(line, RL_HUD_WIDTH + 1, L" maps %d %.2f ms prsnt %.2f ms",
+        last.nmaps, last.tmap * 1000.0, last.tprsnt * 1000.0);
+    rldisp_hudln(this, line, 2, fg, bg);
+
+    swprintf(line, RL_HUD_WIDTH + 1, L" hud %.2f ms gmiss %d kb %zu",
+        last.thud * 1000.0, last.gmiss, last.bytes / 1024);
+    rldisp_hudln(this, line, 3, fg, bg);
+
+    /* Frame time graph, one column per frame with the latest on the right */
+    n = (this->stats.count < RL_HUD_WIDTH) ? this->stats.count : RL_HUD_WIDTH;
+
+    for (int x = 0; x < RL_HUD_WIDTH; ++x)
+    {
+        frame = 0.0;
+
+        if (x >= RL_HUD_WIDTH - n)
+            frame = this->stats.frames[(this->stats.head - RL_HUD_WIDTH + x
+                + RL_STATS_FRAMES) % RL_STATS_FRAMES];
+
+        level = (int)(frame / RL_HUD_SCALE * (double)(RL_HUD_GRAPH * 8));
+        bar = (frame < RL_HUD_SCALE / 2.0) ? (rlhue){0, 220, 0, 255}
+            : (frame < RL_HUD_SCALE) ? hot : (rlhue){255, 40, 40, 255};
+
+        for (int y = 0; y < RL_HUD_GRAPH; ++y)
+        {
+            n = level - (RL_HUD_GRAPH - 1 - y) * 8;
+            n = (n < 0) ? 0 : (n > 8) ? 8 : n;
+            rltmap_pcell(this->hud.tmap, (rlcell){n ? (wchar_t)(0x2580 + n)
+                : L' ', bar, bg, 0.0f, 0.0f, RL_TILE_TEXT}, x,
+                RL_HUD_HEIGHT - RL_HUD_GRAPH + y);
+        }
+    }
+
+    rldisp_dtmap(this, this->hud.tmap);
+
+    /* Mark the frame time of 60 fps on the graph */
+    rldisp_dline(this, 0, RL_HUD_HEIGHT * RL_HUD_TILEY - RL_HUD_GRAPH
+        * RL_HUD_TILEY / 2, RL_HUD_WIDTH * RL_HUD_TILEX, RL_HUD_HEIGHT
+        * RL_HUD_TILEY - RL_HUD_GRAPH * RL_HUD_TILEY / 2, 1, hot);
+
+    /* Held back draws of the HUD are submitted before the statistics are
+       restored */
+    rldisp_flush(this);
+
+    this->stats.acc = keep;
+    this->stats.acc.thud = rlstats_now() - t0;
+    RL_TRACE_END("hud", t0, 0);
+}
+
+static void
+rldisp_hudln(rldisp *this, wchar_t *line, int y, rlhue fg, rlhue bg)
+{
+    size_t len = wcslen(line);
+
+    /* Pad with spaces so the text of the previous frame is overwritten */
+    for (size_t i = len; i < RL_HUD_WIDTH; ++i)
+        line[i] = L' ';
+
+    line[RL_HUD_WIDTH] = L'\0';
+    rltmap_wstrr(this->hud.tmap, line, fg, bg, RL_TILE_CENTER, 0, y);
+}
+
+static void
+rldisp_updstats(rldisp *this, double now)
+{
+    if (!this)
+        return;
+
+    this->stats.acc.tframe = now - this->stats.prev;
+    this->stats.prev = now;
+
+    this->stats.frames[this->stats.head] = this->stats.acc.tframe;
+    this->stats.head = (this->stats.head + 1) % RL_STATS_FRAMES;
+
+    if (this->stats.count < RL_STATS_FRAMES)
+        this->stats.count += 1;
+
+    /* Allocations are not tied to an rldisp, so a frame counts all those
+       made by the library since the last frame of this rldisp ended */
+    this->stats.acc.allocs = rlacount - this->stats.allocs;
+    this->stats.allocs = rlacount;
+
+    /* Steady state frames are not expected to allocate at all */
+    assert(!this->stats.noalloc || !this->stats.acc.allocs);
+
+    this->stats.last = this->stats.acc;
+    memset(&this->stats.acc, 0, sizeof(this->stats.acc));
+}
+
+void
+rldisp_prsnt(rldisp *this)
+{
+    double t0, t1;
+    sfSprite *sprite = NULL;
+
+    if (!this || !this->window.handle || !this->frame.handle
+        || !(sprite = this->frame.sprite))
+        return;
+
+    /* An idle rldisp shows nothing new unless the frame changed */
+    if (this->idle.on && !this->frame.dirty)
+        return;
+
+    rldisp_flush(this);
+    rldisp_drwhud(this);
+    t0 = rlstats_now();
+
+    this->window.scroll = 0;
+    sfRenderTexture_display(this->frame.handle);
+    
+    sfSprite_setScale(sprite, this->frame.scale);
+    sfSprite_setTexture(sprite, sfRenderTexture_getTexture(this->frame.handle),
+        false);
+
+    sfRenderWindow_drawSprite(this->window.handle, sprite, NULL);
+
+    t1 = rlstats_now();
+    sfRenderWindow_display(this->window.handle);
+    this->stats.acc.tswap = rlstats_now() - t1;
+    rldisp_updlat(this, t1, t1 + this->stats.acc.tswap);
+    RL_TRACE_END("swap", t1, 0);
+
+    this->stats.acc.draws += 1;
+    this->stats.acc.verts += 4;
+    this->stats.acc.bytes += 4 * sizeof(sfVertex);
+    this->stats.acc.tprsnt = rlstats_now() - t0;
+    RL_TRACE_END("rldisp_prsnt", t0, 0);
+
+    this->frame.dirty = false;
+
+    if (this->stats.tfirst == 0.0)
+        this->stats.tfirst = rlstats_now() - this->stats.born;
+
+    /* A mode switch or resize is done once a frame is shown after it */
+    if (this->stats.switched != 0.0)
+    {
+        this->stats.tmode = rlstats_now() - this->stats.switched;
+        this->stats.switched = 0.0;
+    }
+
+    rldisp_updstats(this, rlstats_now());
+}
+
+void
+rldisp_stats(rldisp *this, rlstats *stats)
+{
+    int n;
+    double sorted[RL_STATS_FRAMES], sum = 0.0;
+
+    if (!this || !stats)
+        return;
+
+    *stats = this->stats.last;
+    stats->abytes = rlabytes;
+    stats->tfirst = this->stats.tfirst;
+    stats->tmode = this->stats.tmode;
+
+    if (!(n = this->stats.count))
+        return;
+
+    memcpy(sorted, this->stats.frames, (size_t)n * sizeof(double));
+    qsort(sorted, (size_t)n, sizeof(double), rlstats_cmp);
+
+    for (int i = 0; i < n; ++i)
+        sum += sorted[i];
+
+    stats->frames = n;
+    stats->fmin = sorted[0];
+    stats->favg = sum / (double)n;
+    stats->fp99 = sorted[(int)ceil(0.99 * (double)n) - 1];
+}
+
+void
+rldisp_noalloc(rldisp *this, bool enabled)
+{
+    if (!this)
+        return;
+
+    this->stats.noalloc = enabled;
+}
+
+void
+rldisp_latency(rldisp *this, rllatency *latency, bool reset)
+{
+    if (!this)
+        return;
+
+    if (latency)
+    {
+        *latency = this->latency.last;
+
+        if (latency->events)
+        {
+            latency->pavg = this->latency.psum / (double)latency->events;
+            latency->savg = this->latency.ssum / (double)latency->events;
+        }
+    }
+
+    if (reset)
+    {
+        memset(&this->latency.last, 0, sizeof(rllatency));
+        this->latency.psum = 0.0;
+        this->latency.ssum = 0.0;
+    }
+}
+
+bool
+rldisp_hudset(rldisp *this, const char *font, rlkey key)
+{
+    if (!this)
+        return false;
+
+    if (this->hud.tmap)
+        rltmap_free(this->hud.tmap);
+
+    this->hud.tmap = NULL;
+    this->hud.key = key;
+    this->hud.down = false;
+
+    if (!font)
+    {
+        this->hud.shown = false;
+        return true;
+    }
+
+    if (!(this->hud.tmap = rltmap_init(font, RL_HUD_TILEY, 65536,
+        RL_HUD_WIDTH, RL_HUD_HEIGHT, RL_HUD_TILEX, RL_HUD_TILEY)))
+    {
+        this->hud.shown = false;
+        return false;
+    }
+
+    /* Cache every glyph the HUD can show up front, so a frame drawing a
+       glyph for the first time doesn't count against rldisp_noalloc(2) */
+    for (wchar_t g = L' '; g <= L'~'; ++g)
+        rltmap_glyph(this->hud.tmap, g);
+
+    for (wchar_t g = 0x2581; g <= 0x2588; ++g)
+        rltmap_glyph(this->hud.tmap, g);
+
+    return true;
+}
+
+bool
+rldisp_shwhud(rldisp *this, bool visible)
+{
+    if (!this)
+        return false;
+
+    this->hud.shown = visible && this->hud.tmap;
+    return this->hud.shown;
+}
+
+bool
+rldisp_trace(rldisp *this, bool enabled)
+{
+#ifdef RL_TRACE
+    if (!this)
+        return false;
+
+    rltrace.on = enabled;
+    return rltrace.on;
+#else
+    UNUSED(this);
+    UNUSED(enabled);
+    return false;
+#endif
+}
+
+bool
+rldisp_trdump(rldisp *this, const char *path)
+{
+#ifdef RL_TRACE
+    FILE *file = NULL;
+    const struct rltevt *evt = NULL;
+    int first = rltrace.wrap ? rltrace.head : 0;
+    int count = rltrace.wrap ? RL_TRACE_EVENTS : rltrace.head;
+
+    if (!this || !path || !(file = fopen(path, "w")))
+        return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (int i = 0; i < count; ++i)
+    {
+        evt = &rltrace.evts[(first + i) % RL_TRACE_EVENTS];
+
+        /* Complete events carry their duration, instant events a scope */
+        if (evt->dur < 0.0)
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"p\","
+                "\"ts\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"count\":%d}}",
+                evt->name, evt->ts * 1000000.0, evt->count);
+        else
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+                "\"dur\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"count\":%d}}",
+                evt->name, evt->ts * 1000000.0, evt->dur * 1000000.0,
+                evt->count);
+
+        fputs((i + 1 < count) ? ",\n" : "\n", file);
+    }
+
+    fprintf(file, "]}\n");
+
+    return !fclose(file);
+#else
+    UNUSED(this);
+    UNUSED(path);
+    return false;
+#endif
+}
+
+bool
+rldisp_key(rldisp *this, rlkey key)
+{
+    if (!this || key < 0 || key >= RL_KEY_MAXIMUM)
+        return false;
+
+    /* *this is unused in the SFML renderer implementation, but the interface
+       requires it to be passed for compatibility with other backends */
+    UNUSED(this);
+
+    switch (key)
+    {
+    case RL_KEY_A:
+        return sfKeyboard_isKeyPressed(sfKeyA);
     case RL_KEY_B:
         return sfKeyboard_isKeyPressed(sfKeyB);
     case RL_KEY_C:
@@ -701,347 +3232,1368 @@ rldisp_key(rldisp *this, rlkey key)
     default:
         return false;
     }
-}
+}
+
+int
+rldisp_mousx(rldisp *this)
+{
+    int x;
+
+    if (!this || !this->window.handle)
+        return 0;
+
+    x = sfMouse_getPositionRenderWindow(this->window.handle).x;
+
+    if (x < 0 || x > this->window.width)
+        return x;
+
+    return (int)((float)x / this->frame.scale.x);
+}
+
+int
+rldisp_mousy(rldisp *this)
+{
+    int y;
+
+    if (!this || !this->window.handle)
+        return 0;
+
+    y = sfMouse_getPositionRenderWindow(this->window.handle).y;
+
+    if (y < 0 || y > this->window.height)
+        return y;
+
+    return (int)((float)y / this->frame.scale.y);
+}
+
+void
+rldisp_mouse(rldisp *this, int *x, int *y)
+{
+    sfVector2i m;
+
+    if (!this || !this->window.handle || !x || !y)
+        return;
+
+    m = sfMouse_getPositionRenderWindow(this->window.handle);
+
+    if (m.x < 0 || m.x > this->window.width)
+        *x = -1;
+    else
+        *x = (int)((float)m.x / this->frame.scale.x);
+
+    if (m.y < 0 || m.y > this->window.height)
+        *y = -1;
+    else
+        *y = (int)((float)m.y / this->frame.scale.y);
+}
+
+extern int
+rldisp_mscrl(rldisp *this)
+{
+    if (!this)
+        return 0;
+
+    return this->window.scroll;
+}
+
+extern double
+rldisp_delta(void)
+{
+    sfTime t = sfClock_restart(rldclock);
+    return (double)sfTime_asMicroseconds(t) / 1000000.0;
+}
+
+/******************************************************************************
+rltile function implementations
+******************************************************************************/
+
+static void
+rltile_set(rltile *this, wchar_t glyph, rlhue fghue, rlhue bghue,
+    rlttype type, float right, float bottom)
+{
+    if (!this)
+        return;
+
+    this->glyph = glyph;
+    
+    for (int i = 0; i < 4; ++i)
+    {
+        this->fghue[i] = (sfColor){fghue.r, fghue.g, fghue.b, fghue.a};
+        this->bghue[i] = (sfColor){bghue.r, bghue.g, bghue.b, bghue.a};
+    }
+
+    this->type = type;
+    this->right = right;
+    this->bottom = bottom;
+}
+
+rltile *
+rltile_init(wchar_t glyph, rlhue fghue, rlhue bghue, rlttype type, float right,
+    float bottom)
+{
+    rltile *this = NULL;
+
+    if (!(this = rlmalloc(sizeof(rltile))))
+        return NULL;
+
+    rltile_set(this, glyph, fghue, bghue, type, right, bottom);
+
+    return this;
+}
+
+rltile *
+rltile_null(void)
+{
+    rlhue fg = {255, 0, 0, 255};
+    rlhue bg = {0, 0, 255, 255};
+
+    return rltile_init(L'?', fg, bg, RL_TILE_CENTER, 0.0f, 0.0f);
+}
+
+void
+rltile_glyph(rltile *this, wchar_t glyph)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    this->glyph = glyph;
+}
+
+void
+rltile_fghue(rltile *this, rlhue hue)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    for (size_t i = 0; i < 4; ++i)
+        this->fghue[i] = (sfColor){hue.r, hue.g, hue.b, hue.a};
+}
+
+void
+rltile_bghue(rltile *this, rlhue hue)
+{
+    if (RL_INVALID(!this))
+        return;
+
+    for (size_t i = 0; i < 4; ++i)
+        this->bghue[i] = (sfColor){hue.r, hue.g, hue.b, hue.a};
+}
+
+void
+rltile_type(rltile *this, rlttype type)
+{
+    if (!this)
+        return;
+
+    this->type = type;
+}
+
+void
+rltile_right(rltile *this, float right)
+{
+    if (!this)
+        return;
+
+    this->right = right;
+}
+
+void
+rltile_bottm(rltile *this, float bottom)
+{
+    if (!this)
+        return;
+
+    this->bottom = bottom;
+}
+
+extern void
+rltile_shift(rltile *this, float right, float bottom)
+{
+    if (!this)
+        return;
+
+    this->right = right;
+    this->bottom = bottom;
+}
+
+void
+rltile_free(rltile *this)
+{
+    if (!this)
+        return;
+
+    rlfree(this);
+}
+
+/******************************************************************************
+rltpool function implementations
+******************************************************************************/
+
+static bool
+rltpool_grow(rltpool *this)
+{
+    struct rltslab *slab = NULL;
+
+    if (!this)
+        return false;
+
+    if (!(slab = rlmalloc(sizeof(struct rltslab)
+        + (size_t)this->count * sizeof(union rltnode))))
+        return false;
+
+    slab->next = this->slabs;
+    this->slabs = slab;
+
+    /* Thread the new nodes onto the free list */
+    for (int i = 0; i < this->count; ++i)
+    {
+        slab->nodes[i].next = this->head;
+        this->head = &slab->nodes[i];
+    }
+
+    return true;
+}
+
+rltpool *
+rltpool_init(int count)
+{
+    rltpool *this = NULL;
+
+    if (count <= 0 || !(this = rlmalloc(sizeof(rltpool))))
+        return NULL;
+
+    this->count = count;
+    this->head = NULL;
+    this->slabs = NULL;
+
+    if (!rltpool_grow(this))
+        goto error;
+
+    return this;
+
+error:
+
+    rltpool_free(this);
+    return NULL;
+}
+
+rltile *
+rltpool_take(rltpool *this)
+{
+    union rltnode *node = NULL;
+    rlhue fg = {255, 0, 0, 255};
+    rlhue bg = {0, 0, 255, 255};
+
+    if (!this || (!this->head && !rltpool_grow(this)))
+        return NULL;
+
+    node = this->head;
+    this->head = node->next;
+
+    rltile_set(&node->tile, L'?', fg, bg, RL_TILE_CENTER, 0.0f, 0.0f);
+
+    return &node->tile;
+}
+
+void
+rltpool_give(rltpool *this, rltile *tile)
+{
+    union rltnode *node = (union rltnode *)tile;
+
+    if (!this || !tile)
+        return;
+
+    node->next = this->head;
+    this->head = node;
+}
+
+void
+rltpool_free(rltpool *this)
+{
+    struct rltslab *next = NULL;
+
+    if (!this)
+        return;
+
+    while (this->slabs)
+    {
+        next = this->slabs->next;
+        rlfree(this->slabs);
+        this->slabs = next;
+    }
+
+    rlfree(this);
+}
+
+/******************************************************************************
+rltmap function implementations
+******************************************************************************/
+
+static void
+rltmap_shift(rltmap *this, wchar_t glyph, rlttype type, float right,
+    float bottom, float *r, float *b, sfIntRect *rect)
+{
+    const struct rltglyph *g = NULL;
+
+    if (!this || !r || !b || !rect)
+        return;
+
+    if (!(g = rltmap_glyph(this, glyph)))
+        g = &rltgnone;
+
+    *r = 0.0f;
+    *b = 0.0f;
+    *rect = g->rect;
+
+    switch (type)
+    {
+    case RL_TILE_TEXT:
+        *r = g->left;
+        *b = (float)(this->offy) + g->top;
+        break;
+    case RL_TILE_EXACT:
+        *r = (float)(int)(((float)(this->offx - g->rect.width)
+            / 2.0f));
+        *b = (float)(int)(((float)(this->offy - g->rect.height)
+            / 2.0f));
+        *r += right;
+        *b += bottom;
+        break;
+    case RL_TILE_FLOOR:
+        *r = (float)(int)((float)(this->offx - g->rect.width)
+            / 2.0f);
+        *b = (float)(int)((float)(this->offy - g->rect.height));
+        break;
+    case RL_TILE_CENTER:
+        *r = (float)(int)((float)(this->offx - g->rect.width)
+            / 2.0f);
+        *b = (float)(int)((float)(this->offy - g->rect.height)
+            / 2.0f);
+        break;
+    }
+}
+
+/* Loading thread of rltmap_async(7), which only defers opening the font.
+   sfFont keeps a FreeType library per font, so opening it here touches
+   nothing the main thread uses, and allocates nothing through rlahooks.
+   Glyphs are rasterized on first use, as for rltmap_init(7). */
+static void
+rltmap_work(void *arg)
+{
+    rltmap *this = arg;
+    sfFont *font = sfFont_createFromFile(this->load.path);
+
+    sfMutex_lock(this->load.lock);
+    this->load.font = font;
+    this->load.done = true;
+    sfMutex_unlock(this->load.lock);
+}
+
+/* Waits for the loading thread of an rltmap_async(7) rltmap and takes over
+   its font. An rltmap whose font failed to load draws no glyphs. */
+static void
+rltmap_adopt(rltmap *this)
+{
+    sfThread_wait(this->load.thread);
+    sfThread_destroy(this->load.thread);
+    sfMutex_destroy(this->load.lock);
+    this->load.thread = NULL;
+    this->load.lock = NULL;
+    this->load.pending = false;
+
+    rlfree(this->load.path);
+    this->load.path = NULL;
+
+    this->font = this->load.font;
+    this->load.failed = !this->font;
+}
+
+static const struct rltglyph *
+rltmap_glyph(rltmap *this, wchar_t glyph)
+{
+    sfGlyph g;
+    sfVector2u size;
+    int page = (int)glyph / RL_GLYPH_PAGE;
+    struct rltglyph *entry = NULL;
+
+    if (!this)
+        return NULL;
+
+    if (this->load.pending)
+        rltmap_adopt(this);
+
+    /* Glyphs past cnum (e.g. from rltmap_wstrr(7)) are looked up uncached */
+    if (glyph >= 0 && page < this->glyph.pages)
+    {
+        if (!this->glyph.list[page] && this->sheet)
+            return &rltgnone;
+
+        if (!this->glyph.list[page] && !(this->glyph.list[page]
+            = rlcalloc(RL_GLYPH_PAGE, sizeof(struct rltglyph))))
+            return NULL;
+
+        entry = &this->glyph.list[page][(int)glyph % RL_GLYPH_PAGE];
+
+        if (entry->ok)
+            return entry;
+    }
+    else
+    {
+        entry = &this->glyph.scratch;
+    }
 
-int
-rldisp_mousx(rldisp *this)
-{
-    int x;
+    /* Every glyph of a tilesheet is cached by rltmap_sheet */
+    if (this->sheet || !this->font)
+        return &rltgnone;
 
-    if (!this || !this->window.handle)
-        return 0;
+    g = sfFont_getGlyph(this->font, (unsigned)glyph, (unsigned)this->csize,
+        false, 0.0f);
 
-    x = sfMouse_getPositionRenderWindow(this->window.handle).x;
+    entry->ok = true;
+    entry->left = g.bounds.left;
+    entry->top = g.bounds.top;
+    entry->rect = g.textureRect;
 
-    if (x < 0 || x > this->window.width)
-        return x;
+    /* A new glyph is rasterized into the font's atlas. When the atlas is out
+       of room SFML grows it, which re-uploads the whole texture. */
+    size = sfTexture_getSize(sfFont_getTexture(this->font,
+        (unsigned)this->csize));
 
-    return (int)((float)x / this->frame.scale.x);
+    this->stats.gmiss += 1;
+    this->stats.bytes += (size_t)(g.textureRect.width
+        * g.textureRect.height) * 4;
+
+    if (size.x != this->glyph.size.x || size.y != this->glyph.size.y)
+    {
+        if (this->glyph.size.x)
+        {
+            this->stats.agrow += 1;
+            rlacount += 1;
+            this->stats.bytes += (size_t)size.x * size.y * 4;
+            RL_TRACE_MARK("atlas growth", (int)(size.x * size.y));
+        }
+
+        rlabytes += (size_t)size.x * size.y * 4;
+        rlabytes -= (size_t)this->glyph.size.x * this->glyph.size.y * 4;
+        this->glyph.size = size;
+    }
+
+    return entry;
 }
 
-int
-rldisp_mousy(rldisp *this)
+static void
+rltmap_updtile(rltmap *this, rltile *t, int x, int y)
 {
-    int y;
+    int i;
+    sfIntRect rect;
+    float r, b;
 
-    if (!this || !this->window.handle)
-        return 0;
+    if (RL_INVALID(!this || !t))
+        return;
 
-    y = sfMouse_getPositionRenderWindow(this->window.handle).y;
+    rltmap_shift(this, t->glyph, t->type, t->right, t->bottom, &r, &b, &rect);
 
-    if (y < 0 || y > this->window.height)
-        return y;
+    i = rltmap_index(this, x, y);
 
-    return (int)((float)y / this->frame.scale.y);
+    if (this->cmpct)
+    {
+        rltmap_updcmp(this, i, t->glyph, t->fghue[0], t->bghue[0], r, b);
+    }
+    else
+    {
+        rltmap_updfg(this, i, t->fghue, x, y, r, b, &rect);
+        rltmap_updbg(this, i, t->bghue, x, y);
+    }
+
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
 }
 
-void
-rldisp_mouse(rldisp *this, int *x, int *y)
+static void
+rltmap_updcell(rltmap *this, const rlcell *c, int x, int y)
 {
-    sfVector2i m;
+    int i;
+    float r, b;
+    sfIntRect rect;
+    sfColor fg[4], bg[4];
 
-    if (!this || !this->window.handle || !x || !y)
+    if (RL_INVALID(!this || !c))
         return;
 
-    m = sfMouse_getPositionRenderWindow(this->window.handle);
+    rltmap_shift(this, c->glyph, c->type, c->right, c->bottom, &r, &b, &rect);
 
-    if (m.x < 0 || m.x > this->window.width)
-        *x = -1;
-    else
-        *x = (int)((float)m.x / this->frame.scale.x);
+    for (int j = 0; j < 4; ++j)
+    {
+        fg[j] = (sfColor){c->fghue.r, c->fghue.g, c->fghue.b, c->fghue.a};
+        bg[j] = (sfColor){c->bghue.r, c->bghue.g, c->bghue.b, c->bghue.a};
+    }
 
-    if (m.y < 0 || m.y > this->window.height)
-        *y = -1;
+    i = rltmap_index(this, x, y);
+
+    if (this->cmpct)
+    {
+        rltmap_updcmp(this, i, c->glyph, fg[0], bg[0], r, b);
+    }
     else
-        *y = (int)((float)m.y / this->frame.scale.y);
+    {
+        rltmap_updfg(this, i, fg, x, y, r, b, &rect);
+        rltmap_updbg(this, i, bg, x, y);
+    }
+
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
 }
 
-extern int
-rldisp_mscrl(rldisp *this)
+static void
+rltmap_updfg(rltmap *this, int i, const sfColor *hue, int x, int y, float r,
+    float b, sfIntRect *rect)
 {
-    if (!this)
-        return 0;
+    size_t vi = (size_t)i * 4;
 
-    return this->window.scroll;
+    if (RL_INVALID(!this || !hue || !rect))
+        return;
+
+    sfVertexArray_getVertex(this->fg, vi)->position = (sfVector2f){
+        (float)x * (float)(this->offx) + r,
+        (float)y * (float)(this->offy) + b
+    };
+
+    sfVertexArray_getVertex(this->fg, vi + 1)->position = (sfVector2f){
+        (float)x * (float)(this->offx) + (float)(rect->width) + r,
+        (float)y * (float)(this->offy) + b
+    };
+
+    sfVertexArray_getVertex(this->fg, vi + 2)->position = (sfVector2f){
+        (float)x * (float)(this->offx) + (float)(rect->width) + r,
+        (float)y * (float)(this->offy) + (float)(rect->height) + b
+    };
+
+    sfVertexArray_getVertex(this->fg, vi + 3)->position = (sfVector2f){
+        (float)x * (float)(this->offx) + r,
+        (float)y * (float)(this->offy) + (float)(rect->height) + b
+    };
+
+    sfVertexArray_getVertex(this->fg, vi)->texCoords = (sfVector2f){
+        (float)(rect->left),
+        (float)(rect->top)
+    };
+
+    sfVertexArray_getVertex(this->fg, vi + 1)->texCoords = (sfVector2f){
+        (float)(rect->left) + (float)(rect->width),
+        (float)(rect->top)
+    };
+
+    sfVertexArray_getVertex(this->fg, vi + 2)->texCoords = (sfVector2f){
+        (float)(rect->left) + (float)(rect->width),
+        (float)(rect->top) + (float)(rect->height)
+    };
+
+    sfVertexArray_getVertex(this->fg, vi + 3)->texCoords = (sfVector2f){
+        (float)(rect->left),
+        (float)(rect->top) + (float)(rect->height)
+    };
+
+    sfVertexArray_getVertex(this->fg, vi)->color = hue[0];
+    sfVertexArray_getVertex(this->fg, vi + 1)->color = hue[1];
+    sfVertexArray_getVertex(this->fg, vi + 2)->color = hue[2];
+    sfVertexArray_getVertex(this->fg, vi + 3)->color = hue[3];
 }
 
-extern double
-rldisp_delta(void)
+static void
+rltmap_updbg(rltmap *this, int i, const sfColor *hue, int x, int y)
 {
-    sfTime t = sfClock_restart(rldclock);
-    return (double)sfTime_asMicroseconds(t) / 1000000.0;
+    size_t vi = (size_t)i * 4;
+
+    if (RL_INVALID(!this || !hue))
+        return;
+
+    sfVertexArray_getVertex(this->bg, vi)->position = (sfVector2f){
+        (float)x * (float)(this->offx),
+        (float)y * (float)(this->offy)
+    };
+
+    sfVertexArray_getVertex(this->bg, vi + 1)->position = (sfVector2f){
+        (float)x * (float)(this->offx) + (float)(this->offx),
+        (float)y * (float)(this->offy)
+    };
+
+    sfVertexArray_getVertex(this->bg, vi + 2)->position = (sfVector2f){
+        (float)x * (float)(this->offx) + (float)(this->offx),
+        (float)y * (float)(this->offy) + (float)(this->offy)
+    };
+
+    sfVertexArray_getVertex(this->bg, vi + 3)->position = (sfVector2f){
+        (float)x * (float)(this->offx),
+        (float)y * (float)(this->offy) + (float)(this->offy)
+    };
+
+    sfVertexArray_getVertex(this->bg, vi)->color = hue[0];
+    sfVertexArray_getVertex(this->bg, vi + 1)->color = hue[1];
+    sfVertexArray_getVertex(this->bg, vi + 2)->color = hue[2];
+    sfVertexArray_getVertex(this->bg, vi + 3)->color = hue[3];
 }
 
-/******************************************************************************
-rltile function implementations
-******************************************************************************/
+/* Rebuilds the background spans of a row of an rltmap from its tiles */
+static void
+rltmap_runbg(rltmap *this, int y)
+{
+    int n = 0;
+    float l, t;
+    bool plain;
+    sfColor hue;
+    const sfVertex *v = NULL;
+    struct rlbrun *spans = &this->merge.spans[y * this->width];
+
+    for (int x = 0; x < this->width; ++x)
+    {
+        if (this->cmpct)
+        {
+            /* The hues of a compact tile are uniform */
+            hue = this->cmpct[rltmap_index(this, x, y)].bg;
+            plain = true;
+        }
+        else
+        {
+            v = sfVertexArray_getVertex(this->bg,
+                (size_t)rltmap_index(this, x, y) * 4);
+            l = (float)x * (float)this->offx;
+            t = (float)y * (float)this->offy;
+
+            /* A tile never written has an empty quad */
+            if (v[0].position.x == v[2].position.x
+                && v[0].position.y == v[2].position.y)
+                continue;
+
+            hue = v[0].color;
+            plain = v[0].position.x == l && v[0].position.y == t
+                && v[2].position.x == l + (float)this->offx
+                && v[2].position.y == t + (float)this->offy
+                && !memcmp(&v[0].color, &v[1].color, sizeof(sfColor))
+                && !memcmp(&v[0].color, &v[2].color, sizeof(sfColor))
+                && !memcmp(&v[0].color, &v[3].color, sizeof(sfColor));
+        }
 
-rltile *
-rltile_init(wchar_t glyph, rlhue fghue, rlhue bghue, rlttype type, float right,
-    float bottom)
+        /* Transparent backgrounds draw nothing, unless the palette gives
+           them a hue */
+        if (plain && !hue.a && !this->palet.hues)
+            continue;
+
+        if (plain && n && !spans[n - 1].raw && spans[n - 1].x1 == x - 1
+            && !memcmp(&spans[n - 1].hue, &hue, sizeof(sfColor)))
+            spans[n - 1].x1 = x;
+        else
+            spans[n++] = (struct rlbrun){x, x, -1, !plain, hue};
+    }
+
+    this->merge.nspans[y] = n;
+}
+
+/* Cuts the spans of row y of an rltmap into runs, stacking them onto the
+   runs of the row above. A run of the row above, of the same hue, that
+   begins where what is left of a span begins, or ends where it ends,
+   extends its rect down over that part of the span, so a cut never adds a
+   rect to the row. Returns the number of rects. */
+static int
+rltmap_stkbg(rltmap *this, int y, int rects)
 {
-    rltile *this = NULL;
+    int n = 0, p = 0, q, np = y ? this->merge.count[y - 1] : 0, x0;
+    const struct rlbrun *span = NULL;
+    const struct rlbrun *prev = &this->merge.runs[(y - !!y) * this->width];
+    struct rlbrun *runs = &this->merge.runs[y * this->width];
 
-    if (!(this = malloc(sizeof(rltile))))
-        return NULL;
+    this->merge.first[y] = rects;
 
-    this->glyph = glyph;
-    
-    for (int i = 0; i < 4; ++i)
+    for (int i = 0; i < this->merge.nspans[y]; ++i)
     {
-        this->fghue[i] = (sfColor){fghue.r, fghue.g, fghue.b, fghue.a};
-        this->bghue[i] = (sfColor){bghue.r, bghue.g, bghue.b, bghue.a};
+        span = &this->merge.spans[y * this->width + i];
+
+        if (span->raw)
+        {
+            runs[n++] = *span;
+            continue;
+        }
+
+        for (x0 = span->x0; x0 <= span->x1; )
+        {
+            /* Both rows are in order of x, so a single pass pairs them up */
+            while (p < np && prev[p].x1 < x0)
+                p += 1;
+
+            if (p < np && !prev[p].raw && prev[p].x0 == x0
+                && prev[p].x1 <= span->x1
+                && !memcmp(&prev[p].hue, &span->hue, sizeof(sfColor)))
+            {
+                runs[n] = (struct rlbrun){x0, prev[p].x1, prev[p].rect,
+                    false, span->hue};
+                this->merge.rects[prev[p].rect].y1 = y;
+                x0 = runs[n++].x1 + 1;
+                continue;
+            }
+
+            /* A new rect up to a run above ending with the span, if any */
+            for (q = p; q < np && prev[q].x1 < span->x1; ++q)
+                ;
+
+            runs[n] = (struct rlbrun){x0, span->x1, rects, false, span->hue};
+
+            if (q < np && !prev[q].raw && prev[q].x0 > x0
+                && prev[q].x1 == span->x1
+                && !memcmp(&prev[q].hue, &span->hue, sizeof(sfColor)))
+                runs[n].x1 = prev[q].x0 - 1;
+
+            this->merge.rects[rects++] = (struct rlbrect){x0, y, runs[n].x1,
+                y, span->hue};
+            x0 = runs[n++].x1 + 1;
+        }
     }
 
-    this->type = type;
-    this->right = right;
-    this->bottom = bottom;
+    this->merge.count[y] = n;
+    return rects;
+}
 
-    return this;
+/* Writes the quad of rect i of an rltmap to its merged backgrounds */
+static void
+rltmap_quadbg(rltmap *this, int i)
+{
+    const struct rlbrect *r = &this->merge.rects[i];
+    sfVertex *v = sfVertexArray_getVertex(this->merge.verts, (size_t)i * 4);
+
+    v[0] = (sfVertex){{(float)(r->x0 * this->offx),
+        (float)(r->y0 * this->offy)}, r->hue, {0.0f, 0.0f}};
+    v[1] = (sfVertex){{(float)((r->x1 + 1) * this->offx),
+        (float)(r->y0 * this->offy)}, r->hue, {0.0f, 0.0f}};
+    v[2] = (sfVertex){{(float)((r->x1 + 1) * this->offx),
+        (float)((r->y1 + 1) * this->offy)}, r->hue, {0.0f, 0.0f}};
+    v[3] = (sfVertex){{(float)(r->x0 * this->offx),
+        (float)((r->y1 + 1) * this->offy)}, r->hue, {0.0f, 0.0f}};
 }
 
-rltile *
-rltile_null(void)
+/* Brings the merged backgrounds of an rltmap up to date. The rows above the
+   first dirty row keep their runs and rects, so only the rects reaching
+   past it and those of the rows from it on are made again. Returns false
+   if there is no memory to merge them. */
+static bool
+rltmap_mrgbg(rltmap *this)
 {
-    rlhue fg = {255, 0, 0, 255};
-    rlhue bg = {0, 0, 255, 255};
+    int y0 = this->dirty.y0, y1 = this->dirty.y1, rects, raws = 0;
+    size_t cells = (size_t)(this->width * this->height), vi;
+    const struct rlbrun *row = NULL;
 
-    return rltile_init(L'?', fg, bg, RL_TILE_CENTER, 0.0f, 0.0f);
+    if (!this->merge.verts)
+    {
+        if (!(this->merge.nspans = rlcalloc((size_t)this->height,
+            sizeof(int))))
+            goto error;
+        if (!(this->merge.count = rlcalloc((size_t)this->height,
+            sizeof(int))))
+            goto error;
+        if (!(this->merge.first = rlcalloc((size_t)this->height,
+            sizeof(int))))
+            goto error;
+        if (!(this->merge.spans = rlmalloc(cells * sizeof(struct rlbrun))))
+            goto error;
+        if (!(this->merge.runs = rlmalloc(cells * sizeof(struct rlbrun))))
+            goto error;
+        if (!(this->merge.rects = rlmalloc(cells * sizeof(struct rlbrect))))
+            goto error;
+        if (!(this->merge.verts = sfVertexArray_create()))
+            goto error;
+
+        sfVertexArray_setPrimitiveType(this->merge.verts, sfQuads);
+        this->merge.stale = true;
+    }
+
+    if (this->merge.stale)
+    {
+        y0 = 0;
+        y1 = this->height - 1;
+        this->merge.stale = false;
+    }
+
+    if (y1 < y0)
+        return true;
+
+    for (int y = y0; y <= y1; ++y)
+        rltmap_runbg(this, y);
+
+    /* The rects of the rows above end there until stacked onto again */
+    rects = this->merge.first[y0];
+    row = &this->merge.runs[(y0 - !!y0) * this->width];
+
+    for (int i = 0; y0 && i < this->merge.count[y0 - 1]; ++i)
+        if (!row[i].raw)
+            this->merge.rects[row[i].rect].y1 = y0 - 1;
+
+    for (int y = y0; y < this->height; ++y)
+        rects = rltmap_stkbg(this, y, rects);
+
+    for (int y = 0; y < this->height; ++y)
+    {
+        row = &this->merge.runs[y * this->width];
+
+        for (int i = 0; i < this->merge.count[y]; ++i)
+            raws += row[i].raw;
+    }
+
+    /* The rects of the rows above keep their quads, except those that
+       reached the first dirty row */
+    sfVertexArray_resize(this->merge.verts, (size_t)(rects + raws) * 4);
+    row = &this->merge.runs[(y0 - !!y0) * this->width];
+
+    for (int i = 0; y0 && i < this->merge.count[y0 - 1]; ++i)
+        if (!row[i].raw)
+            rltmap_quadbg(this, row[i].rect);
+
+    for (int i = this->merge.first[y0]; i < rects; ++i)
+        rltmap_quadbg(this, i);
+
+    vi = (size_t)rects * 4;
+
+    for (int y = 0; raws && y < this->height; ++y)
+    {
+        row = &this->merge.runs[y * this->width];
+
+        for (int i = 0; i < this->merge.count[y]; ++i)
+        {
+            if (!row[i].raw)
+                continue;
+
+            memcpy(sfVertexArray_getVertex(this->merge.verts, vi),
+                sfVertexArray_getVertex(this->bg,
+                (size_t)rltmap_index(this, row[i].x0, y) * 4),
+                4 * sizeof(sfVertex));
+            vi += 4;
+        }
+    }
+
+    return true;
+
+error:
+
+    rltmap_freebg(this);
+    return false;
 }
 
-void
-rltile_glyph(rltile *this, wchar_t glyph)
+/* Frees the merged backgrounds of an rltmap, made again when next drawn */
+static void
+rltmap_freebg(rltmap *this)
 {
-    if (!this)
-        return;
-
-    this->glyph = glyph;
+    if (this->merge.verts)
+        sfVertexArray_destroy(this->merge.verts);
+
+    rlfree(this->merge.nspans);
+    rlfree(this->merge.count);
+    rlfree(this->merge.first);
+    rlfree(this->merge.spans);
+    rlfree(this->merge.runs);
+    rlfree(this->merge.rects);
+
+    this->merge.verts = NULL;
+    this->merge.nspans = NULL;
+    this->merge.count = NULL;
+    this->merge.first = NULL;
+    this->merge.spans = NULL;
+    this->merge.runs = NULL;
+    this->merge.rects = NULL;
 }
 
-void
-rltile_fghue(rltile *this, rlhue hue)
+static void
+rltmap_updhue(rltmap *this, sfVertexArray *va, const rlhue *hues, int x,
+    int y, int width, int height)
 {
-    if (!this)
+    int xi, yi;
+    size_t vi;
+    sfColor color;
+    RL_TRACE_BEGIN(t0);
+
+    if (!this || !va || !hues)
         return;
 
-    for (size_t i = 0; i < 4; ++i)
-        this->fghue[i] = (sfColor){hue.r, hue.g, hue.b, hue.a};
+    for (int j = 0; j < height; ++j)
+    for (int i = 0; i < width; ++i)
+    {
+        xi = x + i;
+        yi = y + j;
+
+        if (xi < 0 || xi >= this->width || yi < 0 || yi >= this->height)
+            continue;
+
+        color = (sfColor){hues[j * width + i].r, hues[j * width + i].g,
+            hues[j * width + i].b, hues[j * width + i].a};
+        vi = (size_t)rltmap_index(this, xi, yi) * 4;
+
+        if (this->cmpct && va == this->fg)
+            this->cmpct[vi / 4].fg = color;
+        else if (this->cmpct)
+            this->cmpct[vi / 4].bg = color;
+        else
+        {
+            sfVertexArray_getVertex(va, vi)->color = color;
+            sfVertexArray_getVertex(va, vi + 1)->color = color;
+            sfVertexArray_getVertex(va, vi + 2)->color = color;
+            sfVertexArray_getVertex(va, vi + 3)->color = color;
+        }
+
+        rltmap_dirty(this, xi, yi);
+        this->stats.tiles += 1;
+    }
+
+    RL_TRACE_END((va == this->fg) ? "rltmap_vhuef" : "rltmap_vhueb", t0,
+        width * height);
 }
 
-void
-rltile_bghue(rltile *this, rlhue hue)
+static void
+rltmap_updproto(rltmap *this, const struct rltproto *p, int x, int y)
 {
-    if (!this)
+    sfVertex *fg, *bg;
+    size_t vi = (size_t)rltmap_index(this, x, y) * 4;
+    sfVector2f o = {(float)x * (float)this->offx, (float)y * (float)this->offy};
+
+    if (this->cmpct)
+    {
+        this->cmpct[vi / 4] = p->cmp;
+        rltmap_dirty(this, x, y);
+        this->stats.tiles += 1;
         return;
+    }
 
-    for (size_t i = 0; i < 4; ++i)
-        this->bghue[i] = (sfColor){hue.r, hue.g, hue.b, hue.a};
+    /* The four vertices of a tile are contiguous in the vertex arrays */
+    fg = sfVertexArray_getVertex(this->fg, vi);
+    bg = sfVertexArray_getVertex(this->bg, vi);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        fg[i] = p->fg[i];
+        fg[i].position.x += o.x;
+        fg[i].position.y += o.y;
+        bg[i].color = p->bg;
+    }
+
+    bg[0].position = o;
+    bg[1].position = (sfVector2f){o.x + (float)this->offx, o.y};
+    bg[2].position = (sfVector2f){o.x + (float)this->offx,
+        o.y + (float)this->offy};
+    bg[3].position = (sfVector2f){o.x, o.y + (float)this->offy};
+
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
 }
 
-void
-rltile_type(rltile *this, rlttype type)
+static void
+rltmap_updcmp(rltmap *this, int i, wchar_t glyph, sfColor fg, sfColor bg,
+    float r, float b)
 {
-    if (!this)
-        return;
+    struct rltcmp *c = &this->cmpct[i];
 
-    this->type = type;
+    c->glyph = (uint32_t)glyph;
+    c->fg = fg;
+    c->bg = bg;
+    c->right = (int16_t)lroundf(r * RL_CMPCT_SUB);
+    c->bottom = (int16_t)lroundf(b * RL_CMPCT_SUB);
 }
 
-void
-rltile_right(rltile *this, float right)
+static size_t
+rltmap_drwcmp(rltmap *this, sfRenderTexture *target, sfRenderStates *states,
+    sfVertex *scratch, const uint8_t *mask, bool fg)
 {
-    if (!this)
-        return;
+    int x, y;
+    float l, t, r, b;
+    sfVertex *v = NULL;
+    const struct rltcmp *c = NULL;
+    const struct rltglyph *g = NULL;
+    int count = this->width * this->height, n = 0;
+    size_t verts = 0;
+
+    /* Tiles are expanded into a scratch buffer a chunk at a time. All the
+       backgrounds are drawn before any glyph, so glyphs overhanging their
+       tile are not covered by the background of a later chunk. */
+    for (int i = 0; i < count; ++i)
+    {
+        if (mask && mask[i])
+            continue;
 
-    this->right = right;
+        c = &this->cmpct[i];
+        v = &scratch[n * 4];
+        x = (i % this->width) * this->offx;
+        y = (i / this->width) * this->offy;
+
+        if (fg)
+        {
+            if (!(g = rltmap_glyph(this, (wchar_t)c->glyph)))
+                continue;
+
+            l = (float)x + (float)c->right / RL_CMPCT_SUB;
+            t = (float)y + (float)c->bottom / RL_CMPCT_SUB;
+            r = l + (float)g->rect.width;
+            b = t + (float)g->rect.height;
+
+            v[0] = (sfVertex){{l, t}, c->fg, {(float)g->rect.left,
+                (float)g->rect.top}};
+            v[1] = (sfVertex){{r, t}, c->fg, {(float)(g->rect.left
+                + g->rect.width), (float)g->rect.top}};
+            v[2] = (sfVertex){{r, b}, c->fg, {(float)(g->rect.left
+                + g->rect.width), (float)(g->rect.top + g->rect.height)}};
+            v[3] = (sfVertex){{l, b}, c->fg, {(float)g->rect.left,
+                (float)(g->rect.top + g->rect.height)}};
+        }
+        else
+        {
+            l = (float)x;
+            t = (float)y;
+            r = l + (float)this->offx;
+            b = t + (float)this->offy;
+
+            v[0] = (sfVertex){{l, t}, c->bg, {0.0f, 0.0f}};
+            v[1] = (sfVertex){{r, t}, c->bg, {0.0f, 0.0f}};
+            v[2] = (sfVertex){{r, b}, c->bg, {0.0f, 0.0f}};
+            v[3] = (sfVertex){{l, b}, c->bg, {0.0f, 0.0f}};
+        }
+
+        verts += 4;
+
+        if (++n == RL_CMPCT_CHUNK)
+        {
+            rltmap_drwscr(this, target, states, scratch, n);
+            n = 0;
+        }
+    }
+
+    rltmap_drwscr(this, target, states, scratch, n);
+    return verts;
 }
 
-void
-rltile_bottm(rltile *this, float bottom)
+/* Draws the backgrounds or glyphs of the tiles of an rltmap not marked in
+   mask, copied into the scratch buffer a chunk at a time. A merged
+   background is drawn whole if any tile under it is left. Returns the
+   number of vertices drawn. */
+static size_t
+rltmap_drwcul(rltmap *this, sfRenderTexture *target, sfRenderStates *states,
+    sfVertex *scratch, const uint8_t *mask, bool fg)
 {
-    if (!this)
-        return;
+    int w = this->width, n = 0, runs;
+    bool merged = !fg && rltmap_mrgbg(this), shown;
+    size_t verts = 0;
+    const sfVertex *src = NULL;
+    const struct rlbrun *row = NULL;
+    const struct rlbrect *r = NULL;
+
+    for (int y = 0; y < this->height; ++y)
+    {
+        row = merged ? &this->merge.runs[y * w] : NULL;
+        runs = merged ? this->merge.count[y] : w;
 
-    this->bottom = bottom;
+        for (int i = 0; i < runs; ++i)
+        {
+            src = NULL;
+
+            if (!row && !mask[y * w + i])
+                src = sfVertexArray_getVertex(fg ? this->fg : this->bg,
+                    (size_t)(y * w + i) * 4);
+            else if (row && row[i].raw && !mask[y * w + row[i].x0])
+                src = sfVertexArray_getVertex(this->bg,
+                    (size_t)(y * w + row[i].x0) * 4);
+            else if (row && !row[i].raw
+                && this->merge.rects[row[i].rect].y0 == y)
+            {
+                /* A rect is drawn from the first row it spans */
+                r = &this->merge.rects[row[i].rect];
+                shown = false;
+
+                for (int ry = r->y0; !shown && ry <= r->y1; ++ry)
+                for (int rx = r->x0; !shown && rx <= r->x1; ++rx)
+                    shown = !mask[ry * w + rx];
+
+                if (shown)
+                    src = sfVertexArray_getVertex(this->merge.verts,
+                        (size_t)row[i].rect * 4);
+            }
+
+            if (!src)
+                continue;
+
+            memcpy(&scratch[n * 4], src, 4 * sizeof(sfVertex));
+            verts += 4;
+
+            if (++n == RL_CMPCT_CHUNK)
+            {
+                rltmap_drwscr(this, target, states, scratch, n);
+                n = 0;
+            }
+        }
+    }
+
+    rltmap_drwscr(this, target, states, scratch, n);
+    return verts;
 }
 
-extern void
-rltile_shift(rltile *this, float right, float bottom)
+/* Draws the first n quads of the scratch buffer */
+static void
+rltmap_drwscr(rltmap *this, sfRenderTexture *target, sfRenderStates *states,
+    const sfVertex *scratch, int n)
 {
-    if (!this)
+    if (!n)
         return;
 
-    this->right = right;
-    this->bottom = bottom;
+    sfRenderTexture_drawPrimitives(target, scratch, (size_t)n * 4,
+        sfQuads, states);
+    this->stats.draws += 1;
 }
 
-void
-rltile_free(rltile *this)
+static void
+rltmap_updlight(rltmap *this)
 {
-    if (!this)
+    if (!this || !this->light.handle || this->light.dirty0 < 0)
         return;
 
-    free(this);
+    /* Only whole rows between the first and last dirty row are uploaded, as
+       they are contiguous in the light hue array */
+    sfTexture_updateFromPixels(this->light.handle,
+        (const sfUint8 *)&this->light.hues[this->light.dirty0 * this->width],
+        (unsigned)this->width,
+        (unsigned)(this->light.dirty1 - this->light.dirty0 + 1), 0,
+        (unsigned)this->light.dirty0);
+
+    this->stats.bytes += (size_t)(this->width * (this->light.dirty1
+        - this->light.dirty0 + 1)) * sizeof(rlhue);
+
+    this->light.dirty0 = -1;
+    this->light.dirty1 = -1;
 }
 
-/******************************************************************************
-rltmap function implementations
-******************************************************************************/
+/* Translated by the position, scaled and then rotated about the origin */
+static void
+rltmap_xform(rltmap *this, sfTransform *xform)
+{
+    *xform = sfTransform_Identity;
+    sfTransform_translate(xform, (float)this->x, (float)this->y);
+    sfTransform_scale(xform, (float)this->scale, (float)this->scale);
+    sfTransform_rotateWithCenter(xform, this->rot, (float)this->origx,
+        (float)this->origy);
+}
 
+/* The render states an rltmap is drawn with under the transform xform */
 static void
-rltmap_updtile(rltmap *this, rltile *t, int x, int y)
+rltmap_states(rltmap *this, const sfTransform *xform,
+    sfRenderStates *states)
 {
-    int i;
-    sfGlyph glyph;
-    float r = 0.0f, b = 0.0f;
+    states->shader = rltmap_shader(this);
+    states->blendMode = sfBlendAlpha;
+    states->transform = *xform;
+    states->texture = this->sheet ? this->sheet : this->font
+        ? sfFont_getTexture(this->font, (unsigned)this->csize) : NULL;
+}
 
-    if (!this || !t)
-        return;
+/* Whether the background of tile i covers its cell entirely, as it is drawn
+   after the palette and the light */
+static bool
+rltmap_opaque(rltmap *this, int i)
+{
+    float l, t;
+    sfColor bg;
+    const sfVertex *v = NULL;
 
-    glyph = sfFont_getGlyph(this->font, (unsigned)t->glyph,
-        (unsigned)this->csize, false, 0.0f);
+    if (this->light.hues && this->light.hues[i].a != 255)
+        return false;
 
-    switch (t->type)
+    if (this->cmpct)
+        bg = this->cmpct[i].bg;
+    else
     {
-    case RL_TILE_TEXT:
-        r = glyph.bounds.left;
-        b = (float)(this->offy) + glyph.bounds.top;
-        break;
-    case RL_TILE_EXACT:
-        r = (float)(int)(((float)(this->offx - glyph.textureRect.width)
-            / 2.0f));
-        b = (float)(int)(((float)(this->offy - glyph.textureRect.height)
-            / 2.0f));
-        r += t->right;
-        b += t->bottom;
-        break;
-    case RL_TILE_FLOOR:
-        r = (float)(int)((float)(this->offx - glyph.textureRect.width)
-            / 2.0f);
-        b = (float)(int)((float)(this->offy - glyph.textureRect.height));
-        break;
-    case RL_TILE_CENTER:
-        r = (float)(int)((float)(this->offx - glyph.textureRect.width)
-            / 2.0f);
-        b = (float)(int)((float)(this->offy - glyph.textureRect.height)
-            / 2.0f);
-        break;
+        v = sfVertexArray_getVertex(this->bg, (size_t)i * 4);
+        l = (float)(i % this->width) * (float)this->offx;
+        t = (float)(i / this->width) * (float)this->offy;
+
+        /* Only a quad of one hue over its whole cell, as rltmap_runbg(2)
+           tells them apart */
+        if (!(v[0].position.x == l && v[0].position.y == t
+            && v[2].position.x == l + (float)this->offx
+            && v[2].position.y == t + (float)this->offy
+            && !memcmp(&v[0].color, &v[1].color, sizeof(sfColor))
+            && !memcmp(&v[0].color, &v[2].color, sizeof(sfColor))
+            && !memcmp(&v[0].color, &v[3].color, sizeof(sfColor))))
+            return false;
+
+        bg = v[0].color;
     }
 
-    i = rltmap_index(this, x, y);
+    if (this->palet.hues)
+        return this->palet.hues[bg.r].a == 255;
 
-    rltmap_updfg(this, i, t, x, y, r, b, &glyph.textureRect);
-    rltmap_updbg(this, i, t, x, y);
+    return bg.a == 255;
 }
 
+/* Writes the bounds of what tile i draws, its cell and its glyph, in pixels
+   of the rltmap as left, top, right and bottom */
 static void
-rltmap_updfg(rltmap *this, int i, rltile *t, int x, int y, float r, float b,
-    sfIntRect *rect)
+rltmap_bounds(rltmap *this, int i, float *box)
 {
-    size_t vi = (size_t)i * 4;
+    float g[4];
+    const sfVertex *v = NULL;
+    const struct rltcmp *c = NULL;
+    const struct rltglyph *glyph = NULL;
 
-    if (!this || !t || !rect)
-        return;
+    box[0] = (float)(i % this->width) * (float)this->offx;
+    box[1] = (float)(i / this->width) * (float)this->offy;
+    box[2] = box[0] + (float)this->offx;
+    box[3] = box[1] + (float)this->offy;
 
-    sfVertexArray_getVertex(this->fg, vi)->position = (sfVector2f){
-        (float)x * (float)(this->offx) + r,
-        (float)y * (float)(this->offy) + b
-    };
+    if (this->cmpct)
+    {
+        c = &this->cmpct[i];
 
-    sfVertexArray_getVertex(this->fg, vi + 1)->position = (sfVector2f){
-        (float)x * (float)(this->offx) + (float)(rect->width) + r,
-        (float)y * (float)(this->offy) + b
-    };
+        if (!(glyph = rltmap_glyph(this, (wchar_t)c->glyph)))
+            return;
 
-    sfVertexArray_getVertex(this->fg, vi + 2)->position = (sfVector2f){
-        (float)x * (float)(this->offx) + (float)(rect->width) + r,
-        (float)y * (float)(this->offy) + (float)(rect->height) + b
-    };
+        g[0] = box[0] + (float)c->right / RL_CMPCT_SUB;
+        g[1] = box[1] + (float)c->bottom / RL_CMPCT_SUB;
+        g[2] = g[0] + (float)glyph->rect.width;
+        g[3] = g[1] + (float)glyph->rect.height;
+    }
+    else
+    {
+        v = sfVertexArray_getVertex(this->fg, (size_t)i * 4);
+        g[0] = g[2] = v[0].position.x;
+        g[1] = g[3] = v[0].position.y;
 
-    sfVertexArray_getVertex(this->fg, vi + 3)->position = (sfVector2f){
-        (float)x * (float)(this->offx) + r,
-        (float)y * (float)(this->offy) + (float)(rect->height) + b
-    };
+        for (int k = 1; k < 4; ++k)
+        {
+            g[0] = (v[k].position.x < g[0]) ? v[k].position.x : g[0];
+            g[1] = (v[k].position.y < g[1]) ? v[k].position.y : g[1];
+            g[2] = (v[k].position.x > g[2]) ? v[k].position.x : g[2];
+            g[3] = (v[k].position.y > g[3]) ? v[k].position.y : g[3];
+        }
+    }
 
-    sfVertexArray_getVertex(this->fg, vi)->texCoords = (sfVector2f){
-        (float)(rect->left),
-        (float)(rect->top)
-    };
+    /* An empty quad draws nothing */
+    if (g[0] == g[2] || g[1] == g[3])
+        return;
 
-    sfVertexArray_getVertex(this->fg, vi + 1)->texCoords = (sfVector2f){
-        (float)(rect->left) + (float)(rect->width),
-        (float)(rect->top)
-    };
+    box[0] = (g[0] < box[0]) ? g[0] : box[0];
+    box[1] = (g[1] < box[1]) ? g[1] : box[1];
+    box[2] = (g[2] > box[2]) ? g[2] : box[2];
+    box[3] = (g[3] > box[3]) ? g[3] : box[3];
+}
 
-    sfVertexArray_getVertex(this->fg, vi + 2)->texCoords = (sfVector2f){
-        (float)(rect->left) + (float)(rect->width),
-        (float)(rect->top) + (float)(rect->height)
-    };
+/* Writes the bounds of what all of the tiles draw, as rltmap_bounds */
+static void
+rltmap_extent(rltmap *this, float *box)
+{
+    float b[4];
 
-    sfVertexArray_getVertex(this->fg, vi + 3)->texCoords = (sfVector2f){
-        (float)(rect->left),
-        (float)(rect->top) + (float)(rect->height)
-    };
+    box[0] = box[1] = 0.0f;
+    box[2] = (float)(this->width * this->offx);
+    box[3] = (float)(this->height * this->offy);
 
-    sfVertexArray_getVertex(this->fg, vi)->color = t->fghue[0];
-    sfVertexArray_getVertex(this->fg, vi + 1)->color = t->fghue[1];
-    sfVertexArray_getVertex(this->fg, vi + 2)->color = t->fghue[2];
-    sfVertexArray_getVertex(this->fg, vi + 3)->color = t->fghue[3];
+    for (int i = 0; i < this->width * this->height; ++i)
+    {
+        rltmap_bounds(this, i, b);
+        box[0] = (b[0] < box[0]) ? b[0] : box[0];
+        box[1] = (b[1] < box[1]) ? b[1] : box[1];
+        box[2] = (b[2] > box[2]) ? b[2] : box[2];
+        box[3] = (b[3] > box[3]) ? b[3] : box[3];
+    }
 }
 
-static void
-rltmap_updbg(rltmap *this, int i, rltile *t, int x, int y)
+static sfShader *
+rltmap_shader(rltmap *this)
 {
-    size_t vi = (size_t)i * 4;
+    int flags = 0;
+    sfShader *shader = NULL;
 
-    if (!this || !t)
-        return;
+    if (!this)
+        return NULL;
 
-    sfVertexArray_getVertex(this->bg, vi)->position = (sfVector2f){
-        (float)x * (float)(this->offx),
-        (float)y * (float)(this->offy)
-    };
+    if (this->light.handle)
+        flags |= RL_SHADER_LIGHT;
 
-    sfVertexArray_getVertex(this->bg, vi + 1)->position = (sfVector2f){
-        (float)x * (float)(this->offx) + (float)(this->offx),
-        (float)y * (float)(this->offy)
-    };
+    if (this->palet.handle)
+        flags |= RL_SHADER_PALET;
 
-    sfVertexArray_getVertex(this->bg, vi + 2)->position = (sfVector2f){
-        (float)x * (float)(this->offx) + (float)(this->offx),
-        (float)y * (float)(this->offy) + (float)(this->offy)
-    };
+    if (!(shader = rlshader_get(flags)))
+        return NULL;
 
-    sfVertexArray_getVertex(this->bg, vi + 3)->position = (sfVector2f){
-        (float)x * (float)(this->offx),
-        (float)y * (float)(this->offy) + (float)(this->offy)
-    };
+    sfShader_setCurrentTextureUniform(shader, "texture");
+
+    if (flags & RL_SHADER_LIGHT)
+    {
+        rltmap_updlight(this);
+        sfShader_setVec2Uniform(shader, "rl_cell",
+            (sfGlslVec2){(float)this->offx, (float)this->offy});
+        sfShader_setVec2Uniform(shader, "rl_size",
+            (sfGlslVec2){(float)this->width, (float)this->height});
+        sfShader_setTextureUniform(shader, "rl_light", this->light.handle);
+    }
+
+    if (flags & RL_SHADER_PALET)
+    {
+        if (this->palet.dirty)
+        {
+            sfTexture_updateFromPixels(this->palet.handle,
+                (const sfUint8 *)this->palet.hues, RL_PALET_SIZE, 1, 0, 0);
+            this->stats.bytes += RL_PALET_SIZE * sizeof(rlhue);
+        }
+
+        this->palet.dirty = false;
+        sfShader_setTextureUniform(shader, "rl_palet", this->palet.handle);
+    }
 
-    sfVertexArray_getVertex(this->bg, vi)->color = t->bghue[0];
-    sfVertexArray_getVertex(this->bg, vi + 1)->color = t->bghue[1];
-    sfVertexArray_getVertex(this->bg, vi + 2)->color = t->bghue[2];
-    sfVertexArray_getVertex(this->bg, vi + 3)->color = t->bghue[3];
+    return shader;
 }
 
 static int
 rltmap_index(rltmap *this, int x, int y)
 {
-    if (!this)
+    if (RL_INVALID(!this))
         return 0;
 
     return (y * this->width) + x;
 }
 
-rltmap *
-rltmap_init(const char *font, int csize, int cnum, int width, int height,
-    int offx, int offy)
+static void
+rltmap_dirty(rltmap *this, int x, int y)
+{
+    if (x < this->dirty.x0)
+        this->dirty.x0 = x;
+    if (x > this->dirty.x1)
+        this->dirty.x1 = x;
+    if (y < this->dirty.y0)
+        this->dirty.y0 = y;
+    if (y > this->dirty.y1)
+        this->dirty.y1 = y;
+}
+
+static void
+rltmap_clean(rltmap *this)
+{
+    this->dirty.x0 = this->width;
+    this->dirty.y0 = this->height;
+    this->dirty.x1 = -1;
+    this->dirty.y1 = -1;
+}
+
+/* Draws an rltmap an rldisp holds back before it is written to, as the draw
+   shows the tiles as they were when it was made */
+static void
+rltmap_flush(rltmap *this)
+{
+    if (this->queued)
+        rldisp_flush(this->queued);
+}
+
+static rltmap *
+rltmap_new(int csize, int cnum, int width, int height, int offx, int offy)
 {
     rltmap *this = NULL;
 
-    if (!(this = malloc(sizeof(rltmap))))
+    if (!(this = rlcalloc(1, sizeof(rltmap))))
         return NULL;
 
-    if (!(this->font = sfFont_createFromFile(font)))
+    rltcount += 1;
+    this->id = rltnext++;
+    this->glyph.pages = cnum / RL_GLYPH_PAGE + 1;
+
+    if (!(this->glyph.list = rlcalloc((size_t)this->glyph.pages,
+        sizeof(struct rltglyph *))))
         goto error;
 
     if (!(this->fg = sfVertexArray_create()))
@@ -1068,11 +4620,189 @@ rltmap_init(const char *font, int csize, int cnum, int width, int height,
     this->csize = csize;
     this->width = width;
     this->height = height;
+    this->light.dirty0 = -1;
+    this->light.dirty1 = -1;
+
+    rltmap_clean(this);
+
+    return this;
+
+error:
+
+    rltmap_free(this);
+    return NULL;
+}
+
+rltmap *
+rltmap_init(const char *font, int csize, int cnum, int width, int height,
+    int offx, int offy)
+{
+    rltmap *this = NULL;
+
+    if (!(this = rltmap_new(csize, cnum, width, height, offx, offy)))
+        return NULL;
+
+    if (!(this->font = sfFont_createFromFile(font)))
+        goto error;
+
+    return this;
+
+error:
+
+    rltmap_free(this);
+    return NULL;
+}
+
+rltmap *
+rltmap_async(const char *font, int csize, int cnum, int width, int height,
+    int offx, int offy)
+{
+    rltmap *this = NULL;
+
+    if (!font || !(this = rltmap_new(csize, cnum, width, height, offx,
+        offy)))
+        return NULL;
+
+    if (!(this->load.path = rlstrdup(font)))
+        goto error;
+
+    if (!(this->load.lock = sfMutex_create()))
+        goto error;
+
+    if (!(this->load.thread = sfThread_create(rltmap_work, this)))
+        goto error;
+
+    sfThread_launch(this->load.thread);
+    this->load.pending = true;
+
+    return this;
+
+error:
+
+    rltmap_free(this);
+    return NULL;
+}
+
+bool
+rltmap_ready(rltmap *this, bool wait)
+{
+    bool done = false;
+
+    if (!this)
+        return false;
+
+    if (this->load.pending && !wait)
+    {
+        sfMutex_lock(this->load.lock);
+        done = this->load.done;
+        sfMutex_unlock(this->load.lock);
+
+        if (!done)
+            return false;
+    }
+
+    if (this->load.pending)
+        rltmap_adopt(this);
+
+    return !this->load.failed;
+}
+
+rltmap *
+rltmap_sheet(const char *sheet, int cwidth, int cheight, const wchar_t *map,
+    int count, int width, int height, int offx, int offy)
+{
+    int cols, cells, page, cnum = 0;
+    bool opaque = true;
+    size_t bytes;
+    sfVector2u size;
+    sfUint8 *pixels = NULL, *p = NULL;
+    sfImage *image = NULL;
+    rltmap *this = NULL;
+    struct rltglyph *entry = NULL;
+
+    if (cwidth <= 0 || cheight <= 0 || (map && count <= 0))
+        return NULL;
+
+    if (!map)
+    {
+        map = rlcp437;
+        count = 256;
+    }
+
+    for (int i = 0; i < count; ++i)
+        cnum = (int)map[i] > cnum ? (int)map[i] : cnum;
+
+    if (!(image = sfImage_createFromFile(sheet)))
+        return NULL;
+
+    size = sfImage_getSize(image);
+    cols = (int)size.x / cwidth;
+    cells = cols * ((int)size.y / cheight);
+    bytes = (size_t)size.x * size.y * 4;
+
+    if (!cells || !(this = rltmap_new(cheight, cnum, width, height, offx,
+        offy)))
+        goto error;
+
+    /* The sheet is placed below a strip of white pixels for the backgrounds
+       to sample, like the one at the top of an sfFont texture */
+    if (!(pixels = rlmalloc(bytes + (size_t)size.x * RL_SHEET_STRIP * 4)))
+        goto error;
+
+    memset(pixels, 255, (size_t)size.x * RL_SHEET_STRIP * 4);
+    p = pixels + (size_t)size.x * RL_SHEET_STRIP * 4;
+    memcpy(p, sfImage_getPixelsPtr(image), bytes);
+
+    for (size_t i = 3; opaque && i < bytes; i += 4)
+        opaque = p[i] == 255;
+
+    /* A sheet without transparency is a mask of white glyphs on black */
+    for (size_t i = 0; opaque && i < bytes; i += 4)
+    {
+        p[i + 3] = p[i] > p[i + 1] ? p[i] : p[i + 1];
+        p[i + 3] = p[i + 3] > p[i + 2] ? p[i + 3] : p[i + 2];
+        p[i] = p[i + 1] = p[i + 2] = 255;
+    }
+
+    if (!(this->sheet = sfTexture_create(size.x, size.y + RL_SHEET_STRIP)))
+        goto error;
+
+    sfTexture_updateFromPixels(this->sheet, pixels, size.x,
+        size.y + RL_SHEET_STRIP, 0, 0);
+    sfTexture_setSmooth(this->sheet, false);
+
+    rlabytes += (size_t)size.x * (size.y + RL_SHEET_STRIP) * 4;
+    rlacount += 1;
+    this->stats.bytes += bytes;
+
+    for (int i = 0; i < count && i < cells; ++i)
+    {
+        if (map[i] < 0)
+            continue;
+
+        page = (int)map[i] / RL_GLYPH_PAGE;
+
+        if (!this->glyph.list[page] && !(this->glyph.list[page]
+            = rlcalloc(RL_GLYPH_PAGE, sizeof(struct rltglyph))))
+            goto error;
+
+        entry = &this->glyph.list[page][(int)map[i] % RL_GLYPH_PAGE];
+        entry->ok = true;
+        entry->left = 0.0f;
+        entry->top = (float)-cheight;
+        entry->rect = (sfIntRect){i % cols * cwidth,
+            RL_SHEET_STRIP + i / cols * cheight, cwidth, cheight};
+    }
+
+    rlfree(pixels);
+    sfImage_destroy(image);
 
     return this;
 
 error:
 
+    rlfree(pixels);
+    sfImage_destroy(image);
     rltmap_free(this);
     return NULL;
 }
@@ -1129,27 +4859,179 @@ rltmap_angle(rltmap *this, float rot)
 void
 rltmap_ptile(rltmap *this, rltile *tile, int x, int y)
 {
-    if (!this || !tile || tile->glyph > this->cnum)
+    if (RL_INVALID(!this || !tile || tile->glyph > this->cnum))
         return;
 
+    rltmap_flush(this);
     rltmap_updtile(this, tile, x, y);
 }
 
+extern void
+rltmap_pcell(rltmap *this, rlcell cell, int x, int y)
+{
+    if (RL_INVALID(!this || cell.glyph > this->cnum))
+        return;
+
+    rltmap_flush(this);
+    rltmap_updcell(this, &cell, x, y);
+}
+
+extern void
+rltmap_pcells(rltmap *this, const rlcell *cells, int x, int y, int width,
+    int height)
+{
+    int xi, yi;
+    const rlcell *c = NULL;
+    RL_TRACE_BEGIN(t0);
+
+    if (!this || !cells)
+        return;
+
+    rltmap_flush(this);
+
+    for (int j = 0; j < height; ++j)
+    for (int i = 0; i < width; ++i)
+    {
+        xi = x + i;
+        yi = y + j;
+        c = &cells[j * width + i];
+
+        if (xi >= 0 && xi < this->width && yi >= 0 && yi < this->height
+            && c->glyph <= this->cnum)
+            rltmap_updcell(this, c, xi, yi);
+    }
+
+    RL_TRACE_END("rltmap_pcells", t0, width * height);
+}
+
+extern int
+rltmap_proto(rltmap *this, rlcell cell)
+{
+    float r, b;
+    sfIntRect rect;
+    struct rltproto *p = NULL;
+    sfColor fg = {cell.fghue.r, cell.fghue.g, cell.fghue.b, cell.fghue.a};
+
+    if (!this || cell.glyph > this->cnum
+        || this->proto.count >= RL_PROTO_MAXIMUM)
+        return -1;
+
+    if (this->proto.count == this->proto.capacity)
+    {
+        if (!(p = rlrealloc(this->proto.list, (size_t)(this->proto.capacity
+            ? this->proto.capacity * 2 : 64) * sizeof(struct rltproto))))
+            return -1;
+
+        this->proto.list = p;
+        this->proto.capacity = this->proto.capacity
+            ? this->proto.capacity * 2 : 64;
+    }
+
+    rltmap_shift(this, cell.glyph, cell.type, cell.right, cell.bottom, &r, &b,
+        &rect);
+
+    p = &this->proto.list[this->proto.count];
+
+    p->fg[0].position = (sfVector2f){r, b};
+    p->fg[1].position = (sfVector2f){(float)rect.width + r, b};
+    p->fg[2].position = (sfVector2f){(float)rect.width + r,
+        (float)rect.height + b};
+    p->fg[3].position = (sfVector2f){r, (float)rect.height + b};
+
+    p->fg[0].texCoords = (sfVector2f){(float)rect.left, (float)rect.top};
+    p->fg[1].texCoords = (sfVector2f){(float)rect.left + (float)rect.width,
+        (float)rect.top};
+    p->fg[2].texCoords = (sfVector2f){(float)rect.left + (float)rect.width,
+        (float)rect.top + (float)rect.height};
+    p->fg[3].texCoords = (sfVector2f){(float)rect.left,
+        (float)rect.top + (float)rect.height};
+
+    for (int i = 0; i < 4; ++i)
+        p->fg[i].color = fg;
+
+    p->bg = (sfColor){cell.bghue.r, cell.bghue.g, cell.bghue.b, cell.bghue.a};
+
+    p->cmp = (struct rltcmp){(uint32_t)cell.glyph, fg, p->bg,
+        (int16_t)lroundf(r * RL_CMPCT_SUB), (int16_t)lroundf(b * RL_CMPCT_SUB)};
+
+    return this->proto.count++;
+}
+
+extern void
+rltmap_pid(rltmap *this, uint16_t id, int x, int y)
+{
+    if (RL_INVALID(!this || x < 0 || x >= this->width || y < 0
+        || y >= this->height))
+        return;
+
+    /* Skipped like in rltmap_pgrid, it indexes the prototype list */
+    if (id >= this->proto.count)
+        return;
+
+    rltmap_flush(this);
+    rltmap_updproto(this, &this->proto.list[id], x, y);
+}
+
+extern void
+rltmap_pgrid(rltmap *this, const uint16_t *ids, int x, int y, int width,
+    int height)
+{
+    int x0, x1, y0, y1;
+    const uint16_t *row = NULL;
+    RL_TRACE_BEGIN(t0);
+
+    if (!this || !ids)
+        return;
+
+    rltmap_flush(this);
+
+    /* Clip the region to the rltmap once instead of per tile */
+    x0 = (x < 0) ? -x : 0;
+    y0 = (y < 0) ? -y : 0;
+    x1 = (x + width > this->width) ? this->width - x : width;
+    y1 = (y + height > this->height) ? this->height - y : height;
+
+    for (int j = y0; j < y1; ++j)
+    {
+        row = &ids[j * width];
+
+        for (int i = x0; i < x1; ++i)
+            if (row[i] < this->proto.count)
+                rltmap_updproto(this, &this->proto.list[row[i]], x + i,
+                    y + j);
+    }
+
+    RL_TRACE_END("rltmap_pgrid", t0, width * height);
+}
+
 extern void
 rltmap_phuef(rltmap *this, rlhue hue, int x, int y)
 {
     size_t vi;
     sfColor color = {hue.r, hue.g, hue.b, hue.a};
 
-    if (!this)
+    if (RL_INVALID(!this))
         return;
 
+    rltmap_flush(this);
+
     vi = (unsigned)rltmap_index(this, x, y) * 4;
 
+    if (this->cmpct)
+    {
+        this->cmpct[vi / 4].fg = color;
+        rltmap_dirty(this, x, y);
+        this->stats.tiles += 1;
+        return;
+    }
+
     sfVertexArray_getVertex(this->fg, vi)->color = color;
     sfVertexArray_getVertex(this->fg, vi + 1)->color = color;
     sfVertexArray_getVertex(this->fg, vi + 2)->color = color;
     sfVertexArray_getVertex(this->fg, vi + 3)->color = color;
+
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
 }
 
 extern void
@@ -1158,39 +5040,75 @@ rltmap_phueb(rltmap *this, rlhue hue, int x, int y)
     size_t vi;
     sfColor color = {hue.r, hue.g, hue.b, hue.a};
 
-    if (!this)
+    if (RL_INVALID(!this))
         return;
 
+    rltmap_flush(this);
+
     vi = (unsigned)rltmap_index(this, x, y) * 4;
 
+    if (this->cmpct)
+    {
+        this->cmpct[vi / 4].bg = color;
+        rltmap_dirty(this, x, y);
+        this->stats.tiles += 1;
+        return;
+    }
+
     sfVertexArray_getVertex(this->bg, vi)->color = color;
     sfVertexArray_getVertex(this->bg, vi + 1)->color = color;
     sfVertexArray_getVertex(this->bg, vi + 2)->color = color;
     sfVertexArray_getVertex(this->bg, vi + 3)->color = color;
 
+    rltmap_dirty(this, x, y);
+    this->stats.tiles += 1;
+}
+
+extern void
+rltmap_vhuef(rltmap *this, const rlhue *hues, int x, int y, int width,
+    int height)
+{
+    if (!this || !hues)
+        return;
+
+    rltmap_flush(this);
+    rltmap_updhue(this, this->fg, hues, x, y, width, height);
+}
+
+extern void
+rltmap_vhueb(rltmap *this, const rlhue *hues, int x, int y, int width,
+    int height)
+{
+    if (!this || !hues)
+        return;
+
+    rltmap_flush(this);
+    rltmap_updhue(this, this->bg, hues, x, y, width, height);
 }
 
 extern void
 rltmap_wstrr(rltmap *this, wchar_t *wstr, rlhue fg, rlhue bg, rlttype type,
     int x, int y)
 {
-    int xi, yi;
-    rltile *tile = NULL;
+    int xi, yi, len;
+    rlcell cell = {L'\0', fg, bg, 0.0f, 0.0f, type};
 
     if (!this || !wstr)
         return;
 
-    for (int i = 0; i < (int)wcslen(wstr); ++i)
+    rltmap_flush(this);
+
+    len = (int)wcslen(wstr);
+
+    for (int i = 0; i < len; ++i)
     {
         xi = (x + i) % this->width;
         yi = y + ((x + i) / this->width);
 
         if (xi >= 0 && xi < this->width && yi >= 0 && yi < this->height)
         {
-            if (!(tile = rltile_init(wstr[i], fg, bg, type, 0.0f, 0.0f)))
-                return;
-            rltmap_updtile(this, tile, xi, yi);
-            rltile_free(tile);
+            cell.glyph = wstr[i];
+            rltmap_updcell(this, &cell, xi, yi);
         }
     }
 }
@@ -1199,23 +5117,25 @@ extern void
 rltmap_wstrb(rltmap *this, wchar_t *wstr, rlhue fg, rlhue bg, rlttype type,
     int x, int y)
 {
-    int xi, yi;
-    rltile *tile = NULL;
+    int xi, yi, len;
+    rlcell cell = {L'\0', fg, bg, 0.0f, 0.0f, type};
 
     if (!this || !wstr)
         return;
 
-    for (int i = 0; i < (int)wcslen(wstr); ++i)
+    rltmap_flush(this);
+
+    len = (int)wcslen(wstr);
+
+    for (int i = 0; i < len; ++i)
     {
         xi = x + ((y + i) / this->height);
         yi = (y + i) % this->height;
 
         if (xi >= 0 && xi < this->width && yi >= 0 && yi < this->height)
         {
-            if (!(tile = rltile_init(wstr[i], fg, bg, type, 0.0f, 0.0f)))
-                return;
-            rltmap_updtile(this, tile, xi, yi);
-            rltile_free(tile);
+            cell.glyph = wstr[i];
+            rltmap_updcell(this, &cell, xi, yi);
         }
     }   
 }
@@ -1223,20 +5143,316 @@ rltmap_wstrb(rltmap *this, wchar_t *wstr, rlhue fg, rlhue bg, rlttype type,
 void
 rltmap_free(rltmap *this)
 {
+    sfVector2u size;
+
     if (!this)
         return;
 
+    if (this->load.pending)
+        rltmap_adopt(this);
+
+    /* An rltmap held back for occlusion culling is drawn while it lasts */
+    if (this->queued)
+        rldisp_flush(this->queued);
+
+    if (this->load.lock)
+        sfMutex_destroy(this->load.lock);
+
     if (this->font)
         sfFont_destroy(this->font);
 
+    rlfree(this->load.path);
+
+    if (this->sheet)
+    {
+        size = sfTexture_getSize(this->sheet);
+        rlabytes -= (size_t)size.x * size.y * 4;
+        sfTexture_destroy(this->sheet);
+    }
+
+    rlabytes -= (size_t)this->glyph.size.x * this->glyph.size.y * 4;
+
     if (this->fg)
         sfVertexArray_destroy(this->fg);
 
     if (this->bg)
         sfVertexArray_destroy(this->bg);
 
+    rltmap_freebg(this);
+    rltmap_light(this, false);
+    rltmap_palet(this, false);
+
+    rlfree(this->proto.list);
+    rlfree(this->cmpct);
+
+    for (int i = 0; this->glyph.list && i < this->glyph.pages; ++i)
+        rlfree(this->glyph.list[i]);
+
+    rlfree(this->glyph.list);
+
+    rltcount -= 1;
+
+    /* If this is the last rltmap, free the shared shaders */
+    if (rltcount == 0)
+        rlshader_free();
+
     if (this)
-        free(this);
+        rlfree(this);
+}
+
+extern bool
+rltmap_cmpct(rltmap *this, bool enabled)
+{
+    sfVertexArray *fg = NULL, *bg = NULL;
+    size_t count;
+
+    if (!this)
+        return false;
+
+    if (enabled == !!this->cmpct)
+        return enabled;
+
+    rltmap_flush(this);
+
+    count = (size_t)(this->width * this->height);
+
+    /* The vertex arrays are recreated rather than resized, since resizing
+       them down would not release their memory */
+    if (!(fg = sfVertexArray_create()) || !(bg = sfVertexArray_create()))
+        goto error;
+
+    sfVertexArray_setPrimitiveType(fg, sfQuads);
+    sfVertexArray_setPrimitiveType(bg, sfQuads);
+
+    if (enabled)
+    {
+        if (!(this->cmpct = rlcalloc(count, sizeof(struct rltcmp))))
+            goto error;
+    }
+    else
+    {
+        sfVertexArray_resize(fg, (unsigned)(count * 4));
+        sfVertexArray_resize(bg, (unsigned)(count * 4));
+        rlfree(this->cmpct);
+        this->cmpct = NULL;
+    }
+
+    sfVertexArray_destroy(this->fg);
+    sfVertexArray_destroy(this->bg);
+    this->fg = fg;
+    this->bg = bg;
+
+    /* The merged backgrounds are made again from the new tiles */
+    rltmap_freebg(this);
+
+    return enabled;
+
+error:
+
+    if (fg)
+        sfVertexArray_destroy(fg);
+    if (bg)
+        sfVertexArray_destroy(bg);
+
+    return !!this->cmpct;
+}
+
+extern bool
+rltmap_atlas(rltmap *this, int size, int pages, int pad)
+{
+    UNUSED(this);
+    UNUSED(size);
+    UNUSED(pages);
+    UNUSED(pad);
+
+    /* Glyphs are packed by sfFont, which has no say in its layout */
+    return false;
+}
+
+extern bool
+rltmap_sdf(rltmap *this, bool enabled)
+{
+    /* sfFont only rasterizes coverage */
+    return this && !enabled;
+}
+
+extern bool
+rltmap_light(rltmap *this, bool enabled)
+{
+    rlhue white = {255, 255, 255, 255};
+
+    if (!this)
+        return false;
+
+    rltmap_flush(this);
+
+    if (!enabled)
+    {
+        if (this->light.handle)
+            sfTexture_destroy(this->light.handle);
+
+        rlfree(this->light.hues);
+
+        this->light.hues = NULL;
+        this->light.handle = NULL;
+        return true;
+    }
+
+    if (this->light.handle)
+        return true;
+
+    if (!sfShader_isAvailable())
+        return false;
+
+    if (!(this->light.hues = rlmalloc((size_t)(this->width * this->height)
+        * sizeof(rlhue))))
+        goto error;
+
+    if (!(this->light.handle = sfTexture_create((unsigned)this->width,
+        (unsigned)this->height)))
+        goto error;
+
+    for (int i = 0; i < this->width * this->height; ++i)
+        this->light.hues[i] = white;
+
+    sfTexture_setSmooth(this->light.handle, false);
+
+    this->light.dirty0 = 0;
+    this->light.dirty1 = this->height - 1;
+
+    return true;
+
+error:
+
+    rltmap_light(this, false);
+    return false;
+}
+
+extern bool
+rltmap_palet(rltmap *this, bool enabled)
+{
+    if (!this)
+        return false;
+
+    rltmap_flush(this);
+
+    if (!enabled)
+    {
+        if (this->palet.handle)
+            sfTexture_destroy(this->palet.handle);
+
+        rlfree(this->palet.hues);
+
+        this->palet.hues = NULL;
+        this->palet.handle = NULL;
+        this->merge.stale = true;
+        return true;
+    }
+
+    if (this->palet.handle)
+        return true;
+
+    if (!sfShader_isAvailable())
+        return false;
+
+    if (!(this->palet.hues = rlmalloc(RL_PALET_SIZE * sizeof(rlhue))))
+        goto error;
+
+    if (!(this->palet.handle = sfTexture_create(RL_PALET_SIZE, 1)))
+        goto error;
+
+    for (int i = 0; i < RL_PALET_SIZE; ++i)
+        rlhue_set(&this->palet.hues[i], (uint8_t)i, (uint8_t)i, (uint8_t)i,
+            255);
+
+    sfTexture_setSmooth(this->palet.handle, false);
+
+    /* Transparent backgrounds are drawn in the hue of their index */
+    this->palet.dirty = true;
+    this->merge.stale = true;
+
+    return true;
+
+error:
+
+    rltmap_palet(this, false);
+    return false;
+}
+
+extern void
+rltmap_ppal(rltmap *this, uint8_t index, rlhue hue)
+{
+    rltmap_vpal(this, &hue, index, 1);
+}
+
+extern void
+rltmap_vpal(rltmap *this, const rlhue *hues, int first, int count)
+{
+    if (!this || !this->palet.hues || !hues || first < 0)
+        return;
+
+    rltmap_flush(this);
+
+    for (int i = 0; i < count && first + i < RL_PALET_SIZE; ++i)
+        this->palet.hues[first + i] = hues[i];
+
+    this->palet.dirty = true;
+}
+
+extern void
+rltmap_pindx(rltmap *this, uint8_t fg, uint8_t bg, int x, int y)
+{
+    if (RL_INVALID(!this || x < 0 || x >= this->width || y < 0
+        || y >= this->height))
+        return;
+
+    rltmap_phuef(this, (rlhue){fg, 0, 0, 255}, x, y);
+    rltmap_phueb(this, (rlhue){bg, 0, 0, 255}, x, y);
+}
+
+extern void
+rltmap_plight(rltmap *this, rlhue hue, int x, int y)
+{
+    rltmap_vlight(this, &hue, x, y, 1, 1);
+}
+
+extern void
+rltmap_vlight(rltmap *this, const rlhue *hues, int x, int y, int width,
+    int height)
+{
+    int xi, yi;
+
+    if (RL_INVALID(!this || !hues))
+        return;
+
+    /* Not an argument check, maps without a light map ignore writes */
+    if (!this->light.hues)
+        return;
+
+    rltmap_flush(this);
+
+    for (int j = 0; j < height; ++j)
+    {
+        yi = y + j;
+
+        if (yi < 0 || yi >= this->height)
+            continue;
+
+        for (int i = 0; i < width; ++i)
+        {
+            xi = x + i;
+
+            if (xi >= 0 && xi < this->width)
+                this->light.hues[rltmap_index(this, xi, yi)]
+                    = hues[j * width + i];
+        }
+
+        if (this->light.dirty0 < 0 || yi < this->light.dirty0)
+            this->light.dirty0 = yi;
+
+        if (yi > this->light.dirty1)
+            this->light.dirty1 = yi;
+    }
 }
 
 int
@@ -1304,7 +5520,7 @@ rlhue function implementations
 extern void
 rlhue_set(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
-    if (!this)
+    if (RL_INVALID(!this))
         return;
 
     this->r = r;
@@ -1316,7 +5532,7 @@ rlhue_set(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 extern void
 rlhue_add(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
-    if (!this)
+    if (RL_INVALID(!this))
         return;
 
     this->r = (uint8_t)(this->r + r);
@@ -1328,7 +5544,7 @@ rlhue_add(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 extern void
 rlhue_sub(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
-    if (!this)
+    if (RL_INVALID(!this))
         return;
 
     this->r = (uint8_t)(this->r - r);
@@ -1336,3 +5552,28 @@ rlhue_sub(rlhue *this, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
     this->b = (uint8_t)(this->b - b);
     this->a = (uint8_t)(this->a - a);
 }
+
+/******************************************************************************
+rlalloc function implementations
+******************************************************************************/
+
+bool
+rlalloc_set(const rlalloc *alloc)
+{
+    /* Memory from one allocator must not be returned to another */
+    if (rlalive)
+        return false;
+
+    if (!alloc)
+    {
+        rlahooks = (rlalloc){rlalloc_dmalloc, rlalloc_drealloc, rlalloc_dfree,
+            NULL};
+        return true;
+    }
+
+    if (!alloc->alloc || !alloc->realloc || !alloc->free)
+        return false;
+
+    rlahooks = *alloc;
+    return true;
+}
@@ -0,0 +1,164 @@
+/*
+ * Loads fonts in the background with rltmap_async while the main thread
+ * keeps writing and drawing another rltmap, both allocating through a
+ * counting allocator set with rlalloc_set. Every rltmap loaded this way has
+ * to draw the same frame as one from rltmap_init once adopted, one that
+ * fails to load has to draw no glyphs, the allocator can't be swapped while
+ * the loads are pending, and every block has to be freed in the end.
+ *
+ * Usage: test_async, test_async_gl
+ */
+
+#include "test.h"
+
+#include <pthread.h>
+
+#define LOADS 4
+
+/* Background hue of the tiles written */
+#define BG (rlhue){0, 0, 80, 255}
+
+/* Allocator counting its live blocks, locked as the loading threads call
+   it too */
+struct counter
+{
+    pthread_mutex_t lock;
+    long alive;
+};
+
+static void *
+count_alloc(void *user, size_t size)
+{
+    struct counter *c = user;
+    void *ptr = malloc(size);
+
+    pthread_mutex_lock(&c->lock);
+    c->alive += ptr != NULL;
+    pthread_mutex_unlock(&c->lock);
+
+    return ptr;
+}
+
+static void *
+count_realloc(void *user, void *ptr, size_t size)
+{
+    struct counter *c = user;
+    void *next = realloc(ptr, size);
+
+    pthread_mutex_lock(&c->lock);
+    c->alive += next != NULL && !ptr;
+    pthread_mutex_unlock(&c->lock);
+
+    return next;
+}
+
+static void
+count_free(void *user, void *ptr)
+{
+    struct counter *c = user;
+
+    pthread_mutex_lock(&c->lock);
+    c->alive -= ptr != NULL;
+    pthread_mutex_unlock(&c->lock);
+
+    free(ptr);
+}
+
+/* Fills an rltmap like fill, with spaces instead of text */
+static void
+blank(rltmap *tmap)
+{
+    wchar_t line[21];
+    rlhue fg = {230, 230, 200, 255};
+
+    for (int x = 0; x < 20; ++x)
+        line[x] = L' ';
+
+    line[20] = L'\0';
+
+    for (int y = 0; y < 4; ++y)
+        rltmap_wstrr(tmap, line, fg, BG, RL_TILE_TEXT, 0, y);
+}
+
+static void
+frame(rldisp *disp, rltmap *tmap, uint8_t *pixels)
+{
+    rldisp_clear(disp);
+    rldisp_dtmap(disp, tmap);
+    rldisp_prsnt(disp);
+
+    if (pixels)
+        grab(disp, pixels);
+}
+
+int
+main(void)
+{
+    int pending = LOADS, seed = 0;
+    struct test t;
+    rltmap *ref = NULL, *bad = NULL, *maps[LOADS] = {NULL};
+    struct counter counter = {PTHREAD_MUTEX_INITIALIZER, 0};
+    rlalloc hooks = {count_alloc, count_realloc, count_free, &counter};
+
+    CHECK(rlalloc_set(&hooks));
+
+    /* Loads start before the window, as they would in a game */
+    for (int i = 0; i < LOADS; ++i)
+        CHECK((maps[i] = rltmap_async(FONT, 16, 256, 20, 4, 9, 16)) != NULL);
+
+    bad = rltmap_async("missing.ttf", 16, 256, 20, 4, 9, 16);
+    CHECK(bad != NULL);
+    CHECK(!rlalloc_set(NULL));
+
+    if (!setup(&t, "test_async") || !(ref = newmap(&t, 16, 20, 4, 9, 16)))
+        goto done;
+
+    /* The main thread allocates too while the fonts load */
+    while (pending)
+    {
+        fill(ref, 20, 4, seed++, BG);
+
+        for (int i = 0; i < LOADS; ++i)
+            rldisp_dtmap(t.disp, maps[i]);
+
+        frame(t.disp, ref, NULL);
+        pending = 0;
+
+        for (int i = 0; i < LOADS; ++i)
+            pending += !rltmap_ready(maps[i], false);
+    }
+
+    printf("loaded after %d frames\n", seed);
+    fill(ref, 20, 4, 0, BG);
+    frame(t.disp, ref, t.a);
+
+    for (int i = 0; i < LOADS; ++i)
+    {
+        CHECK(rltmap_ready(maps[i], true));
+        fill(maps[i], 20, 4, 0, BG);
+        frame(t.disp, maps[i], t.b);
+        CHECK(pxdiff(t.a, t.b, fsize(t.disp)) == 0);
+    }
+
+    /* A font that fails to load draws the backgrounds but no glyphs */
+    CHECK(!rltmap_ready(bad, true));
+    fill(bad, 20, 4, 0, BG);
+    frame(t.disp, bad, t.a);
+    blank(bad);
+    frame(t.disp, bad, t.b);
+    CHECK(pxdiff(t.a, t.b, fsize(t.disp)) == 0);
+
+done:
+
+    for (int i = 0; i < LOADS; ++i)
+        rltmap_free(maps[i]);
+
+    rltmap_free(bad);
+    teardown(&t);
+
+    printf("blocks alive %ld\n", counter.alive);
+    CHECK(counter.alive == 0);
+    CHECK(rlalloc_set(NULL));
+
+    return report("async");
+}
@@ -0,0 +1,87 @@
+/*
+ * Draws a scene of rltmaps, lines and boxes immediately, then with deferred
+ * drawing, alone and with occlusion culling, and checks all the frames are
+ * the same. A panel is drawn, written to and drawn again elsewhere, so the
+ * draw held back has to show it as it was before the write, then drawn a
+ * third time, hidden elsewhere than the second.
+ *
+ * Usage: test_defer, test_defer_gl
+ */
+
+#include "test.h"
+
+/* Draws the scene and reads it back, returning the draw calls made */
+static int
+scene(rldisp *disp, rltmap *world, rltmap *panel, rltmap *cover,
+    uint8_t *pixels)
+{
+    rlstats stats;
+
+    fill(panel, 12, 6, 5, (rlhue){40, 80, 40, 255});
+
+    rldisp_clear(disp);
+    rldisp_dtmap(disp, world);
+    rldisp_dboxf(disp, 200, 10, 50, 30, (rlhue){200, 40, 40, 255});
+
+    rltmap_dpos(panel, 27, 18);
+    rldisp_dtmap(disp, panel);
+
+    /* Written to while the draw above may be held back */
+    fill(panel, 12, 6, 11, (rlhue){40, 40, 100, 255});
+    rltmap_phueb(panel, (rlhue){250, 250, 0, 255}, 0, 0);
+    rltmap_dpos(panel, 162, 114);
+    rldisp_dtmap(disp, panel);
+
+    /* Drawn again as it is, hidden elsewhere than the draw above */
+    rltmap_dpos(panel, 200, 160);
+    rldisp_dtmap(disp, panel);
+
+    rldisp_dline(disp, 0, 230, 319, 180, 2, (rlhue){0, 200, 200, 255});
+    rltmap_dpos(cover, 144, 130);
+    rldisp_dtmap(disp, cover);
+    rltmap_dpos(cover, 250, 180);
+    rldisp_dtmap(disp, cover);
+    rldisp_dboxo(disp, 140, 126, 80, 72, 2, (rlhue){255, 255, 255, 255});
+
+    rldisp_prsnt(disp);
+    grab(disp, pixels);
+    rldisp_stats(disp, &stats);
+
+    return stats.draws;
+}
+
+int
+main(void)
+{
+    int now, held;
+    struct test t;
+    rltmap *world = NULL, *panel = NULL, *cover = NULL;
+
+    if (!setup(&t, "test_defer") || !(world = newmap(&t, 16, 35, 15, 9, 16))
+        || !(panel = newmap(&t, 16, 12, 6, 9, 16))
+        || !(cover = newmap(&t, 16, 8, 4, 9, 16)))
+        goto done;
+
+    fill(world, 35, 15, 0, (rlhue){20, 20, 40, 255});
+    fill(cover, 8, 4, 9, (rlhue){90, 30, 30, 255});
+
+    now = scene(t.disp, world, panel, cover, t.a);
+
+    rldisp_defer(t.disp, true);
+    held = scene(t.disp, world, panel, cover, t.b);
+    printf("draws %d immediate, %d deferred, %d pixels differ\n", now, held,
+        pxdiff(t.a, t.b, fsize(t.disp)));
+    CHECK(pxdiff(t.a, t.b, fsize(t.disp)) == 0);
+
+    rldisp_occl(t.disp, true);
+    scene(t.disp, world, panel, cover, t.b);
+    printf("with culling %d pixels differ\n",
+        pxdiff(t.a, t.b, fsize(t.disp)));
+    CHECK(pxdiff(t.a, t.b, fsize(t.disp)) == 0);
+
+done:
+
+    teardown(&t);
+
+    return report("defer");
+}
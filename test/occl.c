@@ -0,0 +1,72 @@
+/*
+ * Draws a scene of overlapping rltmaps with occlusion culling off and on
+ * and checks both frames are the same, and that culling did hide tiles. A
+ * panel is drawn twice at different places, each draw hidden in other
+ * places by a cover drawn after it, so each draw needs a mask of its own.
+ *
+ * Usage: test_occl, test_occl_gl
+ */
+
+#include "test.h"
+
+/* Draws the scene and reads it back, returning the tiles culled */
+static int
+scene(rldisp *disp, rltmap *world, rltmap *panel, rltmap *cover,
+    uint8_t *pixels)
+{
+    rlstats stats;
+
+    rldisp_clear(disp);
+    rldisp_dtmap(disp, world);
+
+    rltmap_dpos(panel, 27, 18);
+    rldisp_dtmap(disp, panel);
+    rltmap_dpos(panel, 162, 114);
+    rldisp_dtmap(disp, panel);
+
+    /* Over the right of the first panel, then the left of the second */
+    rltmap_dpos(cover, 90, 18);
+    rldisp_dtmap(disp, cover);
+    rltmap_dpos(cover, 144, 130);
+    rldisp_dtmap(disp, cover);
+
+    rldisp_dboxf(disp, 4, 200, 60, 20, (rlhue){200, 40, 40, 255});
+    rldisp_prsnt(disp);
+    grab(disp, pixels);
+    rldisp_stats(disp, &stats);
+
+    return stats.culled;
+}
+
+int
+main(void)
+{
+    int culled;
+    struct test t;
+    rltmap *world = NULL, *panel = NULL, *cover = NULL;
+
+    if (!setup(&t, "test_occl") || !(world = newmap(&t, 16, 35, 15, 9, 16))
+        || !(panel = newmap(&t, 16, 12, 6, 9, 16))
+        || !(cover = newmap(&t, 16, 8, 4, 9, 16)))
+        goto done;
+
+    fill(world, 35, 15, 0, (rlhue){20, 20, 40, 255});
+    fill(panel, 12, 6, 5, (rlhue){40, 80, 40, 255});
+    fill(cover, 8, 4, 9, (rlhue){90, 30, 30, 255});
+
+    culled = scene(t.disp, world, panel, cover, t.a);
+    CHECK(culled == 0);
+
+    rldisp_occl(t.disp, true);
+    culled = scene(t.disp, world, panel, cover, t.b);
+    printf("culled %d, %d pixels differ\n", culled,
+        pxdiff(t.a, t.b, fsize(t.disp)));
+    CHECK(culled > 0);
+    CHECK(pxdiff(t.a, t.b, fsize(t.disp)) == 0);
+
+done:
+
+    teardown(&t);
+
+    return report("occl");
+}
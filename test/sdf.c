@@ -0,0 +1,134 @@
+/*
+ * Compares the glyphs of an rltmap drawn as signed distance fields (see
+ * rltmap_sdf) with its coverage glyphs, both at 1x. Distance fields are
+ * resolved to an edge without hinting, so single pixels differ, but the text
+ * has to cover about as much of the frame in the same places. That is
+ * checked on the frames blurred over 3 x 3 pixels, which a glyph placed a
+ * pixel off already fails. Also checks that SDF rltmaps of the same font
+ * share their glyph cache, and draw the same as one with an atlas of its
+ * own, that leaving SDF mode draws the coverage glyphs again, and that a
+ * draw held back across a switch to SDF mode draws the glyphs it was made
+ * with.
+ *
+ * Usage: test_sdf_gl
+ */
+
+#include "test.h"
+
+/* Largest difference of the blurred frames, and of the ink of the frames,
+   in percent of their ink */
+#define BLUR_DIFF 35
+#define INK_DIFF 15
+
+/* Writes text placed as each rlttype */
+static void
+sample(rltmap *tmap)
+{
+    rlhue fg = {255, 255, 255, 255}, bg = {0, 0, 0, 255};
+
+    rltmap_wstrr(tmap, L"Hello, SDF! gjy@#", fg, bg, RL_TILE_TEXT, 0, 0);
+    rltmap_wstrr(tmap, L"ABCxyz%&*", fg, bg, RL_TILE_CENTER, 0, 1);
+    rltmap_wstrr(tmap, L"._-~", fg, bg, RL_TILE_FLOOR, 0, 2);
+    rltmap_wstrr(tmap, L"EXACT", fg, bg, RL_TILE_EXACT, 0, 3);
+}
+
+static void
+frame(rldisp *disp, rltmap *tmap, uint8_t *pixels)
+{
+    rldisp_clear(disp);
+    rldisp_dtmap(disp, tmap);
+    rldisp_prsnt(disp);
+    grab(disp, pixels);
+}
+
+/* Sum of the red channel around a pixel */
+static long
+blur(const uint8_t *pixels, int x, int y)
+{
+    long sum = 0;
+
+    for (int j = y - 1; j <= y + 1; ++j)
+    for (int i = x - 1; i <= x + 1; ++i)
+    {
+        if (i >= 0 && j >= 0 && i < WIDTH && j < HEIGHT)
+            sum += pixels[(j * WIDTH + i) * 4];
+    }
+
+    return sum;
+}
+
+int
+main(void)
+{
+    long ink[2] = {0, 0}, diff = 0, total = 0;
+    struct test t;
+    rltmap *tmap = NULL, *other = NULL, *own = NULL;
+
+    if (!setup(&t, "test_sdf") || !(tmap = newmap(&t, 16, 20, 4, 9, 24)))
+        goto done;
+
+    rldisp_clrhue(t.disp, (rlhue){0, 0, 0, 255});
+    sample(tmap);
+    frame(t.disp, tmap, t.a);
+
+    CHECK(rltmap_sdf(tmap, true));
+    sample(tmap);
+    frame(t.disp, tmap, t.b);
+
+    for (int y = 0; y < HEIGHT; ++y)
+    for (int x = 0; x < WIDTH; ++x)
+    {
+        ink[0] += t.a[(y * WIDTH + x) * 4];
+        ink[1] += t.b[(y * WIDTH + x) * 4];
+        diff += labs(blur(t.a, x, y) - blur(t.b, x, y));
+        total += blur(t.a, x, y);
+    }
+
+    printf("ink %ld sdf %ld, blurred difference %ld of %ld\n", ink[0],
+        ink[1], diff, total);
+    CHECK(ink[0] > 0);
+    CHECK(labs(ink[1] - ink[0]) * 100 <= ink[0] * INK_DIFF);
+    CHECK(diff * 100 <= total * BLUR_DIFF);
+
+    /* Another font size shares the distance fields, and draws as if it had
+       an atlas of its own (it is given another layout for one) */
+    if (!(other = newmap(&t, 24, 10, 2, 14, 36))
+        || !(own = newmap(&t, 24, 10, 2, 14, 36)))
+        goto done;
+
+    CHECK(rltmap_sdf(other, true) && rltmap_sdf(own, true));
+    CHECK(rltmap_atlas(own, 512, 8, 1));
+    CHECK(other->cache == tmap->cache && own->cache != tmap->cache);
+
+    fill(other, 10, 2, 0, (rlhue){0, 0, 0, 255});
+    fill(own, 10, 2, 0, (rlhue){0, 0, 0, 255});
+    frame(t.disp, other, t.a);
+    frame(t.disp, own, t.b);
+    CHECK(pxdiff(t.a, t.b, fsize(t.disp)) == 0);
+
+    /* Back to coverage glyphs, which are rasterized as before */
+    CHECK(rltmap_sdf(tmap, false));
+    CHECK(tmap->cache != other->cache);
+    sample(tmap);
+    frame(t.disp, tmap, t.a);
+
+    CHECK(rltmap_sdf(tmap, true) && rltmap_sdf(tmap, false));
+    sample(tmap);
+    frame(t.disp, tmap, t.b);
+    CHECK(pxdiff(t.a, t.b, fsize(t.disp)) == 0);
+
+    /* A draw held back when the mode changes still shows coverage glyphs */
+    rldisp_occl(t.disp, true);
+    rldisp_clear(t.disp);
+    rldisp_dtmap(t.disp, tmap);
+    CHECK(rltmap_sdf(tmap, true));
+    rldisp_prsnt(t.disp);
+    grab(t.disp, t.b);
+    CHECK(pxdiff(t.a, t.b, fsize(t.disp)) == 0);
+
+done:
+
+    teardown(&t);
+
+    return report("sdf");
+}
@@ -0,0 +1,183 @@
+/*
+ * Helpers shared by the tests.
+ *
+ * A test is built against one backend, OpenGL when TEST_GL is defined and
+ * SFML otherwise, whose source it includes so it can read back the frame an
+ * rldisp draws into. Like the benchmark, the tests need a window, so on a
+ * headless machine run them under Xvfb (e.g. xvfb-run) with a software GL
+ * driver such as llvmpipe. A test prints one line per failed check and exits
+ * with a non-zero status if any failed.
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#ifdef TEST_GL
+#include "../src/rl_display_gl.c"
+#else
+#include "../src/rl_display_sfml.c"
+#endif
+
+#include <stdio.h>
+
+#ifndef FONT
+#define FONT "res/fonts/unifont.ttf"
+#endif
+
+/* Size of the rldisp of a test and its frame, and the most rltmaps newmap
+   makes for a test */
+#define WIDTH 320
+#define HEIGHT 240
+#define TEST_MAPS 8
+
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+/* What a test draws with: an rldisp, two frames a and b read back from it
+   to compare, and the rltmaps made by newmap */
+struct test
+{
+    rldisp *disp;
+    uint8_t *a;
+    uint8_t *b;
+    int count;
+    rltmap *maps[TEST_MAPS];
+};
+
+static int fails = 0;
+
+static void
+check(bool ok, const char *cond, const char *file, int line)
+{
+    if (ok)
+        return;
+
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, cond);
+    fails += 1;
+}
+
+/* Returns the size in bytes of a frame of an rldisp read back by grab */
+static size_t
+fsize(rldisp *disp)
+{
+    return (size_t)(disp->frame.width * disp->frame.height) * 4;
+}
+
+/* Reads back the frame of an rldisp as RGBA pixels, after it is presented.
+   Rows are in the order of the backend, which is the same for all frames
+   it compares. */
+static void
+grab(rldisp *disp, uint8_t *pixels)
+{
+#ifdef TEST_GL
+    void (*read)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void *);
+
+    read = (void (*)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum,
+        void *))glfwGetProcAddress("glReadPixels");
+
+    glfwMakeContextCurrent(disp->window.handle);
+    rlgl.BindFramebuffer(GL_FRAMEBUFFER, disp->frame.fbo);
+    rlbound = NULL;
+    read(0, 0, disp->frame.width, disp->frame.height, GL_RGBA,
+        GL_UNSIGNED_BYTE, pixels);
+#else
+    sfImage *image = sfTexture_copyToImage(sfRenderTexture_getTexture(
+        disp->frame.handle));
+
+    memcpy(pixels, sfImage_getPixelsPtr(image), fsize(disp));
+    sfImage_destroy(image);
+#endif
+}
+
+/* Returns the number of pixels that differ between two frames */
+static int
+pxdiff(const uint8_t *a, const uint8_t *b, size_t size)
+{
+    int count = 0;
+
+    for (size_t i = 0; i < size; i += 4)
+        count += memcmp(&a[i], &b[i], 4) != 0;
+
+    return count;
+}
+
+/* Opens the rldisp of a test, named name, and allocates its frames.
+   Returns false, failing the test, if it could not. */
+static bool
+setup(struct test *test, const char *name)
+{
+    *test = (struct test){NULL, NULL, NULL, 0, {NULL}};
+
+    if ((test->disp = rldisp_init(WIDTH, HEIGHT, WIDTH, HEIGHT, name,
+        false)))
+    {
+        test->a = malloc(fsize(test->disp));
+        test->b = malloc(fsize(test->disp));
+    }
+
+    if (test->a && test->b)
+        return true;
+
+    fprintf(stderr, "could not set up the display\n");
+    fails += 1;
+    return false;
+}
+
+/* Makes an rltmap of the test font with room for 256 glyphs, freed by
+   teardown. Returns NULL, failing the test, if it could not. */
+static rltmap *
+newmap(struct test *test, int csize, int width, int height, int offx,
+    int offy)
+{
+    rltmap *tmap = NULL;
+
+    if (test->count < TEST_MAPS && (tmap = rltmap_init(FONT, csize, 256,
+        width, height, offx, offy)))
+        test->maps[test->count++] = tmap;
+    else
+    {
+        fprintf(stderr, "could not make an rltmap\n");
+        fails += 1;
+    }
+
+    return tmap;
+}
+
+/* Frees the rltmaps, the rldisp and the frames of a test */
+static void
+teardown(struct test *test)
+{
+    for (int i = test->count - 1; i >= 0; --i)
+        rltmap_free(test->maps[i]);
+
+    rldisp_free(test->disp);
+    free(test->a);
+    free(test->b);
+}
+
+/* Fills width x height tiles of an rltmap with text over a background of
+   hue bg, the text varying with seed */
+static void
+fill(rltmap *tmap, int width, int height, int seed, rlhue bg)
+{
+    wchar_t line[64];
+    rlhue fg = {230, 230, 200, 255};
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+            line[x] = (wchar_t)(L'!' + (seed + x * 7 + y * 13) % 94);
+
+        line[width] = L'\0';
+        rltmap_wstrr(tmap, line, fg, bg, RL_TILE_TEXT, 0, y);
+    }
+}
+
+/* Prints the result of a test and returns its exit status */
+static int
+report(const char *name)
+{
+    printf("%s: %s\n", name, fails ? "FAIL" : "OK");
+    return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif